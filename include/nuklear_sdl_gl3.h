@@ -16,11 +16,43 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 
+/* Counters of the last drawn frame and totals since init */
+struct nk_sdl_stats {
+    nk_size vertices;        /* vertices of the last drawn frame */
+    nk_size elements;        /* indices of the last drawn frame */
+    nk_size draw_calls;      /* glDrawElements calls of the last drawn frame */
+    nk_size vertex_capacity; /* bytes per ring segment */
+    nk_size element_capacity;
+    nk_size frames_drawn;
+    nk_size frames_skipped;  /* unchanged frames (see nk_sdl_render) */
+    nk_size buffer_grows;    /* times the buffers were too small for a frame */
+};
+
+/* Fonts of the atlas as rasterised by nk_sdl_font_stash_bake, lets the
+ * application cache the bake and restore it instead of baking again. The
+ * pointers are valid until the stash ends. */
+#define NK_SDL_MAX_FONTS 8
+struct nk_sdl_font_bake {
+    int width, height;               /* alpha8 image */
+    const void *pixels;
+    int glyph_count;
+    const struct nk_font_glyph *glyphs;
+    int font_count;
+    struct nk_baked_font fonts[NK_SDL_MAX_FONTS]; /* in the order added, without ranges */
+    struct nk_recti custom;          /* white pixel and cursors */
+    struct nk_cursor cursors[NK_CURSOR_COUNT];
+};
+
 NK_API struct nk_context*   nk_sdl_init(SDL_Window *win);
 NK_API void                 nk_sdl_font_stash_begin(struct nk_font_atlas **atlas);
 NK_API void                 nk_sdl_font_stash_end(void);
+NK_API int                  nk_sdl_font_stash_bake(struct nk_sdl_font_bake *bake);
+NK_API int                  nk_sdl_font_stash_restore(const struct nk_sdl_font_bake *bake);
+NK_API struct nk_image      nk_sdl_font_stash_end_shared(const void *image, int width, int height);
 NK_API int                  nk_sdl_handle_event(SDL_Event *evt);
-NK_API void                 nk_sdl_render(enum nk_anti_aliasing , int max_vertex_buffer, int max_element_buffer);
+NK_API int                  nk_sdl_render(enum nk_anti_aliasing , int max_vertex_buffer, int max_element_buffer);
+NK_API void                 nk_sdl_invalidate(void);
+NK_API struct nk_sdl_stats  nk_sdl_frame_stats(void);
 NK_API void                 nk_sdl_shutdown(void);
 NK_API void                 nk_sdl_device_destroy(void);
 NK_API void                 nk_sdl_device_create(void);
@@ -36,8 +68,20 @@ NK_API void                 nk_sdl_device_create(void);
  */
 #ifdef NK_SDL_GL3_IMPLEMENTATION
 
+#include <stdlib.h>
 #include <string.h>
 
+/* Vertices and elements are streamed through a ring of segments, each frame
+ * writes the next segment while the GPU may still read the previous ones. A
+ * fence per segment guards against overwriting data still in use. */
+#define NK_SDL_RING_SEGMENTS 3
+
+enum nk_sdl_stream_mode {
+    NK_SDL_STREAM_ORPHAN,     /* glBufferData + glMapBuffer every frame */
+    NK_SDL_STREAM_MAP_RANGE,  /* unsynchronized glMapBufferRange into the ring */
+    NK_SDL_STREAM_PERSISTENT  /* glBufferStorage, mapped once for good */
+};
+
 struct nk_sdl_device {
     struct nk_buffer cmds;
     struct nk_draw_null_texture null;
@@ -51,6 +95,22 @@ struct nk_sdl_device {
     GLint uniform_tex;
     GLint uniform_proj;
     GLuint font_tex;
+    /* streaming ring */
+    enum nk_sdl_stream_mode stream_mode;
+    GLsizeiptr vbo_segment, ebo_segment; /* bytes per segment */
+    void *vbo_map, *ebo_map;             /* NK_SDL_STREAM_PERSISTENT */
+    GLsync fences[NK_SDL_RING_SEGMENTS];
+    int segment;
+    struct nk_sdl_stats stats;
+    /* previous frame, rendering is skipped while it is unchanged
+     * (requires NK_ZERO_COMMAND_MEMORY) */
+    void *last_cmds;
+    nk_size last_cmds_size;
+    nk_size last_cmds_capacity;
+    nk_uint last_order;
+    int last_width, last_height;
+    int last_display_width, last_display_height;
+    int invalid;
 };
 
 struct nk_sdl_vertex {
@@ -124,29 +184,18 @@ nk_sdl_device_create(void)
     dev->attrib_uv = glGetAttribLocation(dev->prog, "TexCoord");
     dev->attrib_col = glGetAttribLocation(dev->prog, "Color");
 
-    {
-        /* buffer setup */
-        GLsizei vs = sizeof(struct nk_sdl_vertex);
-        size_t vp = offsetof(struct nk_sdl_vertex, position);
-        size_t vt = offsetof(struct nk_sdl_vertex, uv);
-        size_t vc = offsetof(struct nk_sdl_vertex, col);
-
-        glGenBuffers(1, &dev->vbo);
-        glGenBuffers(1, &dev->ebo);
-        glGenVertexArrays(1, &dev->vao);
-
-        glBindVertexArray(dev->vao);
-        glBindBuffer(GL_ARRAY_BUFFER, dev->vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dev->ebo);
-
-        glEnableVertexAttribArray((GLuint)dev->attrib_pos);
-        glEnableVertexAttribArray((GLuint)dev->attrib_uv);
-        glEnableVertexAttribArray((GLuint)dev->attrib_col);
+    glGenVertexArrays(1, &dev->vao);
+    glBindVertexArray(dev->vao);
+    glEnableVertexAttribArray((GLuint)dev->attrib_pos);
+    glEnableVertexAttribArray((GLuint)dev->attrib_uv);
+    glEnableVertexAttribArray((GLuint)dev->attrib_col);
 
-        glVertexAttribPointer((GLuint)dev->attrib_pos, 2, GL_FLOAT, GL_FALSE, vs, (void*)vp);
-        glVertexAttribPointer((GLuint)dev->attrib_uv, 2, GL_FLOAT, GL_FALSE, vs, (void*)vt);
-        glVertexAttribPointer((GLuint)dev->attrib_col, 4, GL_UNSIGNED_BYTE, GL_TRUE, vs, (void*)vc);
-    }
+    /* buffers are created on the first render once their sizes are known */
+    if ((GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) && (GLEW_VERSION_3_2 || GLEW_ARB_sync))
+        dev->stream_mode = NK_SDL_STREAM_PERSISTENT;
+    else if (GLEW_VERSION_3_2 || (GLEW_ARB_map_buffer_range && GLEW_ARB_sync))
+        dev->stream_mode = NK_SDL_STREAM_MAP_RANGE;
+    else dev->stream_mode = NK_SDL_STREAM_ORPHAN;
 
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -166,6 +215,119 @@ nk_sdl_device_upload_atlas(const void *image, int width, int height)
                 GL_RGBA, GL_UNSIGNED_BYTE, image);
 }
 
+NK_INTERN void
+nk_sdl_stream_destroy(void)
+{
+    struct nk_sdl_device *dev = &sdl.ogl;
+    int i;
+    for (i = 0; i < NK_SDL_RING_SEGMENTS; ++i) {
+        if (dev->fences[i]) glDeleteSync(dev->fences[i]);
+        dev->fences[i] = 0;
+    }
+    if (dev->vbo_map) {
+        glBindBuffer(GL_ARRAY_BUFFER, dev->vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    if (dev->ebo_map) {
+        glBindBuffer(GL_ARRAY_BUFFER, dev->ebo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (dev->vbo) glDeleteBuffers(1, &dev->vbo);
+    if (dev->ebo) glDeleteBuffers(1, &dev->ebo);
+    dev->vbo = dev->ebo = 0;
+    dev->vbo_map = dev->ebo_map = NULL;
+    dev->vbo_segment = dev->ebo_segment = 0;
+    dev->segment = 0;
+}
+
+/* (Re)creates the buffers for segments of the given sizes, buffer storage is
+ * immutable so the buffers are replaced rather than resized */
+NK_INTERN void
+nk_sdl_stream_create(GLsizeiptr vbo_segment, GLsizeiptr ebo_segment)
+{
+    struct nk_sdl_device *dev = &sdl.ogl;
+    const GLsizeiptr vbo_size = vbo_segment * NK_SDL_RING_SEGMENTS;
+    const GLsizeiptr ebo_size = ebo_segment * NK_SDL_RING_SEGMENTS;
+    nk_sdl_stream_destroy();
+    dev->vbo_segment = vbo_segment;
+    dev->ebo_segment = ebo_segment;
+
+    glGenBuffers(1, &dev->vbo);
+    glGenBuffers(1, &dev->ebo);
+    glBindVertexArray(dev->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, dev->vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dev->ebo);
+
+    if (dev->stream_mode == NK_SDL_STREAM_PERSISTENT) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, vbo_size, NULL, flags);
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, ebo_size, NULL, flags);
+        dev->vbo_map = glMapBufferRange(GL_ARRAY_BUFFER, 0, vbo_size, flags);
+        dev->ebo_map = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, ebo_size, flags);
+        if (dev->vbo_map && dev->ebo_map) return;
+
+        /* driver refused the persistent mapping, use plain buffers instead */
+        dev->stream_mode = NK_SDL_STREAM_MAP_RANGE;
+        nk_sdl_stream_create(vbo_segment, ebo_segment);
+        return;
+    }
+    glBufferData(GL_ARRAY_BUFFER, vbo_size, NULL, GL_STREAM_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ebo_size, NULL, GL_STREAM_DRAW);
+}
+
+/* Waits until the GPU is done reading the segment from NK_SDL_RING_SEGMENTS frames ago */
+NK_INTERN void
+nk_sdl_stream_wait(int segment)
+{
+    struct nk_sdl_device *dev = &sdl.ogl;
+    GLsync fence = dev->fences[segment];
+    GLbitfield flags = 0;
+    if (!fence) return;
+    for (;;) {
+        GLenum status = glClientWaitSync(fence, flags, 1000000000);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED ||
+            status == GL_WAIT_FAILED) break;
+        flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    }
+    glDeleteSync(fence);
+    dev->fences[segment] = 0;
+}
+
+/* Maps the segment for writing, the pointers are valid until nk_sdl_stream_unmap */
+NK_INTERN int
+nk_sdl_stream_map(int segment, void **vertices, void **elements)
+{
+    struct nk_sdl_device *dev = &sdl.ogl;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    *vertices = *elements = NULL;
+    switch (dev->stream_mode) {
+    case NK_SDL_STREAM_PERSISTENT:
+        *vertices = (nk_byte*)dev->vbo_map + dev->vbo_segment * segment;
+        *elements = (nk_byte*)dev->ebo_map + dev->ebo_segment * segment;
+        break;
+    case NK_SDL_STREAM_MAP_RANGE:
+        *vertices = glMapBufferRange(GL_ARRAY_BUFFER, dev->vbo_segment * segment, dev->vbo_segment, flags);
+        *elements = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, dev->ebo_segment * segment, dev->ebo_segment, flags);
+        break;
+    case NK_SDL_STREAM_ORPHAN:
+        glBufferData(GL_ARRAY_BUFFER, dev->vbo_segment, NULL, GL_STREAM_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, dev->ebo_segment, NULL, GL_STREAM_DRAW);
+        *vertices = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+        *elements = glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
+        break;
+    }
+    return *vertices && *elements;
+}
+
+NK_INTERN void
+nk_sdl_stream_unmap(void)
+{
+    if (sdl.ogl.stream_mode == NK_SDL_STREAM_PERSISTENT) return;
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+}
+
 NK_API void
 nk_sdl_device_destroy(void)
 {
@@ -176,17 +338,81 @@ nk_sdl_device_destroy(void)
     glDeleteShader(dev->frag_shdr);
     glDeleteProgram(dev->prog);
     glDeleteTextures(1, &dev->font_tex);
-    glDeleteBuffers(1, &dev->vbo);
-    glDeleteBuffers(1, &dev->ebo);
+    nk_sdl_stream_destroy();
+    glDeleteVertexArrays(1, &dev->vao);
     nk_buffer_free(&dev->cmds);
+    free(dev->last_cmds);
+    dev->last_cmds = NULL;
+    dev->last_cmds_size = dev->last_cmds_capacity = 0;
 }
 
 NK_API void
+nk_sdl_invalidate(void)
+{
+    sdl.ogl.invalid = 1;
+}
+
+NK_API struct nk_sdl_stats
+nk_sdl_frame_stats(void)
+{
+    struct nk_sdl_stats stats = sdl.ogl.stats;
+    stats.vertex_capacity = (nk_size)sdl.ogl.vbo_segment;
+    stats.element_capacity = (nk_size)sdl.ogl.ebo_segment;
+    return stats;
+}
+
+/* Returns 1 if the frame differs from the previous one and remembers it. The
+ * command memory is compared as is, the window order and the window size are
+ * compared separately as they change the output without changing commands. */
+NK_INTERN int
+nk_sdl_frame_changed(int width, int height, int display_width, int display_height)
+{
+    struct nk_sdl_device *dev = &sdl.ogl;
+    const struct nk_context *ctx = &sdl.ctx;
+    const void *cmds = nk_buffer_memory_const(&ctx->memory);
+    const nk_size size = ctx->memory.allocated;
+    const struct nk_window *win;
+    nk_uint order = 2166136261u;
+    int changed;
+
+    for (win = ctx->begin; win; win = win->next) {
+        if ((win->flags & NK_WINDOW_HIDDEN) || win->seq != ctx->seq) continue;
+        order = (order ^ (nk_uint)win->buffer.begin) * 16777619u;
+    }
+
+    changed = dev->invalid || !dev->last_cmds || size != dev->last_cmds_size ||
+        order != dev->last_order || width != dev->last_width ||
+        height != dev->last_height || display_width != dev->last_display_width ||
+        display_height != dev->last_display_height ||
+        memcmp(cmds, dev->last_cmds, size) != 0;
+    if (!changed) return 0;
+
+    if (size > dev->last_cmds_capacity || !dev->last_cmds) {
+        dev->last_cmds_capacity = size > 0 ? size : 1;
+        dev->last_cmds = realloc(dev->last_cmds, dev->last_cmds_capacity);
+    }
+    memcpy(dev->last_cmds, cmds, size);
+    dev->last_cmds_size = size;
+    dev->last_order = order;
+    dev->last_width = width;
+    dev->last_height = height;
+    dev->last_display_width = display_width;
+    dev->last_display_height = display_height;
+    dev->invalid = 0;
+    return 1;
+}
+
+/* Returns 0 without drawing if nothing changed since the previous frame, the
+ * previously presented frame is still valid then and should not be swapped.
+ * The buffer sizes are initial sizes, the buffers grow when a frame does not
+ * fit. Define NK_UINT_DRAW_INDEX for UIs of more than 64k vertices. */
+NK_API int
 nk_sdl_render(enum nk_anti_aliasing AA, int max_vertex_buffer, int max_element_buffer)
 {
     struct nk_sdl_device *dev = &sdl.ogl;
     int width, height;
     int display_width, display_height;
+    int drawn;
     struct nk_vec2 scale;
     GLfloat ortho[4][4] = {
         {2.0f, 0.0f, 0.0f, 0.0f},
@@ -196,6 +422,11 @@ nk_sdl_render(enum nk_anti_aliasing AA, int max_vertex_buffer, int max_element_b
     };
     SDL_GetWindowSize(sdl.win, &width, &height);
     SDL_GL_GetDrawableSize(sdl.win, &display_width, &display_height);
+    if (!nk_sdl_frame_changed(width, height, display_width, display_height)) {
+        nk_clear(&sdl.ctx);
+        dev->stats.frames_skipped++;
+        return 0;
+    }
     ortho[0][0] /= (GLfloat)width;
     ortho[1][1] /= (GLfloat)height;
 
@@ -222,46 +453,85 @@ nk_sdl_render(enum nk_anti_aliasing AA, int max_vertex_buffer, int max_element_b
         void *vertices, *elements;
         const nk_draw_index *offset = NULL;
         struct nk_buffer vbuf, ebuf;
+        GLsizei vs = sizeof(struct nk_sdl_vertex);
+        GLsizeiptr vp;
+        int segment;
+
+        /* fill convert configuration */
+        struct nk_convert_config config;
+        static const struct nk_draw_vertex_layout_element vertex_layout[] = {
+            {NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, position)},
+            {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, uv)},
+            {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(struct nk_sdl_vertex, col)},
+            {NK_VERTEX_LAYOUT_END}
+        };
+        NK_MEMSET(&config, 0, sizeof(config));
+        config.vertex_layout = vertex_layout;
+        config.vertex_size = sizeof(struct nk_sdl_vertex);
+        config.vertex_alignment = NK_ALIGNOF(struct nk_sdl_vertex);
+        config.null = dev->null;
+        config.circle_segment_count = 22;
+        config.curve_segment_count = 22;
+        config.arc_segment_count = 22;
+        config.global_alpha = 1.0f;
+        config.shape_AA = AA;
+        config.line_AA = AA;
+
+        /* the segments hold whole vertices so that they can be addressed by attribute offset */
+        if (max_vertex_buffer / vs * vs > dev->vbo_segment || max_element_buffer > dev->ebo_segment)
+            nk_sdl_stream_create(NK_MAX(dev->vbo_segment, max_vertex_buffer / vs * vs),
+                NK_MAX(dev->ebo_segment, max_element_buffer));
+        segment = dev->stream_mode == NK_SDL_STREAM_ORPHAN ? 0 : dev->segment;
+        nk_sdl_stream_wait(segment);
 
-        /* allocate vertex and element buffer */
         glBindVertexArray(dev->vao);
         glBindBuffer(GL_ARRAY_BUFFER, dev->vbo);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dev->ebo);
 
-        glBufferData(GL_ARRAY_BUFFER, max_vertex_buffer, NULL, GL_STREAM_DRAW);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, max_element_buffer, NULL, GL_STREAM_DRAW);
-
-        /* load vertices/elements directly into vertex/element buffer */
-        vertices = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-        elements = glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
-        {
-            /* fill convert configuration */
-            struct nk_convert_config config;
-            static const struct nk_draw_vertex_layout_element vertex_layout[] = {
-                {NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, position)},
-                {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, uv)},
-                {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(struct nk_sdl_vertex, col)},
-                {NK_VERTEX_LAYOUT_END}
-            };
-            NK_MEMSET(&config, 0, sizeof(config));
-            config.vertex_layout = vertex_layout;
-            config.vertex_size = sizeof(struct nk_sdl_vertex);
-            config.vertex_alignment = NK_ALIGNOF(struct nk_sdl_vertex);
-            config.null = dev->null;
-            config.circle_segment_count = 22;
-            config.curve_segment_count = 22;
-            config.arc_segment_count = 22;
-            config.global_alpha = 1.0f;
-            config.shape_AA = AA;
-            config.line_AA = AA;
-
-            /* setup buffers to load vertices and elements */
-            nk_buffer_init_fixed(&vbuf, vertices, (nk_size)max_vertex_buffer);
-            nk_buffer_init_fixed(&ebuf, elements, (nk_size)max_element_buffer);
-            nk_convert(&sdl.ctx, &dev->cmds, &vbuf, &ebuf, &config);
+        /* load vertices/elements directly into the segment, growing the
+         * buffers and converting again until the frame fits */
+        for (;;) {
+            nk_flags result = NK_CONVERT_SUCCESS;
+            GLsizeiptr vbo_segment = dev->vbo_segment, ebo_segment = dev->ebo_segment;
+            drawn = nk_sdl_stream_map(segment, &vertices, &elements);
+            if (drawn) {
+                nk_buffer_clear(&dev->cmds);
+                nk_buffer_init_fixed(&vbuf, vertices, (nk_size)dev->vbo_segment);
+                nk_buffer_init_fixed(&ebuf, elements, (nk_size)dev->ebo_segment);
+                result = nk_convert(&sdl.ctx, &dev->cmds, &vbuf, &ebuf, &config);
+            }
+            nk_sdl_stream_unmap();
+            if (!drawn || !(result & (NK_CONVERT_VERTEX_BUFFER_FULL | NK_CONVERT_ELEMENT_BUFFER_FULL)))
+                break;
+
+            if (result & NK_CONVERT_VERTEX_BUFFER_FULL)
+                vbo_segment = NK_MAX(2 * vbo_segment, (GLsizeiptr)vbuf.needed / vs * vs + vs);
+            if (result & NK_CONVERT_ELEMENT_BUFFER_FULL)
+                ebo_segment = NK_MAX(2 * ebo_segment, (GLsizeiptr)((ebuf.needed / sizeof(nk_draw_index) + 1) * sizeof(nk_draw_index)));
+            nk_sdl_stream_create(vbo_segment, ebo_segment);
+            dev->stats.buffer_grows++;
+            segment = 0;
         }
-        glUnmapBuffer(GL_ARRAY_BUFFER);
-        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+        if (!drawn) {
+            /* mapping failed, e.g. the context was lost, drop the frame */
+            nk_clear(&sdl.ctx);
+            nk_sdl_invalidate();
+            goto cleanup;
+        }
+        dev->stats.frames_drawn++;
+        dev->stats.vertices = vbuf.allocated / (nk_size)vs;
+        dev->stats.elements = ebuf.allocated / sizeof(nk_draw_index);
+        dev->stats.draw_calls = 0;
+
+        /* point the attributes at the segment */
+        vp = dev->vbo_segment * segment;
+        glVertexAttribPointer((GLuint)dev->attrib_pos, 2, GL_FLOAT, GL_FALSE, vs,
+            (void*)(vp + offsetof(struct nk_sdl_vertex, position)));
+        glVertexAttribPointer((GLuint)dev->attrib_uv, 2, GL_FLOAT, GL_FALSE, vs,
+            (void*)(vp + offsetof(struct nk_sdl_vertex, uv)));
+        glVertexAttribPointer((GLuint)dev->attrib_col, 4, GL_UNSIGNED_BYTE, GL_TRUE, vs,
+            (void*)(vp + offsetof(struct nk_sdl_vertex, col)));
+        offset = (const nk_draw_index*)(nk_size)(dev->ebo_segment * segment);
 
         /* iterate over and execute each draw command */
         nk_draw_foreach(cmd, &sdl.ctx, &dev->cmds) {
@@ -271,18 +541,27 @@ nk_sdl_render(enum nk_anti_aliasing AA, int max_vertex_buffer, int max_element_b
                 (GLint)((height - (GLint)(cmd->clip_rect.y + cmd->clip_rect.h)) * scale.y),
                 (GLint)(cmd->clip_rect.w * scale.x),
                 (GLint)(cmd->clip_rect.h * scale.y));
-            glDrawElements(GL_TRIANGLES, (GLsizei)cmd->elem_count, GL_UNSIGNED_SHORT, offset);
+            glDrawElements(GL_TRIANGLES, (GLsizei)cmd->elem_count,
+                sizeof(nk_draw_index) == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT, offset);
             offset += cmd->elem_count;
+            dev->stats.draw_calls++;
         }
         nk_clear(&sdl.ctx);
+
+        if (dev->stream_mode != NK_SDL_STREAM_ORPHAN) {
+            dev->fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            dev->segment = (segment + 1) % NK_SDL_RING_SEGMENTS;
+        }
     }
 
+cleanup:
     glUseProgram(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     glDisable(GL_BLEND);
     glDisable(GL_SCISSOR_TEST);
+    return drawn;
 }
 
 static void
@@ -339,6 +618,121 @@ nk_sdl_font_stash_end(void)
 
 }
 
+/* Rasterises the fonts added since nk_sdl_font_stash_begin, bake may be NULL */
+NK_API int
+nk_sdl_font_stash_bake(struct nk_sdl_font_bake *bake)
+{
+    struct nk_font_atlas *atlas = &sdl.atlas;
+    struct nk_font *font;
+    int w, h;
+    if (!nk_font_atlas_bake(atlas, &w, &h, NK_FONT_ATLAS_ALPHA8))
+        return 0;
+    if (!bake) return 1;
+    nk_zero(bake, sizeof(*bake));
+    bake->width = w;
+    bake->height = h;
+    bake->pixels = atlas->pixel;
+    bake->glyph_count = atlas->glyph_count;
+    bake->glyphs = atlas->glyphs;
+    for (font = atlas->fonts; font; font = font->next) {
+        if (bake->font_count == NK_SDL_MAX_FONTS) return 0;
+        bake->fonts[bake->font_count] = font->info;
+        bake->fonts[bake->font_count++].ranges = 0;
+    }
+    bake->custom = atlas->custom;
+    memcpy(bake->cursors, atlas->cursors, sizeof(bake->cursors));
+    return 1;
+}
+
+/* Uses a previous bake of the same fonts instead of rasterising them again,
+ * returns 0 if the bake does not fit the fonts added */
+NK_API int
+nk_sdl_font_stash_restore(const struct nk_sdl_font_bake *bake)
+{
+    struct nk_font_atlas *atlas = &sdl.atlas;
+    struct nk_font *font;
+    int i = 0;
+    for (font = atlas->fonts; font; font = font->next) ++i;
+    if (!bake || i == 0 || i != bake->font_count || atlas->pixel || bake->glyph_count <= 0)
+        return 0;
+    for (i = 0; i < bake->font_count; ++i) {
+        if (bake->fonts[i].glyph_offset + bake->fonts[i].glyph_count > (nk_rune)bake->glyph_count)
+            return 0;
+    }
+
+    atlas->glyph_count = bake->glyph_count;
+    atlas->glyphs = (struct nk_font_glyph*)atlas->permanent.alloc(atlas->permanent.userdata, 0,
+        sizeof(struct nk_font_glyph) * (nk_size)bake->glyph_count);
+    atlas->pixel = atlas->temporary.alloc(atlas->temporary.userdata, 0,
+        (nk_size)bake->width * (nk_size)bake->height);
+    if (!atlas->glyphs || !atlas->pixel) return 0;
+    memcpy(atlas->glyphs, bake->glyphs, sizeof(struct nk_font_glyph) * (nk_size)bake->glyph_count);
+    memcpy(atlas->pixel, bake->pixels, (nk_size)bake->width * (nk_size)bake->height);
+    atlas->tex_width = bake->width;
+    atlas->tex_height = bake->height;
+    atlas->custom = bake->custom;
+    memcpy(atlas->cursors, bake->cursors, sizeof(atlas->cursors));
+    for (font = atlas->fonts, i = 0; font; font = font->next, ++i) {
+        font->info = bake->fonts[i];
+        font->info.ranges = font->config->range;
+        nk_font_init(font, font->config->size, font->config->fallback_glyph, atlas->glyphs,
+            &font->info, nk_handle_ptr(0));
+    }
+    return 1;
+}
+
+/* Like nk_sdl_font_stash_end but uploads the RGBA32 image of width x height
+ * below the font into the same texture, so that text and the image (e.g. an
+ * icon atlas) can be drawn in one batch. The fonts are baked unless already
+ * baked or restored. Returns the image as a sub-image of that texture. */
+NK_API struct nk_image
+nk_sdl_font_stash_end_shared(const void *image, int width, int height)
+{
+    const nk_byte *font; int font_w, font_h, w, h, x, y, i;
+    float scale_u, scale_v;
+    nk_byte *pixels;
+    if (!sdl.atlas.pixel && !nk_sdl_font_stash_bake(0))
+        return nk_image_id(0);
+    font = (const nk_byte*)sdl.atlas.pixel;
+    font_w = sdl.atlas.tex_width;
+    font_h = sdl.atlas.tex_height;
+    w = NK_MAX(font_w, width);
+    h = font_h + height;
+    pixels = (nk_byte*)calloc((size_t)w * (size_t)h, 4);
+    for (y = 0; y < font_h; ++y) {
+        for (x = 0; x < font_w; ++x) {
+            nk_byte *dst = &pixels[((size_t)y * w + x) * 4];
+            dst[0] = dst[1] = dst[2] = 0xFF; /* white glyphs, as nk_font_bake_convert */
+            dst[3] = font[(size_t)y * font_w + x];
+        }
+    }
+    for (y = 0; y < height; ++y)
+        memcpy(&pixels[(size_t)(font_h + y) * w * 4], (const nk_byte*)image + (size_t)y * width * 4, (size_t)width * 4);
+    nk_sdl_device_upload_atlas(pixels, w, h);
+    free(pixels);
+
+    /* glyph uvs are relative to the baked font, the pixel positions of the
+     * white pixel and the cursors are unchanged as the font is at the origin */
+    scale_u = (float)font_w / (float)w;
+    scale_v = (float)font_h / (float)h;
+    for (i = 0; i < sdl.atlas.glyph_count; ++i) {
+        struct nk_font_glyph *g = &sdl.atlas.glyphs[i];
+        g->u0 *= scale_u; g->u1 *= scale_u;
+        g->v0 *= scale_v; g->v1 *= scale_v;
+    }
+    for (i = 0; i < NK_CURSOR_COUNT; ++i) {
+        sdl.atlas.cursors[i].img.w = (unsigned short)w;
+        sdl.atlas.cursors[i].img.h = (unsigned short)h;
+    }
+    sdl.atlas.tex_width = w;
+    sdl.atlas.tex_height = h;
+    nk_font_atlas_end(&sdl.atlas, nk_handle_id((int)sdl.ogl.font_tex), &sdl.ogl.null);
+    if (sdl.atlas.default_font)
+        nk_style_set_font(&sdl.ctx, &sdl.atlas.default_font->handle);
+    return nk_subimage_id((int)sdl.ogl.font_tex, (unsigned short)w, (unsigned short)h,
+        nk_rect(0, (float)font_h, (float)width, (float)height));
+}
+
 NK_API int
 nk_sdl_handle_event(SDL_Event *evt)
 {
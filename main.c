@@ -1,5 +1,10 @@
+#define _DEFAULT_SOURCE // POSIX file mapping & I/O (mmap, fstat, etc)
+
 #include <assert.h>
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <ncurses.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -7,8 +12,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "ui_help_strs.h"
 
@@ -31,11 +40,14 @@
 #define NK_IMPLEMENTATION
 #define NK_SDL_GL3_IMPLEMENTATION
 #define NK_KEYSTATE_BASED_INPUT
+#define NK_ZERO_COMMAND_MEMORY // Lets nk_sdl_render skip unchanged frames
+#define NK_UINT_DRAW_INDEX     // 32-bit indices, large lists exceed 64k vertices
 
 #include "include/nuklear.h"
 #include "include/nuklear_sdl_gl3.h"
 #include "style.h"
 
+// Initial sizes of the GUI vertex & index buffers, they grow when needed
 #define MAX_VERTEX_MEMORY 512 * 1024
 #define MAX_ELEMENT_MEMORY 128 * 1024
 
@@ -78,6 +90,18 @@ static struct {
   bool HARD_MODE;
   bool FULLSCREEN;
   int LANGUAGE;
+  uint32_t EVENTLOG_CAPACITY; // Size of the event log ring in bytes
+  uint32_t AUTOSAVE_SLOTS;    // Number of rotating autosave files, 0 disables autosaves
+  bool RECORD_REPLAY;         // Record the seed and player commands for replays
+  bool STATE_HASH_TRACE;      // Trace the state hash of every timestep alongside the replay
+  uint32_t REWIND_BUDGET_MB;  // Memory kept for rewind snapshots, 0 disables rewinding
+  uint32_t REWIND_INTERVAL;   // Timesteps between rewind snapshots
+  const char *CATALOGUE;      // Name of the content catalogue in the resources folder
+  bool COMPRESSION;           // LZ compress savegames and the event journal
+  uint32_t AUTOSAVE_CHECKPOINT_INTERVAL; // Autosaves per full checkpoint, the others are deltas
+  bool VSYNC;                 // Synchronise buffer swaps with the display refresh
+  uint32_t FPS_CAP;           // Maximum frames drawn per second, 0 is uncapped
+  bool ASSET_OVERRIDES;       // Read assets from the resources folder even if embedded
   struct Resolution RESOLUTION;
   enum DIFFICULTY DIFFICULTY;
 } CONFIG;
@@ -103,6 +127,74 @@ char *str_concat_new(const char *lhs, const char *rhs) {
   return new_str;
 }
 
+/***** frame arena *****/
+// Bump allocator for the temporary text of a frame, reset at its start so that
+// the GUI formats its strings without touching the heap. A frame that runs out
+// gets truncated strings and the arena grows before the next frame.
+#define FRAME_ARENA_DEFAULT_SIZE (16 * 1024)
+
+static struct {
+  char *base;
+  size_t size;
+  size_t used;
+  size_t needed; // Bytes the current frame asked for, used or not
+} frame_arena;
+
+// Frees the memory of the last frame, call once at the start of every frame
+void frame_arena_reset() {
+  if (frame_arena.needed > frame_arena.size || frame_arena.base == NULL) {
+    size_t size = frame_arena.size ? frame_arena.size : FRAME_ARENA_DEFAULT_SIZE;
+    while (size < frame_arena.needed) {
+      size *= 2;
+    }
+    frame_arena.base = (char *)realloc(frame_arena.base, size);
+    frame_arena.size = size;
+  }
+  frame_arena.used = 0;
+  frame_arena.needed = 0;
+}
+
+// Returns size bytes valid until the next frame, NULL if the arena is full
+char *frame_alloc(const size_t size) {
+  frame_arena.needed += size;
+  if (frame_arena.used + size > frame_arena.size) {
+    return NULL;
+  }
+  char *ptr = &frame_arena.base[frame_arena.used];
+  frame_arena.used += size;
+  return ptr;
+}
+
+// printf into a string valid until the next frame
+const char *frame_vprintf(const char *fmt, va_list args) {
+  va_list lng_args;
+  va_copy(lng_args, args);
+  const int lng = vsnprintf(NULL, 0, fmt, lng_args);
+  va_end(lng_args);
+  char *str = lng < 0 ? NULL : frame_alloc(lng + 1);
+  if (str == NULL) {
+    // Out of arena, whatever fits of the string is the best there is
+    const size_t left = frame_arena.size - frame_arena.used;
+    if (left == 0) {
+      return "";
+    }
+    str = &frame_arena.base[frame_arena.used];
+    frame_arena.used += left;
+    vsnprintf(str, left, fmt, args);
+    return str;
+  }
+  vsnprintf(str, lng + 1, fmt, args);
+  return str;
+}
+
+const char *frame_printf(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  const char *str = frame_vprintf(fmt, args);
+  va_end(args);
+  return str;
+}
+
 /***** file utility functions *****/
 // Returns callee owned ptr to file contents, NULL on failure
 const char *open_file(const char *filepath) {
@@ -122,7 +214,101 @@ const char *open_file(const char *filepath) {
   return file_contents;
 }
 
-static  float uniform_random() { return rand() / RAND_MAX; }
+/***** embedded assets *****/
+// Builds with -DEMBED_ASSETS compile the C file written by --embed into the
+// executable: the assets and a table of them by logical name, their path in
+// the resources folder. Embedded assets are read without any file I/O unless
+// "asset_overrides" in config.json sends the game to the resources folder.
+#define EMBEDDED_ASSETS_ALIGNMENT 16 // Enough for the structs of the cooked blobs
+
+struct EmbeddedAsset {
+  const char *name;
+  const uint8_t *data; // Followed by a NUL so that text can be parsed in place
+  size_t size;
+};
+
+#ifdef EMBED_ASSETS
+#include "resources/embedded_assets.c"
+#else
+static const struct EmbeddedAsset embedded_assets[] = {{NULL, NULL, 0}};
+#endif
+
+// Returns the asset embedded as name, NULL if there is none or it is overridden
+const struct EmbeddedAsset *asset_embedded(const char *name) {
+  assert(name);
+  if (CONFIG.ASSET_OVERRIDES) {
+    return NULL;
+  }
+  for (const struct EmbeddedAsset *asset = embedded_assets; asset->name; asset++) {
+    if (strcmp(asset->name, name) == 0) {
+      return asset;
+    }
+  }
+  return NULL;
+}
+
+// Writes the C file of the assets given as name=path, returns false on failure
+bool embed_assets(const char *c_filepath, char **assets, const int num_assets) {
+  assert(c_filepath); assert(assets);
+  char *tmp_filepath = str_concat_new(c_filepath, ".tmp");
+  FILE *out = fopen(tmp_filepath, "w");
+  size_t *sizes = (size_t *)calloc(num_assets + 1, sizeof(size_t));
+  bool success = out != NULL;
+  if (success) {
+    fprintf(out, "// Generated by rome-total-simulation --embed, do not edit\n\n");
+  }
+  for (int i = 0; success && i < num_assets; i++) {
+    const char *path = strchr(assets[i], '=');
+    FILE *in = path ? fopen(&path[1], "rb") : NULL;
+    if (in == NULL) {
+      fprintf(stderr, "[ColoniaC]: Failed to embed %s, expected name=path of an existing file \n", assets[i]);
+      success = false;
+      break;
+    }
+    fprintf(out, "_Alignas(%d) static const uint8_t embedded_asset_%d[] = {", EMBEDDED_ASSETS_ALIGNMENT, i);
+    for (int c = fgetc(in); c != EOF; c = fgetc(in)) {
+      fprintf(out, "%s%d,", sizes[i]++ % 32 == 0 ? "\n" : "", c);
+    }
+    fprintf(out, "0};\n\n");
+    success = !ferror(in);
+    fclose(in);
+  }
+  if (success) {
+    fprintf(out, "static const struct EmbeddedAsset embedded_assets[] = {\n");
+    for (int i = 0; i < num_assets; i++) {
+      const int name_lng = strchr(assets[i], '=') - assets[i];
+      fprintf(out, "    {\"%.*s\", embedded_asset_%d, %zu},\n", name_lng, assets[i], i, sizes[i]);
+    }
+    fprintf(out, "    {NULL, NULL, 0}};\n");
+  }
+  success = out && fclose(out) == 0 && success && rename(tmp_filepath, c_filepath) == 0;
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: Failed to write %s \n", c_filepath);
+  }
+  free(sizes);
+  free(tmp_filepath);
+  return success;
+}
+
+/***** random number generation *****/
+// Game RNG (xorshift64*), its state is part of the savegame so that a loaded
+// game continues with the same random sequence
+#define RANDOM_U32_MAX UINT32_MAX
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static void random_seed(const uint64_t seed) {
+  rng_state = seed ? seed : 0x9E3779B97F4A7C15ull; // State must be non-zero
+}
+
+static uint32_t random_u32() {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (rng_state * 0x2545F4914F6CDD1Dull) >> 32;
+}
+
+// FIXME: Integer division, returns 0 except at RANDOM_U32_MAX (as rand() / RAND_MAX did)
+static  float uniform_random() { return random_u32() / RANDOM_U32_MAX; }
 
 // NOTE: Julian calendar introduced Jan. 1st of 45 BC
 struct Date {
@@ -136,20 +322,15 @@ struct Date {
 static struct Date date;
 
 // NOTE: Modern Roman numerals (I, V, X, L, C, D, M), (1, 5, 10, 50, 100, 500,
-// 1000) NOTE: Using subtractive notation API: Callee-responsible for freeing
-// the returned pointer
-static  char *roman_numeral_new_str(const uint32_t n) {
+// 1000) NOTE: Using subtractive notation API: The string is valid until the
+// next frame (frame_alloc)
+static const char *roman_numeral_str(const uint32_t n) {
   const div_t M = div(n, 1000);
   const div_t C = div(M.rem, 100);
   const div_t X = div(C.rem, 10);
   const div_t I = div(X.rem, 1);
 
-  char Ms[M.quot];
-  for (int32_t i = 0; i < M.quot; i++) {
-    Ms[i] = (char)'M';
-  }
-
-  char *Cs = NULL;
+  const char *Cs = "";
   size_t Cs_size = 0;
   switch (C.quot) {
   case 1:
@@ -190,7 +371,7 @@ static  char *roman_numeral_new_str(const uint32_t n) {
     break;
   }
 
-  char *Xs = NULL;
+  const char *Xs = "";
   size_t Xs_size = 0;
   switch (X.quot) {
   case 1:
@@ -231,7 +412,7 @@ static  char *roman_numeral_new_str(const uint32_t n) {
     break;
   }
 
-  char *Is = NULL;
+  const char *Is = "";
   size_t Is_size = 0;
   switch (I.quot) {
   case 1:
@@ -252,7 +433,7 @@ static  char *roman_numeral_new_str(const uint32_t n) {
     break;
   case 5:
     Is = "V";
-    Is_size = 2;
+    Is_size = 1;
     break;
   case 6:
     Is = "VI";
@@ -273,10 +454,13 @@ static  char *roman_numeral_new_str(const uint32_t n) {
   }
 
   const size_t str_len = M.quot + Cs_size + Xs_size + Is_size;
-  char *str = calloc(str_len + 1, 1);
+  char *str = frame_alloc(str_len + 1);
+  if (str == NULL) {
+    return "";
+  }
 
   size_t p = 0;
-  memcpy(&str[p], Ms, M.quot);
+  memset(&str[p], 'M', M.quot);
   p += M.quot;
 
   memcpy(&str[p], Cs, Cs_size);
@@ -288,7 +472,6 @@ static  char *roman_numeral_new_str(const uint32_t n) {
   memcpy(&str[p], Is, Is_size);
   p += Is_size;
 
-  p++;
   str[p] = '\0';
 
   return str;
@@ -310,9 +493,9 @@ static  uint32_t get_days_in_month(const struct Date date) {
   return month_lngs[date.month];
 }
 
-// Callee-owned date string
+// Date string valid until the next frame (frame_alloc)
 enum DateFormat { DATE_FORMAT_SHORT, DATE_FORMAT_MEDIUM, DATE_FORMAT_LONG };
-static char *get_new_date_str(const struct Date d, const enum DateFormat fmt) {
+static const char *get_date_str(const struct Date d, const enum DateFormat fmt) {
   char *fmt_str = NULL;
   if (d.year < 0) {
     fmt_str = " %d BC";
@@ -330,10 +513,7 @@ static char *get_new_date_str(const struct Date d, const enum DateFormat fmt) {
     break;
   }
 
-  const int lng = snprintf(NULL, 0, fmt_str, abs(d.year)) + 1;
-  char *str = (char *)calloc(1, lng);
-  snprintf(str, lng, fmt_str, abs(d.year));
-  return str;
+  return frame_printf(fmt_str, abs(d.year));
   // TODO: Implement date string formats?
   // Latin
   // Year: "234 BC";
@@ -487,1161 +667,8121 @@ const char *lut_farm_produce_str(const enum FarmProduceType type) {
   return strs[type];
 }
 
-// Ring buffer with strings basically
-#define EVENTLOG_CAPACITY 10
-struct EventLog {
-  char **lines;
-  int32_t curr_line; // Curr line for pushing msgs (a.k.a p(ush)) -1 == empty
-  int32_t read_line; // Curr line for reading msgs (a.k.a r(ead)) -1 == empty
-  const uint32_t capacity;
+// Kinds of events in the event log, text events carry a preformatted msg
+enum EventType {
+  EVENT_TEXT = 0,
+  EVENT_CONSTRUCTION_STARTED = 1,
+  EVENT_CONSTRUCTION_FINISHED = 2,
+  EVENT_DEBUG = 3,
+  NUM_EVENT_TYPES
 };
 
-struct EventLog eventlog_new() {
-  struct EventLog log = {.capacity = EVENTLOG_CAPACITY};
-  log.lines = (char **)calloc(log.capacity, sizeof(char *));
-  log.curr_line = -1;
-  log.read_line = -1;
-  return log;
+const char *lut_event_type_str(const enum EventType type) {
+  static const char *strs[NUM_EVENT_TYPES] = {"Messages", "Construction started",
+                                              "Construction finished", "Debug"};
+  return strs[type];
 }
 
-// FIXME: EventLog ring buffer printout does not print in the correct order
-// Should print [oldest msg ... least oldest msg] but prints [0 ... X], [X + 1,
-// 2X], etc ...
-void eventlog_rewind(struct EventLog *log) { log->read_line = -1; }
+// Event argument, names are offsets into the string table of the catalogue
+// so that records outlive the City they were added in (saves, rewinds and
+// earlier sessions in the journal)
+union EventArg {
+  int32_t i;
+  float f;
+  uint32_t h;
+};
 
-// Adds msg to the eventlog by copying over the string
-void eventlog_add_msg(struct EventLog *log, const char *msg) {
-  assert(log);
-  assert(msg);
+// Defined with the catalogue (see catalogue)
+static uint32_t catalogue_find_str(const char *str);
+static const char *catalogue_event_str(const uint32_t offset);
+
+// Compact event formatted into text only when it is displayed
+#define EVENT_MAX_ARGS 3
+struct EventRecord {
+  uint16_t type; // enum EventType
+  uint8_t month;
+  uint8_t day;
+  int32_t year;
+  union EventArg args[EVENT_MAX_ARGS];
+};
+#define EVENTLOG_MSG_MAX 256 // Longest text msg in bytes, including the '\0'
+
+/***** compression *****/
+// Byte oriented LZ77 in the style of LZ4, favouring decompression speed over
+// ratio. A compressed block is a sequence of [token, literal length, literals,
+// offset, match length] where the token holds the literal length and match
+// length - LZ_MIN_MATCH in 4 bits each, 15 meaning more length bytes follow
+// (each adding up to 255). The last sequence only has literals.
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+#define LZ_LAST_LITERALS 5         // Bytes at the end of a block that are never matched
+#define LZ_BLOCK_SIZE (64 * 1024)  // Input bytes per block of an LzWriter stream
+
+
+static uint32_t lz_hash(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static bool lz_write_length(uint8_t *dst, const size_t capacity, size_t *op, size_t length) {
+  for (; length >= 255; length -= 255) {
+    if (*op == capacity) {
+      return false;
+    }
+    dst[(*op)++] = 255;
+  }
+  if (*op == capacity) {
+    return false;
+  }
+  dst[(*op)++] = (uint8_t)length;
+  return true;
+}
 
-  log->curr_line = (log->curr_line + 1) % log->capacity;
+// Appends a sequence, match_length 0 for the last one. False if dst is full.
+static bool lz_write_sequence(uint8_t *dst, const size_t capacity, size_t *op,
+                              const uint8_t *literals, const size_t num_literals,
+                              const size_t offset, const size_t match_length) {
+  if (*op == capacity) {
+    return false;
+  }
+  const size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+  dst[(*op)++] = (uint8_t)(((num_literals < 15 ? num_literals : 15) << 4) |
+                           (match_code < 15 ? match_code : 15));
+  if (num_literals >= 15 && !lz_write_length(dst, capacity, op, num_literals - 15)) {
+    return false;
+  }
+  if (capacity - *op < num_literals) {
+    return false;
+  }
+  memcpy(&dst[*op], literals, num_literals);
+  *op += num_literals;
 
-  if (log->lines[log->curr_line] != NULL) {
-    free(log->lines[log->curr_line]);
-    log->lines[log->curr_line] = NULL;
+  if (match_length == 0) {
+    return true;
+  }
+  if (capacity - *op < 2) {
+    return false;
   }
+  dst[(*op)++] = (uint8_t)(offset & 0xff);
+  dst[(*op)++] = (uint8_t)(offset >> 8);
+  return match_code < 15 || lz_write_length(dst, capacity, op, match_code - 15);
+}
 
-  if (log->curr_line == log->read_line) {
-    log->read_line = (log->read_line + 1) % log->capacity;
+// Compresses size bytes of src into dst, returns the compressed size or 0 if
+// it does not fit in capacity bytes (store the block uncompressed then)
+size_t lz_compress(const uint8_t *src, const size_t size, uint8_t *dst, const size_t capacity) {
+  assert(src || size == 0); assert(dst);
+  uint32_t table[1 << LZ_HASH_BITS] = {0}; // Last position of each hashed 4 bytes
+  const size_t match_end = size > LZ_LAST_LITERALS ? size - LZ_LAST_LITERALS : 0;
+  size_t op = 0;
+  size_t anchor = 0; // Start of the pending literals
+  size_t ip = 0;
+  while (ip + LZ_MIN_MATCH <= match_end) {
+    const uint32_t h = lz_hash(&src[ip]);
+    const size_t ref = table[h];
+    table[h] = (uint32_t)ip;
+    if (ref >= ip || ip - ref > LZ_MAX_OFFSET || memcmp(&src[ref], &src[ip], LZ_MIN_MATCH) != 0) {
+      ip += 1 + ((ip - anchor) >> 6); // Skip faster through incompressible data
+      continue;
+    }
+
+    size_t length = LZ_MIN_MATCH;
+    while (ip + length < match_end && src[ref + length] == src[ip + length]) {
+      length++;
+    }
+    if (!lz_write_sequence(dst, capacity, &op, &src[anchor], ip - anchor, ip - ref, length)) {
+      return 0;
+    }
+    ip += length;
+    anchor = ip;
   }
 
-  const size_t len = strlen(msg) + 1;
-  log->lines[log->curr_line] = (char *)calloc(len, sizeof(char));
-  strcpy(log->lines[log->curr_line], msg);
+  if (!lz_write_sequence(dst, capacity, &op, &src[anchor], size - anchor, 0, 0)) {
+    return 0;
+  }
+  return op;
 }
 
-void eventlog_add_msgf(struct EventLog *log, const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  va_list args_cpy;
-  va_copy(args_cpy, args); // vsnprintf modifies va list args
-  const int lng = vsnprintf(NULL, 0, fmt, args) + 1;
-  char msg[lng];
-  vsnprintf(msg, lng, fmt, args_cpy);
-  va_end(args);
-  va_end(args_cpy);
-  eventlog_add_msg(log, msg);
+static bool lz_read_length(const uint8_t *src, const size_t size, size_t *ip, size_t *length) {
+  uint8_t b;
+  do {
+    if (*ip == size) {
+      return false;
+    }
+    b = src[(*ip)++];
+    *length += b;
+  } while (b == 255);
+  return true;
 }
 
-void eventlog_clear(struct EventLog *log) {
-  assert(log);
-  for (size_t i = 0; i < log->capacity; i++) {
-    if (log->lines[i]) {
-      free(log->lines[i]);
-      log->lines[i] = NULL;
+// Decompresses size bytes of src into exactly dst_size bytes of dst, returns
+// false if src is corrupt
+bool lz_decompress(const uint8_t *src, const size_t size, uint8_t *dst, const size_t dst_size) {
+  assert(src || size == 0); assert(dst || dst_size == 0);
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < size) {
+    const uint8_t token = src[ip++];
+    size_t num_literals = token >> 4;
+    if (num_literals == 15 && !lz_read_length(src, size, &ip, &num_literals)) {
+      return false;
+    }
+    if (num_literals > size - ip || num_literals > dst_size - op) {
+      return false;
+    }
+    memcpy(&dst[op], &src[ip], num_literals);
+    ip += num_literals;
+    op += num_literals;
+    if (ip == size) {
+      break; // Last sequence
+    }
+
+    if (size - ip < 2) {
+      return false;
+    }
+    const size_t offset = src[ip] | (size_t)src[ip + 1] << 8;
+    ip += 2;
+    size_t length = token & 15;
+    if (length == 15 && !lz_read_length(src, size, &ip, &length)) {
+      return false;
+    }
+    length += LZ_MIN_MATCH;
+    if (offset == 0 || offset > op || length > dst_size - op) {
+      return false;
+    }
+
+    const uint8_t *match = &dst[op - offset];
+    if (offset >= length) {
+      memcpy(&dst[op], match, length);
+    } else {
+      for (size_t i = 0; i < length; i++) { // Overlapping copy repeats the pattern
+        dst[op + i] = match[i];
+      }
     }
+    op += length;
   }
-  log->curr_line = -1;
-  log->read_line = -1;
+  return op == dst_size;
 }
 
-bool eventlog_next_msg(struct EventLog *log, char **msg) {
-  assert(log);
-  assert(log->lines);
-  assert(msg);
+// Header of each block of an LzWriter stream, stored_size == raw_size if the
+// block is stored uncompressed
+struct LzBlockHeader {
+  uint32_t stored_size;
+  uint32_t raw_size;
+};
 
-  // empty ring
-  if (log->curr_line == -1) {
-    return false;
+// Streaming compressor writing to a file, input is cut into LZ_BLOCK_SIZE
+// blocks that are compressed and written as soon as they are full
+struct LzWriter {
+  int fd;
+  uint8_t *block; // Input of the current block
+  size_t num_block;
+  uint8_t *out;
+  uint64_t written; // Bytes written to fd
+  bool failed;
+};
+
+void lz_writer_open(struct LzWriter *w, const int fd) {
+  assert(w);
+  w->fd = fd;
+  w->block = (uint8_t *)malloc(LZ_BLOCK_SIZE);
+  w->out = (uint8_t *)malloc(sizeof(struct LzBlockHeader) + LZ_BLOCK_SIZE);
+  w->num_block = 0;
+  w->written = 0;
+  w->failed = false;
+}
+
+static void lz_writer_flush_block(struct LzWriter *w) {
+  if (w->num_block == 0 || w->failed) {
+    return;
+  }
+  struct LzBlockHeader header = {.raw_size = w->num_block};
+  uint8_t *stored = w->out + sizeof(header);
+  header.stored_size = lz_compress(w->block, w->num_block, stored, w->num_block - 1);
+  if (header.stored_size == 0) {
+    header.stored_size = w->num_block;
+    memcpy(stored, w->block, w->num_block);
   }
+  memcpy(w->out, &header, sizeof(header));
 
-  const uint32_t nxt_msg_line = (log->read_line + 1) % log->capacity;
+  const size_t size = sizeof(header) + header.stored_size;
+  w->failed = write(w->fd, w->out, size) != (ssize_t)size;
+  w->written += size;
+  w->num_block = 0;
+}
 
-  // did reach end of ring
-  if (log->read_line == log->curr_line) {
-    eventlog_rewind(log);
-    // ring not full must return to start at -1 (0) instead of at p + 1
-    if (log->lines[log->read_line] == NULL) {
-      log->read_line = -1;
+void lz_write(struct LzWriter *w, const void *data, size_t size) {
+  assert(w); assert(data || size == 0);
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (size > 0) {
+    const size_t n = size < LZ_BLOCK_SIZE - w->num_block ? size : LZ_BLOCK_SIZE - w->num_block;
+    memcpy(&w->block[w->num_block], bytes, n);
+    w->num_block += n;
+    bytes += n;
+    size -= n;
+    if (w->num_block == LZ_BLOCK_SIZE) {
+      lz_writer_flush_block(w);
     }
-    return false;
   }
+}
 
-  *msg = log->lines[nxt_msg_line];
-  log->read_line = nxt_msg_line;
-  return true;
+// Ends the stream by writing the last partial block, the writer can be used
+// for the next stream. Returns false if a write failed.
+bool lz_writer_finish(struct LzWriter *w) {
+  assert(w);
+  lz_writer_flush_block(w);
+  return !w->failed;
 }
 
-struct ForumArgument {
-  size_t taberna_capacity;
-  size_t num_taberna;
-  struct Construction *tabernas;
-};
+void lz_writer_close(struct LzWriter *w) {
+  assert(w);
+  free(w->block);
+  free(w->out);
+  memset(w, 0, sizeof(struct LzWriter));
+}
 
-struct LandTaxArgument {
-  float tax_percentage;
-};
+// Decompresses the stream of size bytes at src written by an LzWriter into
+// exactly dst_size bytes of dst, returns false if it is corrupt
+bool lz_read_stream(const uint8_t *src, const size_t size, uint8_t *dst, const size_t dst_size) {
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < size) {
+    struct LzBlockHeader header;
+    if (size - ip < sizeof(header)) {
+      return false;
+    }
+    memcpy(&header, &src[ip], sizeof(header));
+    ip += sizeof(header);
+    if (header.stored_size > size - ip || header.raw_size > dst_size - op ||
+        header.stored_size > header.raw_size) {
+      return false;
+    }
+    if (header.stored_size == header.raw_size) {
+      memcpy(&dst[op], &src[ip], header.raw_size);
+    } else if (!lz_decompress(&src[ip], header.stored_size, &dst[op], header.raw_size)) {
+      return false;
+    }
+    ip += header.stored_size;
+    op += header.raw_size;
+  }
+  return op == dst_size;
+}
 
-struct FarmArgument {
-  size_t area;                  // Land area used (jugerum, cirka 0.6 hectare)
-  enum FarmProduceType produce; // Farm produce (olives, grapes, etc)
-  // NOTE: Individual farm cyclic ouput parameters
-  const float p0;
-  const float p1;
+/***** event journal *****/
+// Append-only file of every EventRecord in the game, written in blocks of
+// JOURNAL_BLOCK_RECORDS records that are LZ compressed when that makes them
+// smaller. A block holds its records followed by the text of its EVENT_TEXT
+// records, each a uint16_t length prefixed and '\0' terminated payload whose
+// offset in the text the record holds in args[0]. The index file holds one
+// JournalIndexEntry per block written. A journal belongs to one game and is
+// named after its id, savegames store the id with the number of records at the
+// time so that loading or rewinding continues the journal from there.
+#define JOURNAL_MAGIC "RTSJ"
+#define JOURNAL_VERSION 5 // 3: Text payloads of EVENT_TEXT records, 4: Catalogue names in construction events, 5: Id
+#define JOURNAL_BLOCK_RECORDS 1024 // Records per block and index entry
+#define JOURNAL_BATCH_RECORDS 256  // Records handed to the writer thread at once
+#define JOURNAL_TEXT_MAX (sizeof(uint16_t) + EVENTLOG_MSG_MAX) // Text payload of a record
+#define JOURNAL_BLOCK_SIZE (JOURNAL_BLOCK_RECORDS * (sizeof(struct EventRecord) + JOURNAL_TEXT_MAX))
+#define JOURNAL_FILENAME_FMT "%sjournal_%016" PRIx64 ".%s" // Folder, id and extension
+#define JOURNAL_EXT "bin"
+#define JOURNAL_INDEX_EXT "idx"
+
+struct JournalHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t block_records;
+  uint64_t id;
 };
 
-enum { MAGISTRATES_AEDILE = 0x1, MAGISTRATES_CENSOR = 0x2 };
-struct CursusHonorum {
-  size_t magistrates_enabled;
-  bool aedile_enabled;
-  bool censor_enabled;
-  struct Construction *aedile_assigned_construction;
+struct JournalIndexEntry {
+  int32_t first_date; // date_key of the first record in the block
+  uint32_t type_mask; // Bit (1 << type) set if the block contains that type
+  uint64_t offset;    // Of the block in the journal file
+  uint32_t size;      // In the journal file, the block is stored uncompressed if it is raw_size
+  uint32_t num_records; // JOURNAL_BLOCK_RECORDS except for the last block
+  uint32_t raw_size;    // Records and text of the block uncompressed
+  uint32_t pad;
 };
 
-// Roman Lex (pl. leges)
-struct Law {
-  bool passed;
-  char *name_str;        // TODO: Classify the strings used and where they fit in the UI
-  char *description_str;
-  char *help_str;
-  enum CapacityType type;
-  uint8_t cost;     // Quantify of power points
-  uint8_t cost_lng; // How many ticks the cost is incurred
-  struct Date date_passed;
-  struct Effect *effect;
-  void (*gui_handler)(struct nk_context *ctx, struct Law *l);
-};
+// Monotonic key of a date used to compare records
+static int32_t date_key(const int32_t year, const uint32_t month, const uint32_t day) {
+  return year * 512 + (int32_t)(month * 32 + day);
+}
 
-struct Construction {
-  float construction_delay_risk; // TODO: Implement it ...
-  bool construction_in_progress; // Active construction site or not
-  bool construction_finished;
-  bool maintained; // Affects maintenance cost & effects
-  const char *name_str;
-  const char *description_str; // Short descriptive str
-  const char *help_str;        // Longer explainatory str used in help menus
-  float construction_cost;     // Cost in gold per timestep construction period
-  float cost;
-  float maintenance;
-  // NOTE: Effect.description_str provides gameplay information in short format
-  // If true, the Effect may only be built once and Effect is duration = FOREVER
-  bool unique_effects;
-  struct Effect *effect;
-  size_t num_effects;          // Construction variants available to build now
-  size_t num_effects_capacity; // Number of construction variants from the start (IMMUTABLE)
-  size_t construction_time;    // Time to build in timesteps (days)
-  struct Date construction_started;
-  struct Date construction_completed;
-  // Callback to the management pane of the construction
-  void (*gui_construction_management)(struct nk_context *ctx, struct Construction *con, struct City *c);
+struct Journal {
+  char *folder;
+  char *path;
+  char *index_path;
+  FILE *file;
+  FILE *index_file;
+  bool compress;
+  uint64_t id;           // Of the game, names the files
+  uint64_t num_appended; // Records appended, written or not
+  uint32_t generation;   // Bumped when the journal is reopened by journal_restore
+  // Filled by the simulation, swapped with pending when full or flushed
+  struct EventRecord *active;
+  uint32_t num_active;
+  uint8_t *active_text; // Text payloads of the active records
+  uint32_t active_text_size;
+  // Owned by the writer thread while num_pending > 0
+  struct EventRecord *pending;
+  uint32_t num_pending;
+  uint8_t *pending_text;
+  uint32_t pending_text_size;
+  // Records of the block being filled and of the full block being written,
+  // modified under lock so that views can copy the records not yet on disk
+  struct EventRecord *block;
+  uint32_t num_block_records;
+  uint8_t *block_text;
+  uint32_t block_text_size;
+  struct EventRecord *sealed;
+  uint32_t num_sealed;
+  uint8_t *sealed_text;
+  uint32_t sealed_text_size;
+  uint64_t num_records; // Moved into blocks so far
+  uint32_t num_blocks;  // Written to disk with their index entries
+  // Writer thread only
+  uint8_t *raw;        // Block being written, records followed by their text
+  uint8_t *compressed;
+  uint64_t offset; // End of the journal file
+  bool quit;
+  SDL_Thread *thread;
+  SDL_mutex *lock;
+  SDL_cond *cond;
 };
 
-// TODO: Documentate
-struct {
-  float max_population_reached;
-} Gamestate;
+// Returns the '\0' terminated text payload at offset in text, "" if it is corrupt
+static const char *journal_text(const uint8_t *text, const uint32_t text_size, const uint32_t offset) {
+  uint16_t len = 0;
+  if (offset > text_size || text_size - offset < sizeof(len)) {
+    return "";
+  }
+  memcpy(&len, &text[offset], sizeof(len));
+  const char *msg = (const char *)&text[offset + sizeof(len)];
+  if (len == 0 || len > text_size - offset - sizeof(len) || msg[len - 1] != '\0') {
+    return "";
+  }
+  return msg;
+}
 
-struct City {
-  char *name;
-  struct EventLog *log;
-  // Flags
-  bool diplomacy_enabled;
-  // Farming
-  float *produce_values; // Gold and nutriental (food) value in terms of produce
-  size_t land_area;      // Land area available (used by farms, mansio, castrum)
-  size_t land_area_used; // Land used
-  float food_production; // Excess food creates population & gold
-  float food_production_modifier;
-  float food_usage;
-  // Gold
-  float gold; // Gold creates food (negative counts as debt)
-  float gold_usage;
-  /// Capacity
-  uint32_t political_capacity;
-  uint32_t political_usage;
-  uint32_t diplomatic_capacity;
-  uint32_t diplomatic_usage;
-  uint32_t military_capacity;
-  uint32_t military_usage;
-  /// Demographics
-  size_t population;
-  int32_t population_delta;
-  /// Effects
-  struct Effect *effects;
-  size_t num_effects;
-  size_t num_effects_capacity;
-  // Construction projects available
-  struct Construction *construction_projects;
-  size_t num_construction_projects;
-  size_t num_construction_projects_capacity;
-  // Constructions raised and still standing
-  struct Construction *constructions;
-  size_t num_constructions;
-  size_t num_constructions_capacity;
-  // Popups
-  struct Popup *popups;
-  size_t num_popups;
-  size_t num_popups_capacity;
-  // Laws
-  bool laws_enabled;
-  struct Law *available_laws;
-  size_t num_available_laws;
-  size_t num_available_laws_capacity;
-  struct CursusHonorum *cursus_honorum;
-};
+// Appends msg as a text payload to text, returns its offset
+static uint32_t journal_text_push(uint8_t *text, uint32_t *text_size, const char *msg) {
+  const uint16_t len = strlen(msg) + 1;
+  assert(len <= EVENTLOG_MSG_MAX);
+  const uint32_t offset = *text_size;
+  memcpy(&text[offset], &len, sizeof(len));
+  memcpy(&text[offset + sizeof(len)], msg, len);
+  *text_size += sizeof(len) + len;
+  return offset;
+}
 
-#define FOREVER -1
-// NOTE: When either one of the human readable strings are NULL the effect is
-// hidden in the UI.
-struct Effect {
-  bool scheduled_for_removal; // Removed next simulation step if true
-  char *name_str;             // Human readable name of the effect
-  char *description_str;      // Human readable description of the effect
-  int64_t duration; // Negative for forever, 0 = done/inactive, timesteps left
-  void *arg;        // Custom argument provided
-  // NOTE: Tick effect is a function used as: c1 = tick_effect(c, e)
-  void (*tick_effect)(struct Effect *e, const struct City *c, struct City *c1);
-};
+// Appends the text payload at offset in src to dst, returns its new offset
+static uint32_t journal_text_copy(uint8_t *dst, uint32_t *dst_size, const uint8_t *src, const uint32_t offset) {
+  uint16_t len = 0;
+  memcpy(&len, &src[offset], sizeof(len));
+  const uint32_t dst_offset = *dst_size;
+  memcpy(&dst[dst_offset], &src[offset], sizeof(len) + len);
+  *dst_size += sizeof(len) + len;
+  return dst_offset;
+}
 
-struct Popup {
-  char *title;
-  char *description;
-  uint32_t num_choices;
-  char **choices;
-  char **hover_txts; // Description text for the choices when hovering over them
-  void (*callback)(const struct Popup *p, const struct City *c, struct City *c1);
-  // NOTE: -1 = not handled by user, >= 0 callback executed in simulate_timestep
-  int32_t choice_choosen; // Set by the popup handling mechanic and processed by the callback
-};
-
-/// NOTE: All city_add_* functions returns a ptr to the last element added
-struct Popup *city_add_popup(struct City *c, const struct Popup p) {
-  if (c->num_popups + 1 > c->num_popups_capacity) {
-    c->num_popups_capacity += 100; // FIXME: Realloc will invalidate ptrs
-    c->popups = realloc(c->popups, sizeof(struct Popup) * c->num_popups_capacity);
+// Writes a block to disk followed by its index entry
+static void journal_write_block(struct Journal *j, const struct EventRecord *records, const uint32_t n,
+                                const uint8_t *text, const uint32_t text_size) {
+  struct JournalIndexEntry entry = {.first_date = date_key(records[0].year, records[0].month, records[0].day),
+                                    .offset = j->offset,
+                                    .num_records = n};
+  for (uint32_t i = 0; i < n; i++) {
+    entry.type_mask |= 1u << records[i].type;
   }
-  c->popups[c->num_popups++] = p;
-  return &c->popups[c->num_popups - 1];
-}
 
-struct Effect *city_add_effect(struct City *c, const struct Effect e) {
-  if (c->num_effects + 1 > c->num_effects_capacity) {
-    c->num_effects_capacity += 100;
-    c->effects = realloc(c->effects, sizeof(struct Effect) * c->num_effects_capacity);
+  const size_t records_size = n * sizeof(struct EventRecord);
+  memcpy(j->raw, records, records_size);
+  memcpy(&j->raw[records_size], text, text_size);
+  entry.raw_size = records_size + text_size;
+  entry.size = j->compress ? lz_compress(j->raw, entry.raw_size, j->compressed, entry.raw_size - 1) : 0;
+  const void *data = j->compressed;
+  if (entry.size == 0) {
+    entry.size = entry.raw_size;
+    data = j->raw;
   }
-  c->effects[c->num_effects++] = e;
-  return &c->effects[c->num_effects - 1];
-}
 
-struct Construction *city_add_construction(struct City *c, const struct Construction con) {
-  if (c->num_constructions + 1 > c->num_constructions_capacity) {
-    c->num_constructions_capacity += 100;
-    c->constructions = realloc(c->constructions, sizeof(struct Construction) * c->num_constructions_capacity);
-  }
-  c->constructions[c->num_constructions++] = con;
-  return &c->constructions[c->num_constructions - 1];
+  fwrite(data, 1, entry.size, j->file);
+  fflush(j->file);
+  fwrite(&entry, sizeof(entry), 1, j->index_file);
+  fflush(j->index_file);
+  j->offset += entry.size;
 }
 
-struct Construction *city_add_construction_project(struct City *c, struct Construction con) {
-  con.num_effects_capacity = con.num_effects; // NOTE: Set initial number of effect available
+static int journal_writer_thread(void *data) {
+  struct Journal *j = (struct Journal *)data;
 
-  if (c->num_construction_projects + 1 > c->num_construction_projects_capacity) {
-    c->num_construction_projects_capacity += 100;
-    c->construction_projects = realloc( c->construction_projects, sizeof(struct Construction) * c->num_construction_projects_capacity);
+  SDL_LockMutex(j->lock);
+  while (true) {
+    while (j->num_pending == 0 && !j->quit) {
+      SDL_CondWait(j->cond, j->lock);
+    }
+    if (j->num_pending == 0 && j->quit) {
+      break;
+    }
+
+    for (uint32_t i = 0; i < j->num_pending; i++) {
+      struct EventRecord rec = j->pending[i];
+      if (rec.type == EVENT_TEXT) {
+        rec.args[0].h = journal_text_copy(j->block_text, &j->block_text_size, j->pending_text, rec.args[0].h);
+      }
+      j->block[j->num_block_records++] = rec;
+      j->num_records++;
+
+      if (j->num_block_records == JOURNAL_BLOCK_RECORDS) {
+        struct EventRecord *tmp = j->sealed;
+        j->sealed = j->block;
+        j->num_sealed = j->num_block_records;
+        j->block = tmp;
+        j->num_block_records = 0;
+        uint8_t *tmp_text = j->sealed_text;
+        j->sealed_text = j->block_text;
+        j->sealed_text_size = j->block_text_size;
+        j->block_text = tmp_text;
+        j->block_text_size = 0;
+        SDL_UnlockMutex(j->lock);
+        journal_write_block(j, j->sealed, j->num_sealed, j->sealed_text, j->sealed_text_size);
+        SDL_LockMutex(j->lock);
+        j->num_sealed = 0;
+        j->sealed_text_size = 0;
+        j->num_blocks++;
+      }
+    }
+
+    j->num_pending = 0;
+    j->pending_text_size = 0;
+    SDL_CondBroadcast(j->cond);
   }
-  c->construction_projects[c->num_construction_projects++] = con;
-  return &c->construction_projects[c->num_construction_projects - 1];
-}
 
-struct Law *city_add_law(struct City *c, const struct Law l) {
-  if (c->num_available_laws + 1 > c->num_available_laws_capacity) {
-    c->num_available_laws_capacity += 100;
-    c->available_laws = realloc(c->available_laws, sizeof(struct Law) * c->num_available_laws_capacity);
+  // The last block is written partially filled
+  if (j->num_block_records > 0) {
+    journal_write_block(j, j->block, j->num_block_records, j->block_text, j->block_text_size);
+    j->num_blocks++;
   }
-  c->available_laws[c->num_available_laws++] = l;
-  return &c->available_laws[c->num_available_laws_capacity - 1];
+  SDL_UnlockMutex(j->lock);
+  return 0;
 }
 
-/// Calculates the population changes this timestep
-void population_calculation(const struct City *c, struct City *c1) {
-  assert(c); assert(c1);
-
-  // TODO: Import / Export of foodstuffs
-  // TODO: Add different produce effectiveness values instead of using the
-  // current value (see farm_tick_effect)
-  // TODO: Limit 1 of each type of farm (or even building)
-
-  // Food-gold cycle
-  {
-    // TODO: Bad to use avg. when I know how much of each produce is produced ...
-    float avg_food_price = 0.0f;
-    for (size_t i = 0; i < NUMBER_OF_PRODUCE; i++) {
-      avg_food_price += c->produce_values[i];
-    }
-    avg_food_price /= NUMBER_OF_PRODUCE;
-    c1->gold_usage += avg_food_price * (c->food_production - c->food_usage);
+// Reads the first n records of a block on disk back into the block being
+// filled, their text is copied over record by record
+static bool journal_read_block(struct Journal *j, const struct JournalIndexEntry *entry, const uint32_t n) {
+  if (fseek(j->file, entry->offset, SEEK_SET) != 0 || fread(j->compressed, 1, entry->size, j->file) != entry->size) {
+    return false;
+  }
+  if (entry->size == entry->raw_size) {
+    memcpy(j->raw, j->compressed, entry->raw_size);
+  } else if (!lz_decompress(j->compressed, entry->size, j->raw, entry->raw_size)) {
+    return false;
   }
 
-  // Gold-food-population cycle
-  {
-    const float food_limit = 1000.0f * c1->food_production;
-    if (c1->population < food_limit) {
-      c1->population_delta = 1;
-    } else if (c1->population > food_limit) {
-      c1->population_delta = -1;
+  const size_t records_size = entry->num_records * sizeof(struct EventRecord);
+  memcpy(j->block, j->raw, n * sizeof(struct EventRecord));
+  j->num_block_records = n;
+  j->block_text_size = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    if (j->block[i].type == EVENT_TEXT) {
+      const char *msg = journal_text(&j->raw[records_size], entry->raw_size - records_size, j->block[i].args[0].h);
+      msg = strlen(msg) < EVENTLOG_MSG_MAX ? msg : "";
+      j->block[i].args[0].h = journal_text_push(j->block_text, &j->block_text_size, msg);
     }
+  }
+  return true;
+}
 
-    c1->population += c1->population_delta;
+// Continues the journal files of j->id from its first num_records records,
+// the block record num_records is in is read back and everything after it is
+// cut off. Returns false if the files are not a valid journal of the game.
+static bool journal_resume(struct Journal *j, const uint64_t num_records) {
+  j->file = fopen(j->path, "r+b");
+  j->index_file = fopen(j->index_path, "r+b");
+  if (j->file == NULL || j->index_file == NULL) {
+    return false;
   }
 
-  // Population-gold cycle
-  {
-    const float base_tax = 0.05f;
-    c1->gold_usage -= c1->population * 0.000001f + base_tax;
+  struct JournalHeader header;
+  if (fread(&header, sizeof(header), 1, j->file) != 1 ||
+      memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 || header.version != JOURNAL_VERSION ||
+      header.record_size != sizeof(struct EventRecord) || header.block_records != JOURNAL_BLOCK_RECORDS ||
+      header.id != j->id || fseek(j->file, 0, SEEK_END) != 0 || fseek(j->index_file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  const long file_size = ftell(j->file);
+  const long index_size = ftell(j->index_file);
+  if (file_size < 0 || index_size < 0 || index_size % sizeof(struct JournalIndexEntry) != 0) {
+    return false;
   }
-}
 
-/// Apply and deal with the effects in place on the city
-void simulate_next_timestep(const struct City *c, struct City *c1) {
-  assert(c);
-  assert(c1);
+  // Blocks are back to back and all but the last are full
+  const uint32_t num_entries = index_size / sizeof(struct JournalIndexEntry);
+  struct JournalIndexEntry *entries = (struct JournalIndexEntry *)calloc(num_entries + 1, sizeof(struct JournalIndexEntry));
+  rewind(j->index_file);
+  bool valid = fread(entries, sizeof(struct JournalIndexEntry), num_entries, j->index_file) == num_entries;
+  uint64_t offset = sizeof(header);
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < num_entries && valid; i++) {
+    const struct JournalIndexEntry *entry = &entries[i];
+    valid = entry->offset == offset && entry->size <= (uint64_t)file_size - offset && entry->num_records > 0 &&
+            entry->num_records <= JOURNAL_BLOCK_RECORDS &&
+            (entry->num_records == JOURNAL_BLOCK_RECORDS || i + 1 == num_entries) &&
+            entry->raw_size >= entry->num_records * sizeof(struct EventRecord) &&
+            entry->raw_size <= entry->num_records * (sizeof(struct EventRecord) + JOURNAL_TEXT_MAX) &&
+            entry->size <= entry->raw_size;
+    offset += entry->size;
+    total += entry->num_records;
+  }
 
-  memset(c1, 0, sizeof(struct City)); // Reset next state
+  // The blocks before the one record num_records is in are kept as they are
+  const uint64_t keep = num_records < total ? num_records : total;
+  j->num_blocks = keep / JOURNAL_BLOCK_RECORDS;
+  const uint32_t num_block_records = keep % JOURNAL_BLOCK_RECORDS;
+  if (j->num_blocks < num_entries) {
+    offset = entries[j->num_blocks].offset;
+  }
+  if (valid && num_block_records > 0) {
+    valid = journal_read_block(j, &entries[j->num_blocks], num_block_records);
+  }
+  free(entries);
 
-  // NOTE: Move shared resources
-  c1->name = c->name;
-  c1->num_effects = c->num_effects;
-  c1->effects = c->effects;
-  c1->military_capacity = c->military_capacity;
-  c1->political_capacity = c->political_capacity;
-  c1->diplomatic_capacity = c->diplomatic_capacity;
-  c1->num_effects_capacity = c->num_effects_capacity;
-  c1->num_construction_projects = c->num_construction_projects;
-  c1->construction_projects = c->construction_projects;
-  c1->num_construction_projects_capacity = c->num_construction_projects_capacity;
-  c1->num_constructions = c->num_constructions;
-  c1->constructions = c->constructions;
-  c1->num_constructions_capacity = c->num_constructions_capacity;
-  c1->land_area = c->land_area;
-  c1->produce_values = c->produce_values;
-  c1->log = c->log;
-  c1->popups = c->popups;
-  c1->num_popups = c->num_popups;
-  c1->num_popups_capacity = c->num_popups_capacity;
-  c1->population = c->population;
-  c1->available_laws = c->available_laws;
-  c1->num_available_laws = c->num_available_laws;
-  c1->num_available_laws_capacity = c->num_available_laws_capacity;
-  c1->cursus_honorum = c->cursus_honorum;
-  c1->food_production_modifier = 1.0f;
+  if (!valid || ftruncate(fileno(j->file), offset) != 0 ||
+      ftruncate(fileno(j->index_file), j->num_blocks * sizeof(struct JournalIndexEntry)) != 0 ||
+      fseek(j->file, 0, SEEK_END) != 0 || fseek(j->index_file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  j->offset = offset;
+  j->num_records = keep;
+  j->num_appended = keep;
+  return true;
+}
 
-  // Compute effects affecting the change of rate
-  for (size_t i = 0; i < c1->num_effects; i++) {
-    if (c1->effects[i].scheduled_for_removal) {
-      c1->effects[i] = c1->effects[c1->num_effects - 1];
-      c1->num_effects--;
-      i--;
-      continue;
-    }
+// Path of a file of the journal with id in folder
+static char *journal_path_new(const char *folder, const uint64_t id, const char *ext) {
+  const int lng = snprintf(NULL, 0, JOURNAL_FILENAME_FMT, folder, id, ext) + 1;
+  char *path = (char *)malloc(lng);
+  snprintf(path, lng, JOURNAL_FILENAME_FMT, folder, id, ext);
+  return path;
+}
 
-    c1->effects[i].tick_effect(&c1->effects[i], c, c1);
-    if (c1->effects[i].duration == FOREVER) {
-      continue;
+// Id of a new journal, its creation time unless a journal in folder has it
+static uint64_t journal_new_id(const char *folder) {
+  uint64_t id = time(NULL);
+  while (true) {
+    char *path = journal_path_new(folder, id, JOURNAL_EXT);
+    const bool exists = access(path, F_OK) == 0;
+    free(path);
+    if (!exists) {
+      return id;
     }
+    id++;
+  }
+}
 
-    c1->effects[i].duration--;
-    if (c1->effects[i].duration == 0) {
-      c1->effects[i] = c1->effects[c1->num_effects - 1];
-      if (c1->num_effects - 1 > 0) {
-        c1->num_effects--;
-      } else {
-        c1->num_effects = 0;
-      }
-      i--;
-    }
+static void journal_free(struct Journal *j) {
+  if (j->file) {
+    fclose(j->file);
+  }
+  if (j->index_file) {
+    fclose(j->index_file);
   }
+  j->file = NULL;
+  j->index_file = NULL;
+  free(j->folder);
+  free(j->path);
+  free(j->index_path);
+  free(j->active);
+  free(j->active_text);
+  free(j->pending);
+  free(j->pending_text);
+  free(j->block);
+  free(j->block_text);
+  free(j->sealed);
+  free(j->sealed_text);
+  free(j->raw);
+  free(j->compressed);
+}
 
-  // Construction effects
-  for (size_t i = 0; i < c1->num_constructions; i++) {
-    const struct Construction *con = &c1->constructions[i];
-    if (!con->construction_finished) {
-      continue;
+// Opens the journal of the game with id in folder, continued from its first
+// num_records records. A new journal is started for id 0 (a new game) or if
+// the files of id are missing or not valid. Returns false if the files could
+// not be created.
+bool journal_open(struct Journal *j, const char *folder, const bool compress, const uint64_t id,
+                  const uint64_t num_records) {
+  assert(j); assert(folder);
+  memset(j, 0, sizeof(struct Journal));
+
+  j->folder = str_concat_new(folder, "");
+  j->id = id ? id : journal_new_id(folder);
+  j->path = journal_path_new(folder, j->id, JOURNAL_EXT);
+  j->index_path = journal_path_new(folder, j->id, JOURNAL_INDEX_EXT);
+  j->compress = compress;
+
+  j->active = (struct EventRecord *)calloc(JOURNAL_BATCH_RECORDS, sizeof(struct EventRecord));
+  j->active_text = (uint8_t *)malloc(JOURNAL_BATCH_RECORDS * JOURNAL_TEXT_MAX);
+  j->pending = (struct EventRecord *)calloc(JOURNAL_BATCH_RECORDS, sizeof(struct EventRecord));
+  j->pending_text = (uint8_t *)malloc(JOURNAL_BATCH_RECORDS * JOURNAL_TEXT_MAX);
+  j->block = (struct EventRecord *)calloc(JOURNAL_BLOCK_RECORDS, sizeof(struct EventRecord));
+  j->block_text = (uint8_t *)malloc(JOURNAL_BLOCK_RECORDS * JOURNAL_TEXT_MAX);
+  j->sealed = (struct EventRecord *)calloc(JOURNAL_BLOCK_RECORDS, sizeof(struct EventRecord));
+  j->sealed_text = (uint8_t *)malloc(JOURNAL_BLOCK_RECORDS * JOURNAL_TEXT_MAX);
+  j->raw = (uint8_t *)malloc(JOURNAL_BLOCK_SIZE);
+  j->compressed = (uint8_t *)malloc(JOURNAL_BLOCK_SIZE);
+
+  if (id == 0 || !journal_resume(j, num_records)) {
+    if (id != 0) {
+      fprintf(stderr, "[ColoniaC]: The event journal %s is missing or not valid, starting a new one \n", j->path);
     }
-    if (!con->maintained) {
-      continue;
+    if (j->file) {
+      fclose(j->file);
     }
-    for (size_t j = 0; j < con->num_effects; j++) {
-      con->effect[j].tick_effect(con->effect, c, c1);
+    if (j->index_file) {
+      fclose(j->index_file);
     }
-  }
-
-  // Popups effects
-  for (size_t i = 0; i < c1->num_popups; i++) {
-    if (c1->popups[i].choice_choosen >= 0) {
-      c1->popups[i].callback(&c1->popups[i], c, c1);
-
-      c1->popups[i] = c1->popups[c1->num_popups - 1];
-      c1->num_popups--;
-      i--;
+    j->num_block_records = 0;
+    j->block_text_size = 0;
+    j->num_blocks = 0;
+    j->num_records = 0;
+    j->num_appended = 0;
+
+    j->file = fopen(j->path, "wb");
+    j->index_file = fopen(j->index_path, "wb");
+    if (j->file == NULL || j->index_file == NULL) {
+      fprintf(stderr, "[ColoniaC]: Failed to create the event journal in %s \n", folder);
+      journal_free(j);
+      return false;
     }
-  }
-
-  // Apply modifiers
-  c1->food_production *= c1->food_production_modifier;
-
-  // Compute changes during this timestep
-  population_calculation(c, c1);
 
-  // Compute changes based on current state
-  c1->gold = c->gold - c1->gold_usage;
+    const struct JournalHeader header = {.magic = JOURNAL_MAGIC,
+                                         .version = JOURNAL_VERSION,
+                                         .record_size = sizeof(struct EventRecord),
+                                         .block_records = JOURNAL_BLOCK_RECORDS,
+                                         .id = j->id};
+    fwrite(&header, sizeof(header), 1, j->file);
+    fflush(j->file);
+    j->offset = sizeof(header);
+  }
 
-  timestep++;
-  increment_date(&date);
+  j->lock = SDL_CreateMutex();
+  j->cond = SDL_CreateCond();
+  j->thread = SDL_CreateThread(journal_writer_thread, "journal_writer", j);
+  return true;
 }
 
-void building_maintenance_tick_effect(struct Effect *e, const struct City *c,
-                                      struct City *c1) {
-  for (size_t i = 0; i < c->num_constructions; i++) {
-    c1->gold_usage += c->constructions[i].maintenance;
+// Hands the buffered records to the writer thread
+void journal_flush(struct Journal *j) {
+  assert(j);
+  if (j->file == NULL || j->num_active == 0) {
+    return;
   }
-}
 
-void farm_tick_effect(struct Effect *e, const struct City *c, struct City *c1) {
-  assert(c); assert(c1); assert(e->arg);
-  const struct FarmArgument *arg = (struct FarmArgument *)e->arg;
-  // FIXME: const float output_effectiveness = fabs(cosf(arg->p0 + date.month + (M_PI / 12.0f))) + arg->p1;
-  c1->food_production += 1.0f * c->produce_values[arg->produce] * arg->area;
-  c1->land_area_used += arg->area;
+  SDL_LockMutex(j->lock);
+  while (j->num_pending != 0) {
+    SDL_CondWait(j->cond, j->lock); // Writer is behind, wait for the buffer
+  }
+  struct EventRecord *tmp = j->pending;
+  j->pending = j->active;
+  j->num_pending = j->num_active;
+  j->active = tmp;
+  j->num_active = 0;
+  uint8_t *tmp_text = j->pending_text;
+  j->pending_text = j->active_text;
+  j->pending_text_size = j->active_text_size;
+  j->active_text = tmp_text;
+  j->active_text_size = 0;
+  SDL_CondBroadcast(j->cond);
+  SDL_UnlockMutex(j->lock);
 }
 
-void aqueduct_tick_effect(struct Effect *e, const struct City *c,
-                          struct City *c1) {
-  c1->diplomatic_capacity += 1;
-  c1->food_production_modifier += 0.05f;
-  if (c->cursus_honorum->aedile_assigned_construction == e->arg) {
-    c1->food_production_modifier += 0.15f;
+// Appends rec, msg is the text of EVENT_TEXT records (at most EVENTLOG_MSG_MAX
+// bytes including the '\0')
+void journal_append(struct Journal *j, const struct EventRecord *rec, const char *msg) {
+  if (j->file == NULL) {
+    return;
+  }
+  struct EventRecord *dst = &j->active[j->num_active++];
+  *dst = *rec;
+  if (rec->type == EVENT_TEXT) {
+    dst->args[0].h = journal_text_push(j->active_text, &j->active_text_size, msg ? msg : "");
+  }
+  j->num_appended++;
+  if (j->num_active == JOURNAL_BATCH_RECORDS) {
+    journal_flush(j);
   }
 }
 
-void basilica_tick_effect(struct Effect *e, const struct City *c,
-                          struct City *c1) {
-  c1->political_capacity += 1;
-}
+// Flushes everything to disk and stops the writer thread
+void journal_close(struct Journal *j) {
+  assert(j);
+  if (j->file == NULL) {
+    return;
+  }
 
-void forum_tick_effect(struct Effect *e, const struct City *c,
-                       struct City *c1) {
-  c1->diplomatic_capacity += 1;
-  c1->political_capacity += 1;
-}
+  journal_flush(j);
+  SDL_LockMutex(j->lock);
+  j->quit = true;
+  SDL_CondBroadcast(j->cond);
+  SDL_UnlockMutex(j->lock);
+  SDL_WaitThread(j->thread, NULL);
 
-void coin_mint_tick_effect(struct Effect *e, const struct City *c,
-                           struct City *c1) {
-  c1->gold_usage -= 0.5f;
+  SDL_DestroyCond(j->cond);
+  SDL_DestroyMutex(j->lock);
+  journal_free(j);
 }
 
-void temple_of_jupiter_tick_effect(struct Effect *e, const struct City *c,
-                                   struct City *c1) {
-  c1->diplomatic_capacity += 1;
-}
+// Continues the journal of a loaded or rewound game from the id and number of
+// records saved with it, views notice the reopened journal by its generation
+void journal_restore(struct Journal *j, const uint64_t id, const uint64_t num_records) {
+  assert(j);
+  if (j->file == NULL) {
+    return;
+  }
 
-void temple_of_mars_tick_effect(struct Effect *e, const struct City *c,
-                                struct City *c1) {
-  c1->military_capacity += 1;
+  char *folder = str_concat_new(j->folder, "");
+  const bool compress = j->compress;
+  const uint32_t generation = j->generation + 1;
+  journal_close(j);
+  journal_open(j, folder, compress, id, num_records);
+  j->generation = generation;
+  free(folder);
 }
 
-void temple_of_vulcan_tick_effect(struct Effect *e, const struct City *c,
-                                  struct City *c1) {
-  // TODO: Add Festival spawning
-}
+// Read-only view of a journal through memory maps of its files, the blocks
+// are decompressed on demand and the records not yet on disk are copied
+struct JournalView {
+  int fd;       // -1 if not open
+  int index_fd; // -1 if not open
+  uint32_t generation; // Of the journal the files were opened for
+  const uint8_t *map;
+  size_t map_size;
+  const struct JournalIndexEntry *index;
+  size_t num_index_entries;
+  uint64_t num_records;
+  // Records after the last block on disk, the text of the sealed block is
+  // followed by that of the block being filled
+  struct EventRecord *tail;
+  uint32_t num_tail;
+  uint8_t *tail_text;
+  uint32_t tail_text_size;
+  // Last block read, records followed by their text
+  uint8_t *block;
+  const uint8_t *block_text;
+  uint32_t block_text_size;
+  size_t block_index;
+  bool has_block;
+};
 
-void pops_eating_tick_effect(struct Effect *e, const struct City *c,
-                             struct City *c1) {
-  const uint32_t consumption = c->population * 0.001f;
-  c1->food_usage += consumption;
+static void journal_view_unmap(struct JournalView *v) {
+  if (v->map) {
+    munmap((void *)v->map, v->map_size);
+  }
+  if (v->index) {
+    munmap((void *)v->index, v->num_index_entries * sizeof(struct JournalIndexEntry));
+  }
+  v->map = NULL;
+  v->map_size = 0;
+  v->index = NULL;
+  v->num_index_entries = 0;
+  v->has_block = false;
 }
 
-void senate_house_tick_effect(struct Effect *e, const struct City *c,
-                              struct City *c1) {
-  c1->laws_enabled = true;
-  c1->diplomatic_capacity += 1;
-  c1->political_capacity += 1;
+// Closes the files of a journal that has been reopened since
+static void journal_view_close(struct JournalView *v) {
+  journal_view_unmap(v);
+  if (v->fd >= 0) {
+    close(v->fd);
+  }
+  if (v->index_fd >= 0) {
+    close(v->index_fd);
+  }
+  v->fd = -1;
+  v->index_fd = -1;
+  v->num_records = 0;
+  v->num_tail = 0;
+  v->tail_text_size = 0;
 }
 
-void land_tax_tick_effect(struct Effect *e, const struct City *c,
-                          struct City *c1) {
-  const struct LandTaxArgument *arg = (struct LandTaxArgument *)e->arg;
-  const float land_tax_price = 0.05f;
-  c1->gold_usage -= land_tax_price * c->land_area_used * arg->tax_percentage;
-}
+// (Re)maps the journal files if blocks were written, returns false on failure
+static bool journal_view_map(struct JournalView *v, const struct Journal *j, const uint32_t num_blocks) {
+  if (v->fd < 0) {
+    v->fd = open(j->path, O_RDONLY);
+    v->index_fd = open(j->index_path, O_RDONLY);
+    if (v->fd < 0 || v->index_fd < 0) {
+      if (v->fd >= 0) {
+        close(v->fd);
+      }
+      if (v->index_fd >= 0) {
+        close(v->index_fd);
+      }
+      v->fd = -1;
+      v->index_fd = -1;
+      return false;
+    }
+  }
 
-void insula_tick_effect(struct Effect *e, const struct City *c,
-                        struct City *c1) {
-  c1->population_delta += 1;
-}
+  if (num_blocks == v->num_index_entries && (num_blocks == 0 || v->map != NULL)) {
+    return true;
+  }
 
-void port_ostia_tick_effect(struct Effect *e, const struct City *c,
-                            struct City *c1) {
-  // TODO:
-}
+  journal_view_unmap(v);
+  struct stat st;
+  struct stat index_st;
+  const size_t index_size = num_blocks * sizeof(struct JournalIndexEntry);
+  if (fstat(v->fd, &st) != 0 || fstat(v->index_fd, &index_st) != 0 ||
+      (size_t)st.st_size < sizeof(struct JournalHeader) || (size_t)index_st.st_size < index_size) {
+    return false;
+  }
 
-void taberna_bakery_tick_effect(struct Effect *e, const struct City *c,
+  v->map = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, v->fd, 0);
+  if (v->map == MAP_FAILED) {
+    v->map = NULL;
+    return false;
+  }
+  v->map_size = st.st_size;
+
+  const struct JournalHeader *header = (const struct JournalHeader *)v->map;
+  if (memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != JOURNAL_VERSION || header->record_size != sizeof(struct EventRecord) || header->id != j->id) {
+    journal_view_unmap(v);
+    return false;
+  }
+
+  if (index_size > 0) {
+    v->index = (const struct JournalIndexEntry *)mmap(NULL, index_size, PROT_READ, MAP_SHARED, v->index_fd, 0);
+    if (v->index == MAP_FAILED) {
+      v->index = NULL;
+      journal_view_unmap(v);
+      return false;
+    }
+    v->num_index_entries = num_blocks;
+  }
+  return true;
+}
+
+// Updates the view with the records written since the last update, returns
+// false on failure
+bool journal_view_update(struct JournalView *v, const struct Journal *j) {
+  assert(v); assert(j);
+  if (j->file == NULL) {
+    return false;
+  }
+  if (v->tail == NULL) {
+    v->tail = (struct EventRecord *)calloc(2 * JOURNAL_BLOCK_RECORDS, sizeof(struct EventRecord));
+    v->tail_text = (uint8_t *)malloc(2 * JOURNAL_BLOCK_RECORDS * JOURNAL_TEXT_MAX);
+    v->block = (uint8_t *)calloc(JOURNAL_BLOCK_SIZE, sizeof(uint8_t));
+  }
+  if (v->generation != j->generation) {
+    journal_view_close(v);
+    v->generation = j->generation;
+  }
+
+  // Snapshot the records not yet on disk together with the number of blocks that are
+  SDL_LockMutex(j->lock);
+  const uint32_t num_blocks = j->num_blocks;
+  const uint64_t num_records = j->num_records;
+  if (num_records != v->num_records || num_blocks != v->num_index_entries) {
+    memcpy(v->tail, j->sealed, j->num_sealed * sizeof(struct EventRecord));
+    memcpy(v->tail_text, j->sealed_text, j->sealed_text_size);
+    for (uint32_t i = 0; i < j->num_block_records; i++) {
+      struct EventRecord rec = j->block[i];
+      if (rec.type == EVENT_TEXT) {
+        rec.args[0].h += j->sealed_text_size; // The text of the block follows that of the sealed block
+      }
+      v->tail[j->num_sealed + i] = rec;
+    }
+    memcpy(&v->tail_text[j->sealed_text_size], j->block_text, j->block_text_size);
+    v->num_tail = j->num_sealed + j->num_block_records;
+    v->tail_text_size = j->sealed_text_size + j->block_text_size;
+  }
+  SDL_UnlockMutex(j->lock);
+
+  if (!journal_view_map(v, j, num_blocks)) {
+    v->num_records = 0;
+    return false;
+  }
+  v->num_records = num_records;
+  return true;
+}
+
+// Returns record n, msg (optional) is set to the text of EVENT_TEXT records
+// and to NULL otherwise
+static const struct EventRecord *journal_view_record(struct JournalView *v, const uint64_t n, const char **msg) {
+  assert(n < v->num_records);
+  const struct EventRecord *rec = NULL;
+  const uint8_t *text = NULL;
+  uint32_t text_size = 0;
+  const size_t block = n / JOURNAL_BLOCK_RECORDS;
+  if (block >= v->num_index_entries) {
+    rec = &v->tail[n - v->num_index_entries * JOURNAL_BLOCK_RECORDS];
+    text = v->tail_text;
+    text_size = v->tail_text_size;
+  } else {
+    if (!v->has_block || v->block_index != block) {
+      const struct JournalIndexEntry *entry = &v->index[block];
+      const size_t records_size = entry->num_records * sizeof(struct EventRecord);
+      const bool in_bounds = entry->num_records <= JOURNAL_BLOCK_RECORDS && entry->raw_size >= records_size &&
+                             entry->raw_size <= JOURNAL_BLOCK_SIZE && entry->offset <= v->map_size &&
+                             entry->size <= v->map_size - entry->offset;
+      v->block_text = &v->block[records_size];
+      v->block_text_size = entry->raw_size - records_size;
+      if (in_bounds && entry->size == entry->raw_size) {
+        memcpy(v->block, &v->map[entry->offset], entry->raw_size);
+      } else if (!in_bounds || !lz_decompress(&v->map[entry->offset], entry->size, v->block, entry->raw_size)) {
+        fprintf(stderr, "[ColoniaC]: Journal block %zu is corrupt \n", block);
+        memset(v->block, 0, JOURNAL_BLOCK_RECORDS * sizeof(struct EventRecord));
+        v->block_text = v->block;
+        v->block_text_size = 0;
+      }
+      v->block_index = block;
+      v->has_block = true;
+    }
+    rec = &((const struct EventRecord *)v->block)[n % JOURNAL_BLOCK_RECORDS];
+    text = v->block_text;
+    text_size = v->block_text_size;
+  }
+
+  if (msg) {
+    *msg = rec->type == EVENT_TEXT ? journal_text(text, text_size, rec->args[0].h) : NULL;
+  }
+  return rec;
+}
+
+// True if the block containing record n can be skipped by a type filter
+static bool journal_view_skip_block(const struct JournalView *v, const uint64_t n,
+                                    const uint32_t type_mask) {
+  const uint64_t block = n / JOURNAL_BLOCK_RECORDS;
+  return block < v->num_index_entries && (v->index[block].type_mask & type_mask) == 0;
+}
+
+// Returns the record number count matching records after (dir > 0) or before
+// (dir < 0) record n, clamped to the journal
+uint64_t journal_view_seek(struct JournalView *v, uint64_t n, const int dir,
+                           uint32_t count, const uint32_t type_mask) {
+  if (dir > 0) {
+    while (count > 0 && n < v->num_records) {
+      if (n % JOURNAL_BLOCK_RECORDS == 0 && journal_view_skip_block(v, n, type_mask)) {
+        n += JOURNAL_BLOCK_RECORDS;
+        continue;
+      }
+      if (type_mask & (1u << journal_view_record(v, n, NULL)->type)) {
+        count--;
+      }
+      n++;
+    }
+    return n < v->num_records ? n : v->num_records;
+  }
+
+  while (count > 0 && n > 0) {
+    if (n % JOURNAL_BLOCK_RECORDS == 0 && journal_view_skip_block(v, n - 1, type_mask)) {
+      n -= JOURNAL_BLOCK_RECORDS;
+      continue;
+    }
+    n--;
+    if (type_mask & (1u << journal_view_record(v, n, NULL)->type)) {
+      count--;
+    }
+  }
+  return n;
+}
+
+// Returns the first record dated on or after the key
+uint64_t journal_view_find_date(struct JournalView *v, const int32_t key) {
+  uint64_t n = 0;
+  for (size_t i = 0; i < v->num_index_entries; i++) {
+    if (v->index[i].first_date >= key) {
+      break;
+    }
+    n = i * JOURNAL_BLOCK_RECORDS;
+  }
+  for (; n < v->num_records; n++) {
+    const struct EventRecord *rec = journal_view_record(v, n, NULL);
+    if (date_key(rec->year, rec->month, rec->day) >= key) {
+      break;
+    }
+  }
+  return n;
+}
+
+
+// Ring buffer of length-prefixed event records stored inline in one byte buffer
+#define EVENTLOG_DEFAULT_CAPACITY 4096 // Default ring size in bytes (see config.json)
+#define EVENTLOG_MIN_CAPACITY (sizeof(uint16_t) + sizeof(struct EventRecord) + EVENTLOG_MSG_MAX) // Fits one msg
+struct EventLog {
+  uint8_t *buf;      // [len (uint16_t), EventRecord, msg] records back to back
+  uint32_t capacity; // Size of buf in bytes
+  uint32_t head;     // Offset of the oldest record
+  uint32_t tail;     // Offset where the next record is written
+  uint32_t end;      // Offset where the records stop before wrapping to 0
+  uint32_t num_msgs;
+  bool wrapped;            // Records are in [head, end) followed by [0, tail)
+  uint32_t version;        // Bumped when msgs are added or dropped
+  struct Journal *journal; // Optional on-disk history of every event added
+};
+
+// Iterator from oldest to newest msg, does not modify the EventLog
+struct EventLogIter {
+  uint32_t offset;
+  uint32_t remaining;
+};
+
+struct EventLog eventlog_new(uint32_t capacity) {
+  struct EventLog log = {.capacity = capacity < EVENTLOG_MIN_CAPACITY ? EVENTLOG_MIN_CAPACITY : capacity};
+  log.buf = (uint8_t *)calloc(log.capacity, sizeof(uint8_t));
+  log.end = log.capacity;
+  return log;
+}
+
+void eventlog_clear(struct EventLog *log) {
+  assert(log);
+  log->head = 0;
+  log->tail = 0;
+  log->end = log->capacity;
+  log->num_msgs = 0;
+  log->wrapped = false;
+  log->version++;
+}
+
+// Drops the oldest msg
+static void eventlog_pop_msg(struct EventLog *log) {
+  assert(log->num_msgs > 0);
+  uint16_t len = 0;
+  memcpy(&len, &log->buf[log->head], sizeof(len));
+  log->head += sizeof(len) + len;
+  log->num_msgs--;
+
+  if (log->num_msgs == 0) {
+    eventlog_clear(log);
+  } else if (log->wrapped && log->head == log->end) {
+    log->head = 0;
+    log->end = log->capacity;
+    log->wrapped = false;
+  }
+}
+
+// Reserves len bytes for a new record after its length prefix, evicts the
+// oldest msgs if the ring is full
+static uint8_t *eventlog_push(struct EventLog *log, const uint16_t len) {
+  const uint32_t size = sizeof(len) + len;
+  assert(size <= log->capacity);
+
+  while (true) {
+    if (!log->wrapped) {
+      if (log->capacity - log->tail >= size) {
+        break;
+      }
+      // Not enough room at the end, continue from the start of the buffer
+      log->end = log->tail;
+      log->tail = 0;
+      log->wrapped = true;
+    } else {
+      if (log->head - log->tail >= size) {
+        break;
+      }
+      eventlog_pop_msg(log);
+    }
+  }
+
+  uint8_t *dst = &log->buf[log->tail];
+  memcpy(dst, &len, sizeof(len));
+  log->tail += size;
+  log->num_msgs++;
+  log->version++;
+  return dst + sizeof(len);
+}
+
+// Adds a structured event dated today, the record is formatted when displayed
+void eventlog_add_event(struct EventLog *log, struct EventRecord rec) {
+  assert(log);
+  rec.year = date.year;
+  rec.month = date.month;
+  rec.day = date.day;
+  memcpy(eventlog_push(log, sizeof(rec)), &rec, sizeof(rec));
+  if (log->journal) {
+    journal_append(log->journal, &rec, NULL);
+  }
+}
+
+// Adds msg to the eventlog by copying over the string. Msgs longer than
+// EVENTLOG_MSG_MAX are truncated.
+void eventlog_add_msg(struct EventLog *log, const char *msg) {
+  assert(log);
+  assert(msg);
+
+  size_t msg_lng = strlen(msg);
+  if (msg_lng > EVENTLOG_MSG_MAX - 1) {
+    msg_lng = EVENTLOG_MSG_MAX - 1;
+  }
+
+  const struct EventRecord rec = {.type = EVENT_TEXT,
+                                  .year = date.year,
+                                  .month = date.month,
+                                  .day = date.day};
+  uint8_t *dst = eventlog_push(log, sizeof(rec) + msg_lng + 1);
+  memcpy(dst, &rec, sizeof(rec));
+  memcpy(dst + sizeof(rec), msg, msg_lng);
+  dst[sizeof(rec) + msg_lng] = '\0';
+  if (log->journal) {
+    journal_append(log->journal, &rec, (const char *)(dst + sizeof(rec)));
+  }
+}
+
+void eventlog_add_msgf(struct EventLog *log, const char *fmt, ...) {
+  char msg[EVENTLOG_MSG_MAX];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, args);
+  va_end(args);
+  eventlog_add_msg(log, msg);
+}
+
+// Checks that the ring of an EventLog read from a savegame holds num_msgs
+// whole records, the iterators trust the length prefixes
+bool eventlog_validate(const struct EventLog *log) {
+  assert(log);
+  if (log->capacity < EVENTLOG_MIN_CAPACITY || log->head > log->capacity || log->tail > log->capacity ||
+      log->end > log->capacity) {
+    return false;
+  }
+  if (log->wrapped ? (log->tail > log->head || log->head > log->end)
+                   : (log->head > log->tail || log->end != log->capacity)) {
+    return false;
+  }
+
+  // Records are in [head, end) followed by [0, tail) if wrapped, else in [head, tail)
+  uint32_t offset = log->head;
+  uint32_t stop = log->wrapped ? log->end : log->tail;
+  bool last_part = !log->wrapped;
+  uint32_t num_msgs = 0;
+  while (true) {
+    if (offset == stop) {
+      if (last_part) {
+        break;
+      }
+      offset = 0;
+      stop = log->tail;
+      last_part = true;
+      continue;
+    }
+
+    uint16_t len = 0;
+    if (stop - offset < sizeof(len)) {
+      return false;
+    }
+    memcpy(&len, &log->buf[offset], sizeof(len));
+    if (len < sizeof(struct EventRecord) || len > stop - offset - sizeof(len)) {
+      return false;
+    }
+    struct EventRecord rec;
+    memcpy(&rec, &log->buf[offset + sizeof(len)], sizeof(rec));
+    const uint32_t msg_lng = len - sizeof(rec); // Including the '\0'
+    if (rec.type >= NUM_EVENT_TYPES || (rec.type == EVENT_TEXT) != (msg_lng > 0) || msg_lng > EVENTLOG_MSG_MAX ||
+        (msg_lng > 0 && log->buf[offset + sizeof(len) + len - 1] != '\0')) {
+      return false;
+    }
+    offset += sizeof(len) + len;
+    num_msgs++;
+  }
+  return num_msgs == log->num_msgs;
+}
+
+struct EventLogIter eventlog_iter(const struct EventLog *log) {
+  assert(log);
+  const struct EventLogIter it = {.offset = log->head, .remaining = log->num_msgs};
+  return it;
+}
+
+// Returns false when there are no more msgs. rec is copied out of the ring,
+// msg points into the ring for EVENT_TEXT records and is NULL otherwise.
+bool eventlog_iter_next(const struct EventLog *log, struct EventLogIter *it,
+                        struct EventRecord *rec, const char **msg) {
+  assert(log);
+  assert(it);
+  assert(rec);
+  assert(msg);
+
+  if (it->remaining == 0) {
+    return false;
+  }
+
+  if (log->wrapped && it->offset == log->end) {
+    it->offset = 0;
+  }
+
+  uint16_t len = 0;
+  const uint8_t *src = &log->buf[it->offset];
+  memcpy(&len, src, sizeof(len));
+  memcpy(rec, src + sizeof(len), sizeof(*rec));
+  *msg = NULL;
+  if (rec->type == EVENT_TEXT) {
+    *msg = (const char *)(src + sizeof(len) + sizeof(*rec));
+  }
+  it->offset += sizeof(len) + len;
+  it->remaining--;
+  return true;
+}
+
+struct ForumArgument {
+  size_t taberna_capacity;
+  size_t num_taberna;
+  uint32_t tabernas; // Construction handle, COMPONENT_NONE if there are none
+};
+
+struct LandTaxArgument {
+  float tax_percentage;
+};
+
+#define COMPONENT_NONE 0xFFFFFFFFu // No component or construction handle
+
+struct FarmArgument {
+  size_t area;                  // Land area used (jugerum, cirka 0.6 hectare)
+  enum FarmProduceType produce; // Farm produce (olives, grapes, etc)
+  // NOTE: Individual farm cyclic ouput parameters
+  const float p0;
+  const float p1;
+  uint32_t construction; // Farm construction, COMPONENT_NONE for construction project variants
+};
+
+enum { MAGISTRATES_AEDILE = 0x1, MAGISTRATES_CENSOR = 0x2 };
+struct CursusHonorum {
+  size_t magistrates_enabled;
+  bool aedile_enabled;
+  bool censor_enabled;
+  uint32_t aedile_assigned_construction; // Construction handle, COMPONENT_NONE if unassigned
+};
+
+/***** callback registry *****/
+// Callbacks kept in the game state are stored as stable IDs into their
+// registry instead of function pointers, which keeps the state serialisable.
+// NOTE: IDs are part of the savegame format, only ever append new IDs
+
+/// Effect.tick_effect
+enum TickEffectId {
+  TICK_EFFECT_NONE = 0,
+  TICK_EFFECT_BUILDING_MAINTENANCE,
+  TICK_EFFECT_FARM,
+  TICK_EFFECT_AQUEDUCT,
+  TICK_EFFECT_BASILICA,
+  TICK_EFFECT_FORUM,
+  TICK_EFFECT_COIN_MINT,
+  TICK_EFFECT_TEMPLE_OF_JUPITER,
+  TICK_EFFECT_TEMPLE_OF_MARS,
+  TICK_EFFECT_TEMPLE_OF_VULCAN,
+  TICK_EFFECT_POPS_EATING,
+  TICK_EFFECT_SENATE_HOUSE,
+  TICK_EFFECT_LAND_TAX,
+  TICK_EFFECT_INSULA,
+  TICK_EFFECT_PORT_OSTIA,
+  TICK_EFFECT_TABERNA_BAKERY,
+  TICK_EFFECT_VILLA_PUBLICA,
+  TICK_EFFECT_CIRCUS_MAXIMUS,
+  TICK_EFFECT_EVENT_LOG_TEST,
+  TICK_EFFECT_ENACT_LAW,
+  TICK_EFFECT_BATH,
+  TICK_EFFECT_IMPERATOR_DEMANDS_MONEY,
+  TICK_EFFECT_BUILDING,
+  NUM_TICK_EFFECTS
+};
+
+/// Popup.callback
+enum PopupCallbackId {
+  POPUP_CALLBACK_NONE = 0,
+  POPUP_CALLBACK_IMPERATOR_DEMANDS_MONEY,
+  NUM_POPUP_CALLBACKS
+};
+
+/// Construction.gui_construction_management
+enum ConstructionGuiId {
+  CONSTRUCTION_GUI_NONE = 0,
+  CONSTRUCTION_GUI_FARM,
+  CONSTRUCTION_GUI_FORUM,
+  NUM_CONSTRUCTION_GUIS
+};
+
+/// Law.gui_handler
+enum LawGuiId {
+  LAW_GUI_NONE = 0,
+  NUM_LAW_GUIS
+};
+
+/// Type of the custom argument of an effect (Effect.arg)
+enum EffectArgType {
+  EFFECT_ARG_NONE = 0,
+  EFFECT_ARG_FARM,         // struct FarmArgument
+  EFFECT_ARG_FORUM,        // struct ForumArgument
+  EFFECT_ARG_LAND_TAX,     // struct LandTaxArgument
+  EFFECT_ARG_CONSTRUCTION, // struct Construction in City.constructions (Effect.component)
+  EFFECT_ARG_LAW,          // struct Law in City.available_laws
+  NUM_EFFECT_ARG_TYPES
+};
+
+// Roman Lex (pl. leges)
+struct Law {
+  bool passed;
+  char *name_str;        // TODO: Classify the strings used and where they fit in the UI
+  char *description_str;
+  char *help_str;
+  enum CapacityType type;
+  uint8_t cost;     // Quantify of power points
+  uint8_t cost_lng; // How many ticks the cost is incurred
+  struct Date date_passed;
+  struct Effect *effect;
+  uint8_t gui_handler; // enum LawGuiId
+};
+
+struct Construction {
+  float construction_delay_risk; // TODO: Implement it ...
+  bool construction_in_progress; // Active construction site or not
+  bool construction_finished;
+  bool maintained; // Affects maintenance cost & effects
+  const char *name_str;
+  const char *description_str; // Short descriptive str
+  const char *help_str;        // Longer explainatory str used in help menus
+  float construction_cost;     // Cost in gold per timestep construction period
+  float cost;
+  float maintenance;
+  // NOTE: Effect.description_str provides gameplay information in short format
+  // If true, the Effect may only be built once and Effect is duration = FOREVER
+  bool unique_effects;
+  struct Effect *effect;
+  size_t num_effects;          // Construction variants available to build now
+  size_t num_effects_capacity; // Number of construction variants from the start (IMMUTABLE)
+  size_t construction_time;    // Time to build in timesteps (days)
+  struct Date construction_started;
+  struct Date construction_completed;
+  // Management pane of the construction (enum ConstructionGuiId)
+  uint8_t gui_construction_management;
+};
+
+// TODO: Documentate
+struct {
+  float max_population_reached;
+} Gamestate;
+
+struct City {
+  char *name;
+  struct EventLog *log;
+  // Flags
+  bool diplomacy_enabled;
+  // Farming
+  float *produce_values; // Gold and nutriental (food) value in terms of produce
+  size_t land_area;      // Land area available (used by farms, mansio, castrum)
+  size_t land_area_used; // Land used
+  float food_production; // Excess food creates population & gold
+  float food_production_modifier;
+  float food_usage;
+  // Gold
+  float gold; // Gold creates food (negative counts as debt)
+  float gold_usage;
+  /// Capacity
+  uint32_t political_capacity;
+  uint32_t political_usage;
+  uint32_t diplomatic_capacity;
+  uint32_t diplomatic_usage;
+  uint32_t military_capacity;
+  uint32_t military_usage;
+  /// Demographics
+  size_t population;
+  int32_t population_delta;
+  /// Effects
+  struct Effect *effects;
+  size_t num_effects;
+  size_t num_effects_capacity;
+  uint32_t effects_version; // Bumped when effects are added or removed
+  // Construction projects available
+  struct Construction *construction_projects;
+  size_t num_construction_projects;
+  size_t num_construction_projects_capacity;
+  // Constructions raised and still standing
+  struct Construction *constructions;
+  size_t num_constructions;
+  size_t num_constructions_capacity;
+  uint32_t constructions_version; // Bumped when constructions are added or finished
+  // Popups
+  struct Popup *popups;
+  size_t num_popups;
+  size_t num_popups_capacity;
+  // Laws
+  bool laws_enabled;
+  struct Law *available_laws;
+  size_t num_available_laws;
+  size_t num_available_laws_capacity;
+  struct CursusHonorum *cursus_honorum;
+  struct Components *components; // Effect arguments
+};
+
+#define FOREVER -1
+// NOTE: When either one of the human readable strings are NULL the effect is
+// hidden in the UI.
+struct Effect {
+  bool scheduled_for_removal; // Removed next simulation step if true
+  char *name_str;             // Human readable name of the effect
+  char *description_str;      // Human readable description of the effect
+  int64_t duration; // Negative for forever, 0 = done/inactive, timesteps left
+  void *arg;        // Custom argument provided, type given by the registry
+  // NOTE: Tick effect is a function used as: c1 = tick_effect(c, e)
+  uint16_t tick_effect; // enum TickEffectId
+  uint32_t component;   // Handle of the argument if its type is a component (see components_pool) or a construction
+};
+
+struct Popup {
+  char *title;
+  char *description;
+  uint32_t num_choices;
+  char **choices;
+  char **hover_txts; // Description text for the choices when hovering over them
+  uint8_t callback; // enum PopupCallbackId
+  // NOTE: -1 = not handled by user, >= 0 callback executed in simulate_timestep
+  int32_t choice_choosen; // Set by the popup handling mechanic and processed by the callback
+};
+
+struct TickEffectEntry {
+  void (*fn)(struct Effect *e, const struct City *c, struct City *c1);
+  enum EffectArgType arg_type;
+  const char *name_str; // Debug name
+};
+
+// Registries are defined once their callbacks are (see simulation)
+static const struct TickEffectEntry tick_effect_registry[NUM_TICK_EFFECTS];
+static void (*const popup_callback_registry[NUM_POPUP_CALLBACKS])(const struct Popup *p,
+                                                                  const struct City *c,
+                                                                  struct City *c1);
+
+#define CITY_ARRAY_GROWTH 100 // Entries the City arrays grow by, also the room left after a load
+
+/// NOTE: All city_add_* functions returns a ptr to the last element added
+struct Popup *city_add_popup(struct City *c, const struct Popup p) {
+  if (c->num_popups + 1 > c->num_popups_capacity) {
+    c->num_popups_capacity += CITY_ARRAY_GROWTH; // FIXME: Realloc will invalidate ptrs
+    c->popups = realloc(c->popups, sizeof(struct Popup) * c->num_popups_capacity);
+  }
+  c->popups[c->num_popups++] = p;
+  return &c->popups[c->num_popups - 1];
+}
+
+struct Effect *city_add_effect(struct City *c, const struct Effect e) {
+  if (c->num_effects + 1 > c->num_effects_capacity) {
+    c->num_effects_capacity += CITY_ARRAY_GROWTH;
+    c->effects = realloc(c->effects, sizeof(struct Effect) * c->num_effects_capacity);
+  }
+  c->effects[c->num_effects++] = e;
+  c->effects_version++;
+  return &c->effects[c->num_effects - 1];
+}
+
+struct Construction *city_add_construction(struct City *c, const struct Construction con) {
+  if (c->num_constructions + 1 > c->num_constructions_capacity) {
+    c->num_constructions_capacity += CITY_ARRAY_GROWTH;
+    c->constructions = realloc(c->constructions, sizeof(struct Construction) * c->num_constructions_capacity);
+  }
+  c->constructions[c->num_constructions++] = con;
+  c->constructions_version++;
+  return &c->constructions[c->num_constructions - 1];
+}
+
+struct Construction *city_add_construction_project(struct City *c, struct Construction con) {
+  con.num_effects_capacity = con.num_effects; // NOTE: Set initial number of effect available
+
+  if (c->num_construction_projects + 1 > c->num_construction_projects_capacity) {
+    c->num_construction_projects_capacity += CITY_ARRAY_GROWTH;
+    c->construction_projects = realloc( c->construction_projects, sizeof(struct Construction) * c->num_construction_projects_capacity);
+  }
+  c->construction_projects[c->num_construction_projects++] = con;
+  return &c->construction_projects[c->num_construction_projects - 1];
+}
+
+struct Law *city_add_law(struct City *c, const struct Law l) {
+  if (c->num_available_laws + 1 > c->num_available_laws_capacity) {
+    c->num_available_laws_capacity += CITY_ARRAY_GROWTH;
+    c->available_laws = realloc(c->available_laws, sizeof(struct Law) * c->num_available_laws_capacity);
+  }
+  c->available_laws[c->num_available_laws++] = l;
+  return &c->available_laws[c->num_available_laws_capacity - 1];
+}
+
+// Frees an array of effects, building effects own their strings
+void effects_free(struct Effect *effects, const size_t num_effects) {
+  for (size_t i = 0; i < num_effects; i++) {
+    if (effects[i].tick_effect == TICK_EFFECT_BUILDING && effects[i].component != COMPONENT_NONE) {
+      free(effects[i].name_str);
+      free(effects[i].description_str);
+    }
+  }
+  free(effects);
+}
+
+// Frees an array of constructions (or projects) and the effects each owns
+void constructions_free(struct Construction *cons, const size_t num_cons) {
+  for (size_t i = 0; i < num_cons; i++) {
+    free(cons[i].effect);
+  }
+  free(cons);
+}
+
+// Frees an array of laws and the effect each owns
+void laws_free(struct Law *laws, const size_t num_laws) {
+  for (size_t i = 0; i < num_laws; i++) {
+    free(laws[i].effect);
+  }
+  free(laws);
+}
+
+/***** component pools *****/
+// Effect arguments of the FARM, FORUM and LAND_TAX types are components kept
+// in a typed pool per type, one record per instance so that every construction
+// has its own state. Effects refer to their record by handle (Effect.component)
+// as records move when a pool grows. Freed records are reused via a free list.
+
+struct ComponentPool {
+  uint8_t *records; // num_records records of record_size bytes
+  uint8_t *alive;   // Per record, 0 if the record is on the free list
+  uint32_t *free_list;
+  uint32_t record_size;
+  uint32_t num_records;
+  uint32_t num_free;
+  uint32_t capacity;
+};
+
+struct Components {
+  struct ComponentPool farms;      // struct FarmArgument
+  struct ComponentPool forums;     // struct ForumArgument
+  struct ComponentPool land_taxes; // struct LandTaxArgument
+};
+
+struct Components *components_new() {
+  struct Components *cs = (struct Components *)calloc(1, sizeof(struct Components));
+  cs->farms.record_size = sizeof(struct FarmArgument);
+  cs->forums.record_size = sizeof(struct ForumArgument);
+  cs->land_taxes.record_size = sizeof(struct LandTaxArgument);
+  return cs;
+}
+
+// Pool of the arguments of type, NULL if the type is not a component
+static struct ComponentPool *components_pool(struct Components *cs, const enum EffectArgType type) {
+  switch (type) {
+  case EFFECT_ARG_FARM:
+    return &cs->farms;
+  case EFFECT_ARG_FORUM:
+    return &cs->forums;
+  case EFFECT_ARG_LAND_TAX:
+    return &cs->land_taxes;
+  default:
+    return NULL;
+  }
+}
+
+static inline void *component_get(const struct ComponentPool *p, const uint32_t handle) {
+  assert(handle < p->num_records && p->alive[handle] && "Invalid component handle");
+  return &p->records[(size_t)handle * p->record_size];
+}
+
+static inline struct FarmArgument *farm_component(const struct City *c, const uint32_t handle) {
+  return (struct FarmArgument *)component_get(&c->components->farms, handle);
+}
+
+static inline struct ForumArgument *forum_component(const struct City *c, const uint32_t handle) {
+  return (struct ForumArgument *)component_get(&c->components->forums, handle);
+}
+
+static inline struct LandTaxArgument *land_tax_component(const struct City *c, const uint32_t handle) {
+  return (struct LandTaxArgument *)component_get(&c->components->land_taxes, handle);
+}
+
+// Constructions are referenced by their index in City.constructions as the
+// array moves when it grows, NULL for COMPONENT_NONE
+static inline struct Construction *construction_get(const struct City *c, const uint32_t handle) {
+  assert((handle == COMPONENT_NONE || handle < c->num_constructions) && "Invalid construction handle");
+  return handle < c->num_constructions ? &c->constructions[handle] : NULL;
+}
+
+// Returns the handle of a new zeroed record
+uint32_t component_new(struct ComponentPool *p) {
+  assert(p); assert(p->record_size > 0);
+  uint32_t handle;
+  if (p->num_free > 0) {
+    handle = p->free_list[--p->num_free];
+  } else {
+    if (p->num_records == p->capacity) {
+      p->capacity = p->capacity ? 2 * p->capacity : 16;
+      p->records = (uint8_t *)realloc(p->records, (size_t)p->capacity * p->record_size);
+      p->alive = (uint8_t *)realloc(p->alive, p->capacity);
+      p->free_list = (uint32_t *)realloc(p->free_list, p->capacity * sizeof(uint32_t));
+    }
+    handle = p->num_records++;
+  }
+  p->alive[handle] = 1;
+  memset(&p->records[(size_t)handle * p->record_size], 0, p->record_size);
+  return handle;
+}
+
+// Returns the handle of a new copy of the record handle
+uint32_t component_clone(struct ComponentPool *p, const uint32_t handle) {
+  const uint32_t clone = component_new(p);
+  memcpy(component_get(p, clone), component_get(p, handle), p->record_size);
+  return clone;
+}
+
+void component_free(struct ComponentPool *p, const uint32_t handle) {
+  assert(p->alive[handle]);
+  memset(component_get(p, handle), 0, p->record_size);
+  p->alive[handle] = 0;
+  p->free_list[p->num_free++] = handle;
+}
+
+void component_pool_free(struct ComponentPool *p) {
+  free(p->records);
+  free(p->alive);
+  free(p->free_list);
+  *p = (struct ComponentPool){.record_size = p->record_size};
+}
+
+// Copy of e for a new instance owned by the construction, with its own component
+struct Effect effect_instance(struct City *c, const struct Effect *e, const uint32_t construction) {
+  assert(c); assert(e);
+  struct Effect instance = *e;
+  const enum EffectArgType type = tick_effect_registry[e->tick_effect].arg_type;
+  struct ComponentPool *pool = components_pool(c->components, type);
+  if (pool) {
+    instance.component = component_clone(pool, e->component);
+    if (type == EFFECT_ARG_FARM) {
+      farm_component(c, instance.component)->construction = construction;
+    }
+  } else if (type == EFFECT_ARG_CONSTRUCTION) {
+    instance.component = construction;
+  }
+  return instance;
+}
+
+// Food production of all finished and maintained farms, streamed over the
+// dense farm pool instead of ticking each farm effect
+static void farm_production_kernel(const struct City *c, struct City *c1) {
+  const struct ComponentPool *pool = &c->components->farms;
+  const struct FarmArgument *farms = (const struct FarmArgument *)pool->records;
+  float food_production = 0.0f;
+  size_t land_area_used = 0;
+  for (uint32_t i = 0; i < pool->num_records; i++) {
+    const struct FarmArgument *farm = &farms[i];
+    if (!pool->alive[i] || farm->construction == COMPONENT_NONE) {
+      continue; // Free record or a farm variant of the construction projects
+    }
+    const struct Construction *con = &c1->constructions[farm->construction];
+    if (!con->construction_finished || !con->maintained) {
+      continue;
+    }
+    // FIXME: const float output_effectiveness = fabs(cosf(farm->p0 + date.month + (M_PI / 12.0f))) + farm->p1;
+    food_production += c->produce_values[farm->produce] * farm->area;
+    land_area_used += farm->area;
+  }
+  c1->food_production += food_production;
+  c1->land_area_used += land_area_used;
+}
+
+/// Calculates the population changes this timestep
+void population_calculation(const struct City *c, struct City *c1) {
+  assert(c); assert(c1);
+
+  // TODO: Import / Export of foodstuffs
+  // TODO: Add different produce effectiveness values instead of using the
+  // current value (see farm_tick_effect)
+  // TODO: Limit 1 of each type of farm (or even building)
+
+  // Food-gold cycle
+  {
+    // TODO: Bad to use avg. when I know how much of each produce is produced ...
+    float avg_food_price = 0.0f;
+    for (size_t i = 0; i < NUMBER_OF_PRODUCE; i++) {
+      avg_food_price += c->produce_values[i];
+    }
+    avg_food_price /= NUMBER_OF_PRODUCE;
+    c1->gold_usage += avg_food_price * (c->food_production - c->food_usage);
+  }
+
+  // Gold-food-population cycle
+  {
+    const float food_limit = 1000.0f * c1->food_production;
+    if (c1->population < food_limit) {
+      c1->population_delta = 1;
+    } else if (c1->population > food_limit) {
+      c1->population_delta = -1;
+    }
+
+    c1->population += c1->population_delta;
+  }
+
+  // Population-gold cycle
+  {
+    const float base_tax = 0.05f;
+    c1->gold_usage -= c1->population * 0.000001f + base_tax;
+  }
+}
+
+/// Apply and deal with the effects in place on the city
+static inline void effect_tick(struct Effect *e, const struct City *c, struct City *c1) {
+  assert(e->tick_effect < NUM_TICK_EFFECTS);
+  if (e->tick_effect != TICK_EFFECT_NONE) {
+    tick_effect_registry[e->tick_effect].fn(e, c, c1);
+  }
+}
+
+// Ticks the effects of c1 grouped by tick effect ID, each group in array order
+static void effects_dispatch(const struct City *c, struct City *c1) {
+  static uint32_t *order = NULL; // Effect indices sorted by ID
+  static size_t order_capacity = 0;
+  if (c1->num_effects > order_capacity) {
+    order_capacity = c1->num_effects_capacity;
+    order = (uint32_t *)realloc(order, sizeof(uint32_t) * order_capacity);
+  }
+
+  // Counting sort, the group of ID i is order[offsets[i]] .. order[offsets[i + 1]]
+  uint32_t offsets[NUM_TICK_EFFECTS + 1] = {0};
+  for (size_t i = 0; i < c1->num_effects; i++) {
+    assert(c1->effects[i].tick_effect < NUM_TICK_EFFECTS);
+    offsets[c1->effects[i].tick_effect + 1]++;
+  }
+  for (size_t id = 0; id < NUM_TICK_EFFECTS; id++) {
+    offsets[id + 1] += offsets[id];
+  }
+  uint32_t next[NUM_TICK_EFFECTS];
+  memcpy(next, offsets, sizeof(next));
+  for (size_t i = 0; i < c1->num_effects; i++) {
+    order[next[c1->effects[i].tick_effect]++] = i;
+  }
+
+  const size_t num_effects = c1->num_effects;
+  for (size_t id = TICK_EFFECT_NONE + 1; id < NUM_TICK_EFFECTS; id++) {
+    void (*tick_effect)(struct Effect *e, const struct City *c, struct City *c1) = tick_effect_registry[id].fn;
+    for (uint32_t k = offsets[id]; k < offsets[id + 1]; k++) {
+      tick_effect(&c1->effects[order[k]], c, c1);
+    }
+  }
+  assert(c1->num_effects == num_effects && "Tick effects must not add effects");
+}
+
+void simulate_next_timestep(const struct City *c, struct City *c1) {
+  assert(c);
+  assert(c1);
+
+  memset(c1, 0, sizeof(struct City)); // Reset next state
+
+  // NOTE: Move shared resources
+  c1->name = c->name;
+  c1->num_effects = c->num_effects;
+  c1->effects = c->effects;
+  c1->military_capacity = c->military_capacity;
+  c1->political_capacity = c->political_capacity;
+  c1->diplomatic_capacity = c->diplomatic_capacity;
+  c1->num_effects_capacity = c->num_effects_capacity;
+  c1->effects_version = c->effects_version;
+  c1->num_construction_projects = c->num_construction_projects;
+  c1->construction_projects = c->construction_projects;
+  c1->num_construction_projects_capacity = c->num_construction_projects_capacity;
+  c1->num_constructions = c->num_constructions;
+  c1->constructions = c->constructions;
+  c1->num_constructions_capacity = c->num_constructions_capacity;
+  c1->constructions_version = c->constructions_version;
+  c1->land_area = c->land_area;
+  c1->produce_values = c->produce_values;
+  c1->log = c->log;
+  c1->popups = c->popups;
+  c1->num_popups = c->num_popups;
+  c1->num_popups_capacity = c->num_popups_capacity;
+  c1->population = c->population;
+  c1->available_laws = c->available_laws;
+  c1->num_available_laws = c->num_available_laws;
+  c1->num_available_laws_capacity = c->num_available_laws_capacity;
+  c1->cursus_honorum = c->cursus_honorum;
+  c1->components = c->components;
+  c1->food_production_modifier = 1.0f;
+
+  for (size_t i = 0; i < c1->num_effects; i++) {
+    if (c1->effects[i].scheduled_for_removal) {
+      c1->effects[i] = c1->effects[c1->num_effects - 1];
+      c1->num_effects--;
+      c1->effects_version++;
+      i--;
+    }
+  }
+
+  // Compute effects affecting the change of rate
+  effects_dispatch(c, c1);
+
+  for (size_t i = 0; i < c1->num_effects; i++) {
+    if (c1->effects[i].duration == FOREVER) {
+      continue;
+    }
+
+    c1->effects[i].duration--;
+    if (c1->effects[i].duration == 0) {
+      c1->effects[i] = c1->effects[c1->num_effects - 1];
+      c1->num_effects--;
+      c1->effects_version++;
+      i--;
+    }
+  }
+
+  // Construction effects
+  farm_production_kernel(c, c1);
+  for (size_t i = 0; i < c1->num_constructions; i++) {
+    const struct Construction *con = &c1->constructions[i];
+    if (!con->construction_finished) {
+      continue;
+    }
+    if (!con->maintained) {
+      continue;
+    }
+    for (size_t j = 0; j < con->num_effects; j++) {
+      effect_tick(&con->effect[j], c, c1);
+    }
+  }
+
+  // Popups effects
+  for (size_t i = 0; i < c1->num_popups; i++) {
+    if (c1->popups[i].choice_choosen >= 0) {
+      assert(c1->popups[i].callback < NUM_POPUP_CALLBACKS);
+      if (c1->popups[i].callback != POPUP_CALLBACK_NONE) {
+        popup_callback_registry[c1->popups[i].callback](&c1->popups[i], c, c1);
+      }
+
+      c1->popups[i] = c1->popups[c1->num_popups - 1];
+      c1->num_popups--;
+      i--;
+    }
+  }
+
+  // Apply modifiers
+  c1->food_production *= c1->food_production_modifier;
+
+  // Compute changes during this timestep
+  population_calculation(c, c1);
+
+  // Compute changes based on current state
+  c1->gold = c->gold - c1->gold_usage;
+
+  timestep++;
+  increment_date(&date);
+}
+
+void building_maintenance_tick_effect(struct Effect *e, const struct City *c,
+                                      struct City *c1) {
+  for (size_t i = 0; i < c->num_constructions; i++) {
+    c1->gold_usage += c->constructions[i].maintenance;
+  }
+}
+
+// NOTE: Farms produce in bulk in farm_production_kernel
+void farm_tick_effect(struct Effect *e, const struct City *c, struct City *c1) {}
+
+void aqueduct_tick_effect(struct Effect *e, const struct City *c,
+                          struct City *c1) {
+  c1->diplomatic_capacity += 1;
+  c1->food_production_modifier += 0.05f;
+  if (e->component != COMPONENT_NONE && c->cursus_honorum->aedile_assigned_construction == e->component) {
+    c1->food_production_modifier += 0.15f;
+  }
+}
+
+void basilica_tick_effect(struct Effect *e, const struct City *c,
+                          struct City *c1) {
+  c1->political_capacity += 1;
+}
+
+void forum_tick_effect(struct Effect *e, const struct City *c,
+                       struct City *c1) {
+  c1->diplomatic_capacity += 1;
+  c1->political_capacity += 1;
+}
+
+void coin_mint_tick_effect(struct Effect *e, const struct City *c,
+                           struct City *c1) {
+  c1->gold_usage -= 0.5f;
+}
+
+void temple_of_jupiter_tick_effect(struct Effect *e, const struct City *c,
+                                   struct City *c1) {
+  c1->diplomatic_capacity += 1;
+}
+
+void temple_of_mars_tick_effect(struct Effect *e, const struct City *c,
+                                struct City *c1) {
+  c1->military_capacity += 1;
+}
+
+void temple_of_vulcan_tick_effect(struct Effect *e, const struct City *c,
+                                  struct City *c1) {
+  // TODO: Add Festival spawning
+}
+
+void pops_eating_tick_effect(struct Effect *e, const struct City *c,
+                             struct City *c1) {
+  const uint32_t consumption = c->population * 0.001f;
+  c1->food_usage += consumption;
+}
+
+void senate_house_tick_effect(struct Effect *e, const struct City *c,
+                              struct City *c1) {
+  c1->laws_enabled = true;
+  c1->diplomatic_capacity += 1;
+  c1->political_capacity += 1;
+}
+
+void land_tax_tick_effect(struct Effect *e, const struct City *c,
+                          struct City *c1) {
+  const struct LandTaxArgument *arg = land_tax_component(c, e->component);
+  const float land_tax_price = 0.05f;
+  c1->gold_usage -= land_tax_price * c->land_area_used * arg->tax_percentage;
+}
+
+void insula_tick_effect(struct Effect *e, const struct City *c,
+                        struct City *c1) {
+  c1->population_delta += 1;
+}
+
+void port_ostia_tick_effect(struct Effect *e, const struct City *c,
+                            struct City *c1) {
+  // TODO:
+}
+
+void taberna_bakery_tick_effect(struct Effect *e, const struct City *c,
                                 struct City *c1) {
   c1->food_production_modifier += 0.1f;
 }
 
-void villa_publica_tick_effect(struct Effect *e, const struct City *c,
-                               struct City *c1) {
-  c1->cursus_honorum->censor_enabled = true;
-  c1->diplomacy_enabled = true;
-  c1->diplomatic_capacity += 1;
-  c1->political_capacity += 1;
+void villa_publica_tick_effect(struct Effect *e, const struct City *c,
+                               struct City *c1) {
+  c1->cursus_honorum->censor_enabled = true;
+  c1->diplomacy_enabled = true;
+  c1->diplomatic_capacity += 1;
+  c1->political_capacity += 1;
+}
+
+void circus_maximus_tick_effect(struct Effect *e, const struct City *c,
+                                struct City *c1) {
+  c1->cursus_honorum->aedile_enabled = true;
+  c1->political_capacity += 2;
+}
+
+void event_log_test_effect(struct Effect *e, const struct City *c,
+                           struct City *c1) {
+  static int i = 1;
+  eventlog_add_event(c->log, (struct EventRecord){.type = EVENT_DEBUG, .args[0].i = i});
+  i++;
+}
+
+void enact_law_tick_effect(struct Effect *e, const struct City *c,
+                           struct City *c1) {
+  const struct Law *arg = (struct Law *)e->arg;
+  switch (arg->type) {
+  case Political:
+    c1->political_usage += arg->cost;
+    break;
+  case Diplomatic:
+    c1->diplomatic_usage += arg->cost;
+    break;
+  case Military:
+    c1->military_usage += arg->cost;
+    break;
+  }
+}
+
+void bath_tick_effect(struct Effect *e, const struct City *c, struct City *c1) {
+  // TODO: Implement
+}
+
+void imperator_demands_money_callback(const struct Popup *p,
+                                      const struct City *c, struct City *c1) {
+  switch (p->choice_choosen) {
+  case 0:
+    c1->gold_usage += 50.0f;
+    break;
+  case 1:
+    c1->population -= 50;
+    break;
+  }
+}
+
+void imperator_demands_money(struct Effect *e, const struct City *c,
+                             struct City *c1) {
+  if (uniform_random() < 0.95f) {
+    return;
+  }
+  struct Popup popup;
+  popup.choice_choosen = -1;
+  popup.title = "War effort in the East requires resources ...";
+  popup.description =
+      "Pompey Magnus has sent envoys from the far East. The "
+      "war effort against "
+      "the Seleucid Empire in the East needs resources. Whether or not these "
+      "conquests will be ratified by the Senate is still an open question ..";
+  popup.num_choices = 2;
+  popup.choices = (char **)calloc(2, sizeof(char *));
+  popup.hover_txts = (char **)calloc(2, sizeof(char *));
+  static char *choices[2] = {"Send a wagon of gold!",
+                             "Send Pompey the finest Legionnaires!"};
+  static char *hover_txts[2] = {"-50.0 gold", "-50 population"};
+  popup.choices = choices;
+  popup.hover_txts = hover_txts;
+  popup.callback = POPUP_CALLBACK_IMPERATOR_DEMANDS_MONEY;
+  city_add_popup(c1, popup);
+}
+
+// Description of a building effect, filled by the building_tick_effect
+#define BUILDING_DESCRIPTION_FMT "%li days left, - %.2f gold / day"
+
+// Callee owned, zeroed buffer large enough for any building effect description
+char *building_description_new(const struct Construction *con) {
+  const int lng = snprintf(NULL, 0, BUILDING_DESCRIPTION_FMT, (long)INT32_MAX,
+                           con->construction_cost) + 1;
+  return (char *)calloc(lng, sizeof(char));
+}
+
+void building_tick_effect(struct Effect *e, const struct City *c,
+                          struct City *c1) {
+  struct Construction *arg = construction_get(c1, e->component);
+  assert(arg && "Building without a construction");
+
+  if (!arg->construction_in_progress) {
+    e->duration++;
+    return;
+  }
+
+  c1->gold_usage += arg->construction_cost;
+
+  const int lng = snprintf(NULL, 0, BUILDING_DESCRIPTION_FMT, (long)e->duration,
+                           arg->construction_cost) + 1;
+  snprintf(e->description_str, lng, BUILDING_DESCRIPTION_FMT, (long)e->duration,
+           arg->construction_cost);
+
+  // TODO: Delay risk per construction and the political environment
+  if (uniform_random() < arg->construction_delay_risk) {
+    e->duration++;
+    return;
+  }
+
+  if (e->duration == 1) {
+    arg->maintained = true;
+    arg->construction_finished = true;
+    arg->construction_completed = date;
+    c1->constructions_version++;
+    arg->construction_in_progress = false;
+
+    eventlog_add_event(c1->log, (struct EventRecord){.type = EVENT_CONSTRUCTION_FINISHED,
+                                                     .args[0].h = catalogue_find_str(arg->name_str)});
+
+    free(e->name_str);
+    e->name_str = NULL;
+    free(e->description_str);
+    e->description_str = NULL;
+  }
+}
+
+static const struct TickEffectEntry tick_effect_registry[NUM_TICK_EFFECTS] = {
+    [TICK_EFFECT_NONE] = {NULL, EFFECT_ARG_NONE, "none"},
+    [TICK_EFFECT_BUILDING_MAINTENANCE] = {building_maintenance_tick_effect, EFFECT_ARG_NONE, "building maintenance"},
+    [TICK_EFFECT_FARM] = {farm_tick_effect, EFFECT_ARG_FARM, "farm"},
+    [TICK_EFFECT_AQUEDUCT] = {aqueduct_tick_effect, EFFECT_ARG_CONSTRUCTION, "aqueduct"},
+    [TICK_EFFECT_BASILICA] = {basilica_tick_effect, EFFECT_ARG_NONE, "basilica"},
+    [TICK_EFFECT_FORUM] = {forum_tick_effect, EFFECT_ARG_FORUM, "forum"},
+    [TICK_EFFECT_COIN_MINT] = {coin_mint_tick_effect, EFFECT_ARG_NONE, "coin mint"},
+    [TICK_EFFECT_TEMPLE_OF_JUPITER] = {temple_of_jupiter_tick_effect, EFFECT_ARG_NONE, "temple of jupiter"},
+    [TICK_EFFECT_TEMPLE_OF_MARS] = {temple_of_mars_tick_effect, EFFECT_ARG_NONE, "temple of mars"},
+    [TICK_EFFECT_TEMPLE_OF_VULCAN] = {temple_of_vulcan_tick_effect, EFFECT_ARG_NONE, "temple of vulcan"},
+    [TICK_EFFECT_POPS_EATING] = {pops_eating_tick_effect, EFFECT_ARG_NONE, "pops eating"},
+    [TICK_EFFECT_SENATE_HOUSE] = {senate_house_tick_effect, EFFECT_ARG_NONE, "senate house"},
+    [TICK_EFFECT_LAND_TAX] = {land_tax_tick_effect, EFFECT_ARG_LAND_TAX, "land tax"},
+    [TICK_EFFECT_INSULA] = {insula_tick_effect, EFFECT_ARG_NONE, "insula"},
+    [TICK_EFFECT_PORT_OSTIA] = {port_ostia_tick_effect, EFFECT_ARG_NONE, "port ostia"},
+    [TICK_EFFECT_TABERNA_BAKERY] = {taberna_bakery_tick_effect, EFFECT_ARG_NONE, "taberna bakery"},
+    [TICK_EFFECT_VILLA_PUBLICA] = {villa_publica_tick_effect, EFFECT_ARG_NONE, "villa publica"},
+    [TICK_EFFECT_CIRCUS_MAXIMUS] = {circus_maximus_tick_effect, EFFECT_ARG_NONE, "circus maximus"},
+    [TICK_EFFECT_EVENT_LOG_TEST] = {event_log_test_effect, EFFECT_ARG_NONE, "event log test"},
+    [TICK_EFFECT_ENACT_LAW] = {enact_law_tick_effect, EFFECT_ARG_LAW, "enact law"},
+    [TICK_EFFECT_BATH] = {bath_tick_effect, EFFECT_ARG_NONE, "bath"},
+    [TICK_EFFECT_IMPERATOR_DEMANDS_MONEY] = {imperator_demands_money, EFFECT_ARG_NONE, "imperator demands money"},
+    [TICK_EFFECT_BUILDING] = {building_tick_effect, EFFECT_ARG_CONSTRUCTION, "building"}};
+
+static void (*const popup_callback_registry[NUM_POPUP_CALLBACKS])(const struct Popup *p,
+                                                                  const struct City *c,
+                                                                  struct City *c1) = {
+    [POPUP_CALLBACK_NONE] = NULL,
+    [POPUP_CALLBACK_IMPERATOR_DEMANDS_MONEY] = imperator_demands_money_callback};
+
+/// Returns true if the law was successfully enacted
+bool city_enact_law(struct City *c, struct Law *l) {
+  switch (l->type) {
+  case Political:
+    if (c->political_usage + l->cost > c->political_capacity) {
+      return false;
+    }
+    break;
+  case Diplomatic:
+    if (c->diplomatic_usage + l->cost > c->diplomatic_capacity) {
+      return false;
+    }
+    break;
+  case Military:
+    if (c->military_usage + l->cost > c->military_capacity) {
+      return false;
+    }
+    break;
+  }
+
+  l->date_passed = date;
+  l->passed = true;
+
+  struct Effect enact_law_effect = {.duration = l->cost_lng, .arg = l, .tick_effect = TICK_EFFECT_ENACT_LAW};
+  city_add_effect(c, enact_law_effect);
+
+  city_add_effect(c, *l->effect);
+
+  return true;
+}
+
+void build_construction(struct City *c, struct Construction *cp,
+                        const struct Effect *activated_effect) {
+  assert(cp); assert(activated_effect);
+
+  struct Construction *con = city_add_construction(c, *cp);
+  assert(con);
+  con->name_str = activated_effect->name_str;
+  con->construction_in_progress = true;
+  con->maintained = true;
+  con->construction_cost = con->cost / con->construction_time;
+  con->effect = calloc(1, sizeof(struct Effect));
+  con->construction_started = date;
+  // Linking the construction and its active effect
+  con->effect[0] = effect_instance(c, activated_effect, con - c->constructions);
+  con->num_effects = 1;
+
+  if (cp->unique_effects) {
+    const size_t i = activated_effect - cp->effect;
+    struct ComponentPool *pool = components_pool(c->components, tick_effect_registry[cp->effect[i].tick_effect].arg_type);
+    if (pool) {
+      component_free(pool, cp->effect[i].component);
+    }
+    cp->effect[i] = cp->effect[cp->num_effects - 1];
+    cp->num_effects--;
+  }
+
+  const uint32_t con_handle = con - c->constructions;
+  eventlog_add_event(c->log, (struct EventRecord){.type = EVENT_CONSTRUCTION_STARTED,
+                                                  .args[0].h = catalogue_find_str(con->name_str)});
+
+  char *description_str = building_description_new(con);
+
+  const int lng = snprintf(NULL, 0, "Building %s", con->name_str) + 1;
+  char *name_str = (char *)calloc(lng, sizeof(char));
+  snprintf(name_str, lng, "Building %s", con->name_str);
+
+  struct Effect building_effect = {.name_str = name_str,
+                                   .description_str = description_str,
+                                   .duration = cp->construction_time,
+                                   .tick_effect = TICK_EFFECT_BUILDING,
+                                   .component = con_handle};
+  city_add_effect(c, building_effect);
+}
+
+/***** player commands *****/
+// Every change the player makes to the game goes through command_issue so
+// that it can be recorded and replayed. Arguments are indices into the City
+// arrays, which are identical when a replay reaches the same timestep.
+enum CommandType {
+  COMMAND_BUILD = 0,           // Construction project, effect (variant)
+  COMMAND_ENACT_LAW,           // Law
+  COMMAND_CHOOSE_POPUP,        // Popup, choice
+  COMMAND_TOGGLE_MAINTENANCE,  // Construction
+  COMMAND_BUY_FARM_LAND,       // Construction (a farm)
+  COMMAND_ASSIGN_AEDILE,       // Construction
+  COMMAND_SET_SPEED,           // Simulation speed
+  COMMAND_PAUSE,               // 1 paused, 0 resumed (window focus, the City is not changed)
+  COMMAND_CANCEL_CONSTRUCTION, // Effect (a building site)
+  COMMAND_TOGGLE_CONSTRUCTION, // Effect (a building site), pauses or resumes the construction
+  NUM_COMMANDS
+};
+
+struct Command {
+  uint32_t type; // enum CommandType
+  uint32_t args[2];
+};
+
+const char *lut_command_str(const enum CommandType type) {
+  static const char *strs[NUM_COMMANDS] = {"build", "enact law", "choose popup",
+                                           "toggle maintenance", "buy farm land",
+                                           "assign aedile", "set speed", "pause",
+                                           "cancel construction", "toggle construction"};
+  return type < NUM_COMMANDS ? strs[type] : "unknown";
+}
+
+/// Returns false if the command does not apply to the City or was refused
+bool command_execute(struct City *c, const struct Command *cmd) {
+  assert(c); assert(cmd);
+  const uint32_t *args = cmd->args;
+  switch ((enum CommandType)cmd->type) {
+  case COMMAND_BUILD: {
+    if (args[0] >= c->num_construction_projects) {
+      return false;
+    }
+    struct Construction *proj = &c->construction_projects[args[0]];
+    if (args[1] >= proj->num_effects) {
+      return false;
+    }
+    build_construction(c, proj, &proj->effect[args[1]]);
+    return true;
+  }
+  case COMMAND_ENACT_LAW:
+    if (args[0] >= c->num_available_laws || c->available_laws[args[0]].passed) {
+      return false;
+    }
+    return city_enact_law(c, &c->available_laws[args[0]]);
+  case COMMAND_CHOOSE_POPUP:
+    if (args[0] >= c->num_popups || args[1] >= c->popups[args[0]].num_choices) {
+      return false;
+    }
+    c->popups[args[0]].choice_choosen = args[1];
+    return true;
+  case COMMAND_TOGGLE_MAINTENANCE:
+    if (args[0] >= c->num_constructions) {
+      return false;
+    }
+    c->constructions[args[0]].maintained = !c->constructions[args[0]].maintained;
+    return true;
+  case COMMAND_BUY_FARM_LAND: {
+    if (args[0] >= c->num_constructions ||
+        c->constructions[args[0]].gui_construction_management != CONSTRUCTION_GUI_FARM) {
+      return false;
+    }
+    struct FarmArgument *arg = farm_component(c, c->constructions[args[0]].effect->component);
+    if (c->gold < arg->area || 1 + c->land_area_used > c->land_area) {
+      return false;
+    }
+    c->gold -= (float) arg->area;
+    arg->area++;
+    return true;
+  }
+  case COMMAND_ASSIGN_AEDILE:
+    if (args[0] >= c->num_constructions || !c->cursus_honorum->aedile_enabled) {
+      return false;
+    }
+    c->cursus_honorum->aedile_assigned_construction = args[0];
+    return true;
+  case COMMAND_SET_SPEED:
+    if (args[0] > 9) {
+      return false;
+    }
+    simulation_speed = args[0];
+    return true;
+  case COMMAND_PAUSE:
+    return true;
+  case COMMAND_CANCEL_CONSTRUCTION:
+  case COMMAND_TOGGLE_CONSTRUCTION: {
+    if (args[0] >= c->num_effects || c->effects[args[0]].tick_effect != TICK_EFFECT_BUILDING ||
+        c->effects[args[0]].component >= c->num_constructions) {
+      return false;
+    }
+    struct Effect *e = &c->effects[args[0]];
+    if (cmd->type == COMMAND_CANCEL_CONSTRUCTION) {
+      e->scheduled_for_removal = true;
+    } else {
+      struct Construction *con = construction_get(c, e->component);
+      con->construction_in_progress = !con->construction_in_progress;
+    }
+    return true;
+  }
+  case NUM_COMMANDS:
+    break;
+  }
+  return false;
+}
+
+// State hash of the City (see state_hash_city)
+#define STATE_TRACE_MAGIC "RTST"
+#define STATE_TRACE_VERSION 1
+#define STATE_TRACE_FILENAME "state_hash.trace"
+
+enum StateHashField {
+  STATE_HASH_DATE = 0,
+  STATE_HASH_TIMESTEP,
+  STATE_HASH_RNG,
+  STATE_HASH_FLAGS, // diplomacy_enabled & laws_enabled
+  STATE_HASH_PRODUCE_VALUES,
+  STATE_HASH_LAND_AREA,
+  STATE_HASH_LAND_AREA_USED,
+  STATE_HASH_FOOD_PRODUCTION,
+  STATE_HASH_FOOD_PRODUCTION_MODIFIER,
+  STATE_HASH_FOOD_USAGE,
+  STATE_HASH_GOLD,
+  STATE_HASH_GOLD_USAGE,
+  STATE_HASH_POLITICAL,  // Capacity & usage
+  STATE_HASH_DIPLOMATIC, // Capacity & usage
+  STATE_HASH_MILITARY,   // Capacity & usage
+  STATE_HASH_POPULATION,
+  STATE_HASH_POPULATION_DELTA,
+  STATE_HASH_EFFECTS,
+  STATE_HASH_CONSTRUCTION_PROJECTS,
+  STATE_HASH_CONSTRUCTIONS,
+  STATE_HASH_POPUPS,
+  STATE_HASH_LAWS,
+  STATE_HASH_CURSUS_HONORUM,
+  NUM_STATE_HASH_FIELDS
+};
+
+const char *lut_state_hash_field_str(const enum StateHashField field) {
+  static const char *strs[NUM_STATE_HASH_FIELDS] = {
+      "date", "timestep", "rng", "flags", "produce values", "land area", "land area used",
+      "food production", "food production modifier", "food usage", "gold", "gold usage",
+      "political power", "diplomatic power", "military power", "population", "population delta",
+      "effects", "construction projects", "constructions", "popups", "laws", "cursus honorum"};
+  return field < NUM_STATE_HASH_FIELDS ? strs[field] : "unknown";
+}
+
+struct StateHash {
+  uint64_t hash; // Of all fields
+  uint64_t fields[NUM_STATE_HASH_FIELDS];
+};
+
+// Trace file layout: StateTraceHeader, then per hashed timestep the timestep,
+// a uint32_t mask of the fields whose hash changed since the previous record
+// and the new hashes of those fields in field order.
+struct StateTraceHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_fields;
+  uint32_t pad;
+};
+
+struct StateTrace {
+  FILE *file;                // Trace being written, if any
+  uint8_t *data;             // Trace being read, if any
+  size_t size;
+  size_t offset;             // Of the next record
+  struct StateHash last;     // Hashes of the previous record
+  uint32_t num_records;
+};
+
+// Replay file layout: ReplayHeader, then records of a kind byte (an enum
+// CommandType or enum ReplayRecordKind) followed by the LEB128 encoded
+// timestep delta to the previous record and, for commands, both arguments.
+// Checkpoints carry the 64-bit state hash of the City at their timestep.
+#define REPLAY_MAGIC "RTSR"
+#define REPLAY_VERSION 4 // 2: Checkpoints hash with state_hash_city, 3: catalogue_hash, 4: construction site commands
+#define REPLAY_FILENAME "replay.bin"
+
+enum ReplayRecordKind {
+  REPLAY_RECORD_CHECKPOINT = 0x80, // State hash
+  REPLAY_RECORD_END = 0x81         // State hash, written when the recording stops
+};
+
+struct ReplayHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t seed; // Of the game RNG at startup
+  // Configuration the game was started with
+  struct Date start_date;
+  uint32_t eventlog_capacity;
+  uint32_t difficulty;
+  uint32_t save_version; // Of the game that recorded the replay
+  uint64_t catalogue_hash; // Of the content catalogue the game was started with
+};
+
+struct ReplayRecorder {
+  FILE *file;
+  struct StateTrace trace; // State hash of every timestep if CONFIG.STATE_HASH_TRACE
+  uint64_t last_timestep;
+  uint32_t num_commands;
+  uint32_t num_checkpoints;
+};
+
+static struct ReplayRecorder replay_recorder; // Recording of the game being played, if any
+
+static void replay_write_varint(FILE *file, uint64_t v) {
+  uint8_t buf[10];
+  size_t n = 0;
+  do {
+    buf[n++] = (uint8_t)(v & 0x7f) | (v >= 0x80 ? 0x80 : 0);
+    v >>= 7;
+  } while (v > 0);
+  fwrite(buf, 1, n, file);
+}
+
+static void replay_write_record(struct ReplayRecorder *r, const uint8_t kind) {
+  fputc(kind, r->file);
+  replay_write_varint(r->file, timestep - r->last_timestep);
+  r->last_timestep = timestep;
+}
+
+static void replay_record_command(struct ReplayRecorder *r, const struct Command *cmd) {
+  if (r->file == NULL) {
+    return;
+  }
+  replay_write_record(r, (uint8_t)cmd->type);
+  replay_write_varint(r->file, cmd->args[0]);
+  replay_write_varint(r->file, cmd->args[1]);
+  r->num_commands++;
+}
+
+/// Records and executes a command of the player
+bool command_issue(struct City *c, const enum CommandType type, const uint32_t arg0,
+                   const uint32_t arg1) {
+  const struct Command cmd = {.type = type, .args = {arg0, arg1}};
+  replay_record_command(&replay_recorder, &cmd);
+  return command_execute(c, &cmd);
+}
+
+bool save_game_to_binary(const struct City *c);
+
+/// Saves the game before quitting, returns true if it is safe to quit
+bool quit_menu(struct City *c) {
+  // TODO: Restart
+  return save_game_to_binary(c);
+}
+
+void help_menu(struct City *c) {
+  // TODO: Implement help menu
+  // TODO: There should be a explain word/concept discovery functionality like
+  // Emacs's explain-function
+}
+
+/// GUI specific resources initialized once at startup
+static struct {
+  struct nk_vec2 icon_size;
+  struct nk_image construction_icon;
+  struct nk_image diplomatic_icon;
+  struct nk_image military_icon;
+  struct nk_image political_icon;
+  struct nk_image construction_detail_icon;
+#define WINDOW_NAME_CONSTRUCTION "construction_window"
+#define WINDOW_NAME_EVENTLOG "eventlog_window"
+#define WINDOW_NAME_HELP "help_window"
+#define WINDOW_NAME_MILITARY "military_window"
+#define WINDOW_NAME_DIPLOMATIC "diplomatic_window"
+#define WINDOW_NAME_POLITICAL "political_window"
+} GUI;
+
+void glfw_error_callback(int e, const char *d) {
+  fprintf(stderr, "[glfw3]: Error %d: %s", e, d);
+}
+
+// Height of the rows in a gui_list_view, rounded to the whole pixels that
+// nk_list_view scrolls by so that the rows laid out do not drift from it
+static float gui_list_row_height(const struct nk_context *ctx) {
+  const float height = ctx->style.font->height + 2.0f * ctx->style.button.padding.y + 2.0f;
+  return (float)(int)(height + 0.5f);
+}
+
+// Scrollable list of num_rows rows of gui_list_row_height that only lays out
+// the rows in view. The caller lays out the rows [view->begin, view->end)
+// when this returns true and must call nk_list_view_end afterwards.
+bool gui_list_view_begin(struct nk_context *ctx, struct nk_list_view *view,
+                         const char *id, const float height, const size_t num_rows) {
+  nk_layout_row_dynamic(ctx, height, 1);
+  return nk_list_view_begin(ctx, view, id, NK_WINDOW_BORDER,
+                            (int)(gui_list_row_height(ctx) + 0.5f), (int)num_rows);
+}
+
+// Row indices of a filtered gui_list_view kept across frames, so that only
+// the rows in view cost anything while the listed collection is unchanged
+struct GuiListRows {
+  size_t *rows;
+  size_t num_rows;
+  size_t capacity;
+  uint32_t version; // Of the collection the rows were built from
+  uint32_t filter;  // Mask of the filter the rows were built with
+  bool valid;
+};
+
+// Returns true if the rows must be rebuilt for the collection at version and
+// filter, the rows are then cleared with room for num_items rows
+static bool gui_list_rows_stale(struct GuiListRows *r, const uint32_t version, const uint32_t filter,
+                                const size_t num_items) {
+  if (r->valid && r->version == version && r->filter == filter) {
+    return false;
+  }
+  if (num_items > r->capacity) {
+    r->capacity = num_items + num_items / 2;
+    r->rows = (size_t *)realloc(r->rows, r->capacity * sizeof(size_t));
+  }
+  r->num_rows = 0;
+  r->version = version;
+  r->filter = filter;
+  r->valid = true;
+  return true;
+}
+
+void gui_farm_construction_management(struct nk_context *ctx,
+                                      struct Construction *con,
+                                      struct City *c) {
+  assert(con); assert(ctx); assert(c);
+
+  const struct FarmArgument *arg = farm_component(c, con->effect->component);
+
+  nk_layout_row_dynamic(ctx, 0.0f, 1);
+  nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Food production: %lu +- %.2f", arg->area, arg->p1);
+
+  const float ratio[2] = {0.90f, 0.10f};
+  nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 2, ratio);
+
+  const char *tooltip_str = "Land area increase costs X gold where X is the current land area.";
+  nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Land area: %lu jugerum", arg->area);
+  NK_TOOLTIP(
+      ctx,
+      if (nk_button_symbol(ctx, NK_SYMBOL_PLUS)) {
+        command_issue(c, COMMAND_BUY_FARM_LAND, con - c->constructions, 0);
+      },
+      tooltip_str);
+}
+
+void gui_forum_construction_management(struct nk_context *ctx,
+                                       struct Construction *con,
+                                       struct City *c) {
+  assert(con); assert(ctx); assert(c);
+
+  const struct ForumArgument *arg = forum_component(c, con->effect->component);
+
+  nk_layout_row_dynamic(ctx, 0.0f, 1);
+  nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Taberna spots: %zu / %zu",
+            arg->num_taberna, arg->taberna_capacity);
+}
+
+static void (*const construction_gui_registry[NUM_CONSTRUCTION_GUIS])(struct nk_context *ctx,
+                                                                      struct Construction *con,
+                                                                      struct City *c) = {
+    [CONSTRUCTION_GUI_NONE] = NULL,
+    [CONSTRUCTION_GUI_FARM] = gui_farm_construction_management,
+    [CONSTRUCTION_GUI_FORUM] = gui_forum_construction_management};
+
+// NOTE: No laws have a GUI handler yet
+static void (*const law_gui_registry[NUM_LAW_GUIS])(struct nk_context *ctx, struct Law *l) = {
+    [LAW_GUI_NONE] = NULL};
+
+void gui_construction_detail_menu(struct Construction *con,
+                                  struct nk_context *ctx, struct City *c) {
+  assert(con);
+  assert(ctx);
+
+  const nk_flags flags = NK_WINDOW_BORDER | NK_WINDOW_MINIMIZABLE |
+                         NK_WINDOW_MOVABLE | NK_WINDOW_CLOSABLE;
+  const uint32_t win_width = 400;
+  const uint32_t win_height = 200;
+  const struct nk_rect win_rect =
+      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
+              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
+              win_width, win_height);
+  if (nk_begin(ctx, con->name_str, win_rect, flags)) {
+    nk_layout_row_dynamic(ctx, 0.0f, 1);
+    nk_label_wrap(ctx, con->effect->description_str);
+    nk_label_wrap(ctx, con->help_str);
+
+    if (con->gui_construction_management) {
+      assert(con->gui_construction_management < NUM_CONSTRUCTION_GUIS);
+      construction_gui_registry[con->gui_construction_management](ctx, con, c);
+    }
+
+    char *maintained_str = NULL;
+    if (con->maintained) {
+      maintained_str = "Disable maintenance";
+    } else {
+      maintained_str = "Enable maintenance";
+    }
+    const char *tooltip_str =
+        "Maintained: costs gold, gives effects. Unmaintained: costs no gold, "
+        "gives no effect, might cause other side effects to occur.";
+    NK_TOOLTIP(
+        ctx,
+        if (nk_button_label(ctx, maintained_str)) {
+          command_issue(c, COMMAND_TOGGLE_MAINTENANCE, con - c->constructions, 0);
+        },
+        tooltip_str);
+
+    if (nk_button_label(ctx, "Destroy building")) {
+      // TODO: Implement ?
+    }
+  }
+  nk_end(ctx);
+}
+
+void gui_construction_help_menu(const struct Construction *con,
+                                struct nk_context *ctx) {
+  const nk_flags flags = NK_WINDOW_BORDER | NK_WINDOW_MINIMIZABLE |
+                         NK_WINDOW_MOVABLE | NK_WINDOW_CLOSABLE;
+  const uint32_t win_width = 400;
+  const uint32_t win_height = 200;
+  const struct nk_rect win_rect =
+      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
+              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
+              win_width, win_height);
+  if (nk_begin(ctx, con->name_str, win_rect, flags)) {
+    nk_layout_row_dynamic(ctx, 0.0f, 1);
+    nk_labelf_wrap(ctx, "Effect: %s", con->effect->description_str);
+    nk_label_wrap(ctx, con->help_str);
+  }
+  nk_end(ctx);
+}
+
+void gui_construction_menu(struct City *c, struct nk_context *ctx) {
+  // NOTE: Menus refer to their construction by index as loading a game frees the arrays
+  static bool open_construction_help_menu = false;
+  static size_t help_menu_proj = 0; // Construction project
+
+  static bool open_construction_detail_menu = false;
+  static size_t detail_menu_proj = 0; // Construction
+
+  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_MINIMIZABLE |
+                             NK_WINDOW_CLOSABLE | NK_WINDOW_SCALABLE;
+
+  const uint32_t win_width = 900;
+  const uint32_t win_height = 500;
+  const struct nk_rect win_rect =
+      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
+              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
+              win_width, win_height);
+  if (nk_begin(ctx, "Construction", win_rect, win_flags)) {
+    if (nk_tree_push(ctx, NK_TREE_TAB, "Construction projects", NK_MAXIMIZED)) {
+      for (size_t i = 0; i < c->num_construction_projects; i++) {
+        const struct Construction *proj = &c->construction_projects[i];
+
+        if (proj->num_effects == 0) {
+          continue;
+        }
+
+        // TODO: Add visual indication or smt to show that building failed or started
+        static const float ratio[] = {0.05f, 0.35f, 0.25f, 0.15f, 0.05f, 0.125f};
+        if (proj->num_effects_capacity == 1) {
+          nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 6, ratio);
+
+          if (nk_button_label(ctx, "?")) {
+            open_construction_help_menu = !open_construction_help_menu;
+            help_menu_proj = i;
+          }
+
+          // TODO: Last variant of buildings name will not be shown ...
+          nk_label(ctx, proj->name_str, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+
+          nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%.2f gold", proj->cost);
+          nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%ld days", proj->construction_time);
+
+          nk_spacing(ctx, 1);
+
+          // TODO: Positive colored buttons that are actionable
+          if (nk_button_label(ctx, "Build")) {
+            command_issue(c, COMMAND_BUILD, i, 0);
+          }
+        } else {
+          if (nk_tree_push_id(ctx, NK_TREE_NODE, proj->name_str, NK_MINIMIZED, i)) {
+            for (size_t j = 0; j < proj->num_effects; j++) {
+
+              nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 6, ratio);
+
+              if (nk_button_label(ctx, "?")) {
+                open_construction_help_menu = !open_construction_help_menu;
+                help_menu_proj = i;
+              }
+
+              nk_label(ctx, proj->effect[j].name_str, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+
+              nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%.2f gold", proj->cost);
+              nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%ld days", proj->construction_time);
+
+              nk_spacing(ctx, 1);
+
+              if (nk_button_label(ctx, "Build")) {
+                command_issue(c, COMMAND_BUILD, i, j);
+              }
+            }
+            nk_tree_pop(ctx);
+          }
+        }
+      }
+      nk_tree_pop(ctx);
+    }
+
+    // Constructions built
+    if (nk_tree_push(ctx, NK_TREE_TAB, "Manage constructions", NK_MAXIMIZED)) {
+      static struct GuiListRows rows; // Indices of the finished constructions
+      if (gui_list_rows_stale(&rows, c->constructions_version, 0, c->num_constructions)) {
+        for (size_t i = 0; i < c->num_constructions; i++) {
+          if (c->constructions[i].construction_finished) {
+            rows.rows[rows.num_rows++] = i;
+          }
+        }
+      }
+
+      struct nk_list_view view;
+      if (gui_list_view_begin(ctx, &view, "manage_constructions", 250.0f, rows.num_rows)) {
+        const float ratio[2] = {0.85f, 0.15f};
+        for (int r = view.begin; r < view.end; r++) {
+          struct Construction *con = &c->constructions[rows.rows[r]];
+          nk_layout_row(ctx, NK_DYNAMIC, gui_list_row_height(ctx), 2, ratio);
+
+          nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "%s - %s", con->name_str, con->description_str);
+
+          if (con->gui_construction_management) {
+            // Construction detail menu
+            if (nk_button_label(ctx, "Manage")) {
+              open_construction_detail_menu = !open_construction_detail_menu;
+              detail_menu_proj = rows.rows[r];
+            }
+          } else {
+            nk_spacing(ctx, 1);
+          }
+        }
+        nk_list_view_end(&view);
+      }
+      nk_tree_pop(ctx);
+    }
+  }
+
+  nk_end(ctx);
+
+  if (open_construction_help_menu && help_menu_proj < c->num_construction_projects) {
+    gui_construction_help_menu(&c->construction_projects[help_menu_proj], ctx);
+  } else {
+    open_construction_help_menu = false;
+  }
+
+  if (open_construction_detail_menu && detail_menu_proj < c->num_constructions) {
+    gui_construction_detail_menu(&c->constructions[detail_menu_proj], ctx, c);
+  } else {
+    open_construction_detail_menu = false;
+  }
+}
+
+// Formats the event into buf using the localised strings, msg is the text of
+// EVENT_TEXT records
+void eventlog_format_event(const struct City *c, const struct EventRecord *rec,
+                           const char *msg, char *buf, const size_t buf_size) {
+  static const char **fmt_strs[NUM_EVENT_TYPES] = {
+      [EVENT_CONSTRUCTION_STARTED] = event_construction_started_strs,
+      [EVENT_CONSTRUCTION_FINISHED] = event_construction_finished_strs,
+      [EVENT_DEBUG] = event_debug_strs};
+
+  switch ((enum EventType)rec->type) {
+  case EVENT_TEXT:
+    snprintf(buf, buf_size, "%s", msg);
+    break;
+  case EVENT_CONSTRUCTION_STARTED:
+  case EVENT_CONSTRUCTION_FINISHED: {
+    snprintf(buf, buf_size, fmt_strs[rec->type][CONFIG.LANGUAGE], catalogue_event_str(rec->args[0].h));
+    break;
+  }
+  case EVENT_DEBUG:
+    snprintf(buf, buf_size, fmt_strs[rec->type][CONFIG.LANGUAGE], rec->args[0].i);
+    break;
+  case NUM_EVENT_TYPES:
+    assert(false && "Invalid event type in the event log");
+    break;
+  }
+}
+
+void gui_event_row(const struct City *c, struct nk_context *ctx,
+                   const struct EventRecord *rec, const char *msg) {
+  char buf[EVENTLOG_MSG_MAX];
+  eventlog_format_event(c, rec, msg, buf, sizeof(buf));
+  const struct Date d = {.day = rec->day, .month = rec->month, .year = rec->year};
+  nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "%u %s %d %s", d.day + 1,
+            get_month_str(d), abs(d.year), d.year < 0 ? "BC" : "AD");
+  nk_label(ctx, buf, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+}
+
+// Pages through the event journal on disk
+#define JOURNAL_PAGE_RECORDS 25
+void gui_event_history(const struct City *c, struct nk_context *ctx,
+                       struct Journal *journal, const bool *hidden_types) {
+  static struct JournalView view = {.fd = -1, .index_fd = -1};
+  static uint64_t page_first = 0; // Record number of the first row shown
+  static int jump_year = 0;
+
+  journal_flush(journal);
+  if (!journal_view_update(&view, journal)) {
+    nk_layout_row_dynamic(ctx, 0.0f, 1);
+    nk_label(ctx, "The event journal is not available.", NK_TEXT_ALIGN_LEFT);
+    return;
+  }
+
+  uint32_t type_mask = 0;
+  for (size_t i = 0; i < NUM_EVENT_TYPES; i++) {
+    if (!hidden_types[i]) {
+      type_mask |= 1u << i;
+    }
+  }
+
+  const float nav_ratio[5] = {0.1f, 0.1f, 0.6f, 0.1f, 0.1f};
+  nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 5, nav_ratio);
+  if (nk_button_symbol(ctx, NK_SYMBOL_TRIANGLE_LEFT)) {
+    page_first = 0;
+  }
+  if (nk_button_label(ctx, "<")) {
+    page_first = journal_view_seek(&view, page_first, -1, JOURNAL_PAGE_RECORDS, type_mask);
+  }
+  nk_labelf(ctx, NK_TEXT_ALIGN_CENTERED | NK_TEXT_ALIGN_MIDDLE, "%llu / %llu",
+            (unsigned long long)page_first, (unsigned long long)view.num_records);
+  if (nk_button_label(ctx, ">")) {
+    const uint64_t next = journal_view_seek(&view, page_first, 1, JOURNAL_PAGE_RECORDS, type_mask);
+    if (next < view.num_records) {
+      page_first = next;
+    }
+  }
+  if (nk_button_symbol(ctx, NK_SYMBOL_TRIANGLE_RIGHT)) {
+    page_first = journal_view_seek(&view, view.num_records, -1, JOURNAL_PAGE_RECORDS, type_mask);
+  }
+
+  const float jump_ratio[2] = {0.8f, 0.2f};
+  nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 2, jump_ratio);
+  nk_property_int(ctx, "Year (BC < 0):", -10000, &jump_year, 10000, 1, 1.0f);
+  if (nk_button_label(ctx, "Go")) {
+    page_first = journal_view_find_date(&view, date_key(jump_year, 0, 0));
+  }
+
+  if (page_first > view.num_records) {
+    page_first = view.num_records;
+  }
+
+  const float ratio[2] = {0.25f, 0.75f};
+  nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 2, ratio);
+  uint32_t num_rows = 0;
+  for (uint64_t n = page_first; n < view.num_records && num_rows < JOURNAL_PAGE_RECORDS;) {
+    if (n % JOURNAL_BLOCK_RECORDS == 0 && journal_view_skip_block(&view, n, type_mask)) {
+      n += JOURNAL_BLOCK_RECORDS;
+      continue;
+    }
+    const char *msg = NULL;
+    const struct EventRecord *rec = journal_view_record(&view, n++, &msg);
+    if (type_mask & (1u << rec->type)) {
+      gui_event_row(c, ctx, rec, msg);
+      num_rows++;
+    }
+  }
+}
+
+void gui_event_log(const struct City *c, struct nk_context *ctx) {
+  static bool hidden_types[NUM_EVENT_TYPES] = {false};
+
+  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_BORDER |
+                             NK_WINDOW_CLOSABLE | NK_WINDOW_MINIMIZABLE |
+                             NK_WINDOW_SCALABLE;
+  if (nk_begin(ctx, "Event log", nk_rect(50, 600, 600, 400), win_flags)) {
+    nk_layout_row_dynamic(ctx, 0.0f, NUM_EVENT_TYPES);
+    for (size_t i = 0; i < NUM_EVENT_TYPES; i++) {
+      hidden_types[i] = !nk_check_label(ctx, lut_event_type_str(i), !hidden_types[i]);
+    }
+
+    uint32_t type_mask = 0;
+    for (size_t i = 0; i < NUM_EVENT_TYPES; i++) {
+      if (!hidden_types[i]) {
+        type_mask |= 1u << i;
+      }
+    }
+
+    // Offsets in the ring of the msgs shown, only the rows in view are read
+    static struct GuiListRows rows;
+    struct EventRecord rec;
+    const char *msg = NULL;
+    if (gui_list_rows_stale(&rows, c->log->version, type_mask, c->log->num_msgs)) {
+      struct EventLogIter it = eventlog_iter(c->log);
+      uint32_t offset = it.offset;
+      while (eventlog_iter_next(c->log, &it, &rec, &msg)) {
+        if (type_mask & (1u << rec.type)) {
+          rows.rows[rows.num_rows++] = offset;
+        }
+        offset = it.offset;
+      }
+    }
+
+    struct nk_list_view view;
+    if (gui_list_view_begin(ctx, &view, "event_log", 200.0f, rows.num_rows)) {
+      const float ratio[2] = {0.25f, 0.75f};
+      nk_layout_row(ctx, NK_DYNAMIC, gui_list_row_height(ctx), 2, ratio);
+      for (int r = view.begin; r < view.end; r++) {
+        struct EventLogIter it = {.offset = rows.rows[r], .remaining = 1};
+        eventlog_iter_next(c->log, &it, &rec, &msg);
+        gui_event_row(c, ctx, &rec, msg);
+      }
+      nk_list_view_end(&view);
+    }
+
+    if (c->log->journal && nk_tree_push(ctx, NK_TREE_TAB, "History", NK_MINIMIZED)) {
+      gui_event_history(c, ctx, c->log->journal, hidden_types);
+      nk_tree_pop(ctx);
+    }
+  }
+  nk_end(ctx);
+}
+
+void gui_political_menu(struct City *c, struct nk_context *ctx) {
+  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_BORDER |
+                             NK_WINDOW_CLOSABLE | NK_WINDOW_MINIMIZABLE;
+  const uint32_t win_width = 500;
+  const uint32_t win_height = 500;
+  const struct nk_rect win_rect =
+      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
+              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
+              win_width, win_height);
+  if (nk_begin(ctx, "Political", win_rect, win_flags)) {
+
+    if (nk_tree_push(ctx, NK_TREE_TAB, "Laws", NK_MAXIMIZED)) {
+
+      nk_layout_row_dynamic(ctx, 0.0f, 2);
+
+      static int active_pane = 0;
+      if (nk_button_symbol_label(ctx,
+                                 active_pane == 0 ? NK_SYMBOL_CIRCLE_SOLID
+                                                  : NK_SYMBOL_CIRCLE_OUTLINE,
+                                 "Passed", NK_TEXT_ALIGN_CENTERED)) {
+        active_pane = 0;
+      }
+
+      if (nk_button_symbol_label(ctx,
+                                 active_pane == 1 ? NK_SYMBOL_CIRCLE_SOLID
+                                                  : NK_SYMBOL_CIRCLE_OUTLINE,
+                                 "Available", NK_TEXT_ALIGN_CENTERED)) {
+        active_pane = 1;
+      }
+
+      switch (active_pane) {
+      case 0:
+        for (size_t i = 0; i < c->num_available_laws; i++) {
+          struct Law *law = &c->available_laws[i];
+          if (!law->passed) {
+            continue;
+          }
+          if (nk_tree_push(ctx, NK_TREE_TAB, law->name_str, NK_MINIMIZED)) {
+            nk_layout_row_dynamic(ctx, 100.0f, 1);
+            nk_label_wrap(ctx, law->description_str);
+            nk_layout_row_dynamic(ctx, 0.0f, 1);
+            nk_labelf_wrap(ctx, "Passed: %u BC", law->date_passed.year);
+            if (law->gui_handler) {
+              assert(law->gui_handler < NUM_LAW_GUIS);
+              law_gui_registry[law->gui_handler](ctx, law);
+            }
+
+            nk_tree_pop(ctx);
+          }
+        }
+        break;
+      case 1:
+        for (size_t i = 0; i < c->num_available_laws; i++) {
+          struct Law *law = &c->available_laws[i];
+          if (law->passed) {
+            continue;
+          }
+          if (nk_tree_push(ctx, NK_TREE_TAB, law->name_str, NK_MINIMIZED)) {
+            nk_layout_row_dynamic(ctx, 100.0f, 1);
+            nk_label_wrap(ctx, law->description_str);
+            nk_layout_row_dynamic(ctx, 0.0f, 1);
+            if (nk_button_label(ctx, "Enact")) {
+              // TODO: Implement positive/negative feedback based success or not
+              command_issue(c, COMMAND_ENACT_LAW, i, 0);
+            }
+            nk_tree_pop(ctx);
+          }
+        }
+        break;
+      }
+
+      nk_tree_pop(ctx);
+    }
+
+    if (nk_tree_push(ctx, NK_TREE_TAB, "Cursus Honorum", NK_MAXIMIZED)) {
+      if (c->cursus_honorum->aedile_enabled) {
+        const struct Construction *aedile_con = construction_get(c, c->cursus_honorum->aedile_assigned_construction);
+        if (aedile_con) {
+          nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Aedile assigned to %s", aedile_con->name_str);
+        } else {
+          if (nk_group_begin(ctx, "assign_aedile", NK_WINDOW_BORDER | NK_WINDOW_NO_SCROLLBAR)) {
+            nk_layout_row_dynamic(ctx, 0.0f, 1);
+
+            const struct nk_vec2 menu_size = nk_vec2(200, 100 * c->num_constructions);
+
+            const char *ui_str = "Assign Aedile to ...";
+            if (nk_menu_begin_label(ctx, ui_str, NK_TEXT_ALIGN_CENTERED, menu_size)) {
+              nk_layout_row_dynamic(ctx, 0.0f, 1);
+              for (size_t i = 0; i < c->num_constructions; i++) {
+                if (nk_menu_item_label(ctx, c->constructions[i].name_str, NK_TEXT_ALIGN_CENTERED | NK_TEXT_ALIGN_MIDDLE)) {
+                  command_issue(c, COMMAND_ASSIGN_AEDILE, i, 0);
+                }
+              }
+              nk_menu_end(ctx);
+            }
+
+            nk_group_end(ctx);
+          }
+        }
+      }
+      nk_tree_pop(ctx);
+    }
+  }
+
+  nk_end(ctx);
+}
+
+void gui_diplomatic_menu(struct City *c, struct nk_context *ctx) {
+  // TODO: Implement diplomatic menu
+}
+
+void gui_military_menu(struct City *c, struct nk_context *ctx) {
+  // TODO: Implement military menu
+  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_BORDER |
+                             NK_WINDOW_CLOSABLE | NK_WINDOW_MINIMIZABLE;
+  const uint32_t win_width = 500;
+  const uint32_t win_height = 500;
+  const struct nk_rect win_rect =
+      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
+              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
+              win_width, win_height);
+  if (nk_begin(ctx, "Military", win_rect, win_flags)) {
+    nk_layout_row_dynamic(ctx, 0.0f, 1);
+    if (nk_button_label(ctx, "Raise legion")) {
+      // TODO: Raise a legion
+    }
+
+    if (nk_button_label(ctx, "Strengthen the Rhine border")) {
+      // TODO:
+    }
+
+    if (nk_button_label(ctx, "Strengthen the Danube border")) {
+      // TODO:
+    }
+
+    if (nk_button_label(ctx, "Launch military campaign ..")) {
+      // TODO:
+    }
+
+    // TODO: List legions?
+  }
+  nk_end(ctx);
+}
+
+void gui_help_menu(struct City *c, struct nk_context *ctx) {
+  // TODO: Help menu is used to look things up and search for in-game things
+}
+
+/***** binary savegame *****/
+// File layout: SaveHeader, SaveSection[num_sections], section data. Sections
+// are arrays of pointer-free, little-endian records aligned to 8 bytes. With
+// SAVE_FLAG_LZ the section data is stored as LzWriter streams instead.
+// Pointers are stored as handles: indices into the section of the pointee
+// (SAVE_NONE for NULL), strings as offsets into SAVE_SECTION_STRINGS and
+// callbacks as their registry IDs. Component pools are stored whole in handle
+// order, so component handles are kept as is.
+#define SAVE_MAGIC "RTSS"
+#define SAVE_VERSION 6 // 5: Construction events name their construction by catalogue string, 6: Journal id
+#define SAVE_FLAG_LZ (1u << 0) // Sections are compressed
+#define SAVE_NONE UINT32_MAX
+#define SAVE_FILENAME "save.bin"
+
+enum SaveSectionType {
+  SAVE_SECTION_GAME = 0,        // SaveGame
+  SAVE_SECTION_CITY,            // SaveCity
+  SAVE_SECTION_STRINGS,         // char
+  SAVE_SECTION_EFFECTS,         // SaveEffect, City.effects
+  SAVE_SECTION_OWNED_EFFECTS,   // SaveEffect, arrays owned by projects, constructions & laws
+  SAVE_SECTION_PROJECTS,        // SaveConstruction
+  SAVE_SECTION_CONSTRUCTIONS,   // SaveConstruction
+  SAVE_SECTION_LAWS,            // SaveLaw
+  SAVE_SECTION_POPUPS,          // SavePopup
+  SAVE_SECTION_POPUP_CHOICES,   // uint32_t string, choices & hover texts
+  SAVE_SECTION_FARMS,           // SaveFarm
+  SAVE_SECTION_FORUMS,          // SaveForum
+  SAVE_SECTION_LAND_TAXES,      // SaveLandTax
+  SAVE_SECTION_EVENTLOG,        // SaveEventLog
+  SAVE_SECTION_EVENTLOG_BUFFER, // uint8_t
+  NUM_SAVE_SECTIONS
+};
+
+struct SaveHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_sections;
+  uint32_t flags;
+};
+
+struct SaveSection {
+  uint32_t type;  // enum SaveSectionType
+  uint32_t count; // Number of records
+  uint64_t offset;
+  uint64_t size;        // In bytes
+  uint64_t stored_size; // In the file, equals size unless compressed
+};
+
+struct SaveGame {
+  struct Date date;
+  uint32_t simulation_speed;
+  uint64_t timestep;
+  uint64_t rng_state;
+  float max_population_reached;
+  uint32_t pad;
+  uint64_t journal_id;      // 0 for none
+  uint64_t journal_records; // Appended when saved
+};
+
+struct SaveCity {
+  uint32_t name;
+  uint8_t diplomacy_enabled;
+  uint8_t laws_enabled;
+  uint8_t aedile_enabled;
+  uint8_t censor_enabled;
+  float produce_values[NUMBER_OF_PRODUCE];
+  float food_production;
+  float food_production_modifier;
+  float food_usage;
+  float gold;
+  float gold_usage;
+  uint32_t political_capacity;
+  uint32_t political_usage;
+  uint32_t diplomatic_capacity;
+  uint32_t diplomatic_usage;
+  uint32_t military_capacity;
+  uint32_t military_usage;
+  int32_t population_delta;
+  uint32_t aedile_assigned_construction;
+  uint64_t land_area;
+  uint64_t land_area_used;
+  uint64_t population;
+  uint64_t magistrates_enabled;
+};
+
+struct SaveEffect {
+  int64_t duration;
+  uint32_t name;
+  uint32_t description;
+  uint32_t tick_effect; // enum TickEffectId
+  uint32_t arg;         // Handle into the section of the tick effect's EffectArgType (Effect.component for components)
+  uint8_t scheduled_for_removal;
+  uint8_t pad[7];
+};
+
+struct SaveConstruction {
+  float construction_delay_risk;
+  float construction_cost;
+  float cost;
+  float maintenance;
+  uint32_t name;
+  uint32_t description;
+  uint32_t help;
+  uint32_t effect; // First effect in SAVE_SECTION_OWNED_EFFECTS
+  uint32_t num_effects;
+  uint32_t num_effects_capacity;
+  uint32_t gui_construction_management; // enum ConstructionGuiId
+  uint8_t construction_in_progress;
+  uint8_t construction_finished;
+  uint8_t maintained;
+  uint8_t unique_effects;
+  uint64_t construction_time;
+  struct Date construction_started;
+  struct Date construction_completed;
+};
+
+struct SaveLaw {
+  uint32_t name;
+  uint32_t description;
+  uint32_t help;
+  uint32_t effect; // Effect in SAVE_SECTION_OWNED_EFFECTS
+  uint32_t gui_handler; // enum LawGuiId
+  uint8_t passed;
+  uint8_t type;
+  uint8_t cost;
+  uint8_t cost_lng;
+  struct Date date_passed;
+};
+
+struct SavePopup {
+  uint32_t title;
+  uint32_t description;
+  uint32_t num_choices;
+  uint32_t choices; // First of num_choices choices then hover texts in SAVE_SECTION_POPUP_CHOICES
+  uint32_t callback; // enum PopupCallbackId
+  int32_t choice_choosen;
+};
+
+struct SaveFarm {
+  uint64_t area;
+  uint32_t produce;
+  float p0;
+  float p1;
+  uint32_t construction; // Construction handle
+};
+
+struct SaveForum {
+  uint64_t taberna_capacity;
+  uint64_t num_taberna;
+  uint32_t tabernas; // Construction handle
+  uint32_t pad;
+};
+
+struct SaveLandTax {
+  float tax_percentage;
+};
+
+struct SaveEventLog {
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t end;
+  uint32_t num_msgs;
+  uint32_t wrapped;
+};
+
+// Open addressing map from pointers to handles, used to deduplicate pointees
+struct SavePtrMap {
+  const void **keys;
+  uint32_t *values;
+  uint32_t capacity; // Power of two
+  uint32_t count;
+};
+
+static void save_ptrmap_free(struct SavePtrMap *m) {
+  free(m->keys);
+  free(m->values);
+  memset(m, 0, sizeof(struct SavePtrMap));
+}
+
+static uint32_t *save_ptrmap_slot(struct SavePtrMap *m, const void *key, bool *found) {
+  if (2 * (m->count + 1) > m->capacity) {
+    struct SavePtrMap grown = {.capacity = m->capacity ? 2 * m->capacity : 64};
+    grown.keys = (const void **)calloc(grown.capacity, sizeof(void *));
+    grown.values = (uint32_t *)calloc(grown.capacity, sizeof(uint32_t));
+    for (uint32_t i = 0; i < m->capacity; i++) {
+      if (m->keys[i]) {
+        bool f;
+        *save_ptrmap_slot(&grown, m->keys[i], &f) = m->values[i];
+      }
+    }
+    grown.count = m->count;
+    save_ptrmap_free(m);
+    *m = grown;
+  }
+
+  uint32_t i = (uint32_t)(((uintptr_t)key >> 3) * 2654435761u) & (m->capacity - 1);
+  while (m->keys[i] && m->keys[i] != key) {
+    i = (i + 1) & (m->capacity - 1);
+  }
+  *found = m->keys[i] != NULL;
+  if (!*found) {
+    m->keys[i] = key;
+    m->count++;
+  }
+  return &m->values[i];
+}
+
+// Growable byte buffer used to build a section
+struct SaveBuffer {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  uint32_t count;
+};
+
+static void *save_buffer_push(struct SaveBuffer *b, const size_t size) {
+  if (b->size + size > b->capacity) {
+    b->capacity = (b->size + size) * 2;
+    b->data = (uint8_t *)realloc(b->data, b->capacity);
+  }
+  void *dst = &b->data[b->size];
+  memset(dst, 0, size); // Zeroed padding keeps saves byte-for-byte reproducible
+  b->size += size;
+  b->count++;
+  return dst;
+}
+
+// All the state of a game as pointer-free sections, either built from a City
+// (owned buffers) or a view into a loaded file
+struct SaveImage {
+  struct SaveSection sections[NUM_SAVE_SECTIONS];
+  const uint8_t *data[NUM_SAVE_SECTIONS];
+  bool owned;
+};
+
+// State of save_image_build
+struct SaveBuilder {
+  const struct City *c;
+  struct SaveBuffer buffers[NUM_SAVE_SECTIONS];
+  struct SavePtrMap strings;
+};
+
+static uint32_t save_string(struct SaveBuilder *b, const char *str) {
+  if (str == NULL) {
+    return SAVE_NONE;
+  }
+  bool found;
+  uint32_t *handle = save_ptrmap_slot(&b->strings, str, &found);
+  if (!found) {
+    struct SaveBuffer *buf = &b->buffers[SAVE_SECTION_STRINGS];
+    const size_t lng = strlen(str) + 1;
+    *handle = buf->size;
+    memcpy(save_buffer_push(buf, lng), str, lng);
+  }
+  return *handle;
+}
+
+static uint32_t save_construction_handle(const struct City *c, const uint32_t handle) {
+  return handle < c->num_constructions ? handle : SAVE_NONE;
+}
+
+static uint32_t save_arg(struct SaveBuilder *b, const struct Effect *e) {
+  const struct City *c = b->c;
+  switch (tick_effect_registry[e->tick_effect].arg_type) {
+  case EFFECT_ARG_NONE:
+  case NUM_EFFECT_ARG_TYPES:
+    return SAVE_NONE;
+  case EFFECT_ARG_FARM:
+  case EFFECT_ARG_FORUM:
+  case EFFECT_ARG_LAND_TAX:
+    return e->component;
+  case EFFECT_ARG_CONSTRUCTION:
+    return save_construction_handle(c, e->component);
+  case EFFECT_ARG_LAW: {
+    const struct Law *l = (const struct Law *)e->arg;
+    if (l >= c->available_laws && l < c->available_laws + c->num_available_laws) {
+      return l - c->available_laws;
+    }
+    return SAVE_NONE;
+  }
+  }
+  return SAVE_NONE;
+}
+
+// Pools are saved whole, free records included, so that handles stay valid
+static void save_components(struct SaveBuilder *b) {
+  const struct City *c = b->c;
+  const struct ComponentPool *farms = &c->components->farms;
+  for (uint32_t i = 0; i < farms->num_records; i++) {
+    const struct FarmArgument *farm = &((const struct FarmArgument *)farms->records)[i];
+    struct SaveFarm *rec = save_buffer_push(&b->buffers[SAVE_SECTION_FARMS], sizeof(struct SaveFarm));
+    rec->area = farm->area;
+    rec->produce = farm->produce;
+    rec->p0 = farm->p0;
+    rec->p1 = farm->p1;
+    rec->construction = farms->alive[i] ? farm->construction : SAVE_NONE;
+  }
+
+  const struct ComponentPool *forums = &c->components->forums;
+  for (uint32_t i = 0; i < forums->num_records; i++) {
+    const struct ForumArgument *forum = &((const struct ForumArgument *)forums->records)[i];
+    struct SaveForum *rec = save_buffer_push(&b->buffers[SAVE_SECTION_FORUMS], sizeof(struct SaveForum));
+    rec->taberna_capacity = forum->taberna_capacity;
+    rec->num_taberna = forum->num_taberna;
+    rec->tabernas = save_construction_handle(c, forum->tabernas);
+  }
+
+  const struct ComponentPool *land_taxes = &c->components->land_taxes;
+  for (uint32_t i = 0; i < land_taxes->num_records; i++) {
+    const struct LandTaxArgument *tax = &((const struct LandTaxArgument *)land_taxes->records)[i];
+    struct SaveLandTax *rec = save_buffer_push(&b->buffers[SAVE_SECTION_LAND_TAXES], sizeof(struct SaveLandTax));
+    rec->tax_percentage = tax->tax_percentage;
+  }
+}
+
+static void save_effect(struct SaveBuilder *b, const enum SaveSectionType section,
+                        const struct Effect *e) {
+  assert(e->tick_effect < NUM_TICK_EFFECTS);
+  const uint32_t arg = save_arg(b, e);
+
+  struct SaveEffect *rec = save_buffer_push(&b->buffers[section], sizeof(struct SaveEffect));
+  rec->duration = e->duration;
+  rec->name = save_string(b, e->name_str);
+  rec->description = save_string(b, e->description_str);
+  rec->tick_effect = e->tick_effect;
+  rec->arg = arg;
+  rec->scheduled_for_removal = e->scheduled_for_removal;
+}
+
+static void save_construction(struct SaveBuilder *b, const enum SaveSectionType section,
+                              const struct Construction *con) {
+  const uint32_t effect = b->buffers[SAVE_SECTION_OWNED_EFFECTS].count;
+  for (size_t i = 0; i < con->num_effects; i++) {
+    save_effect(b, SAVE_SECTION_OWNED_EFFECTS, &con->effect[i]);
+  }
+
+  struct SaveConstruction *rec = save_buffer_push(&b->buffers[section], sizeof(struct SaveConstruction));
+  rec->construction_delay_risk = con->construction_delay_risk;
+  rec->construction_cost = con->construction_cost;
+  rec->cost = con->cost;
+  rec->maintenance = con->maintenance;
+  rec->name = save_string(b, con->name_str);
+  rec->description = save_string(b, con->description_str);
+  rec->help = save_string(b, con->help_str);
+  rec->effect = effect;
+  rec->num_effects = con->num_effects;
+  rec->num_effects_capacity = con->num_effects_capacity;
+  rec->gui_construction_management = con->gui_construction_management;
+  rec->construction_in_progress = con->construction_in_progress;
+  rec->construction_finished = con->construction_finished;
+  rec->maintained = con->maintained;
+  rec->unique_effects = con->unique_effects;
+  rec->construction_time = con->construction_time;
+  rec->construction_started = con->construction_started;
+  rec->construction_completed = con->construction_completed;
+}
+
+static bool save_host_is_little_endian() {
+  const uint16_t x = 1;
+  return *(const uint8_t *)&x == 1;
+}
+
+void save_image_free(struct SaveImage *img) {
+  if (img->owned) {
+    for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+      free((void *)img->data[i]);
+    }
+  }
+  memset(img, 0, sizeof(struct SaveImage));
+}
+
+// Flattens the game state into img, free with save_image_free
+void save_image_build(const struct City *c, struct SaveImage *img) {
+  assert(c); assert(img);
+
+  struct SaveBuilder b = {.c = c};
+
+  {
+    struct SaveGame *rec = save_buffer_push(&b.buffers[SAVE_SECTION_GAME], sizeof(struct SaveGame));
+    rec->date = date;
+    rec->simulation_speed = simulation_speed;
+    rec->timestep = timestep;
+    rec->rng_state = rng_state;
+    rec->max_population_reached = Gamestate.max_population_reached;
+    const struct Journal *journal = c->log ? c->log->journal : NULL;
+    if (journal && journal->file) {
+      rec->journal_id = journal->id;
+      rec->journal_records = journal->num_appended;
+    }
+  }
+
+  for (size_t i = 0; i < c->num_effects; i++) {
+    save_effect(&b, SAVE_SECTION_EFFECTS, &c->effects[i]);
+  }
+
+  save_components(&b);
+
+  for (size_t i = 0; i < c->num_construction_projects; i++) {
+    save_construction(&b, SAVE_SECTION_PROJECTS, &c->construction_projects[i]);
+  }
+
+  for (size_t i = 0; i < c->num_constructions; i++) {
+    save_construction(&b, SAVE_SECTION_CONSTRUCTIONS, &c->constructions[i]);
+  }
+
+  for (size_t i = 0; i < c->num_available_laws; i++) {
+    const struct Law *l = &c->available_laws[i];
+    uint32_t effect = SAVE_NONE;
+    if (l->effect) {
+      effect = b.buffers[SAVE_SECTION_OWNED_EFFECTS].count;
+      save_effect(&b, SAVE_SECTION_OWNED_EFFECTS, l->effect);
+    }
+
+    struct SaveLaw *rec = save_buffer_push(&b.buffers[SAVE_SECTION_LAWS], sizeof(struct SaveLaw));
+    rec->name = save_string(&b, l->name_str);
+    rec->description = save_string(&b, l->description_str);
+    rec->help = save_string(&b, l->help_str);
+    rec->effect = effect;
+    rec->gui_handler = l->gui_handler;
+    rec->passed = l->passed;
+    rec->type = l->type;
+    rec->cost = l->cost;
+    rec->cost_lng = l->cost_lng;
+    rec->date_passed = l->date_passed;
+  }
+
+  for (size_t i = 0; i < c->num_popups; i++) {
+    const struct Popup *p = &c->popups[i];
+    const uint32_t choices = b.buffers[SAVE_SECTION_POPUP_CHOICES].count;
+    for (size_t j = 0; j < p->num_choices; j++) {
+      uint32_t *choice = save_buffer_push(&b.buffers[SAVE_SECTION_POPUP_CHOICES], sizeof(uint32_t));
+      *choice = save_string(&b, p->choices[j]);
+    }
+    for (size_t j = 0; j < p->num_choices; j++) {
+      uint32_t *hover_txt = save_buffer_push(&b.buffers[SAVE_SECTION_POPUP_CHOICES], sizeof(uint32_t));
+      *hover_txt = save_string(&b, p->hover_txts ? p->hover_txts[j] : NULL);
+    }
+
+    struct SavePopup *rec = save_buffer_push(&b.buffers[SAVE_SECTION_POPUPS], sizeof(struct SavePopup));
+    rec->title = save_string(&b, p->title);
+    rec->description = save_string(&b, p->description);
+    rec->num_choices = p->num_choices;
+    rec->choices = choices;
+    rec->callback = p->callback;
+    rec->choice_choosen = p->choice_choosen;
+  }
+
+  {
+    struct SaveCity *rec = save_buffer_push(&b.buffers[SAVE_SECTION_CITY], sizeof(struct SaveCity));
+    rec->name = save_string(&b, c->name);
+    rec->diplomacy_enabled = c->diplomacy_enabled;
+    rec->laws_enabled = c->laws_enabled;
+    rec->aedile_enabled = c->cursus_honorum->aedile_enabled;
+    rec->censor_enabled = c->cursus_honorum->censor_enabled;
+    for (size_t i = 0; i < NUMBER_OF_PRODUCE; i++) {
+      rec->produce_values[i] = c->produce_values[i];
+    }
+    rec->food_production = c->food_production;
+    rec->food_production_modifier = c->food_production_modifier;
+    rec->food_usage = c->food_usage;
+    rec->gold = c->gold;
+    rec->gold_usage = c->gold_usage;
+    rec->political_capacity = c->political_capacity;
+    rec->political_usage = c->political_usage;
+    rec->diplomatic_capacity = c->diplomatic_capacity;
+    rec->diplomatic_usage = c->diplomatic_usage;
+    rec->military_capacity = c->military_capacity;
+    rec->military_usage = c->military_usage;
+    rec->population_delta = c->population_delta;
+    rec->aedile_assigned_construction =
+        save_construction_handle(c, c->cursus_honorum->aedile_assigned_construction);
+    rec->land_area = c->land_area;
+    rec->land_area_used = c->land_area_used;
+    rec->population = c->population;
+    rec->magistrates_enabled = c->cursus_honorum->magistrates_enabled;
+  }
+
+  {
+    const struct EventLog *log = c->log;
+    struct SaveEventLog *rec = save_buffer_push(&b.buffers[SAVE_SECTION_EVENTLOG], sizeof(struct SaveEventLog));
+    rec->capacity = log->capacity;
+    rec->head = log->head;
+    rec->tail = log->tail;
+    rec->end = log->end;
+    rec->num_msgs = log->num_msgs;
+    rec->wrapped = log->wrapped;
+    memcpy(save_buffer_push(&b.buffers[SAVE_SECTION_EVENTLOG_BUFFER], log->capacity), log->buf, log->capacity);
+    b.buffers[SAVE_SECTION_EVENTLOG_BUFFER].count = log->capacity;
+  }
+
+  b.buffers[SAVE_SECTION_STRINGS].count = b.buffers[SAVE_SECTION_STRINGS].size;
+
+  memset(img, 0, sizeof(struct SaveImage));
+  img->owned = true;
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    img->sections[i].type = i;
+    img->sections[i].count = b.buffers[i].count;
+    img->sections[i].size = b.buffers[i].size;
+    img->data[i] = b.buffers[i].data;
+  }
+
+  save_ptrmap_free(&b.strings);
+}
+
+// Compresses the sections of the image to fd following the section table,
+// filling in the table. Returns false on failure.
+static bool save_image_write_compressed(struct SaveImage *img, const int fd,
+                                        struct SaveSection *sections, uint64_t offset) {
+  static const uint8_t padding[8] = {0};
+  struct LzWriter w;
+  lz_writer_open(&w, fd);
+  bool success = lseek(fd, offset, SEEK_SET) == (off_t)offset;
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS && success; i++) {
+    sections[i] = img->sections[i];
+    sections[i].offset = offset;
+    const uint64_t start = w.written;
+    lz_write(&w, img->data[i], img->sections[i].size);
+    success = lz_writer_finish(&w);
+    sections[i].stored_size = w.written - start;
+    offset += sections[i].stored_size;
+    if (offset % 8 != 0) {
+      const size_t n = 8 - offset % 8;
+      success &= write(fd, padding, n) == (ssize_t)n;
+      offset += n;
+    }
+  }
+  lz_writer_close(&w);
+  return success;
+}
+
+// Writes the image to filepath with a single writev, or streamed through the
+// compressor, and syncs it to disk. Returns false on failure.
+bool save_image_write(struct SaveImage *img, const char *filepath, const bool compress) {
+  assert(img); assert(filepath);
+  if (!save_host_is_little_endian()) {
+    fprintf(stderr, "[ColoniaC]: Savegames are only supported on little-endian hosts \n");
+    return false;
+  }
+
+  struct {
+    struct SaveHeader header;
+    struct SaveSection sections[NUM_SAVE_SECTIONS];
+  } head = {.header = {.magic = SAVE_MAGIC,
+                       .version = SAVE_VERSION,
+                       .num_sections = NUM_SAVE_SECTIONS,
+                       .flags = compress ? SAVE_FLAG_LZ : 0}};
+
+  static const uint8_t padding[8] = {0};
+  struct iovec iov[2 * NUM_SAVE_SECTIONS + 1];
+  int num_iov = 0;
+  iov[num_iov++] = (struct iovec){.iov_base = &head, .iov_len = sizeof(head)};
+
+  uint64_t offset = sizeof(head);
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    head.sections[i] = img->sections[i];
+    head.sections[i].offset = offset;
+    head.sections[i].stored_size = img->sections[i].size;
+    if (img->sections[i].size > 0) {
+      iov[num_iov++] = (struct iovec){.iov_base = (void *)img->data[i], .iov_len = img->sections[i].size};
+    }
+    offset += img->sections[i].size;
+    if (offset % 8 != 0) {
+      iov[num_iov++] = (struct iovec){.iov_base = (void *)padding, .iov_len = 8 - offset % 8};
+      offset += 8 - offset % 8;
+    }
+  }
+
+  // Written next to the old save and renamed over it once complete
+  char *tmp_filepath = str_concat_new(filepath, ".tmp");
+  const int fd = open(tmp_filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", tmp_filepath, strerror(errno));
+    free(tmp_filepath);
+    return false;
+  }
+
+  bool written;
+  if (compress) {
+    // The section table is written last, once the compressed sizes are known
+    written = save_image_write_compressed(img, fd, head.sections, sizeof(head)) &&
+              pwrite(fd, &head, sizeof(head), 0) == sizeof(head);
+  } else {
+    written = writev(fd, iov, num_iov) == (ssize_t)offset;
+  }
+  const bool synced = written && fsync(fd) == 0;
+  const bool success = close(fd) == 0 && synced && rename(tmp_filepath, filepath) == 0;
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: Failed to write %s: %s \n", filepath, strerror(errno));
+    unlink(tmp_filepath);
+  }
+  free(tmp_filepath);
+  return success;
+}
+
+// Size in bytes of a record in each section
+static const size_t save_record_sizes[NUM_SAVE_SECTIONS] = {
+      [SAVE_SECTION_GAME] = sizeof(struct SaveGame),
+      [SAVE_SECTION_CITY] = sizeof(struct SaveCity),
+      [SAVE_SECTION_STRINGS] = sizeof(char),
+      [SAVE_SECTION_EFFECTS] = sizeof(struct SaveEffect),
+      [SAVE_SECTION_OWNED_EFFECTS] = sizeof(struct SaveEffect),
+      [SAVE_SECTION_PROJECTS] = sizeof(struct SaveConstruction),
+      [SAVE_SECTION_CONSTRUCTIONS] = sizeof(struct SaveConstruction),
+      [SAVE_SECTION_LAWS] = sizeof(struct SaveLaw),
+      [SAVE_SECTION_POPUPS] = sizeof(struct SavePopup),
+      [SAVE_SECTION_POPUP_CHOICES] = sizeof(uint32_t),
+      [SAVE_SECTION_FARMS] = sizeof(struct SaveFarm),
+      [SAVE_SECTION_FORUMS] = sizeof(struct SaveForum),
+      [SAVE_SECTION_LAND_TAXES] = sizeof(struct SaveLandTax),
+      [SAVE_SECTION_EVENTLOG] = sizeof(struct SaveEventLog),
+      [SAVE_SECTION_EVENTLOG_BUFFER] = sizeof(uint8_t)};
+
+// Checks the section table of a loaded image against the record layouts
+static bool save_image_validate(const struct SaveImage *img) {
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    const struct SaveSection *s = &img->sections[i];
+    if (s->type != i || s->size != (uint64_t)s->count * save_record_sizes[i]) {
+      return false;
+    }
+  }
+
+  if (img->sections[SAVE_SECTION_GAME].count != 1 || img->sections[SAVE_SECTION_CITY].count != 1 ||
+      img->sections[SAVE_SECTION_EVENTLOG].count != 1) {
+    return false;
+  }
+
+  // Strings must be terminated so that no string runs off the section
+  const struct SaveSection *strings = &img->sections[SAVE_SECTION_STRINGS];
+  if (strings->size > 0 && img->data[SAVE_SECTION_STRINGS][strings->size - 1] != '\0') {
+    return false;
+  }
+
+  const struct SaveEventLog *log_rec = (const struct SaveEventLog *)img->data[SAVE_SECTION_EVENTLOG];
+  const struct EventLog log = {.buf = (uint8_t *)img->data[SAVE_SECTION_EVENTLOG_BUFFER],
+                               .capacity = log_rec->capacity,
+                               .head = log_rec->head,
+                               .tail = log_rec->tail,
+                               .end = log_rec->end,
+                               .num_msgs = log_rec->num_msgs,
+                               .wrapped = log_rec->wrapped != 0};
+  return log_rec->capacity == img->sections[SAVE_SECTION_EVENTLOG_BUFFER].count && eventlog_validate(&log);
+}
+
+// State of save_image_restore, the arrays of the restored City
+struct SaveRestorer {
+  const struct SaveImage *img;
+  const char *strings;
+  struct Components components; // Restored pools, records become alive once referenced
+  struct Construction *constructions;
+  struct Law *laws;
+  struct Effect *owned_effects;
+  bool corrupt; // Set if any handle is out of range
+};
+
+// Strings and popup choices of the restored games, replaced on every load
+static char *save_strings_block = NULL;
+static char **save_popup_choices_block = NULL;
+
+static const void *save_section(const struct SaveImage *img, const enum SaveSectionType type) {
+  return img->data[type];
+}
+
+static uint32_t save_count(const struct SaveImage *img, const enum SaveSectionType type) {
+  return img->sections[type].count;
+}
+
+static char *restore_string(struct SaveRestorer *r, const uint32_t handle) {
+  if (handle == SAVE_NONE) {
+    return NULL;
+  }
+  if (handle >= save_count(r->img, SAVE_SECTION_STRINGS)) {
+    r->corrupt = true;
+    return NULL;
+  }
+  return (char *)&r->strings[handle];
+}
+
+// Returns base[handle] for a handle into a section of count records
+static void *restore_handle(struct SaveRestorer *r, void *base, const size_t size,
+                            const uint32_t count, const uint32_t handle) {
+  if (handle == SAVE_NONE) {
+    return NULL;
+  }
+  if (handle >= count) {
+    r->corrupt = true;
+    return NULL;
+  }
+  return (uint8_t *)base + (size_t)handle * size;
+}
+
+static uint32_t restore_construction_handle(struct SaveRestorer *r, const uint32_t handle) {
+  if (handle == SAVE_NONE) {
+    return COMPONENT_NONE;
+  }
+  if (handle >= save_count(r->img, SAVE_SECTION_CONSTRUCTIONS)) {
+    r->corrupt = true;
+    return COMPONENT_NONE;
+  }
+  return handle;
+}
+
+// Returns the component handle of a record of the pool of type and marks it alive
+static uint32_t restore_component(struct SaveRestorer *r, const enum EffectArgType type, const uint32_t handle) {
+  struct ComponentPool *pool = components_pool(&r->components, type);
+  if (handle == SAVE_NONE) {
+    return COMPONENT_NONE;
+  }
+  if (handle >= pool->num_records) {
+    r->corrupt = true;
+    return COMPONENT_NONE;
+  }
+  pool->alive[handle] = 1;
+  return handle;
+}
+
+// Allocates the pool for count records, all of them free until referenced
+static void restore_component_pool(struct ComponentPool *p, const uint32_t count) {
+  p->capacity = count + 1;
+  p->num_records = count;
+  p->records = (uint8_t *)calloc(p->capacity, p->record_size);
+  p->alive = (uint8_t *)calloc(p->capacity, sizeof(uint8_t));
+  p->free_list = (uint32_t *)calloc(p->capacity, sizeof(uint32_t));
+}
+
+// Returns the callback ID of a record, 0 (the NONE ID) for invalid IDs
+static uint8_t restore_id(struct SaveRestorer *r, const uint32_t id, const uint32_t num_ids) {
+  if (id >= num_ids) {
+    r->corrupt = true;
+    return 0;
+  }
+  return id;
+}
+
+static void restore_effect(struct SaveRestorer *r, const struct SaveEffect *rec, struct Effect *e) {
+  memset(e, 0, sizeof(struct Effect));
+  e->duration = rec->duration;
+  e->scheduled_for_removal = rec->scheduled_for_removal;
+  e->name_str = restore_string(r, rec->name);
+  e->description_str = restore_string(r, rec->description);
+
+  if (rec->tick_effect >= NUM_TICK_EFFECTS) {
+    r->corrupt = true;
+    return;
+  }
+  e->tick_effect = rec->tick_effect;
+
+  const struct SaveImage *img = r->img;
+  e->component = COMPONENT_NONE;
+  const enum EffectArgType type = tick_effect_registry[e->tick_effect].arg_type;
+  switch (type) {
+  case EFFECT_ARG_NONE:
+  case NUM_EFFECT_ARG_TYPES:
+    break;
+  case EFFECT_ARG_FARM:
+  case EFFECT_ARG_FORUM:
+  case EFFECT_ARG_LAND_TAX:
+    e->component = restore_component(r, type, rec->arg);
+    break;
+  case EFFECT_ARG_CONSTRUCTION:
+    e->component = restore_construction_handle(r, rec->arg);
+    break;
+  case EFFECT_ARG_LAW:
+    e->arg = restore_handle(r, r->laws, sizeof(struct Law), save_count(img, SAVE_SECTION_LAWS), rec->arg);
+    break;
+  }
+
+  // Building effects own their strings, they are freed once the building is done
+  if (e->tick_effect == TICK_EFFECT_BUILDING && e->component != COMPONENT_NONE) {
+    const char *description_str = e->description_str ? e->description_str : "";
+    e->description_str = building_description_new(&r->constructions[e->component]);
+    strcpy(e->description_str, description_str);
+    if (e->name_str) {
+      e->name_str = str_concat_new(e->name_str, "");
+    }
+  }
+}
+
+static void restore_construction(struct SaveRestorer *r, const struct SaveConstruction *rec,
+                                 struct Construction *con) {
+  memset(con, 0, sizeof(struct Construction));
+  con->construction_delay_risk = rec->construction_delay_risk;
+  con->construction_cost = rec->construction_cost;
+  con->cost = rec->cost;
+  con->maintenance = rec->maintenance;
+  con->name_str = restore_string(r, rec->name);
+  con->description_str = restore_string(r, rec->description);
+  con->help_str = restore_string(r, rec->help);
+  con->num_effects = rec->num_effects;
+  con->num_effects_capacity = rec->num_effects_capacity;
+  con->construction_in_progress = rec->construction_in_progress;
+  con->construction_finished = rec->construction_finished;
+  con->maintained = rec->maintained;
+  con->unique_effects = rec->unique_effects;
+  con->construction_time = rec->construction_time;
+  con->construction_started = rec->construction_started;
+  con->construction_completed = rec->construction_completed;
+  con->gui_construction_management = restore_id(r, rec->gui_construction_management, NUM_CONSTRUCTION_GUIS);
+
+  const uint32_t num_owned_effects = save_count(r->img, SAVE_SECTION_OWNED_EFFECTS);
+  if (rec->effect > num_owned_effects || rec->num_effects > num_owned_effects - rec->effect) {
+    r->corrupt = true;
+    con->num_effects = 0;
+    return;
+  }
+  // Constructions own their effects, as in catalogue_instantiate & build_construction
+  con->effect = (struct Effect *)calloc(rec->num_effects + 1, sizeof(struct Effect));
+  memcpy(con->effect, &r->owned_effects[rec->effect], rec->num_effects * sizeof(struct Effect));
+}
+
+// Replaces the state of c with the game state of img. The arrays of c are
+// freed and reallocated, the shared EventLog, CursusHonorum and produce values
+// are overwritten in place. Returns false if the image is corrupt.
+bool save_image_restore(const struct SaveImage *img, struct City *c) {
+  assert(img); assert(c);
+  if (!save_image_validate(img)) {
+    return false;
+  }
+
+  struct SaveRestorer r = {.img = img};
+
+  // Allocate everything first so that handles can be resolved in one pass
+  const uint32_t num_strings = save_count(img, SAVE_SECTION_STRINGS);
+  char *strings = (char *)malloc(num_strings + 1);
+  memcpy(strings, save_section(img, SAVE_SECTION_STRINGS), num_strings);
+  r.strings = strings;
+
+  const uint32_t num_farms = save_count(img, SAVE_SECTION_FARMS);
+  const uint32_t num_forums = save_count(img, SAVE_SECTION_FORUMS);
+  const uint32_t num_land_taxes = save_count(img, SAVE_SECTION_LAND_TAXES);
+  const uint32_t num_owned_effects = save_count(img, SAVE_SECTION_OWNED_EFFECTS);
+  const uint32_t num_effects = save_count(img, SAVE_SECTION_EFFECTS);
+  const uint32_t num_projects = save_count(img, SAVE_SECTION_PROJECTS);
+  const uint32_t num_constructions = save_count(img, SAVE_SECTION_CONSTRUCTIONS);
+  const uint32_t num_laws = save_count(img, SAVE_SECTION_LAWS);
+  const uint32_t num_popups = save_count(img, SAVE_SECTION_POPUPS);
+  const uint32_t num_popup_choices = save_count(img, SAVE_SECTION_POPUP_CHOICES);
+
+  r.components = (struct Components){.farms.record_size = sizeof(struct FarmArgument),
+                                      .forums.record_size = sizeof(struct ForumArgument),
+                                      .land_taxes.record_size = sizeof(struct LandTaxArgument)};
+  restore_component_pool(&r.components.farms, num_farms);
+  restore_component_pool(&r.components.forums, num_forums);
+  restore_component_pool(&r.components.land_taxes, num_land_taxes);
+  struct FarmArgument *farms = (struct FarmArgument *)r.components.farms.records;
+  struct ForumArgument *forums = (struct ForumArgument *)r.components.forums.records;
+  struct LandTaxArgument *land_taxes = (struct LandTaxArgument *)r.components.land_taxes.records;
+  r.owned_effects = (struct Effect *)calloc(num_owned_effects + 1, sizeof(struct Effect));
+  r.constructions = (struct Construction *)calloc(num_constructions + CITY_ARRAY_GROWTH, sizeof(struct Construction));
+  r.laws = (struct Law *)calloc(num_laws + CITY_ARRAY_GROWTH, sizeof(struct Law));
+  struct Effect *effects = (struct Effect *)calloc(num_effects + CITY_ARRAY_GROWTH, sizeof(struct Effect));
+  struct Construction *projects = (struct Construction *)calloc(num_projects + CITY_ARRAY_GROWTH, sizeof(struct Construction));
+  struct Popup *popups = (struct Popup *)calloc(num_popups + CITY_ARRAY_GROWTH, sizeof(struct Popup));
+  char **popup_choices = (char **)calloc(num_popup_choices + 1, sizeof(char *));
+
+  const struct SaveFarm *farm_recs = save_section(img, SAVE_SECTION_FARMS);
+  for (uint32_t i = 0; i < num_farms; i++) {
+    uint32_t construction = farm_recs[i].construction;
+    if (construction != SAVE_NONE && construction >= num_constructions) {
+      r.corrupt = true;
+      construction = COMPONENT_NONE;
+    }
+    const struct FarmArgument farm = {.area = farm_recs[i].area,
+                                      .produce = farm_recs[i].produce % NUMBER_OF_PRODUCE,
+                                      .p0 = farm_recs[i].p0,
+                                      .p1 = farm_recs[i].p1,
+                                      .construction = construction};
+    memcpy(&farms[i], &farm, sizeof(farm)); // NOTE: FarmArgument has const members
+  }
+
+  const struct SaveForum *forum_recs = save_section(img, SAVE_SECTION_FORUMS);
+  for (uint32_t i = 0; i < num_forums; i++) {
+    forums[i].taberna_capacity = forum_recs[i].taberna_capacity;
+    forums[i].num_taberna = forum_recs[i].num_taberna;
+    forums[i].tabernas = restore_construction_handle(&r, forum_recs[i].tabernas);
+  }
+
+  const struct SaveLandTax *land_tax_recs = save_section(img, SAVE_SECTION_LAND_TAXES);
+  for (uint32_t i = 0; i < num_land_taxes; i++) {
+    land_taxes[i].tax_percentage = land_tax_recs[i].tax_percentage;
+  }
+
+  const struct SaveEffect *owned_effect_recs = save_section(img, SAVE_SECTION_OWNED_EFFECTS);
+  for (uint32_t i = 0; i < num_owned_effects; i++) {
+    restore_effect(&r, &owned_effect_recs[i], &r.owned_effects[i]);
+  }
+
+  const struct SaveEffect *effect_recs = save_section(img, SAVE_SECTION_EFFECTS);
+  for (uint32_t i = 0; i < num_effects; i++) {
+    restore_effect(&r, &effect_recs[i], &effects[i]);
+  }
+
+  const struct SaveConstruction *project_recs = save_section(img, SAVE_SECTION_PROJECTS);
+  for (uint32_t i = 0; i < num_projects; i++) {
+    restore_construction(&r, &project_recs[i], &projects[i]);
+  }
+
+  const struct SaveConstruction *construction_recs = save_section(img, SAVE_SECTION_CONSTRUCTIONS);
+  for (uint32_t i = 0; i < num_constructions; i++) {
+    restore_construction(&r, &construction_recs[i], &r.constructions[i]);
+  }
+
+  const struct SaveLaw *law_recs = save_section(img, SAVE_SECTION_LAWS);
+  for (uint32_t i = 0; i < num_laws; i++) {
+    struct Law *l = &r.laws[i];
+    l->passed = law_recs[i].passed;
+    l->name_str = restore_string(&r, law_recs[i].name);
+    l->description_str = restore_string(&r, law_recs[i].description);
+    l->help_str = restore_string(&r, law_recs[i].help);
+    l->type = law_recs[i].type;
+    l->cost = law_recs[i].cost;
+    l->cost_lng = law_recs[i].cost_lng;
+    l->date_passed = law_recs[i].date_passed;
+    const struct Effect *effect = restore_handle(&r, r.owned_effects, sizeof(struct Effect), num_owned_effects,
+                                                 law_recs[i].effect);
+    if (effect) { // Laws own their effect, as in catalogue_instantiate
+      l->effect = (struct Effect *)malloc(sizeof(struct Effect));
+      *l->effect = *effect;
+    }
+    l->gui_handler = restore_id(&r, law_recs[i].gui_handler, NUM_LAW_GUIS);
+  }
+
+  const uint32_t *popup_choice_recs = save_section(img, SAVE_SECTION_POPUP_CHOICES);
+  for (uint32_t i = 0; i < num_popup_choices; i++) {
+    popup_choices[i] = restore_string(&r, popup_choice_recs[i]);
+  }
+
+  const struct SavePopup *popup_recs = save_section(img, SAVE_SECTION_POPUPS);
+  for (uint32_t i = 0; i < num_popups; i++) {
+    struct Popup *p = &popups[i];
+    p->title = restore_string(&r, popup_recs[i].title);
+    p->description = restore_string(&r, popup_recs[i].description);
+    p->num_choices = popup_recs[i].num_choices;
+    p->choice_choosen = popup_recs[i].choice_choosen;
+    p->callback = restore_id(&r, popup_recs[i].callback, NUM_POPUP_CALLBACKS);
+    const uint32_t first = popup_recs[i].choices;
+    if (first > num_popup_choices || 2 * (uint64_t)p->num_choices > num_popup_choices - first) {
+      r.corrupt = true;
+      p->num_choices = 0;
+      continue;
+    }
+    p->choices = &popup_choices[first];
+    p->hover_txts = &popup_choices[first + p->num_choices];
+  }
+
+  const struct SaveCity *city_rec = save_section(img, SAVE_SECTION_CITY);
+  const uint32_t aedile_assigned_construction =
+      restore_construction_handle(&r, city_rec->aedile_assigned_construction);
+
+  if (r.corrupt) {
+    free(strings);
+    component_pool_free(&r.components.farms);
+    component_pool_free(&r.components.forums);
+    component_pool_free(&r.components.land_taxes);
+    free(r.owned_effects);
+    constructions_free(r.constructions, num_constructions);
+    laws_free(r.laws, num_laws);
+    effects_free(effects, num_effects);
+    constructions_free(projects, num_projects);
+    free(popups);
+    free(popup_choices);
+    return false;
+  }
+  free(r.owned_effects); // NOTE: Copied into the constructions and laws owning them
+
+  // Image is valid, replace the game state
+  free(save_strings_block);
+  save_strings_block = strings;
+  free(save_popup_choices_block);
+  save_popup_choices_block = popup_choices;
+  effects_free(c->effects, c->num_effects);
+  constructions_free(c->construction_projects, c->num_construction_projects);
+  constructions_free(c->constructions, c->num_constructions);
+  laws_free(c->available_laws, c->num_available_laws);
+  free(c->popups);
+
+  // Records no effect refers to are free
+  struct ComponentPool *pools[] = {&r.components.farms, &r.components.forums, &r.components.land_taxes};
+  for (size_t i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+    struct ComponentPool *pool = pools[i];
+    for (uint32_t j = pool->num_records; j-- > 0;) {
+      if (!pool->alive[j]) {
+        memset(&pool->records[(size_t)j * pool->record_size], 0, pool->record_size);
+        pool->free_list[pool->num_free++] = j;
+      }
+    }
+  }
+  component_pool_free(&c->components->farms);
+  component_pool_free(&c->components->forums);
+  component_pool_free(&c->components->land_taxes);
+  *c->components = r.components;
+
+  const struct SaveGame *game_rec = save_section(img, SAVE_SECTION_GAME);
+  date = game_rec->date;
+  simulation_speed = game_rec->simulation_speed;
+  timestep = game_rec->timestep;
+  rng_state = game_rec->rng_state;
+  Gamestate.max_population_reached = game_rec->max_population_reached;
+
+  c->name = restore_string(&r, city_rec->name);
+  c->diplomacy_enabled = city_rec->diplomacy_enabled;
+  c->laws_enabled = city_rec->laws_enabled;
+  for (size_t i = 0; i < NUMBER_OF_PRODUCE; i++) {
+    c->produce_values[i] = city_rec->produce_values[i];
+  }
+  c->food_production = city_rec->food_production;
+  c->food_production_modifier = city_rec->food_production_modifier;
+  c->food_usage = city_rec->food_usage;
+  c->gold = city_rec->gold;
+  c->gold_usage = city_rec->gold_usage;
+  c->political_capacity = city_rec->political_capacity;
+  c->political_usage = city_rec->political_usage;
+  c->diplomatic_capacity = city_rec->diplomatic_capacity;
+  c->diplomatic_usage = city_rec->diplomatic_usage;
+  c->military_capacity = city_rec->military_capacity;
+  c->military_usage = city_rec->military_usage;
+  c->population_delta = city_rec->population_delta;
+  c->land_area = city_rec->land_area;
+  c->land_area_used = city_rec->land_area_used;
+  c->population = city_rec->population;
+  c->cursus_honorum->magistrates_enabled = city_rec->magistrates_enabled;
+  c->cursus_honorum->aedile_enabled = city_rec->aedile_enabled;
+  c->cursus_honorum->censor_enabled = city_rec->censor_enabled;
+  c->cursus_honorum->aedile_assigned_construction = aedile_assigned_construction;
+
+  c->effects = effects;
+  c->num_effects = num_effects;
+  c->num_effects_capacity = num_effects + CITY_ARRAY_GROWTH;
+  c->effects_version++;
+  c->construction_projects = projects;
+  c->num_construction_projects = num_projects;
+  c->num_construction_projects_capacity = num_projects + CITY_ARRAY_GROWTH;
+  c->constructions = r.constructions;
+  c->num_constructions = num_constructions;
+  c->num_constructions_capacity = num_constructions + CITY_ARRAY_GROWTH;
+  c->constructions_version++;
+  c->available_laws = r.laws;
+  c->num_available_laws = num_laws;
+  c->num_available_laws_capacity = num_laws + CITY_ARRAY_GROWTH;
+  c->popups = popups;
+  c->num_popups = num_popups;
+  c->num_popups_capacity = num_popups + CITY_ARRAY_GROWTH;
+
+  const struct SaveEventLog *log_rec = save_section(img, SAVE_SECTION_EVENTLOG);
+  struct EventLog *log = c->log;
+  if (log->capacity != log_rec->capacity) {
+    log->buf = (uint8_t *)realloc(log->buf, log_rec->capacity);
+    log->capacity = log_rec->capacity;
+  }
+  memcpy(log->buf, save_section(img, SAVE_SECTION_EVENTLOG_BUFFER), log->capacity);
+  log->head = log_rec->head;
+  log->tail = log_rec->tail;
+  log->end = log_rec->end;
+  log->num_msgs = log_rec->num_msgs;
+  log->wrapped = log_rec->wrapped;
+  log->version++;
+
+  // The journal is cut back to the saved game as well
+  if (log->journal) {
+    journal_restore(log->journal, game_rec->journal_id, game_rec->journal_records);
+  }
+  return true;
+}
+
+// Maps the savegame at filepath and points img into the mapping, compressed
+// sections are decompressed into an owned image instead. Free img with
+// save_image_free and munmap(*map, *size) once done. Only checks the file layout.
+static bool save_image_map(const char *filepath, struct SaveImage *img, const uint8_t **map, size_t *size) {
+  assert(filepath); assert(img); assert(map); assert(size);
+  if (!save_host_is_little_endian()) {
+    fprintf(stderr, "[ColoniaC]: Savegames are only supported on little-endian hosts \n");
+    return false;
+  }
+
+  const int fd = open(filepath, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct SaveHeader)) {
+    close(fd);
+    fprintf(stderr, "[ColoniaC]: %s is not a valid savegame \n", filepath);
+    return false;
+  }
+
+  *size = st.st_size;
+  *map = (const uint8_t *)mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (*map == MAP_FAILED) {
+    return false;
+  }
+
+  const struct SaveHeader *header = (const struct SaveHeader *)*map;
+  const size_t table_size = sizeof(struct SaveHeader) + NUM_SAVE_SECTIONS * sizeof(struct SaveSection);
+  bool valid = memcmp(header->magic, SAVE_MAGIC, sizeof(header->magic)) == 0 &&
+               header->version == SAVE_VERSION && header->num_sections == NUM_SAVE_SECTIONS &&
+               *size >= table_size;
+  if (valid) {
+    const bool compressed = header->flags & SAVE_FLAG_LZ;
+    *img = (struct SaveImage){.owned = compressed};
+    const struct SaveSection *sections = (const struct SaveSection *)(*map + sizeof(struct SaveHeader));
+    for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+      img->sections[i] = sections[i];
+      valid &= sections[i].offset % 8 == 0 && sections[i].offset <= *size &&
+               sections[i].stored_size <= *size - sections[i].offset &&
+               (compressed || sections[i].stored_size == sections[i].size);
+      const uint8_t *stored = *map + sections[i].offset;
+      if (!compressed) {
+        img->data[i] = stored;
+      } else if (valid && sections[i].size < (uint64_t)256 * sections[i].stored_size + 4096) {
+        uint8_t *data = (uint8_t *)malloc(sections[i].size + 1);
+        valid = lz_read_stream(stored, sections[i].stored_size, data, sections[i].size);
+        img->data[i] = data;
+      } else {
+        valid = false; // Does not decompress to anything near the size claimed
+      }
+    }
+  }
+
+  if (!valid) {
+    fprintf(stderr, "[ColoniaC]: %s is not a valid savegame \n", filepath);
+    save_image_free(img);
+    munmap((void *)*map, *size);
+  }
+  return valid;
+}
+
+bool load_game_from_binary_file(struct City *c, const char *filepath) {
+  assert(c); assert(filepath);
+  struct SaveImage img;
+  const uint8_t *map;
+  size_t size;
+  if (!save_image_map(filepath, &img, &map, &size)) {
+    return false;
+  }
+
+  const bool success = save_image_restore(&img, c);
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: %s is not a valid savegame \n", filepath);
+  }
+  save_image_free(&img);
+  munmap((void *)map, size);
+  return success;
+}
+
+bool save_game_to_binary_file(const struct City *c, const char *filepath) {
+  struct SaveImage img;
+  save_image_build(c, &img);
+  const bool success = save_image_write(&img, filepath, CONFIG.COMPRESSION);
+  save_image_free(&img);
+  return success;
+}
+
+// Saves the City state to the save folder from the CONFIG
+bool save_game_to_binary(const struct City *c) {
+  char *filepath = str_concat_new(CONFIG.FILEPATH_SAVE, SAVE_FILENAME);
+  const bool success = save_game_to_binary_file(c, filepath);
+  free(filepath);
+  return success;
+}
+
+// Loads the City state from the save folder from the CONFIG
+bool load_game_from_binary(struct City *c) {
+  char *filepath = str_concat_new(CONFIG.FILEPATH_SAVE, SAVE_FILENAME);
+  const bool success = load_game_from_binary_file(c, filepath);
+  free(filepath);
+  return success;
+}
+
+/***** streaming JSON savegame *****/
+// Human readable savegame for debugging, the same sections as the binary
+// savegame with strings inlined. Written and read through fixed size buffers
+// without building a document tree.
+// NOTE: Only the text is streamed, memory is O(state) by design. Both
+// directions go through a SaveImage of the City like binary saves: a load is
+// validated as a whole before any of the City is replaced, so a broken file
+// never leaves a half loaded city behind, and restoring resolves handles and
+// strings against the complete image. The image is compact, the text is not.
+#define JSON_BUFFER_SIZE 4096 // Bytes buffered between file reads/writes
+#define JSON_STRING_MAX 4096  // Longest string or number token in bytes, including the '\0'
+#define JSON_DEPTH_MAX 32
+#define JSON_SAVE_FILENAME "save.json"
+
+struct JsonWriter {
+  int fd;
+  char buf[JSON_BUFFER_SIZE];
+  size_t size;
+  uint32_t depth;
+  bool needs_comma; // A value has been written at the current depth
+  bool error;
+};
+
+static void json_writer_flush(struct JsonWriter *w) {
+  size_t written = 0;
+  while (!w->error && written < w->size) {
+    const ssize_t n = write(w->fd, w->buf + written, w->size - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      w->error = true;
+    } else {
+      written += n;
+    }
+  }
+  w->size = 0;
+}
+
+static void json_write_raw(struct JsonWriter *w, const char *str, size_t lng) {
+  while (lng > 0) {
+    if (w->size == JSON_BUFFER_SIZE) {
+      json_writer_flush(w);
+    }
+    const size_t n = lng < JSON_BUFFER_SIZE - w->size ? lng : JSON_BUFFER_SIZE - w->size;
+    memcpy(w->buf + w->size, str, n);
+    w->size += n;
+    str += n;
+    lng -= n;
+  }
+}
+
+static void json_write_fmt(struct JsonWriter *w, const char *fmt, ...) {
+  char str[64]; // Only used for numbers
+  va_list args;
+  va_start(args, fmt);
+  const int lng = vsnprintf(str, sizeof(str), fmt, args);
+  va_end(args);
+  assert(lng > 0 && (size_t)lng < sizeof(str));
+  json_write_raw(w, str, lng);
+}
+
+static void json_write_str(struct JsonWriter *w, const char *str) {
+  json_write_raw(w, "\"", 1);
+  const char *run = str; // Characters that need no escaping are written in runs
+  for (; *str; str++) {
+    const unsigned char ch = *str;
+    if (ch != '"' && ch != '\\' && ch >= 0x20) {
+      continue;
+    }
+    json_write_raw(w, run, str - run);
+    run = str + 1;
+    switch (ch) {
+    case '"':
+      json_write_raw(w, "\\\"", 2);
+      break;
+    case '\\':
+      json_write_raw(w, "\\\\", 2);
+      break;
+    case '\n':
+      json_write_raw(w, "\\n", 2);
+      break;
+    case '\t':
+      json_write_raw(w, "\\t", 2);
+      break;
+    default:
+      json_write_fmt(w, "\\u%04x", ch);
+    }
+  }
+  json_write_raw(w, run, str - run);
+  json_write_raw(w, "\"", 1);
+}
+
+// Separator, indentation and key of the next value, key is NULL in arrays
+static void json_write_key(struct JsonWriter *w, const char *key) {
+  if (w->needs_comma) {
+    json_write_raw(w, ",", 1);
+  }
+  if (w->depth > 0) {
+    json_write_raw(w, "\n", 1);
+    for (uint32_t i = 0; i < w->depth; i++) {
+      json_write_raw(w, "  ", 2);
+    }
+  }
+  if (key) {
+    json_write_str(w, key);
+    json_write_raw(w, ": ", 2);
+  }
+  w->needs_comma = true;
+}
+
+static void json_begin(struct JsonWriter *w, const char *key, const char *bracket) {
+  json_write_key(w, key);
+  json_write_raw(w, bracket, 1);
+  w->depth++;
+  w->needs_comma = false;
+}
+
+static void json_end(struct JsonWriter *w, const char *bracket) {
+  assert(w->depth > 0);
+  w->depth--;
+  if (w->needs_comma) { // Non-empty
+    json_write_raw(w, "\n", 1);
+    for (uint32_t i = 0; i < w->depth; i++) {
+      json_write_raw(w, "  ", 2);
+    }
+  }
+  json_write_raw(w, bracket, 1);
+  w->needs_comma = true;
+}
+
+static void json_begin_object(struct JsonWriter *w, const char *key) { json_begin(w, key, "{"); }
+static void json_end_object(struct JsonWriter *w) { json_end(w, "}"); }
+static void json_begin_array(struct JsonWriter *w, const char *key) { json_begin(w, key, "["); }
+static void json_end_array(struct JsonWriter *w) { json_end(w, "]"); }
+
+static void json_write_null(struct JsonWriter *w, const char *key) {
+  json_write_key(w, key);
+  json_write_raw(w, "null", 4);
+}
+
+static void json_write_int(struct JsonWriter *w, const char *key, const int64_t value) {
+  json_write_key(w, key);
+  json_write_fmt(w, "%" PRId64, value);
+}
+
+static void json_write_uint(struct JsonWriter *w, const char *key, const uint64_t value) {
+  json_write_key(w, key);
+  json_write_fmt(w, "%" PRIu64, value);
+}
+
+// Written with enough digits to read back the same float, null if not finite
+static void json_write_float(struct JsonWriter *w, const char *key, const float value) {
+  if (!(value - value == 0.0f)) { // NaN or infinite
+    json_write_null(w, key);
+    return;
+  }
+  json_write_key(w, key);
+  json_write_fmt(w, "%.9g", value);
+}
+
+static void json_write_string(struct JsonWriter *w, const char *key, const char *str) {
+  if (str == NULL) {
+    json_write_null(w, key);
+    return;
+  }
+  json_write_key(w, key);
+  json_write_str(w, str);
+}
+
+enum JsonToken {
+  JSON_TOKEN_ERROR = 0,
+  JSON_TOKEN_EOF,
+  JSON_TOKEN_OBJECT_BEGIN,
+  JSON_TOKEN_OBJECT_END,
+  JSON_TOKEN_ARRAY_BEGIN,
+  JSON_TOKEN_ARRAY_END,
+  JSON_TOKEN_KEY, // Text in JsonReader.str
+  JSON_TOKEN_STRING, // Text in JsonReader.str
+  JSON_TOKEN_NUMBER, // Text in JsonReader.str
+  JSON_TOKEN_TRUE,
+  JSON_TOKEN_FALSE,
+  JSON_TOKEN_NULL
+};
+
+// Pull parser, every call to json_next returns the next token of the file
+struct JsonReader {
+  int fd;
+  char buf[JSON_BUFFER_SIZE];
+  size_t pos;
+  size_t size;
+  char str[JSON_STRING_MAX];
+  size_t str_lng;
+  uint32_t depth;
+  uint32_t objects; // Bit per depth, set when the container is an object
+  bool after_key;   // Next token is the value of a key
+};
+
+// Returns the next character without consuming it, -1 at the end of the file
+static int json_peek(struct JsonReader *r) {
+  if (r->pos == r->size) {
+    ssize_t n;
+    do {
+      n = read(r->fd, r->buf, JSON_BUFFER_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+      return -1;
+    }
+    r->pos = 0;
+    r->size = n;
+  }
+  return (unsigned char)r->buf[r->pos];
+}
+
+static bool json_str_push(struct JsonReader *r, const char ch) {
+  if (r->str_lng + 1 >= JSON_STRING_MAX) {
+    return false;
+  }
+  r->str[r->str_lng++] = ch;
+  r->str[r->str_lng] = '\0';
+  return true;
+}
+
+static bool json_read_literal(struct JsonReader *r, const char *literal) {
+  for (; *literal; literal++) {
+    if (json_peek(r) != *literal) {
+      return false;
+    }
+    r->pos++;
+  }
+  return true;
+}
+
+static bool json_read_str(struct JsonReader *r) {
+  r->pos++; // Opening quote
+  while (true) {
+    int ch = json_peek(r);
+    if (ch < 0) {
+      return false;
+    }
+    r->pos++;
+    if (ch == '"') {
+      return true;
+    }
+    if (ch == '\\') {
+      ch = json_peek(r);
+      r->pos++;
+      switch (ch) {
+      case 'n':
+        ch = '\n';
+        break;
+      case 't':
+        ch = '\t';
+        break;
+      case 'u': {
+        // NOTE: The writer only escapes control characters this way
+        char hex[5] = {0};
+        for (size_t i = 0; i < 4; i++) {
+          const int h = json_peek(r);
+          if (h < 0) {
+            return false;
+          }
+          hex[i] = h;
+          r->pos++;
+        }
+        ch = strtol(hex, NULL, 16) & 0xFF;
+        break;
+      }
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      default:
+        return false;
+      }
+    }
+    if (!json_str_push(r, ch)) {
+      return false;
+    }
+  }
+}
+
+enum JsonToken json_next(struct JsonReader *r) {
+  r->str_lng = 0;
+  r->str[0] = '\0';
+
+  int ch;
+  while ((ch = json_peek(r)) == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == ',' || ch == ':') {
+    r->pos++;
+  }
+
+  const bool in_object = r->depth > 0 && (r->objects >> (r->depth - 1)) & 1;
+  const bool expects_key = in_object && !r->after_key;
+  r->after_key = false;
+
+  switch (ch) {
+  case -1:
+    return r->depth == 0 ? JSON_TOKEN_EOF : JSON_TOKEN_ERROR;
+  case '{':
+  case '[':
+    if (expects_key || r->depth == JSON_DEPTH_MAX) {
+      return JSON_TOKEN_ERROR;
+    }
+    r->pos++;
+    r->objects = (r->objects & ~(1u << r->depth)) | ((uint32_t)(ch == '{') << r->depth);
+    r->depth++;
+    return ch == '{' ? JSON_TOKEN_OBJECT_BEGIN : JSON_TOKEN_ARRAY_BEGIN;
+  case '}':
+  case ']':
+    if (r->depth == 0 || in_object != (ch == '}') || (in_object && !expects_key)) {
+      return JSON_TOKEN_ERROR;
+    }
+    r->pos++;
+    r->depth--;
+    return ch == '}' ? JSON_TOKEN_OBJECT_END : JSON_TOKEN_ARRAY_END;
+  case '"':
+    if (!json_read_str(r)) {
+      return JSON_TOKEN_ERROR;
+    }
+    r->after_key = expects_key;
+    return expects_key ? JSON_TOKEN_KEY : JSON_TOKEN_STRING;
+  }
+
+  if (expects_key) {
+    return JSON_TOKEN_ERROR;
+  }
+  if (ch == 't') {
+    return json_read_literal(r, "true") ? JSON_TOKEN_TRUE : JSON_TOKEN_ERROR;
+  }
+  if (ch == 'f') {
+    return json_read_literal(r, "false") ? JSON_TOKEN_FALSE : JSON_TOKEN_ERROR;
+  }
+  if (ch == 'n') {
+    return json_read_literal(r, "null") ? JSON_TOKEN_NULL : JSON_TOKEN_ERROR;
+  }
+  while (ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E' || (ch >= '0' && ch <= '9')) {
+    if (!json_str_push(r, ch)) {
+      return JSON_TOKEN_ERROR;
+    }
+    r->pos++;
+    ch = json_peek(r);
+  }
+  return r->str_lng > 0 ? JSON_TOKEN_NUMBER : JSON_TOKEN_ERROR;
+}
+
+// Skips the rest of the value started by tok, returns false on errors
+static bool json_skip(struct JsonReader *r, const enum JsonToken tok) {
+  if (tok != JSON_TOKEN_OBJECT_BEGIN && tok != JSON_TOKEN_ARRAY_BEGIN) {
+    return tok != JSON_TOKEN_ERROR && tok != JSON_TOKEN_EOF;
+  }
+  const uint32_t depth = r->depth - 1;
+  while (r->depth > depth) {
+    const enum JsonToken t = json_next(r);
+    if (t == JSON_TOKEN_ERROR || t == JSON_TOKEN_EOF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads a number value, null reads as 0
+static bool json_read_number(struct JsonReader *r, double *value, int64_t *integer) {
+  const enum JsonToken tok = json_next(r);
+  if (tok == JSON_TOKEN_NULL) {
+    *value = 0.0;
+    *integer = 0;
+    return true;
+  }
+  if (tok != JSON_TOKEN_NUMBER) {
+    return false;
+  }
+  char *end = NULL;
+  *value = strtod(r->str, &end);
+  if (*end != '\0') {
+    return false;
+  }
+  // Integers are parsed separately to keep the full 64 bits
+  if (r->str[0] == '-') {
+    *integer = strtoll(r->str, NULL, 10);
+  } else {
+    *integer = (int64_t)strtoull(r->str, NULL, 10);
+  }
+  return true;
+}
+
+// Record fields of the savegame sections as JSON
+enum JsonFieldType {
+  JSON_FIELD_U8 = 0,
+  JSON_FIELD_U32,
+  JSON_FIELD_I32,
+  JSON_FIELD_U64,
+  JSON_FIELD_I64,
+  JSON_FIELD_F32,
+  JSON_FIELD_DATE,
+  JSON_FIELD_STRING,      // uint32_t string handle, written inline
+  JSON_FIELD_HANDLE,      // uint32_t, null for SAVE_NONE
+  JSON_FIELD_TICK_EFFECT, // uint32_t enum TickEffectId, written by its registry name
+};
+
+struct JsonField {
+  const char *key; // NULL for records that are a single bare value
+  enum JsonFieldType type;
+  uint32_t offset;
+  uint32_t count; // Array of count values if > 1
+};
+
+#define JSON_FIELD(record, field, type) {#field, type, offsetof(record, field), 1}
+
+static const struct JsonField json_game_fields[] = {
+    JSON_FIELD(struct SaveGame, date, JSON_FIELD_DATE),
+    JSON_FIELD(struct SaveGame, simulation_speed, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveGame, timestep, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveGame, rng_state, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveGame, max_population_reached, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveGame, journal_id, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveGame, journal_records, JSON_FIELD_U64)};
+
+static const struct JsonField json_city_fields[] = {
+    JSON_FIELD(struct SaveCity, name, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveCity, diplomacy_enabled, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveCity, laws_enabled, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveCity, aedile_enabled, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveCity, censor_enabled, JSON_FIELD_U8),
+    {"produce_values", JSON_FIELD_F32, offsetof(struct SaveCity, produce_values), NUMBER_OF_PRODUCE},
+    JSON_FIELD(struct SaveCity, food_production, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveCity, food_production_modifier, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveCity, food_usage, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveCity, gold, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveCity, gold_usage, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveCity, political_capacity, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveCity, political_usage, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveCity, diplomatic_capacity, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveCity, diplomatic_usage, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveCity, military_capacity, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveCity, military_usage, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveCity, population_delta, JSON_FIELD_I32),
+    JSON_FIELD(struct SaveCity, aedile_assigned_construction, JSON_FIELD_HANDLE),
+    JSON_FIELD(struct SaveCity, land_area, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveCity, land_area_used, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveCity, population, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveCity, magistrates_enabled, JSON_FIELD_U64)};
+
+static const struct JsonField json_effect_fields[] = {
+    JSON_FIELD(struct SaveEffect, name, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveEffect, description, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveEffect, duration, JSON_FIELD_I64),
+    JSON_FIELD(struct SaveEffect, tick_effect, JSON_FIELD_TICK_EFFECT),
+    JSON_FIELD(struct SaveEffect, arg, JSON_FIELD_HANDLE),
+    JSON_FIELD(struct SaveEffect, scheduled_for_removal, JSON_FIELD_U8)};
+
+static const struct JsonField json_construction_fields[] = {
+    JSON_FIELD(struct SaveConstruction, name, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveConstruction, description, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveConstruction, help, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveConstruction, construction_delay_risk, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveConstruction, construction_cost, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveConstruction, cost, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveConstruction, maintenance, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveConstruction, effect, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveConstruction, num_effects, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveConstruction, num_effects_capacity, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveConstruction, gui_construction_management, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveConstruction, construction_in_progress, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveConstruction, construction_finished, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveConstruction, maintained, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveConstruction, unique_effects, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveConstruction, construction_time, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveConstruction, construction_started, JSON_FIELD_DATE),
+    JSON_FIELD(struct SaveConstruction, construction_completed, JSON_FIELD_DATE)};
+
+static const struct JsonField json_law_fields[] = {
+    JSON_FIELD(struct SaveLaw, name, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveLaw, description, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveLaw, help, JSON_FIELD_STRING),
+    JSON_FIELD(struct SaveLaw, effect, JSON_FIELD_HANDLE),
+    JSON_FIELD(struct SaveLaw, gui_handler, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveLaw, passed, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveLaw, type, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveLaw, cost, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveLaw, cost_lng, JSON_FIELD_U8),
+    JSON_FIELD(struct SaveLaw, date_passed, JSON_FIELD_DATE)};
+
+static const struct JsonField json_popup_fields[] = {
+    JSON_FIELD(struct SavePopup, title, JSON_FIELD_STRING),
+    JSON_FIELD(struct SavePopup, description, JSON_FIELD_STRING),
+    JSON_FIELD(struct SavePopup, num_choices, JSON_FIELD_U32),
+    JSON_FIELD(struct SavePopup, choices, JSON_FIELD_U32),
+    JSON_FIELD(struct SavePopup, callback, JSON_FIELD_U32),
+    JSON_FIELD(struct SavePopup, choice_choosen, JSON_FIELD_I32)};
+
+static const struct JsonField json_popup_choice_fields[] = {{NULL, JSON_FIELD_STRING, 0, 1}};
+
+static const struct JsonField json_farm_fields[] = {
+    JSON_FIELD(struct SaveFarm, area, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveFarm, produce, JSON_FIELD_U32),
+    JSON_FIELD(struct SaveFarm, p0, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveFarm, p1, JSON_FIELD_F32),
+    JSON_FIELD(struct SaveFarm, construction, JSON_FIELD_HANDLE)};
+
+static const struct JsonField json_forum_fields[] = {
+    JSON_FIELD(struct SaveForum, taberna_capacity, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveForum, num_taberna, JSON_FIELD_U64),
+    JSON_FIELD(struct SaveForum, tabernas, JSON_FIELD_HANDLE)};
+
+static const struct JsonField json_land_tax_fields[] = {
+    JSON_FIELD(struct SaveLandTax, tax_percentage, JSON_FIELD_F32)};
+
+#define JSON_FIELDS(fields) fields, sizeof(fields) / sizeof(fields[0])
+
+// Sections written as records, the strings and event log are handled apart
+static const struct {
+  const char *key;
+  enum SaveSectionType type;
+  size_t record_size;
+  const struct JsonField *fields;
+  size_t num_fields;
+  bool single; // Exactly one record, written as an object instead of an array
+} json_sections[] = {
+    {"game", SAVE_SECTION_GAME, sizeof(struct SaveGame), JSON_FIELDS(json_game_fields), true},
+    {"city", SAVE_SECTION_CITY, sizeof(struct SaveCity), JSON_FIELDS(json_city_fields), true},
+    {"effects", SAVE_SECTION_EFFECTS, sizeof(struct SaveEffect), JSON_FIELDS(json_effect_fields), false},
+    {"owned_effects", SAVE_SECTION_OWNED_EFFECTS, sizeof(struct SaveEffect), JSON_FIELDS(json_effect_fields), false},
+    {"projects", SAVE_SECTION_PROJECTS, sizeof(struct SaveConstruction), JSON_FIELDS(json_construction_fields), false},
+    {"constructions", SAVE_SECTION_CONSTRUCTIONS, sizeof(struct SaveConstruction), JSON_FIELDS(json_construction_fields), false},
+    {"laws", SAVE_SECTION_LAWS, sizeof(struct SaveLaw), JSON_FIELDS(json_law_fields), false},
+    {"popups", SAVE_SECTION_POPUPS, sizeof(struct SavePopup), JSON_FIELDS(json_popup_fields), false},
+    {"popup_choices", SAVE_SECTION_POPUP_CHOICES, sizeof(uint32_t), JSON_FIELDS(json_popup_choice_fields), false},
+    {"farms", SAVE_SECTION_FARMS, sizeof(struct SaveFarm), JSON_FIELDS(json_farm_fields), false},
+    {"forums", SAVE_SECTION_FORUMS, sizeof(struct SaveForum), JSON_FIELDS(json_forum_fields), false},
+    {"land_taxes", SAVE_SECTION_LAND_TAXES, sizeof(struct SaveLandTax), JSON_FIELDS(json_land_tax_fields), false}};
+#define NUM_JSON_SECTIONS (sizeof(json_sections) / sizeof(json_sections[0]))
+
+static void json_write_field(struct JsonWriter *w, const struct JsonField *field, const uint8_t *value,
+                             const struct SaveImage *img) {
+  const char *key = field->key;
+  switch (field->type) {
+  case JSON_FIELD_U8:
+    json_write_uint(w, key, *value);
+    break;
+  case JSON_FIELD_U32: {
+    uint32_t v; memcpy(&v, value, sizeof(v));
+    json_write_uint(w, key, v);
+    break;
+  }
+  case JSON_FIELD_I32: {
+    int32_t v; memcpy(&v, value, sizeof(v));
+    json_write_int(w, key, v);
+    break;
+  }
+  case JSON_FIELD_U64: {
+    uint64_t v; memcpy(&v, value, sizeof(v));
+    json_write_uint(w, key, v);
+    break;
+  }
+  case JSON_FIELD_I64: {
+    int64_t v; memcpy(&v, value, sizeof(v));
+    json_write_int(w, key, v);
+    break;
+  }
+  case JSON_FIELD_F32: {
+    float v; memcpy(&v, value, sizeof(v));
+    json_write_float(w, key, v);
+    break;
+  }
+  case JSON_FIELD_DATE: {
+    struct Date v; memcpy(&v, value, sizeof(v));
+    json_begin_object(w, key);
+    json_write_int(w, "year", v.year);
+    json_write_uint(w, "month", v.month);
+    json_write_uint(w, "day", v.day);
+    json_end_object(w);
+    break;
+  }
+  case JSON_FIELD_STRING: {
+    uint32_t v; memcpy(&v, value, sizeof(v));
+    const char *strings = (const char *)img->data[SAVE_SECTION_STRINGS];
+    json_write_string(w, key, v == SAVE_NONE ? NULL : &strings[v]);
+    break;
+  }
+  case JSON_FIELD_HANDLE: {
+    uint32_t v; memcpy(&v, value, sizeof(v));
+    if (v == SAVE_NONE) {
+      json_write_null(w, key);
+    } else {
+      json_write_uint(w, key, v);
+    }
+    break;
+  }
+  case JSON_FIELD_TICK_EFFECT: {
+    uint32_t v; memcpy(&v, value, sizeof(v));
+    assert(v < NUM_TICK_EFFECTS);
+    json_write_string(w, key, tick_effect_registry[v].name_str);
+    break;
+  }
+  }
+}
+
+static void json_write_record(struct JsonWriter *w, const char *key, const struct JsonField *fields,
+                              const size_t num_fields, const uint8_t *record, const struct SaveImage *img) {
+  if (num_fields == 1 && fields[0].key == NULL) {
+    json_write_field(w, &fields[0], record, img);
+    return;
+  }
+
+  json_begin_object(w, key);
+  for (size_t i = 0; i < num_fields; i++) {
+    const struct JsonField *field = &fields[i];
+    if (field->count == 1) {
+      json_write_field(w, field, record + field->offset, img);
+      continue;
+    }
+    json_begin_array(w, field->key);
+    const struct JsonField element = {NULL, field->type, 0, 1};
+    for (size_t j = 0; j < field->count; j++) {
+      json_write_field(w, &element, record + field->offset + j * sizeof(uint32_t), img);
+    }
+    json_end_array(w);
+  }
+  json_end_object(w);
+}
+
+// Streams img to filepath as JSON, returns false on failure. The text is never
+// held in memory, img is (see save_image_build).
+bool save_image_write_json(const struct SaveImage *img, const char *filepath) {
+  assert(img); assert(filepath);
+
+  char *tmp_filepath = str_concat_new(filepath, ".tmp");
+  static struct JsonWriter w; // NOTE: Large buffer, kept off the stack
+  w.size = 0;
+  w.depth = 0;
+  w.needs_comma = false;
+  w.error = false;
+  w.fd = open(tmp_filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (w.fd < 0) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", tmp_filepath, strerror(errno));
+    free(tmp_filepath);
+    return false;
+  }
+
+  json_begin_object(&w, NULL);
+  json_write_uint(&w, "version", SAVE_VERSION);
+
+  for (size_t i = 0; i < NUM_JSON_SECTIONS; i++) {
+    const uint8_t *records = img->data[json_sections[i].type];
+    const uint32_t count = img->sections[json_sections[i].type].count;
+    if (json_sections[i].single) {
+      assert(count == 1);
+      json_write_record(&w, json_sections[i].key, json_sections[i].fields, json_sections[i].num_fields,
+                        records, img);
+      continue;
+    }
+    json_begin_array(&w, json_sections[i].key);
+    for (uint32_t j = 0; j < count; j++) {
+      json_write_record(&w, NULL, json_sections[i].fields, json_sections[i].num_fields,
+                        records + j * json_sections[i].record_size, img);
+    }
+    json_end_array(&w);
+  }
+
+  // Event log as its events from oldest to newest
+  const struct SaveEventLog *log_rec = (const struct SaveEventLog *)img->data[SAVE_SECTION_EVENTLOG];
+  const struct EventLog log = {.buf = (uint8_t *)img->data[SAVE_SECTION_EVENTLOG_BUFFER],
+                               .capacity = log_rec->capacity,
+                               .head = log_rec->head,
+                               .tail = log_rec->tail,
+                               .end = log_rec->end,
+                               .num_msgs = log_rec->num_msgs,
+                               .wrapped = log_rec->wrapped};
+  json_begin_object(&w, "eventlog");
+  json_write_uint(&w, "capacity", log.capacity);
+  json_begin_array(&w, "events");
+  struct EventLogIter it = eventlog_iter(&log);
+  struct EventRecord rec;
+  const char *msg = NULL;
+  while (eventlog_iter_next(&log, &it, &rec, &msg)) {
+    json_begin_object(&w, NULL);
+    json_write_uint(&w, "type", rec.type);
+    json_write_int(&w, "year", rec.year);
+    json_write_uint(&w, "month", rec.month);
+    json_write_uint(&w, "day", rec.day);
+    json_begin_array(&w, "args");
+    for (size_t i = 0; i < EVENT_MAX_ARGS; i++) {
+      json_write_uint(&w, NULL, rec.args[i].h);
+    }
+    json_end_array(&w);
+    if (msg) {
+      json_write_string(&w, "msg", msg);
+    }
+    json_end_object(&w);
+  }
+  json_end_array(&w);
+  json_end_object(&w);
+
+  json_end_object(&w);
+  json_write_raw(&w, "\n", 1);
+  json_writer_flush(&w);
+
+  const bool success = !w.error && close(w.fd) == 0 && rename(tmp_filepath, filepath) == 0;
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: Failed to write %s: %s \n", filepath, strerror(errno));
+    unlink(tmp_filepath);
+  }
+  free(tmp_filepath);
+  return success;
+}
+
+// Reads a value of field into value, strings are appended to the strings buffer
+static bool json_read_field(struct JsonReader *r, const struct JsonField *field, uint8_t *value,
+                            struct SaveBuffer *strings) {
+  switch (field->type) {
+  case JSON_FIELD_DATE: {
+    if (json_next(r) != JSON_TOKEN_OBJECT_BEGIN) {
+      return false;
+    }
+    struct Date v = {0};
+    enum JsonToken tok;
+    while ((tok = json_next(r)) == JSON_TOKEN_KEY) {
+      char key[8] = {0}; // NOTE: Longer keys are unknown and match none
+      if (r->str_lng < sizeof(key)) {
+        memcpy(key, r->str, r->str_lng + 1);
+      }
+      double d; int64_t i;
+      if (!json_read_number(r, &d, &i)) {
+        return false;
+      }
+      if (strcmp(key, "year") == 0) {
+        v.year = i;
+      } else if (strcmp(key, "month") == 0) {
+        v.month = i;
+      } else if (strcmp(key, "day") == 0) {
+        v.day = i;
+      }
+    }
+    memcpy(value, &v, sizeof(v));
+    return tok == JSON_TOKEN_OBJECT_END;
+  }
+  case JSON_FIELD_STRING:
+  case JSON_FIELD_TICK_EFFECT: {
+    const enum JsonToken tok = json_next(r);
+    uint32_t v = SAVE_NONE;
+    if (tok == JSON_TOKEN_STRING && field->type == JSON_FIELD_STRING) {
+      v = strings->size;
+      memcpy(save_buffer_push(strings, r->str_lng + 1), r->str, r->str_lng + 1);
+    } else if (tok == JSON_TOKEN_STRING) {
+      for (v = 0; v < NUM_TICK_EFFECTS; v++) {
+        if (tick_effect_registry[v].name_str && strcmp(tick_effect_registry[v].name_str, r->str) == 0) {
+          break;
+        }
+      }
+      if (v == NUM_TICK_EFFECTS) {
+        fprintf(stderr, "[ColoniaC]: Unknown tick effect '%s' \n", r->str);
+        return false;
+      }
+    } else if (tok != JSON_TOKEN_NULL) {
+      return false;
+    }
+    memcpy(value, &v, sizeof(v));
+    return true;
+  }
+  default:
+    break;
+  }
+
+  double d; int64_t i;
+  if (!json_read_number(r, &d, &i)) {
+    return false;
+  }
+  switch (field->type) {
+  case JSON_FIELD_U8: {
+    const uint8_t v = i;
+    memcpy(value, &v, sizeof(v));
+    break;
+  }
+  case JSON_FIELD_U32:
+  case JSON_FIELD_I32:
+  case JSON_FIELD_HANDLE: {
+    const uint32_t v = (field->type == JSON_FIELD_HANDLE && r->str_lng == 0) ? SAVE_NONE : (uint32_t)i;
+    memcpy(value, &v, sizeof(v));
+    break;
+  }
+  case JSON_FIELD_U64:
+  case JSON_FIELD_I64:
+    memcpy(value, &i, sizeof(i));
+    break;
+  case JSON_FIELD_F32: {
+    const float v = d;
+    memcpy(value, &v, sizeof(v));
+    break;
+  }
+  default:
+    assert(false && "Unreachable");
+  }
+  return true;
+}
+
+// Reads one record, fields missing in the file keep their zero (or SAVE_NONE) value
+static bool json_read_record(struct JsonReader *r, const struct JsonField *fields, const size_t num_fields,
+                             uint8_t *record, struct SaveBuffer *strings) {
+  for (size_t i = 0; i < num_fields; i++) {
+    if (fields[i].type == JSON_FIELD_STRING || fields[i].type == JSON_FIELD_HANDLE) {
+      for (size_t j = 0; j < fields[i].count; j++) {
+        const uint32_t none = SAVE_NONE;
+        memcpy(record + fields[i].offset + j * sizeof(uint32_t), &none, sizeof(none));
+      }
+    }
+  }
+
+  if (num_fields == 1 && fields[0].key == NULL) {
+    return json_read_field(r, &fields[0], record, strings);
+  }
+
+  if (json_next(r) != JSON_TOKEN_OBJECT_BEGIN) {
+    return false;
+  }
+  enum JsonToken tok;
+  while ((tok = json_next(r)) == JSON_TOKEN_KEY) {
+    const struct JsonField *field = NULL;
+    for (size_t i = 0; i < num_fields && !field; i++) {
+      if (strcmp(fields[i].key, r->str) == 0) {
+        field = &fields[i];
+      }
+    }
+    if (field == NULL) { // Unknown field, from a newer version perhaps
+      if (!json_skip(r, json_next(r))) {
+        return false;
+      }
+      continue;
+    }
+    if (field->count == 1) {
+      if (!json_read_field(r, field, record + field->offset, strings)) {
+        return false;
+      }
+      continue;
+    }
+    if (json_next(r) != JSON_TOKEN_ARRAY_BEGIN) {
+      return false;
+    }
+    const struct JsonField element = {NULL, field->type, 0, 1};
+    for (size_t j = 0; j < field->count; j++) {
+      if (!json_read_field(r, &element, record + field->offset + j * sizeof(uint32_t), strings)) {
+        return false;
+      }
+    }
+    if (json_next(r) != JSON_TOKEN_ARRAY_END) {
+      return false;
+    }
+  }
+  return tok == JSON_TOKEN_OBJECT_END;
+}
+
+// Rebuilds the event log ring from its events, laid out from the start of the buffer
+static bool json_read_eventlog(struct JsonReader *r, struct SaveBuffer *log_buffer, struct SaveBuffer *ring) {
+  struct SaveEventLog *log = save_buffer_push(log_buffer, sizeof(struct SaveEventLog));
+  if (json_next(r) != JSON_TOKEN_OBJECT_BEGIN) {
+    return false;
+  }
+
+  enum JsonToken tok;
+  while ((tok = json_next(r)) == JSON_TOKEN_KEY) {
+    if (strcmp(r->str, "capacity") == 0) {
+      double d; int64_t i;
+      if (!json_read_number(r, &d, &i) || i <= 0 || log->capacity != 0) {
+        return false;
+      }
+      log->capacity = i;
+      log->end = log->capacity;
+      save_buffer_push(ring, log->capacity);
+      ring->count = log->capacity;
+      continue;
+    }
+    if (strcmp(r->str, "events") != 0) {
+      if (!json_skip(r, json_next(r))) {
+        return false;
+      }
+      continue;
+    }
+
+    // NOTE: Capacity is written before the events
+    if (log->capacity == 0 || json_next(r) != JSON_TOKEN_ARRAY_BEGIN) {
+      return false;
+    }
+    while ((tok = json_next(r)) == JSON_TOKEN_OBJECT_BEGIN) {
+      struct EventRecord rec = {0};
+      char msg[EVENTLOG_MSG_MAX] = {0};
+      size_t msg_lng = 0;
+      bool has_msg = false;
+      while ((tok = json_next(r)) == JSON_TOKEN_KEY) {
+        char key[8] = {0}; // NOTE: Longer keys are unknown and match none
+        if (r->str_lng < sizeof(key)) {
+          memcpy(key, r->str, r->str_lng + 1);
+        }
+        double d; int64_t i;
+        if (strcmp(key, "args") == 0) {
+          if (json_next(r) != JSON_TOKEN_ARRAY_BEGIN) {
+            return false;
+          }
+          for (size_t j = 0; j < EVENT_MAX_ARGS; j++) {
+            if (!json_read_number(r, &d, &i)) {
+              return false;
+            }
+            rec.args[j].h = i;
+          }
+          if (json_next(r) != JSON_TOKEN_ARRAY_END) {
+            return false;
+          }
+        } else if (strcmp(key, "msg") == 0) {
+          if (json_next(r) != JSON_TOKEN_STRING) {
+            return false;
+          }
+          msg_lng = r->str_lng < EVENTLOG_MSG_MAX - 1 ? r->str_lng : EVENTLOG_MSG_MAX - 1;
+          memcpy(msg, r->str, msg_lng);
+          has_msg = true;
+        } else if (json_read_number(r, &d, &i)) {
+          if (strcmp(key, "type") == 0) {
+            rec.type = i;
+          } else if (strcmp(key, "year") == 0) {
+            rec.year = i;
+          } else if (strcmp(key, "month") == 0) {
+            rec.month = i;
+          } else if (strcmp(key, "day") == 0) {
+            rec.day = i;
+          }
+        } else {
+          return false;
+        }
+      }
+      if (tok != JSON_TOKEN_OBJECT_END || rec.type >= NUM_EVENT_TYPES || has_msg != (rec.type == EVENT_TEXT)) {
+        return false;
+      }
+
+      const uint16_t len = sizeof(rec) + (has_msg ? msg_lng + 1 : 0);
+      if (log->tail + sizeof(len) + len > log->capacity) {
+        return false;
+      }
+      uint8_t *dst = &ring->data[log->tail];
+      memcpy(dst, &len, sizeof(len));
+      memcpy(dst + sizeof(len), &rec, sizeof(rec));
+      memcpy(dst + sizeof(len) + sizeof(rec), msg, len - sizeof(rec));
+      log->tail += sizeof(len) + len;
+      log->num_msgs++;
+    }
+    if (tok != JSON_TOKEN_ARRAY_END) {
+      return false;
+    }
+  }
+  return tok == JSON_TOKEN_OBJECT_END && log->capacity > 0;
+}
+
+// Pulls a JSON savegame at filepath into img (owned), returns false if the
+// file could not be read or is not a valid savegame. img grows with the
+// savegame, only the text is read through a fixed buffer.
+bool save_image_read_json(struct SaveImage *img, const char *filepath) {
+  assert(img); assert(filepath);
+
+  static struct JsonReader r; // NOTE: Large buffers, kept off the stack
+  r.pos = 0;
+  r.size = 0;
+  r.depth = 0;
+  r.objects = 0;
+  r.after_key = false;
+  r.fd = open(filepath, O_RDONLY);
+  if (r.fd < 0) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
+
+  struct SaveBuffer buffers[NUM_SAVE_SECTIONS];
+  memset(buffers, 0, sizeof(buffers));
+
+  bool success = json_next(&r) == JSON_TOKEN_OBJECT_BEGIN;
+  enum JsonToken tok = JSON_TOKEN_ERROR;
+  while (success && (tok = json_next(&r)) == JSON_TOKEN_KEY) {
+    if (strcmp(r.str, "version") == 0) {
+      double d; int64_t i;
+      success = json_read_number(&r, &d, &i) && i == SAVE_VERSION;
+      continue;
+    }
+    if (strcmp(r.str, "eventlog") == 0) {
+      success = buffers[SAVE_SECTION_EVENTLOG].count == 0 &&
+                json_read_eventlog(&r, &buffers[SAVE_SECTION_EVENTLOG], &buffers[SAVE_SECTION_EVENTLOG_BUFFER]);
+      continue;
+    }
+
+    size_t s = 0;
+    while (s < NUM_JSON_SECTIONS && strcmp(json_sections[s].key, r.str) != 0) {
+      s++;
+    }
+    if (s == NUM_JSON_SECTIONS) {
+      success = json_skip(&r, json_next(&r));
+      continue;
+    }
+
+    struct SaveBuffer *buffer = &buffers[json_sections[s].type];
+    if (json_sections[s].single) {
+      success = buffer->count == 0 &&
+                json_read_record(&r, json_sections[s].fields, json_sections[s].num_fields,
+                                 save_buffer_push(buffer, json_sections[s].record_size),
+                                 &buffers[SAVE_SECTION_STRINGS]);
+      continue;
+    }
+
+    success = json_next(&r) == JSON_TOKEN_ARRAY_BEGIN;
+    while (success) {
+      // Records are read one value ahead, peek for the end of the array
+      int ch;
+      while ((ch = json_peek(&r)) == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == ',') {
+        r.pos++;
+      }
+      if (ch == ']') {
+        success = json_next(&r) == JSON_TOKEN_ARRAY_END;
+        break;
+      }
+      success = json_read_record(&r, json_sections[s].fields, json_sections[s].num_fields,
+                                 save_buffer_push(buffer, json_sections[s].record_size),
+                                 &buffers[SAVE_SECTION_STRINGS]);
+    }
+  }
+  success = success && tok == JSON_TOKEN_OBJECT_END && json_next(&r) == JSON_TOKEN_EOF;
+  close(r.fd);
+
+  buffers[SAVE_SECTION_STRINGS].count = buffers[SAVE_SECTION_STRINGS].size;
+  memset(img, 0, sizeof(struct SaveImage));
+  img->owned = true;
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    img->sections[i].type = i;
+    img->sections[i].count = buffers[i].count;
+    img->sections[i].size = buffers[i].size;
+    img->data[i] = buffers[i].data;
+  }
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: %s is not a valid JSON savegame \n", filepath);
+    save_image_free(img);
+  }
+  return success;
+}
+
+// Saves the City state to the save folder from the CONFIG
+bool save_game_to_json(const struct City *c) {
+  char *filepath = str_concat_new(CONFIG.FILEPATH_SAVE, JSON_SAVE_FILENAME);
+  struct SaveImage img;
+  save_image_build(c, &img);
+  const bool success = save_image_write_json(&img, filepath);
+  save_image_free(&img);
+  free(filepath);
+  return success;
+}
+
+// Loads the City state from the save folder from the CONFIG
+bool load_game_from_json(struct City *c) {
+  char *filepath = str_concat_new(CONFIG.FILEPATH_SAVE, JSON_SAVE_FILENAME);
+  struct SaveImage img;
+  bool success = save_image_read_json(&img, filepath);
+  if (success) {
+    success = save_image_restore(&img, c);
+    save_image_free(&img);
+  }
+  free(filepath);
+  return success;
+}
+
+/***** delta savegame *****/
+// Between full checkpoints only what changed since the previous save is
+// written. A delta file belongs to one checkpoint file and is a sequence of
+// delta records, each turning the previous image into the next one. Records
+// are compared against the previous image on the saving thread so the
+// simulation does not have to track its own mutations.
+// Delta file layout: SaveDeltaFileHeader, then per record SaveDeltaHeader
+// followed by num_sections times SaveDeltaSection and its runs. A run is a
+// SaveDeltaRun followed by the records, padded to 8 bytes.
+#define SAVE_DELTA_MAGIC "RTSD"
+#define SAVE_DELTA_VERSION 1
+#define SAVE_DELTA_MERGE_BYTES 32 // Runs closer than this are merged into one
+
+struct SaveDeltaFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t checkpoint_hash; // save_image_hash of the checkpoint the deltas apply to
+};
+
+struct SaveDeltaHeader {
+  uint32_t size;     // In bytes, following this header
+  uint32_t checksum; // Of the following bytes, detects torn writes
+  uint64_t timestep;
+  uint32_t num_sections;
+  uint32_t pad;
+};
+
+struct SaveDeltaSection {
+  uint32_t type;  // enum SaveSectionType
+  uint32_t count; // Number of records after the delta
+  uint32_t num_runs;
+  uint32_t pad;
+};
+
+struct SaveDeltaRun {
+  uint32_t first; // Index of the first record
+  uint32_t count;
+};
+
+// FNV-1a
+static uint64_t save_hash(uint64_t hash, const void *data, const size_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+static uint64_t save_image_hash(const struct SaveImage *img) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    hash = save_hash(hash, &img->sections[i].count, sizeof(uint32_t));
+    hash = save_hash(hash, img->data[i], img->sections[i].size);
+  }
+  return hash;
+}
+
+static bool save_record_changed(const struct SaveImage *base, const struct SaveImage *img,
+                                const size_t type, const uint32_t i) {
+  const size_t size = save_record_sizes[type];
+  return i >= base->sections[type].count ||
+         memcmp(&img->data[type][i * size], &base->data[type][i * size], size) != 0;
+}
+
+// Appends the delta record turning base into img to out, returns false
+// without appending anything if nothing changed
+static bool save_delta_build(const struct SaveImage *base, const struct SaveImage *img,
+                             struct SaveBuffer *out) {
+  assert(base); assert(img); assert(out);
+  const size_t start = out->size;
+  save_buffer_push(out, sizeof(struct SaveDeltaHeader));
+
+  uint32_t num_sections = 0;
+  for (size_t type = 0; type < NUM_SAVE_SECTIONS; type++) {
+    const struct SaveSection *s = &img->sections[type];
+    if (s->count == base->sections[type].count &&
+        (s->size == 0 || memcmp(img->data[type], base->data[type], s->size) == 0)) {
+      continue;
+    }
+
+    const size_t record_size = save_record_sizes[type];
+    const size_t section_start = out->size;
+    save_buffer_push(out, sizeof(struct SaveDeltaSection));
+    uint32_t num_runs = 0;
+    uint32_t i = 0;
+    while (i < s->count) {
+      if (!save_record_changed(base, img, type, i)) {
+        i++;
+        continue;
+      }
+
+      // Extend the run over changed records and short gaps of unchanged ones
+      uint32_t end = i + 1;
+      for (uint32_t j = end; j < s->count && (j + 1 - end) * record_size < SAVE_DELTA_MERGE_BYTES; j++) {
+        if (save_record_changed(base, img, type, j)) {
+          end = j + 1;
+        }
+      }
+
+      struct SaveDeltaRun *run = (struct SaveDeltaRun *)save_buffer_push(out, sizeof(struct SaveDeltaRun));
+      run->first = i;
+      run->count = end - i;
+      const size_t size = run->count * record_size;
+      memcpy(save_buffer_push(out, size), &img->data[type][i * record_size], size);
+      save_buffer_push(out, (8 - size % 8) % 8);
+      num_runs++;
+      i = end;
+    }
+
+    struct SaveDeltaSection *section = (struct SaveDeltaSection *)&out->data[section_start];
+    section->type = type;
+    section->count = s->count;
+    section->num_runs = num_runs;
+    num_sections++;
+  }
+
+  if (num_sections == 0) {
+    out->size = start;
+    return false;
+  }
+
+  struct SaveDeltaHeader *header = (struct SaveDeltaHeader *)&out->data[start];
+  header->size = out->size - start - sizeof(struct SaveDeltaHeader);
+  header->checksum = (uint32_t)save_hash(14695981039346656037ull, header + 1, header->size);
+  header->timestep = ((const struct SaveGame *)img->data[SAVE_SECTION_GAME])->timestep;
+  header->num_sections = num_sections;
+  return true;
+}
+
+// Applies the delta record body at data to the owned image img, returns false
+// if the record does not fit the image
+static bool save_delta_apply(struct SaveImage *img, const struct SaveDeltaHeader *header,
+                             const uint8_t *data) {
+  assert(img && img->owned); assert(header); assert(data);
+  size_t offset = 0;
+  for (uint32_t n = 0; n < header->num_sections; n++) {
+    if (header->size - offset < sizeof(struct SaveDeltaSection)) {
+      return false;
+    }
+    const struct SaveDeltaSection *section = (const struct SaveDeltaSection *)&data[offset];
+    offset += sizeof(struct SaveDeltaSection);
+    if (section->type >= NUM_SAVE_SECTIONS) {
+      return false;
+    }
+
+    const size_t record_size = save_record_sizes[section->type];
+    const size_t size = (size_t)section->count * record_size;
+    struct SaveSection *s = &img->sections[section->type];
+    uint8_t *records = (uint8_t *)realloc((void *)img->data[section->type], size + 1);
+    if (size > s->size) {
+      memset(&records[s->size], 0, size - s->size);
+    }
+    img->data[section->type] = records;
+    s->count = section->count;
+    s->size = size;
+
+    for (uint32_t r = 0; r < section->num_runs; r++) {
+      if (header->size - offset < sizeof(struct SaveDeltaRun)) {
+        return false;
+      }
+      const struct SaveDeltaRun *run = (const struct SaveDeltaRun *)&data[offset];
+      offset += sizeof(struct SaveDeltaRun);
+      const size_t run_size = (size_t)run->count * record_size;
+      const size_t padded_size = run_size + (8 - run_size % 8) % 8;
+      if (run->first > section->count || run->count > section->count - run->first ||
+          header->size - offset < padded_size) {
+        return false;
+      }
+      memcpy(&records[run->first * record_size], &data[offset], run_size);
+      offset += padded_size;
+    }
+  }
+  return offset == header->size;
+}
+
+// Copies a view image into owned buffers so that deltas can be applied to it
+static void save_image_copy(const struct SaveImage *view, struct SaveImage *img) {
+  *img = (struct SaveImage){.owned = true};
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    img->sections[i] = view->sections[i];
+    uint8_t *data = (uint8_t *)malloc(view->sections[i].size + 1);
+    memcpy(data, view->data[i], view->sections[i].size);
+    img->data[i] = data;
+  }
+}
+
+// Starts a new, empty delta file for the checkpoint img
+bool save_delta_file_reset(const struct SaveImage *img, const char *filepath) {
+  assert(img); assert(filepath);
+  const struct SaveDeltaFileHeader header = {.magic = SAVE_DELTA_MAGIC,
+                                             .version = SAVE_DELTA_VERSION,
+                                             .checkpoint_hash = save_image_hash(img)};
+  const int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
+  const bool synced = write(fd, &header, sizeof(header)) == sizeof(header) && fsync(fd) == 0;
+  const bool success = close(fd) == 0 && synced;
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: Failed to write %s: %s \n", filepath, strerror(errno));
+  }
+  return success;
+}
+
+// Appends the delta record(s) in record to the delta file and syncs it to disk
+bool save_delta_file_append(const struct SaveBuffer *record, const char *filepath) {
+  assert(record); assert(filepath);
+  const int fd = open(filepath, O_WRONLY | O_APPEND);
+  if (fd < 0) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
+  const bool synced = write(fd, record->data, record->size) == (ssize_t)record->size && fsync(fd) == 0;
+  const bool success = close(fd) == 0 && synced;
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: Failed to write %s: %s \n", filepath, strerror(errno));
+  }
+  return success;
+}
+
+// Loads the checkpoint at checkpoint_filepath and replays the deltas of the
+// delta file onto it. A missing delta file, or one that belongs to another
+// checkpoint, loads the checkpoint as is. A torn record at the end of the
+// delta file (crash while saving) loads the state before it.
+bool load_game_from_checkpoint(struct City *c, const char *checkpoint_filepath,
+                               const char *delta_filepath) {
+  assert(c); assert(checkpoint_filepath); assert(delta_filepath);
+  struct SaveImage view;
+  const uint8_t *map;
+  size_t map_size;
+  if (!save_image_map(checkpoint_filepath, &view, &map, &map_size)) {
+    return false;
+  }
+  struct SaveImage img = view;
+  if (!view.owned) {
+    save_image_copy(&view, &img);
+  }
+  munmap((void *)map, map_size);
+
+  bool success = true;
+  uint32_t num_deltas = 0;
+  const int fd = open(delta_filepath, O_RDONLY);
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct SaveDeltaFileHeader)) {
+    const size_t size = st.st_size;
+    const uint8_t *deltas = (const uint8_t *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (deltas != MAP_FAILED) {
+      const struct SaveDeltaFileHeader *file_header = (const struct SaveDeltaFileHeader *)deltas;
+      if (memcmp(file_header->magic, SAVE_DELTA_MAGIC, sizeof(file_header->magic)) == 0 &&
+          file_header->version == SAVE_DELTA_VERSION &&
+          file_header->checkpoint_hash == save_image_hash(&img)) {
+        size_t offset = sizeof(struct SaveDeltaFileHeader);
+        while (success && size - offset >= sizeof(struct SaveDeltaHeader)) {
+          const struct SaveDeltaHeader *header = (const struct SaveDeltaHeader *)&deltas[offset];
+          const uint8_t *body = (const uint8_t *)(header + 1);
+          offset += sizeof(struct SaveDeltaHeader);
+          if (header->size > size - offset ||
+              header->checksum != (uint32_t)save_hash(14695981039346656037ull, body, header->size)) {
+            fprintf(stderr, "[ColoniaC]: Ignoring the torn end of %s \n", delta_filepath);
+            break;
+          }
+          success = save_delta_apply(&img, header, body);
+          offset += header->size;
+          num_deltas++;
+        }
+      }
+      munmap((void *)deltas, size);
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  success = success && save_image_restore(&img, c);
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: %s is not a valid savegame after %u deltas \n", checkpoint_filepath,
+            num_deltas);
+  }
+  save_image_free(&img);
+  return success;
+}
+
+/***** autosave *****/
+// Autosaves every in-game month into rotating slots. The snapshot is the
+// SaveImage captured at the tick boundary, it is written and synced to disk
+// by a worker thread so that the simulation never waits on the disk.
+// A slot holds a full checkpoint followed by the deltas of the next
+// checkpoint_interval - 1 autosaves, then the next slot is started.
+#define AUTOSAVE_DEFAULT_SLOTS 3 // Default number of autosave files (see config.json)
+#define AUTOSAVE_DEFAULT_CHECKPOINT_INTERVAL 12 // Autosaves per full checkpoint (see config.json)
+#define AUTOSAVE_FILENAME_FMT "autosave%u.bin"
+#define AUTOSAVE_DELTA_FILENAME_FMT "autosave%u.delta"
+
+struct AutosaveStats {
+  uint32_t num_saves;
+  uint32_t num_checkpoints; // Saves written in full, the others are deltas
+  uint32_t num_failed;
+  uint32_t num_skipped;  // Snapshots dropped since the previous one was still being written
+  uint32_t last_slot;
+  uint64_t last_size;    // Bytes written by the last save
+  double snapshot_ms;    // Time the simulation spent capturing the last snapshot
+  double write_ms;       // Time the worker spent writing and syncing the last save
+  double max_write_ms;
+};
+
+struct Autosave {
+  char *folder;
+  uint32_t num_slots;
+  uint32_t next_slot;
+  uint32_t checkpoint_interval;
+  // Owned by the worker thread while has_pending is true
+  struct SaveImage pending;
+  bool has_pending;
+  bool quit;
+  // Owned by the worker thread, the last image written to the current slot
+  struct SaveImage base;
+  bool has_base;
+  uint32_t slot;       // Slot of the base
+  uint32_t num_deltas; // Written to the slot since its checkpoint
+  struct AutosaveStats stats; // Guarded by lock
+  SDL_Thread *thread;
+  SDL_mutex *lock;
+  SDL_cond *cond;
+};
+
+static double time_now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Callee owned path of the checkpoint or delta file of an autosave slot
+static char *autosave_slot_path_new(const char *folder, const uint32_t slot, const bool delta) {
+  char filename[32];
+  if (delta) {
+    snprintf(filename, sizeof(filename), AUTOSAVE_DELTA_FILENAME_FMT, slot);
+  } else {
+    snprintf(filename, sizeof(filename), AUTOSAVE_FILENAME_FMT, slot);
+  }
+  return str_concat_new(folder, filename);
+}
+
+// Time of the last write to an autosave slot in seconds, 0 if it is empty
+static double autosave_slot_mtime(const char *folder, const uint32_t slot) {
+  double mtime = 0.0;
+  for (int delta = 0; delta < 2; delta++) {
+    char *filepath = autosave_slot_path_new(folder, slot, delta);
+    struct stat st;
+    if (stat(filepath, &st) == 0 && st.st_mtim.tv_sec + st.st_mtim.tv_nsec / 1e9 > mtime) {
+      mtime = st.st_mtim.tv_sec + st.st_mtim.tv_nsec / 1e9;
+    }
+    free(filepath);
+  }
+  return mtime;
+}
+
+// Writes the pending image as a delta to the slot of the base or as a
+// checkpoint to the next slot, size is set to the number of bytes written
+static bool autosave_write(struct Autosave *a, uint64_t *size) {
+  bool success;
+  *size = 0;
+  if (a->has_base && a->num_deltas + 1 < a->checkpoint_interval) {
+    char *filepath = autosave_slot_path_new(a->folder, a->slot, true);
+    struct SaveBuffer record = {0};
+    success = !save_delta_build(&a->base, &a->pending, &record) ||
+              save_delta_file_append(&record, filepath);
+    *size = record.size;
+    free(record.data);
+    free(filepath);
+    a->num_deltas++;
+  } else {
+    a->slot = a->next_slot;
+    a->next_slot = (a->next_slot + 1) % a->num_slots;
+    a->num_deltas = 0;
+    char *filepath = autosave_slot_path_new(a->folder, a->slot, false);
+    char *delta_filepath = autosave_slot_path_new(a->folder, a->slot, true);
+    success = save_image_write(&a->pending, filepath, CONFIG.COMPRESSION) &&
+              save_delta_file_reset(&a->pending, delta_filepath);
+    struct stat st;
+    *size = success && stat(filepath, &st) == 0 ? (uint64_t)st.st_size : 0;
+    free(delta_filepath);
+    free(filepath);
+  }
+
+  // After a failure the files no longer match the base, the next save is a checkpoint
+  save_image_free(&a->base);
+  a->has_base = success;
+  if (success) {
+    a->base = a->pending;
+  } else {
+    save_image_free(&a->pending);
+  }
+  memset(&a->pending, 0, sizeof(struct SaveImage));
+  return success;
+}
+
+static int autosave_writer_thread(void *data) {
+  struct Autosave *a = (struct Autosave *)data;
+
+  SDL_LockMutex(a->lock);
+  while (true) {
+    while (!a->has_pending && !a->quit) {
+      SDL_CondWait(a->cond, a->lock);
+    }
+    if (!a->has_pending && a->quit) {
+      break;
+    }
+
+    SDL_UnlockMutex(a->lock);
+    const double t0 = time_now_ms();
+    uint64_t size;
+    const bool success = autosave_write(a, &size);
+    const double t1 = time_now_ms();
+    SDL_LockMutex(a->lock);
+
+    a->has_pending = false;
+    if (success) {
+      a->stats.num_saves++;
+      a->stats.num_checkpoints += a->num_deltas == 0;
+      a->stats.last_slot = a->slot;
+      a->stats.last_size = size;
+      a->stats.write_ms = t1 - t0;
+      if (a->stats.write_ms > a->stats.max_write_ms) {
+        a->stats.max_write_ms = a->stats.write_ms;
+      }
+    } else {
+      a->stats.num_failed++;
+    }
+    SDL_CondBroadcast(a->cond);
+  }
+  SDL_UnlockMutex(a->lock);
+  return 0;
+}
+
+// Starts the autosave worker for num_slots slots in folder, 0 slots disables
+// it. Every checkpoint_interval-th autosave is a full checkpoint.
+void autosave_open(struct Autosave *a, const char *folder, const uint32_t num_slots,
+                   const uint32_t checkpoint_interval) {
+  assert(a); assert(checkpoint_interval > 0);
+  memset(a, 0, sizeof(struct Autosave));
+  if (num_slots == 0 || folder == NULL) {
+    return;
+  }
+
+  a->folder = str_concat_new(folder, "");
+  a->num_slots = num_slots;
+  a->checkpoint_interval = checkpoint_interval;
+
+  // Continue the rotation by starting over the oldest (or a missing) slot
+  double oldest = 0.0;
+  for (uint32_t i = 0; i < num_slots; i++) {
+    const double mtime = autosave_slot_mtime(folder, i);
+    if (i == 0 || mtime < oldest) {
+      oldest = mtime;
+      a->next_slot = i;
+    }
+  }
+
+  a->lock = SDL_CreateMutex();
+  a->cond = SDL_CreateCond();
+  a->thread = SDL_CreateThread(autosave_writer_thread, "autosave_writer", a);
+}
+
+// Snapshots c for the worker to save, call between timesteps. Never waits
+// for the disk, if the previous save is still being written this one is skipped.
+void autosave_request(struct Autosave *a, const struct City *c) {
+  assert(a); assert(c);
+  if (a->num_slots == 0) {
+    return;
+  }
+
+  SDL_LockMutex(a->lock);
+  const bool busy = a->has_pending;
+  if (busy) {
+    a->stats.num_skipped++;
+  }
+  SDL_UnlockMutex(a->lock);
+  if (busy) {
+    return;
+  }
+
+  // Only this thread sets has_pending, the image can be built unlocked
+  const double t0 = time_now_ms();
+  struct SaveImage img;
+  save_image_build(c, &img);
+  const double t1 = time_now_ms();
+
+  SDL_LockMutex(a->lock);
+  a->pending = img;
+  a->has_pending = true;
+  a->stats.snapshot_ms = t1 - t0;
+  SDL_CondBroadcast(a->cond);
+  SDL_UnlockMutex(a->lock);
+}
+
+struct AutosaveStats autosave_stats(struct Autosave *a) {
+  assert(a);
+  struct AutosaveStats stats = {0};
+  if (a->num_slots == 0) {
+    return stats;
+  }
+  SDL_LockMutex(a->lock);
+  stats = a->stats;
+  SDL_UnlockMutex(a->lock);
+  return stats;
 }
 
-void circus_maximus_tick_effect(struct Effect *e, const struct City *c,
-                                struct City *c1) {
-  c1->cursus_honorum->aedile_enabled = true;
-  c1->political_capacity += 2;
+// Finishes the save in progress and stops the worker thread
+void autosave_close(struct Autosave *a) {
+  assert(a);
+  if (a->num_slots == 0) {
+    return;
+  }
+
+  SDL_LockMutex(a->lock);
+  a->quit = true;
+  SDL_CondBroadcast(a->cond);
+  SDL_UnlockMutex(a->lock);
+  SDL_WaitThread(a->thread, NULL);
+
+  SDL_DestroyCond(a->cond);
+  SDL_DestroyMutex(a->lock);
+  save_image_free(&a->base);
+  free(a->folder);
+  a->num_slots = 0;
 }
 
-void event_log_test_effect(struct Effect *e, const struct City *c,
-                           struct City *c1) {
-  static int i = 1;
-  const int lng = snprintf(NULL, 0, "Message #%u", i) + 1;
-  char msg[lng];
-  snprintf(msg, lng, "Message #%u", i);
-  eventlog_add_msg(c->log, msg);
-  i++;
+// Loads the most recent autosave in folder, returns false if there is none
+bool load_game_from_autosave_folder(struct City *c, const char *folder, const uint32_t num_slots) {
+  assert(c); assert(folder);
+  uint32_t latest = 0;
+  double newest = 0.0;
+  for (uint32_t i = 0; i < num_slots; i++) {
+    const double mtime = autosave_slot_mtime(folder, i);
+    if (mtime > newest) {
+      newest = mtime;
+      latest = i;
+    }
+  }
+  if (newest == 0.0) {
+    return false;
+  }
+
+  char *filepath = autosave_slot_path_new(folder, latest, false);
+  char *delta_filepath = autosave_slot_path_new(folder, latest, true);
+  const bool success = load_game_from_checkpoint(c, filepath, delta_filepath);
+  free(delta_filepath);
+  free(filepath);
+  return success;
 }
 
-void enact_law_tick_effect(struct Effect *e, const struct City *c,
-                           struct City *c1) {
-  const struct Law *arg = (struct Law *)e->arg;
-  switch (arg->type) {
-  case Political:
-    c1->political_usage += arg->cost;
+// Loads the most recent autosave from the save folder from the CONFIG
+bool load_game_from_autosave(struct City *c) {
+  return load_game_from_autosave_folder(c, CONFIG.FILEPATH_SAVE, CONFIG.AUTOSAVE_SLOTS);
+}
+
+/***** content catalogue *****/
+// Construction projects and laws available in a game. They are authored as
+// JSON (resources/catalogue.json) and cooked into a blob of fixed size
+// records and a string table which is mmapped at startup. Text starting with
+// '@' is the key of a localised string in ui_help_strs.h.
+#define CATALOGUE_MAGIC "RTSC"
+#define CATALOGUE_VERSION 1
+#define CATALOGUE_NONE 0xFFFFFFFFu // NULL string or no argument
+#define CATALOGUE_DEFAULT_NAME "catalogue"
+
+// Blob layout: CatalogueHeader, effects, constructions, laws, arguments and
+// the string table of NUL-terminated strings
+struct CatalogueHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t hash; // FNV-1a of everything after the header, identifies the content
+  uint32_t num_effects;
+  uint32_t num_constructions;
+  uint32_t num_laws;
+  uint32_t num_args;
+  uint32_t strings_size;
+  uint32_t pad;
+};
+
+struct CatalogueEffect {
+  uint32_t name; // Offsets into the string table or CATALOGUE_NONE
+  uint32_t description;
+  int64_t duration;
+  uint16_t tick_effect; // enum TickEffectId
+  uint16_t pad;
+  uint32_t arg; // Index of the argument or CATALOGUE_NONE
+};
+
+struct CatalogueConstruction {
+  uint32_t name;
+  uint32_t description;
+  uint32_t help;
+  float cost;
+  float maintenance;
+  uint32_t construction_time;
+  uint32_t effect; // First of num_effects effects
+  uint32_t num_effects;
+  uint8_t gui_construction_management; // enum ConstructionGuiId
+  uint8_t unique_effects;
+  uint8_t built; // Standing from the start of the game
+  uint8_t pad;
+  uint32_t pad1;
+};
+
+struct CatalogueLaw {
+  uint32_t name;
+  uint32_t description;
+  uint32_t help;
+  uint32_t type; // enum CapacityType
+  uint8_t cost;
+  uint8_t cost_lng;
+  uint8_t gui_handler; // enum LawGuiId
+  uint8_t pad;
+  uint32_t effect;
+};
+
+// FARM: ints = {produce, area}, floats = {p0 min, p0 max, p1 min, p1 max}
+// FORUM: ints = {taberna_capacity}
+// LAND_TAX: floats = {tax_percentage}
+struct CatalogueArg {
+  uint32_t type; // enum EffectArgType
+  uint32_t ints[2];
+  float floats[4];
+};
+
+// View of a mmapped or embedded catalogue blob
+struct Catalogue {
+  uint8_t *map;
+  size_t size;
+  bool embedded; // map is in the executable rather than mmapped
+  const struct CatalogueHeader *header;
+  const struct CatalogueEffect *effects;
+  const struct CatalogueConstruction *constructions;
+  const struct CatalogueLaw *laws;
+  const struct CatalogueArg *args;
+  const char *strings;
+};
+
+static struct Catalogue catalogue; // Content of the game being played
+
+static const char *catalogue_gui_strs[NUM_CONSTRUCTION_GUIS] = {"none", "farm", "forum"};
+
+// State while cooking a catalogue
+struct CatalogueCook {
+  const char *filepath; // Of the JSON, for error messages
+  struct SaveBuffer effects;
+  struct SaveBuffer constructions;
+  struct SaveBuffer laws;
+  struct SaveBuffer args;
+  struct SaveBuffer strings;
+  bool error;
+};
+
+static void catalogue_cook_error(struct CatalogueCook *cc, const char *what, const char *name) {
+  fprintf(stderr, "[ColoniaC]: %s: %s '%s' \n", cc->filepath, what, name ? name : "");
+  cc->error = true;
+}
+
+// Adds the string of item to the string table unless it is there already
+static uint32_t catalogue_cook_string(struct CatalogueCook *cc, const cJSON *item) {
+  if (item == NULL) {
+    return CATALOGUE_NONE;
+  }
+  if (!cJSON_IsString(item)) {
+    catalogue_cook_error(cc, "Expected a string for", item->string);
+    return CATALOGUE_NONE;
+  }
+
+  const char *str = item->valuestring;
+  if (str[0] == '@') {
+    bool found = false;
+    for (size_t i = 0; i < NUM_UI_STRING_KEYS && !found; i++) {
+      found = strcmp(ui_string_keys[i].key, &str[1]) == 0;
+    }
+    if (!found) {
+      catalogue_cook_error(cc, "Unknown string key", str);
+    }
+  }
+
+  const size_t len = strlen(str) + 1;
+  for (size_t offset = 0; offset < cc->strings.size; offset += strlen((char *)&cc->strings.data[offset]) + 1) {
+    if (strcmp((char *)&cc->strings.data[offset], str) == 0) {
+      return offset;
+    }
+  }
+  const uint32_t offset = cc->strings.size;
+  memcpy(save_buffer_push(&cc->strings, len), str, len);
+  return offset;
+}
+
+static double catalogue_cook_number(struct CatalogueCook *cc, const cJSON *obj, const char *key,
+                                    const double fallback) {
+  const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+  if (item == NULL) {
+    return fallback;
+  }
+  if (!cJSON_IsNumber(item)) {
+    catalogue_cook_error(cc, "Expected a number for", key);
+    return fallback;
+  }
+  return item->valuedouble;
+}
+
+// Looks up the string at key among the count strings of lut, returns -1 and
+// reports an error if it is not one of them
+static int32_t catalogue_cook_enum(struct CatalogueCook *cc, const cJSON *obj, const char *key,
+                                   const char *(*lut)(uint32_t), const uint32_t count,
+                                   const char *fallback) {
+  const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+  const char *str = cJSON_IsString(item) ? item->valuestring : fallback;
+  for (uint32_t i = 0; str && i < count; i++) {
+    if (strcmp(lut(i), str) == 0) {
+      return i;
+    }
+  }
+  fprintf(stderr, "[ColoniaC]: %s: Unknown %s '%s' \n", cc->filepath, key, str ? str : "");
+  cc->error = true;
+  return -1;
+}
+
+static const char *catalogue_tick_effect_str(const uint32_t i) { return tick_effect_registry[i].name_str; }
+static const char *catalogue_gui_str(const uint32_t i) { return catalogue_gui_strs[i]; }
+static const char *catalogue_capacity_str(const uint32_t i) { return lut_capacity_str(i); }
+static const char *catalogue_produce_str(const uint32_t i) { return lut_farm_produce_str(i); }
+
+static void catalogue_cook_range(struct CatalogueCook *cc, const cJSON *obj, const char *key,
+                                 float *range) {
+  const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+  if (!cJSON_IsArray(item) || cJSON_GetArraySize(item) != 2 ||
+      !cJSON_IsNumber(cJSON_GetArrayItem(item, 0)) || !cJSON_IsNumber(cJSON_GetArrayItem(item, 1))) {
+    catalogue_cook_error(cc, "Expected a [min, max] range for", key);
+    return;
+  }
+  range[0] = cJSON_GetArrayItem(item, 0)->valuedouble;
+  range[1] = cJSON_GetArrayItem(item, 1)->valuedouble;
+}
+
+static void catalogue_cook_effect(struct CatalogueCook *cc, const cJSON *json) {
+  struct CatalogueEffect *e = save_buffer_push(&cc->effects, sizeof(struct CatalogueEffect));
+  e->name = catalogue_cook_string(cc, cJSON_GetObjectItemCaseSensitive(json, "name"));
+  e->description = catalogue_cook_string(cc, cJSON_GetObjectItemCaseSensitive(json, "description"));
+  const cJSON *duration = cJSON_GetObjectItemCaseSensitive(json, "duration");
+  if (cJSON_IsString(duration) && strcmp(duration->valuestring, "forever") == 0) {
+    e->duration = FOREVER;
+  } else {
+    e->duration = catalogue_cook_number(cc, json, "duration", FOREVER);
+  }
+  const int32_t tick_effect = catalogue_cook_enum(cc, json, "tick_effect", catalogue_tick_effect_str,
+                                                  NUM_TICK_EFFECTS, NULL);
+  e->tick_effect = tick_effect < 0 ? TICK_EFFECT_NONE : tick_effect;
+  e->arg = CATALOGUE_NONE;
+
+  const enum EffectArgType type = tick_effect_registry[e->tick_effect].arg_type;
+  const cJSON *arg = cJSON_GetObjectItemCaseSensitive(json, "arg");
+  if (arg == NULL) {
+    if (type == EFFECT_ARG_FARM || type == EFFECT_ARG_FORUM || type == EFFECT_ARG_LAND_TAX) {
+      catalogue_cook_error(cc, "Missing the argument of the tick effect", tick_effect_registry[e->tick_effect].name_str);
+    }
+    return;
+  }
+
+  e->arg = cc->args.count;
+  struct CatalogueArg *a = save_buffer_push(&cc->args, sizeof(struct CatalogueArg));
+  a->type = type;
+  switch (type) {
+  case EFFECT_ARG_FARM: {
+    const int32_t produce = catalogue_cook_enum(cc, arg, "produce", catalogue_produce_str, NUMBER_OF_PRODUCE, NULL);
+    a->ints[0] = produce < 0 ? 0 : produce;
+    a->ints[1] = catalogue_cook_number(cc, arg, "area", 1);
+    catalogue_cook_range(cc, arg, "p0", &a->floats[0]);
+    catalogue_cook_range(cc, arg, "p1", &a->floats[2]);
     break;
-  case Diplomatic:
-    c1->diplomatic_usage += arg->cost;
+  }
+  case EFFECT_ARG_FORUM:
+    a->ints[0] = catalogue_cook_number(cc, arg, "taberna_capacity", 0);
     break;
-  case Military:
-    c1->military_usage += arg->cost;
+  case EFFECT_ARG_LAND_TAX:
+    a->floats[0] = catalogue_cook_number(cc, arg, "tax_percentage", 0.0);
     break;
+  default:
+    catalogue_cook_error(cc, "The tick effect takes no argument", tick_effect_registry[e->tick_effect].name_str);
   }
 }
 
-void bath_tick_effect(struct Effect *e, const struct City *c, struct City *c1) {
-  // TODO: Implement
+// Cooks the catalogue JSON at json_filepath into the blob at blob_filepath
+bool catalogue_cook(const char *json_filepath, const char *blob_filepath) {
+  assert(json_filepath); assert(blob_filepath);
+  struct CatalogueCook cc = {.filepath = json_filepath};
+  const int fd = open(json_filepath, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", json_filepath, strerror(errno));
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  char *text = (char *)calloc(st.st_size + 1, sizeof(char));
+  const bool read_all = read(fd, text, st.st_size) == (ssize_t)st.st_size;
+  close(fd);
+  cJSON *json = read_all ? cJSON_Parse(text) : NULL;
+  free(text);
+  if (json == NULL) {
+    fprintf(stderr, "[ColoniaC]: %s is not valid JSON \n", json_filepath);
+    return false;
+  }
+
+  const cJSON *item;
+  cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(json, "constructions")) {
+    const cJSON *effects = cJSON_GetObjectItemCaseSensitive(item, "effects");
+    struct CatalogueConstruction con = {
+        .name = catalogue_cook_string(&cc, cJSON_GetObjectItemCaseSensitive(item, "name")),
+        .description = catalogue_cook_string(&cc, cJSON_GetObjectItemCaseSensitive(item, "description")),
+        .help = catalogue_cook_string(&cc, cJSON_GetObjectItemCaseSensitive(item, "help")),
+        .cost = catalogue_cook_number(&cc, item, "cost", 0.0),
+        .maintenance = catalogue_cook_number(&cc, item, "maintenance", 0.0),
+        .construction_time = catalogue_cook_number(&cc, item, "construction_time", 0),
+        .effect = cc.effects.count,
+        .num_effects = cJSON_GetArraySize(effects),
+        .unique_effects = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "unique_effects")),
+        .built = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "built"))};
+    const int32_t gui = catalogue_cook_enum(&cc, item, "gui", catalogue_gui_str, NUM_CONSTRUCTION_GUIS, "none");
+    con.gui_construction_management = gui < 0 ? CONSTRUCTION_GUI_NONE : gui;
+    if (con.num_effects == 0) {
+      catalogue_cook_error(&cc, "No effects in the construction", cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "name")));
+    }
+    const cJSON *effect;
+    cJSON_ArrayForEach(effect, effects) {
+      catalogue_cook_effect(&cc, effect);
+    }
+    memcpy(save_buffer_push(&cc.constructions, sizeof(con)), &con, sizeof(con));
+  }
+
+  cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(json, "laws")) {
+    struct CatalogueLaw law = {
+        .name = catalogue_cook_string(&cc, cJSON_GetObjectItemCaseSensitive(item, "name")),
+        .description = catalogue_cook_string(&cc, cJSON_GetObjectItemCaseSensitive(item, "description")),
+        .help = catalogue_cook_string(&cc, cJSON_GetObjectItemCaseSensitive(item, "help")),
+        .cost = catalogue_cook_number(&cc, item, "cost", 0),
+        .cost_lng = catalogue_cook_number(&cc, item, "cost_length", 0),
+        .effect = cc.effects.count};
+    const int32_t type = catalogue_cook_enum(&cc, item, "type", catalogue_capacity_str, 3, NULL);
+    law.type = type < 0 ? Political : type;
+    catalogue_cook_effect(&cc, cJSON_GetObjectItemCaseSensitive(item, "effect"));
+    memcpy(save_buffer_push(&cc.laws, sizeof(law)), &law, sizeof(law));
+  }
+  cJSON_Delete(json);
+
+  struct CatalogueHeader header = {.magic = CATALOGUE_MAGIC,
+                                   .version = CATALOGUE_VERSION,
+                                   .num_effects = cc.effects.count,
+                                   .num_constructions = cc.constructions.count,
+                                   .num_laws = cc.laws.count,
+                                   .num_args = cc.args.count,
+                                   .strings_size = cc.strings.size};
+  const struct SaveBuffer *tables[] = {&cc.effects, &cc.constructions, &cc.laws, &cc.args, &cc.strings};
+  const size_t num_tables = sizeof(tables) / sizeof(tables[0]);
+  header.hash = 14695981039346656037ull;
+  for (size_t i = 0; i < num_tables; i++) {
+    header.hash = save_hash(header.hash, tables[i]->data, tables[i]->size);
+  }
+
+  bool success = !cc.error;
+  if (success) {
+    char *tmp_filepath = str_concat_new(blob_filepath, ".tmp");
+    FILE *file = fopen(tmp_filepath, "wb");
+    success = file && fwrite(&header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; success && i < num_tables; i++) {
+      success = tables[i]->size == 0 || fwrite(tables[i]->data, tables[i]->size, 1, file) == 1;
+    }
+    success = file && fclose(file) == 0 && success && rename(tmp_filepath, blob_filepath) == 0;
+    if (!success) {
+      fprintf(stderr, "[ColoniaC]: Failed to write %s: %s \n", blob_filepath, strerror(errno));
+    }
+    free(tmp_filepath);
+  }
+  for (size_t i = 0; i < num_tables; i++) {
+    free(tables[i]->data);
+  }
+  return success;
+}
+
+static bool catalogue_valid_string(const struct Catalogue *cat, const uint32_t offset) {
+  return offset == CATALOGUE_NONE || offset < cat->header->strings_size;
+}
+
+static bool catalogue_valid_effect(const struct Catalogue *cat, const uint32_t i) {
+  if (i >= cat->header->num_effects) {
+    return false;
+  }
+  const struct CatalogueEffect *e = &cat->effects[i];
+  return e->tick_effect < NUM_TICK_EFFECTS && catalogue_valid_string(cat, e->name) &&
+         catalogue_valid_string(cat, e->description) &&
+         (e->arg == CATALOGUE_NONE ||
+          (e->arg < cat->header->num_args &&
+           cat->args[e->arg].type == tick_effect_registry[e->tick_effect].arg_type &&
+           (cat->args[e->arg].type != EFFECT_ARG_FARM || cat->args[e->arg].ints[0] < NUMBER_OF_PRODUCE)));
+}
+
+// Views the catalogue blob of size bytes at data, returns false if it is not valid
+bool catalogue_view(struct Catalogue *cat, const uint8_t *data, const size_t size, const char *name) {
+  assert(cat); assert(data); assert(name);
+  memset(cat, 0, sizeof(struct Catalogue));
+  if (size < sizeof(struct CatalogueHeader)) {
+    fprintf(stderr, "[ColoniaC]: %s is not a catalogue of this version of the game \n", name);
+    return false;
+  }
+  cat->map = (uint8_t *)data;
+  cat->size = size;
+  const struct CatalogueHeader *h = (const struct CatalogueHeader *)cat->map;
+  cat->header = h;
+  size_t offset = sizeof(struct CatalogueHeader);
+  cat->effects = (const struct CatalogueEffect *)&cat->map[offset];
+  offset += (size_t)h->num_effects * sizeof(struct CatalogueEffect);
+  cat->constructions = (const struct CatalogueConstruction *)&cat->map[offset];
+  offset += (size_t)h->num_constructions * sizeof(struct CatalogueConstruction);
+  cat->laws = (const struct CatalogueLaw *)&cat->map[offset];
+  offset += (size_t)h->num_laws * sizeof(struct CatalogueLaw);
+  cat->args = (const struct CatalogueArg *)&cat->map[offset];
+  offset += (size_t)h->num_args * sizeof(struct CatalogueArg);
+  cat->strings = (const char *)&cat->map[offset];
+  offset += h->strings_size;
+
+  bool valid = memcmp(h->magic, CATALOGUE_MAGIC, sizeof(h->magic)) == 0 &&
+               h->version == CATALOGUE_VERSION && offset == cat->size &&
+               (h->strings_size == 0 || cat->strings[h->strings_size - 1] == '\0') &&
+               save_hash(14695981039346656037ull, &cat->map[sizeof(*h)], cat->size - sizeof(*h)) == h->hash;
+  for (uint32_t i = 0; valid && i < h->num_effects; i++) {
+    valid = catalogue_valid_effect(cat, i);
+  }
+  for (uint32_t i = 0; valid && i < h->num_constructions; i++) {
+    const struct CatalogueConstruction *con = &cat->constructions[i];
+    valid = con->num_effects > 0 && con->effect + con->num_effects <= h->num_effects &&
+            con->gui_construction_management < NUM_CONSTRUCTION_GUIS &&
+            catalogue_valid_string(cat, con->name) && catalogue_valid_string(cat, con->description) &&
+            catalogue_valid_string(cat, con->help);
+  }
+  for (uint32_t i = 0; valid && i < h->num_laws; i++) {
+    const struct CatalogueLaw *law = &cat->laws[i];
+    valid = law->effect < h->num_effects && law->type <= Diplomatic && law->gui_handler < NUM_LAW_GUIS &&
+            catalogue_valid_string(cat, law->name) && catalogue_valid_string(cat, law->description) &&
+            catalogue_valid_string(cat, law->help);
+  }
+  if (!valid) {
+    fprintf(stderr, "[ColoniaC]: %s is not a catalogue of this version of the game \n", name);
+    memset(cat, 0, sizeof(struct Catalogue));
+  }
+  return valid;
+}
+
+// Maps the cooked catalogue at filepath, returns false if it is not valid
+bool catalogue_open(struct Catalogue *cat, const char *filepath) {
+  assert(cat); assert(filepath);
+  memset(cat, 0, sizeof(struct Catalogue));
+  const int fd = open(filepath, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct CatalogueHeader)) {
+    fprintf(stderr, "[ColoniaC]: Failed to open the catalogue %s \n", filepath);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "[ColoniaC]: Failed to map %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
+  if (!catalogue_view(cat, (const uint8_t *)map, st.st_size, filepath)) {
+    munmap(map, st.st_size);
+    return false;
+  }
+  return true;
+}
+
+// Uses the catalogue name.bin embedded in the executable or cooks name.json in
+// folder if its blob is missing or older and maps the blob, returns false if
+// neither is usable
+bool catalogue_load(struct Catalogue *cat, const char *folder, const char *name) {
+  assert(cat); assert(folder); assert(name);
+  char *blob_name = str_concat_new(name, ".bin");
+  const struct EmbeddedAsset *asset = asset_embedded(blob_name);
+  free(blob_name);
+  if (asset) {
+    cat->embedded = catalogue_view(cat, asset->data, asset->size, asset->name);
+    return cat->embedded;
+  }
+  char *filepath = str_concat_new(folder, name);
+  char *json_filepath = str_concat_new(filepath, ".json");
+  char *blob_filepath = str_concat_new(filepath, ".bin");
+  struct stat json_st;
+  struct stat blob_st;
+  bool success = true;
+  if (stat(json_filepath, &json_st) == 0 &&
+      (stat(blob_filepath, &blob_st) != 0 || json_st.st_mtime >= blob_st.st_mtime)) {
+    const double t0 = time_now_ms();
+    success = catalogue_cook(json_filepath, blob_filepath);
+    printf("[ColoniaC]: Cooked %s in %.2f ms \n", json_filepath, time_now_ms() - t0);
+  }
+  success = success && catalogue_open(cat, blob_filepath);
+  free(blob_filepath);
+  free(json_filepath);
+  free(filepath);
+  return success;
+}
+
+// Resolves a string of the catalogue, keys to the string of the current language
+static const char *catalogue_str(const struct Catalogue *cat, const uint32_t offset) {
+  if (offset == CATALOGUE_NONE) {
+    return NULL;
+  }
+  const char *str = &cat->strings[offset];
+  if (str[0] == '@') {
+    for (size_t i = 0; i < NUM_UI_STRING_KEYS; i++) {
+      if (strcmp(ui_string_keys[i].key, &str[1]) == 0) {
+        return ui_string_keys[i].strs[CONFIG.LANGUAGE];
+      }
+    }
+    return ""; // Key removed from this version of the game
+  }
+  return str;
+}
+
+// Offset of the string equal to str in the string table of the catalogue
+// played, keys match the string they resolve to. CATALOGUE_NONE if not found.
+static uint32_t catalogue_find_str(const char *str) {
+  const struct Catalogue *cat = &catalogue;
+  if (str == NULL || cat->header == NULL) {
+    return CATALOGUE_NONE;
+  }
+  const uint32_t size = cat->header->strings_size;
+  if (str >= cat->strings && str < cat->strings + size) {
+    return str - cat->strings;
+  }
+  for (uint32_t offset = 0; offset < size; offset += strlen(&cat->strings[offset]) + 1) {
+    if (strcmp(catalogue_str(cat, offset), str) == 0) {
+      return offset;
+    }
+  }
+  return CATALOGUE_NONE;
+}
+
+// String of a catalogue_find_str offset in the current language, "?" if the
+// offset is not the start of a string of the catalogue played
+static const char *catalogue_event_str(const uint32_t offset) {
+  const struct Catalogue *cat = &catalogue;
+  if (cat->header == NULL || offset >= cat->header->strings_size ||
+      (offset > 0 && cat->strings[offset - 1] != '\0')) {
+    return "?";
+  }
+  return catalogue_str(cat, offset);
+}
+
+static struct Effect catalogue_effect(const struct Catalogue *cat, const uint32_t *components,
+                                      const uint32_t i) {
+  const struct CatalogueEffect *e = &cat->effects[i];
+  return (struct Effect){.name_str = (char *)catalogue_str(cat, e->name),
+                         .description_str = (char *)catalogue_str(cat, e->description),
+                         .duration = e->duration,
+                         .tick_effect = e->tick_effect,
+                         .component = e->arg == CATALOGUE_NONE ? COMPONENT_NONE : components[e->arg]};
+}
+
+// Adds the construction projects, standing constructions and laws of the
+// catalogue to c, strings point into the catalogue which must stay open
+void catalogue_instantiate(const struct Catalogue *cat, struct City *c) {
+  assert(cat && cat->header); assert(c);
+  const struct CatalogueHeader *h = cat->header;
+
+  // Arguments are created up front in catalogue order, randomised parameters
+  // draw from the game RNG
+  uint32_t *components = (uint32_t *)calloc(h->num_args + 1, sizeof(uint32_t));
+  for (uint32_t i = 0; i < h->num_args; i++) {
+    const struct CatalogueArg *a = &cat->args[i];
+    struct ComponentPool *pool = components_pool(c->components, a->type);
+    assert(pool && "Catalogue argument is not a component");
+    components[i] = component_new(pool);
+    switch ((enum EffectArgType)a->type) {
+    case EFFECT_ARG_FARM: {
+      const float p0 = a->floats[0] + (a->floats[1] - a->floats[0]) * uniform_random();
+      const float p1 = a->floats[2] + (a->floats[3] - a->floats[2]) * uniform_random();
+      const struct FarmArgument farm = {.produce = a->ints[0], .area = a->ints[1], .p0 = p0, .p1 = p1,
+                                        .construction = COMPONENT_NONE};
+      memcpy(farm_component(c, components[i]), &farm, sizeof(farm)); // NOTE: FarmArgument has const members
+      break;
+    }
+    case EFFECT_ARG_FORUM:
+      forum_component(c, components[i])->taberna_capacity = a->ints[0];
+      forum_component(c, components[i])->tabernas = COMPONENT_NONE;
+      break;
+    case EFFECT_ARG_LAND_TAX:
+      land_tax_component(c, components[i])->tax_percentage = a->floats[0];
+      break;
+    default:
+      assert(false && "Unreachable");
+    }
+  }
+
+  for (uint32_t i = 0; i < h->num_constructions; i++) {
+    const struct CatalogueConstruction *cc = &cat->constructions[i];
+    struct Effect *effects = (struct Effect *)calloc(cc->num_effects, sizeof(struct Effect));
+    for (uint32_t j = 0; j < cc->num_effects; j++) {
+      effects[j] = catalogue_effect(cat, components, cc->effect + j);
+    }
+    const struct Construction con = {.name_str = catalogue_str(cat, cc->name),
+                                     .description_str = catalogue_str(cat, cc->description),
+                                     .help_str = catalogue_str(cat, cc->help),
+                                     .cost = cc->cost,
+                                     .maintenance = cc->maintenance,
+                                     .construction_time = cc->construction_time,
+                                     .unique_effects = cc->unique_effects,
+                                     .effect = effects,
+                                     .num_effects = cc->num_effects,
+                                     .gui_construction_management = cc->gui_construction_management};
+    if (cc->built) {
+      // Standing constructions have their own instances of the project's effects
+      struct Construction built = con;
+      built.effect = (struct Effect *)calloc(cc->num_effects, sizeof(struct Effect));
+      for (uint32_t j = 0; j < cc->num_effects; j++) {
+        built.effect[j] = effect_instance(c, &effects[j], c->num_constructions);
+      }
+      city_add_construction(c, built);
+    }
+    city_add_construction_project(c, con);
+  }
+
+  for (uint32_t i = 0; i < h->num_laws; i++) {
+    const struct CatalogueLaw *cl = &cat->laws[i];
+    struct Effect *effect = (struct Effect *)malloc(sizeof(struct Effect));
+    *effect = catalogue_effect(cat, components, cl->effect);
+    const struct Law law = {.name_str = (char *)catalogue_str(cat, cl->name),
+                            .description_str = (char *)catalogue_str(cat, cl->description),
+                            .help_str = (char *)catalogue_str(cat, cl->help),
+                            .type = cl->type,
+                            .cost = cl->cost,
+                            .cost_lng = cl->cost_lng,
+                            .gui_handler = cl->gui_handler,
+                            .effect = effect};
+    city_add_law(c, law);
+  }
+  free(components);
+}
+
+void catalogue_close(struct Catalogue *cat) {
+  assert(cat);
+  if (cat->map && !cat->embedded) {
+    munmap(cat->map, cat->size);
+  }
+  memset(cat, 0, sizeof(struct Catalogue));
+}
+
+/***** icon atlas *****/
+// All icons of resources/icons/ are decoded and packed into rows of a single
+// RGBA image, cooked into a blob with a table of where each icon is. The GUI
+// uploads the image together with the baked font as one texture so that text
+// and icons are drawn in the same batch.
+#define ATLAS_MAGIC "RTSA"
+#define ATLAS_VERSION 1
+#define ATLAS_DEFAULT_NAME "icons"
+#define ATLAS_MAX_WIDTH 1024 // Icons wrap into a new row beyond this width
+#define ATLAS_MAX_HEIGHT 4096
+#define ATLAS_PADDING 1      // Transparent border that keeps filtering from bleeding between icons
+#define ATLAS_NAME_LENGTH 32
+
+// Blob layout: AtlasHeader, icons and the width * height RGBA pixels
+struct AtlasHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t hash; // FNV-1a of everything after the header
+  uint32_t width;
+  uint32_t height;
+  uint32_t num_icons;
+  uint32_t pad;
+};
+
+struct AtlasIcon {
+  char name[ATLAS_NAME_LENGTH]; // File name without the extension
+  uint16_t x, y, w, h;          // Rectangle in the image
+};
+
+// View of a mmapped or embedded atlas blob
+struct Atlas {
+  uint8_t *map;
+  size_t size;
+  bool embedded; // map is in the executable rather than mmapped
+  const struct AtlasHeader *header;
+  const struct AtlasIcon *icons;
+  const uint8_t *pixels;
+};
+
+struct AtlasCookImage {
+  struct AtlasIcon icon;
+  uint8_t *pixels;
+};
+
+static int atlas_cook_image_cmp(const void *lhs, const void *rhs) {
+  const struct AtlasIcon *l = &((const struct AtlasCookImage *)lhs)->icon;
+  const struct AtlasIcon *r = &((const struct AtlasCookImage *)rhs)->icon;
+  if (l->h != r->h) {
+    return l->h > r->h ? -1 : 1; // Tallest first packs the rows tighter
+  }
+  return strcmp(l->name, r->name);
+}
+
+// Packs every PNG of icons_folder into the atlas blob at blob_filepath
+bool atlas_cook(const char *icons_folder, const char *blob_filepath) {
+  assert(icons_folder); assert(blob_filepath);
+  DIR *dir = opendir(icons_folder);
+  if (dir == NULL) {
+    fprintf(stderr, "[ColoniaC]: Failed to open %s: %s \n", icons_folder, strerror(errno));
+    return false;
+  }
+  struct SaveBuffer images = {0};
+  bool success = true;
+  const struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const size_t lng = strlen(entry->d_name);
+    if (lng <= 4 || strcmp(&entry->d_name[lng - 4], ".png") != 0) {
+      continue;
+    }
+    char *folder = str_concat_new(icons_folder, "/");
+    char *filepath = str_concat_new(folder, entry->d_name);
+    struct AtlasCookImage img = {0};
+    int w = 0, h = 0, n = 0;
+    img.pixels = stbi_load(filepath, &w, &h, &n, 4);
+    if (img.pixels == NULL || lng - 4 >= ATLAS_NAME_LENGTH || w + 2 * ATLAS_PADDING > ATLAS_MAX_WIDTH ||
+        h + 2 * ATLAS_PADDING > ATLAS_MAX_HEIGHT) {
+      fprintf(stderr, "[ColoniaC]: %s is not a usable icon \n", filepath);
+      stbi_image_free(img.pixels);
+      success = false;
+    } else {
+      memcpy(img.icon.name, entry->d_name, lng - 4);
+      img.icon.w = w;
+      img.icon.h = h;
+      memcpy(save_buffer_push(&images, sizeof(img)), &img, sizeof(img));
+    }
+    free(filepath);
+    free(folder);
+  }
+  closedir(dir);
+
+  // Shelf packing, icons are placed left to right in rows as tall as their tallest icon
+  struct AtlasCookImage *imgs = (struct AtlasCookImage *)images.data;
+  qsort(imgs, images.count, sizeof(struct AtlasCookImage), atlas_cook_image_cmp);
+  uint32_t x = 0, y = 0, row_height = 0, width = 0;
+  for (uint32_t i = 0; i < images.count; i++) {
+    struct AtlasIcon *icon = &imgs[i].icon;
+    if (x + icon->w + 2 * ATLAS_PADDING > ATLAS_MAX_WIDTH) {
+      x = 0;
+      y += row_height;
+      row_height = 0;
+    }
+    icon->x = x + ATLAS_PADDING;
+    icon->y = y + ATLAS_PADDING;
+    x += icon->w + 2 * ATLAS_PADDING;
+    if (icon->h + 2 * ATLAS_PADDING > row_height) {
+      row_height = icon->h + 2 * ATLAS_PADDING;
+    }
+    if (x > width) {
+      width = x;
+    }
+  }
+  const uint32_t height = y + row_height;
+  if (height > ATLAS_MAX_HEIGHT) {
+    fprintf(stderr, "[ColoniaC]: The icons of %s do not fit into one atlas \n", icons_folder);
+    success = false;
+  }
+
+  struct SaveBuffer icons = {0};
+  uint8_t *pixels = NULL;
+  struct AtlasHeader header = {.magic = ATLAS_MAGIC, .version = ATLAS_VERSION, .num_icons = images.count};
+  if (success) {
+    header.width = width;
+    header.height = height;
+    pixels = (uint8_t *)calloc((size_t)width * height * 4, sizeof(uint8_t));
+    for (uint32_t i = 0; i < images.count; i++) {
+      const struct AtlasIcon *icon = &imgs[i].icon;
+      for (uint32_t row = 0; row < icon->h; row++) {
+        memcpy(&pixels[((size_t)(icon->y + row) * width + icon->x) * 4],
+               &imgs[i].pixels[(size_t)row * icon->w * 4], (size_t)icon->w * 4);
+      }
+      memcpy(save_buffer_push(&icons, sizeof(struct AtlasIcon)), icon, sizeof(struct AtlasIcon));
+    }
+    header.hash = save_hash(14695981039346656037ull, icons.data, icons.size);
+    header.hash = save_hash(header.hash, pixels, (size_t)width * height * 4);
+
+    char *tmp_filepath = str_concat_new(blob_filepath, ".tmp");
+    FILE *file = fopen(tmp_filepath, "wb");
+    success = file && fwrite(&header, sizeof(header), 1, file) == 1 &&
+              (icons.size == 0 || fwrite(icons.data, icons.size, 1, file) == 1) &&
+              (width * height == 0 || fwrite(pixels, (size_t)width * height * 4, 1, file) == 1);
+    success = file && fclose(file) == 0 && success && rename(tmp_filepath, blob_filepath) == 0;
+    if (!success) {
+      fprintf(stderr, "[ColoniaC]: Failed to write %s: %s \n", blob_filepath, strerror(errno));
+    }
+    free(tmp_filepath);
+  }
+  for (uint32_t i = 0; i < images.count; i++) {
+    stbi_image_free(imgs[i].pixels);
+  }
+  free(images.data);
+  free(icons.data);
+  free(pixels);
+  return success;
+}
+
+// Views the atlas blob of size bytes at data, returns false if it is not valid
+bool atlas_view(struct Atlas *atlas, const uint8_t *data, const size_t size, const char *name) {
+  assert(atlas); assert(data); assert(name);
+  memset(atlas, 0, sizeof(struct Atlas));
+  if (size < sizeof(struct AtlasHeader)) {
+    fprintf(stderr, "[ColoniaC]: %s is not an icon atlas of this version of the game \n", name);
+    return false;
+  }
+  atlas->map = (uint8_t *)data;
+  atlas->size = size;
+  const struct AtlasHeader *h = (const struct AtlasHeader *)atlas->map;
+  atlas->header = h;
+  size_t offset = sizeof(struct AtlasHeader);
+  atlas->icons = (const struct AtlasIcon *)&atlas->map[offset];
+  offset += (size_t)h->num_icons * sizeof(struct AtlasIcon);
+  atlas->pixels = &atlas->map[offset];
+  offset += (size_t)h->width * h->height * 4;
+
+  bool valid = memcmp(h->magic, ATLAS_MAGIC, sizeof(h->magic)) == 0 && h->version == ATLAS_VERSION &&
+               h->width <= ATLAS_MAX_WIDTH && h->height <= ATLAS_MAX_HEIGHT && offset == atlas->size &&
+               save_hash(14695981039346656037ull, &atlas->map[sizeof(*h)], atlas->size - sizeof(*h)) == h->hash;
+  for (uint32_t i = 0; valid && i < h->num_icons; i++) {
+    const struct AtlasIcon *icon = &atlas->icons[i];
+    valid = memchr(icon->name, '\0', ATLAS_NAME_LENGTH) != NULL && icon->x + icon->w <= h->width &&
+            icon->y + icon->h <= h->height;
+  }
+  if (!valid) {
+    fprintf(stderr, "[ColoniaC]: %s is not an icon atlas of this version of the game \n", name);
+    memset(atlas, 0, sizeof(struct Atlas));
+  }
+  return valid;
+}
+
+// Maps the cooked atlas at filepath, returns false if it is not valid
+bool atlas_open(struct Atlas *atlas, const char *filepath) {
+  assert(atlas); assert(filepath);
+  memset(atlas, 0, sizeof(struct Atlas));
+  const int fd = open(filepath, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct AtlasHeader)) {
+    fprintf(stderr, "[ColoniaC]: Failed to open the icon atlas %s \n", filepath);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "[ColoniaC]: Failed to map %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
+  if (!atlas_view(atlas, (const uint8_t *)map, st.st_size, filepath)) {
+    munmap(map, st.st_size);
+    return false;
+  }
+  return true;
+}
+
+// True if any PNG in icons_folder is newer than the blob modified at mtime
+static bool atlas_stale(const char *icons_folder, const time_t mtime) {
+  DIR *dir = opendir(icons_folder);
+  if (dir == NULL) {
+    return false; // Only the cooked atlas is shipped
+  }
+  bool stale = false;
+  char *folder = str_concat_new(icons_folder, "/");
+  const struct dirent *entry;
+  while (!stale && (entry = readdir(dir)) != NULL) {
+    const size_t lng = strlen(entry->d_name);
+    char *filepath = str_concat_new(folder, entry->d_name);
+    struct stat st;
+    stale = lng > 4 && strcmp(&entry->d_name[lng - 4], ".png") == 0 && stat(filepath, &st) == 0 &&
+            st.st_mtime >= mtime;
+    free(filepath);
+  }
+  free(folder);
+  closedir(dir);
+  return stale;
+}
+
+// Uses the atlas name.bin embedded in the executable or cooks the icons of the
+// name folder in folder if its blob is missing or older and maps the blob,
+// returns false if neither is usable
+bool atlas_load(struct Atlas *atlas, const char *folder, const char *name) {
+  assert(atlas); assert(folder); assert(name);
+  char *blob_name = str_concat_new(name, ".bin");
+  const struct EmbeddedAsset *asset = asset_embedded(blob_name);
+  free(blob_name);
+  if (asset) {
+    atlas->embedded = atlas_view(atlas, asset->data, asset->size, asset->name);
+    return atlas->embedded;
+  }
+  char *icons_folder = str_concat_new(folder, name);
+  char *blob_filepath = str_concat_new(icons_folder, ".bin");
+  struct stat icons_st;
+  struct stat blob_st;
+  bool success = true;
+  if (stat(icons_folder, &icons_st) == 0 &&
+      (stat(blob_filepath, &blob_st) != 0 || icons_st.st_mtime >= blob_st.st_mtime ||
+       atlas_stale(icons_folder, blob_st.st_mtime))) {
+    const double t0 = time_now_ms();
+    success = atlas_cook(icons_folder, blob_filepath);
+    printf("[ColoniaC]: Cooked %s in %.2f ms \n", icons_folder, time_now_ms() - t0);
+  }
+  success = success && atlas_open(atlas, blob_filepath);
+  free(blob_filepath);
+  free(icons_folder);
+  return success;
+}
+
+// Returns the icon called name, NULL if there is none
+const struct AtlasIcon *atlas_icon(const struct Atlas *atlas, const char *name) {
+  assert(atlas); assert(name);
+  for (uint32_t i = 0; i < atlas->header->num_icons; i++) {
+    if (strncmp(atlas->icons[i].name, name, ATLAS_NAME_LENGTH) == 0) {
+      return &atlas->icons[i];
+    }
+  }
+  return NULL;
+}
+
+void atlas_close(struct Atlas *atlas) {
+  assert(atlas);
+  if (atlas->map && !atlas->embedded) {
+    munmap(atlas->map, atlas->size);
+  }
+  memset(atlas, 0, sizeof(struct Atlas));
+}
+
+/***** font cache *****/
+// Rasterising the TTF font is the bulk of the GUI startup. The baked pixels
+// and glyphs are kept in the save folder and restored on later launches as
+// long as the font file, its size and glyph ranges are unchanged.
+#define FONT_CACHE_MAGIC "RTSG"
+#define FONT_CACHE_VERSION 1
+#define FONT_CACHE_NAME "font.cache"
+
+// File layout: FontCacheHeader, fonts, cursors, glyphs and the alpha8 pixels.
+// Fonts, cursors and glyphs are stored as the raw Nuklear structs.
+struct FontCacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;  // font_cache_key of the fonts baked
+  uint64_t hash; // FNV-1a of everything after the header
+  int32_t width;
+  int32_t height;
+  int32_t glyph_count;
+  int32_t font_count;
+  struct nk_recti custom;
+};
+
+// Identifies a bake, changes with the TTF files and everything in their configs
+// that affects rasterisation
+static uint64_t font_cache_key(const struct nk_font_atlas *atlas) {
+  assert(atlas);
+  const size_t sizes[] = {sizeof(struct nk_baked_font), sizeof(struct nk_cursor), sizeof(struct nk_font_glyph)};
+  uint64_t hash = save_hash(14695981039346656037ull, sizes, sizeof(sizes));
+  for (const struct nk_font_config *cfg = atlas->config; cfg; cfg = cfg->next) {
+    const struct nk_font_config *it = cfg;
+    do {
+      size_t num_ranges = 0;
+      while (it->range[num_ranges] != 0) {
+        num_ranges++;
+      }
+      hash = save_hash(hash, it->ttf_blob, it->ttf_size);
+      hash = save_hash(hash, it->range, num_ranges * sizeof(nk_rune));
+      hash = save_hash(hash, &it->size, sizeof(it->size));
+      hash = save_hash(hash, &it->merge_mode, sizeof(it->merge_mode));
+      hash = save_hash(hash, &it->pixel_snap, sizeof(it->pixel_snap));
+      hash = save_hash(hash, &it->oversample_v, sizeof(it->oversample_v));
+      hash = save_hash(hash, &it->oversample_h, sizeof(it->oversample_h));
+      hash = save_hash(hash, &it->coord_type, sizeof(it->coord_type));
+      hash = save_hash(hash, &it->spacing, sizeof(it->spacing));
+      hash = save_hash(hash, &it->fallback_glyph, sizeof(it->fallback_glyph));
+    } while ((it = it->n) != cfg);
+  }
+  return hash;
+}
+
+// Restores the bake cached at filepath if it was made for key, returns false
+// if there is none and the fonts must be baked
+bool font_cache_restore(const char *filepath, const uint64_t key) {
+  assert(filepath);
+  const int fd = open(filepath, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct FontCacheHeader)) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  const uint8_t *bytes = (const uint8_t *)map;
+  const size_t size = st.st_size;
+  const struct FontCacheHeader *h = (const struct FontCacheHeader *)bytes;
+  struct nk_sdl_font_bake bake = {.width = h->width,
+                                  .height = h->height,
+                                  .glyph_count = h->glyph_count,
+                                  .font_count = h->font_count,
+                                  .custom = h->custom};
+  bool valid = memcmp(h->magic, FONT_CACHE_MAGIC, sizeof(h->magic)) == 0 && h->version == FONT_CACHE_VERSION &&
+               h->key == key && h->width > 0 && h->height > 0 && h->glyph_count > 0 && h->font_count > 0 &&
+               h->font_count <= NK_SDL_MAX_FONTS;
+  size_t offset = sizeof(struct FontCacheHeader);
+  if (valid) {
+    const size_t fonts_size = (size_t)h->font_count * sizeof(struct nk_baked_font);
+    const size_t glyphs_size = (size_t)h->glyph_count * sizeof(struct nk_font_glyph);
+    valid = offset + fonts_size + sizeof(bake.cursors) + glyphs_size + (size_t)h->width * h->height == size &&
+            save_hash(14695981039346656037ull, &bytes[sizeof(*h)], size - sizeof(*h)) == h->hash;
+    if (valid) {
+      memcpy(bake.fonts, &bytes[offset], fonts_size);
+      offset += fonts_size;
+      memcpy(bake.cursors, &bytes[offset], sizeof(bake.cursors));
+      offset += sizeof(bake.cursors);
+      bake.glyphs = (const struct nk_font_glyph *)&bytes[offset];
+      offset += glyphs_size;
+      bake.pixels = &bytes[offset];
+    }
+  }
+  valid = valid && nk_sdl_font_stash_restore(&bake);
+  if (!valid) {
+    fprintf(stderr, "[ColoniaC]: Ignoring the outdated font cache %s \n", filepath);
+  }
+  munmap(map, size);
+  return valid;
 }
 
-void imperator_demands_money_callback(const struct Popup *p,
-                                      const struct City *c, struct City *c1) {
-  switch (p->choice_choosen) {
-  case 0:
-    c1->gold_usage += 50.0f;
-    break;
-  case 1:
-    c1->population -= 50;
-    break;
+// Writes the bake of the fonts identified by key to the cache at filepath
+bool font_cache_write(const char *filepath, const uint64_t key, const struct nk_sdl_font_bake *bake) {
+  assert(filepath); assert(bake);
+  struct FontCacheHeader header = {.magic = FONT_CACHE_MAGIC,
+                                   .version = FONT_CACHE_VERSION,
+                                   .key = key,
+                                   .width = bake->width,
+                                   .height = bake->height,
+                                   .glyph_count = bake->glyph_count,
+                                   .font_count = bake->font_count,
+                                   .custom = bake->custom};
+  const struct iovec parts[] = {
+      {(void *)bake->fonts, (size_t)bake->font_count * sizeof(struct nk_baked_font)},
+      {(void *)bake->cursors, sizeof(bake->cursors)},
+      {(void *)bake->glyphs, (size_t)bake->glyph_count * sizeof(struct nk_font_glyph)},
+      {(void *)bake->pixels, (size_t)bake->width * bake->height}};
+  const size_t num_parts = sizeof(parts) / sizeof(parts[0]);
+  header.hash = 14695981039346656037ull;
+  for (size_t i = 0; i < num_parts; i++) {
+    header.hash = save_hash(header.hash, parts[i].iov_base, parts[i].iov_len);
+  }
+
+  char *tmp_filepath = str_concat_new(filepath, ".tmp");
+  FILE *file = fopen(tmp_filepath, "wb");
+  bool success = file && fwrite(&header, sizeof(header), 1, file) == 1;
+  for (size_t i = 0; success && i < num_parts; i++) {
+    success = fwrite(parts[i].iov_base, parts[i].iov_len, 1, file) == 1;
   }
+  success = file && fclose(file) == 0 && success && rename(tmp_filepath, filepath) == 0;
+  if (!success) {
+    fprintf(stderr, "[ColoniaC]: Failed to write %s: %s \n", filepath, strerror(errno));
+  }
+  free(tmp_filepath);
+  return success;
 }
 
-void imperator_demands_money(struct Effect *e, const struct City *c,
-                             struct City *c1) {
-  if (uniform_random() < 0.95f) {
+/***** asset loading *****/
+// Assets that do not need the GL context are loaded on worker threads while
+// the main thread creates the window and context, leaving only the texture
+// upload to the main thread. The time of each startup stage is logged once
+// the first frame is drawn.
+#define STARTUP_MAX_STAGES 16
+
+static struct {
+  uint32_t num_stages;
+  const char *names[STARTUP_MAX_STAGES];
+  double ms[STARTUP_MAX_STAGES];
+  bool worker[STARTUP_MAX_STAGES]; // Overlapped with the main thread
+  double start;                     // time_now_ms at the start of main
+} startup;
+
+// Records a stage of the startup, main thread only
+void startup_log(const char *name, const double ms, const bool worker) {
+  if (startup.num_stages == STARTUP_MAX_STAGES) {
     return;
   }
-  struct Popup popup;
-  popup.choice_choosen = -1;
-  popup.title = "War effort in the East requires resources ...";
-  popup.description =
-      "Pompey Magnus has sent envoys from the far East. The "
-      "war effort against "
-      "the Seleucid Empire in the East needs resources. Whether or not these "
-      "conquests will be ratified by the Senate is still an open question ..";
-  popup.num_choices = 2;
-  popup.choices = (char **)calloc(2, sizeof(char *));
-  popup.hover_txts = (char **)calloc(2, sizeof(char *));
-  static char *choices[2] = {"Send a wagon of gold!",
-                             "Send Pompey the finest Legionnaires!"};
-  static char *hover_txts[2] = {"-50.0 gold", "-50 population"};
-  popup.choices = choices;
-  popup.hover_txts = hover_txts;
-  popup.callback = imperator_demands_money_callback;
-  city_add_popup(c1, popup);
+  startup.names[startup.num_stages] = name;
+  startup.ms[startup.num_stages] = ms;
+  startup.worker[startup.num_stages++] = worker;
 }
 
-void building_tick_effect(struct Effect *e, const struct City *c,
-                          struct City *c1) {
-  struct Construction *arg = (struct Construction *)e->arg;
-
-  if (!arg->construction_in_progress) {
-    e->duration++;
+// Prints the breakdown of the startup, once
+void startup_print(void) {
+  if (startup.num_stages == 0) {
     return;
   }
+  printf("[ColoniaC]: First frame after %.2f ms \n", time_now_ms() - startup.start);
+  for (uint32_t i = 0; i < startup.num_stages; i++) {
+    printf("[ColoniaC]:   %-10s %8.2f ms%s \n", startup.names[i], startup.ms[i], startup.worker[i] ? " (worker)" : "");
+  }
+  startup.num_stages = 0;
+}
 
-  c1->gold_usage += arg->construction_cost;
+struct AssetJob {
+  const char *name;
+  bool (*load)(void *data);
+  void *data;
+  SDL_Thread *thread;
+  double ms; // Spent loading on the worker
+  bool success;
+};
 
-  const int lng = snprintf(NULL, 0, "%li days left, - %.2f gold / day",
-                           e->duration, arg->construction_cost) +
-                  1;
-  snprintf(e->description_str, lng, "%li days left, - %.2f gold / day",
-           e->duration, arg->construction_cost);
+static int asset_job_thread(void *data) {
+  struct AssetJob *job = (struct AssetJob *)data;
+  const double t0 = time_now_ms();
+  job->success = job->load(job->data);
+  job->ms = time_now_ms() - t0;
+  return 0;
+}
 
-  // TODO: Delay risk per construction and the political environment
-  if (uniform_random() < arg->construction_delay_risk) {
-    e->duration++;
-    return;
+// Starts load(data) on a worker thread, it runs at once if there is none
+void asset_job_start(struct AssetJob *job, const char *name, bool (*load)(void *data), void *data) {
+  assert(job); assert(name); assert(load);
+  memset(job, 0, sizeof(struct AssetJob));
+  job->name = name;
+  job->load = load;
+  job->data = data;
+  job->thread = SDL_CreateThread(asset_job_thread, name, job);
+  if (job->thread == NULL) {
+    asset_job_thread(job);
   }
+}
 
-  if (e->duration == 1) {
-    arg->maintained = true;
-    arg->construction_finished = true;
-    arg->construction_completed = date;
-    arg->construction_in_progress = false;
+// Waits for the job to finish, returns whether it succeeded
+bool asset_job_wait(struct AssetJob *job) {
+  assert(job);
+  if (job->thread) {
+    SDL_WaitThread(job->thread, NULL);
+    job->thread = NULL;
+  }
+  startup_log(job->name, job->ms, true);
+  return job->success;
+}
 
-    eventlog_add_msgf(c1->log, "Finished construction of a %s",
-                      arg->effect->name_str);
+/***** state hash *****/
+// 64-bit hash of all simulation relevant state, built incrementally field by
+// field straight from the City without serialising it. Each field keeps its
+// own hash so that a divergence can be pinned to the field it started in.
+// NOTE: Floats are hashed by their bits, equivalent means bit-identical
 
-    free(e->name_str);
-    e->name_str = NULL;
-    free(e->description_str);
-    e->description_str = NULL;
+static inline uint64_t state_hash_mix(const uint64_t h, const uint64_t v) {
+  return (((h << 5) | (h >> 59)) ^ v) * 0x9E3779B97F4A7C15ull;
+}
+
+static inline uint64_t state_hash_f32(const uint64_t h, const float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return state_hash_mix(h, bits);
+}
+
+static uint64_t state_hash_str(uint64_t h, const char *str) {
+  if (str == NULL) {
+    return state_hash_mix(h, SAVE_NONE);
   }
+  const size_t len = strlen(str);
+  h = state_hash_mix(h, len);
+  for (size_t i = 0; i < len; i += sizeof(uint64_t)) {
+    uint64_t v = 0;
+    memcpy(&v, &str[i], len - i < sizeof(v) ? len - i : sizeof(v));
+    h = state_hash_mix(h, v);
+  }
+  return h;
 }
 
-/// Returns true if the law was successfully enacted
-bool city_enact_law(struct City *c, struct Law *l) {
-  switch (l->type) {
-  case Political:
-    if (c->political_usage + l->cost > c->political_capacity) {
-      return false;
-    }
+static inline uint64_t state_hash_date(const uint64_t h, const struct Date d) {
+  return state_hash_mix(h, ((uint64_t)(uint32_t)d.year << 32) | (d.month << 8) | d.day);
+}
+
+static uint64_t state_hash_effect(uint64_t h, const struct City *c, const struct Effect *e) {
+  h = state_hash_mix(h, ((uint64_t)e->tick_effect << 1) | e->scheduled_for_removal);
+  h = state_hash_mix(h, (uint64_t)e->duration);
+  h = state_hash_str(h, e->name_str);
+  h = state_hash_str(h, e->description_str);
+  const enum EffectArgType type = tick_effect_registry[e->tick_effect].arg_type;
+  const bool by_handle = components_pool(c->components, type) || type == EFFECT_ARG_CONSTRUCTION;
+  if (by_handle ? e->component == COMPONENT_NONE : e->arg == NULL) {
+    return state_hash_mix(h, SAVE_NONE);
+  }
+
+  // Pointers are hashed as indices into the City, components by their content
+  switch (type) {
+  case EFFECT_ARG_NONE:
+  case NUM_EFFECT_ARG_TYPES:
     break;
-  case Diplomatic:
-    if (c->diplomatic_usage + l->cost > c->diplomatic_capacity) {
-      return false;
-    }
+  case EFFECT_ARG_FARM: {
+    const struct FarmArgument *farm = farm_component(c, e->component);
+    h = state_hash_mix(h, ((uint64_t)farm->area << 8) | farm->produce);
+    h = state_hash_f32(h, farm->p0);
+    h = state_hash_f32(h, farm->p1);
+    h = state_hash_mix(h, farm->construction);
     break;
-  case Military:
-    if (c->military_usage + l->cost > c->military_capacity) {
-      return false;
-    }
+  }
+  case EFFECT_ARG_FORUM: {
+    const struct ForumArgument *forum = forum_component(c, e->component);
+    h = state_hash_mix(h, ((uint64_t)forum->taberna_capacity << 32) | forum->num_taberna);
+    h = state_hash_mix(h, save_construction_handle(c, forum->tabernas));
     break;
   }
-
-  l->date_passed = date;
-  l->passed = true;
-
-  struct Effect enact_law_effect = {.duration = l->cost_lng, .arg = l, .tick_effect = enact_law_tick_effect};
-  city_add_effect(c, enact_law_effect);
-
-  city_add_effect(c, *l->effect);
-
-  return true;
+  case EFFECT_ARG_LAND_TAX:
+    h = state_hash_f32(h, land_tax_component(c, e->component)->tax_percentage);
+    break;
+  case EFFECT_ARG_CONSTRUCTION:
+    h = state_hash_mix(h, save_construction_handle(c, e->component));
+    break;
+  case EFFECT_ARG_LAW:
+    h = state_hash_mix(h, (const struct Law *)e->arg - c->available_laws);
+    break;
+  }
+  return h;
 }
 
-void build_construction(struct City *c, struct Construction *cp,
-                        const struct Effect *activated_effect) {
-  assert(cp); assert(activated_effect);
+static uint64_t state_hash_construction(uint64_t h, const struct City *c,
+                                        const struct Construction *con) {
+  h = state_hash_mix(h, ((uint64_t)con->gui_construction_management << 4) |
+                            (con->construction_in_progress << 3) | (con->construction_finished << 2) |
+                            (con->maintained << 1) | con->unique_effects);
+  h = state_hash_f32(h, con->construction_delay_risk);
+  h = state_hash_f32(h, con->construction_cost);
+  h = state_hash_f32(h, con->cost);
+  h = state_hash_f32(h, con->maintenance);
+  h = state_hash_str(h, con->name_str);
+  h = state_hash_mix(h, con->construction_time);
+  h = state_hash_date(h, con->construction_started);
+  h = state_hash_date(h, con->construction_completed);
+  h = state_hash_mix(h, ((uint64_t)con->num_effects << 32) | con->num_effects_capacity);
+  for (size_t i = 0; i < con->num_effects; i++) {
+    h = state_hash_effect(h, c, &con->effect[i]);
+  }
+  return h;
+}
 
-  struct Construction *con = city_add_construction(c, *cp);
-  assert(con);
-  con->name_str = activated_effect->name_str;
-  con->construction_in_progress = true;
-  con->maintained = true;
-  con->construction_cost = con->cost / con->construction_time;
-  con->effect = calloc(1, sizeof(struct Effect));
-  con->construction_started = date;
-  // Linking the construction and its active effect
-  con->effect[0] = *activated_effect;
-  con->num_effects = 1;
+// Hashes the simulation state of c and the game globals into h
+void state_hash_city(const struct City *c, struct StateHash *h) {
+  assert(c); assert(h);
+  const uint64_t seed = 0xcbf29ce484222325ull;
+  uint64_t *f = h->fields;
+  f[STATE_HASH_DATE] = state_hash_date(seed, date);
+  f[STATE_HASH_TIMESTEP] = state_hash_mix(seed, timestep);
+  f[STATE_HASH_RNG] = state_hash_mix(seed, rng_state);
+  f[STATE_HASH_FLAGS] = state_hash_mix(seed, (c->diplomacy_enabled << 1) | c->laws_enabled);
+  f[STATE_HASH_PRODUCE_VALUES] = seed;
+  for (size_t i = 0; c->produce_values && i < NUMBER_OF_PRODUCE; i++) {
+    f[STATE_HASH_PRODUCE_VALUES] = state_hash_f32(f[STATE_HASH_PRODUCE_VALUES], c->produce_values[i]);
+  }
+  f[STATE_HASH_LAND_AREA] = state_hash_mix(seed, c->land_area);
+  f[STATE_HASH_LAND_AREA_USED] = state_hash_mix(seed, c->land_area_used);
+  f[STATE_HASH_FOOD_PRODUCTION] = state_hash_f32(seed, c->food_production);
+  f[STATE_HASH_FOOD_PRODUCTION_MODIFIER] = state_hash_f32(seed, c->food_production_modifier);
+  f[STATE_HASH_FOOD_USAGE] = state_hash_f32(seed, c->food_usage);
+  f[STATE_HASH_GOLD] = state_hash_f32(seed, c->gold);
+  f[STATE_HASH_GOLD_USAGE] = state_hash_f32(seed, c->gold_usage);
+  f[STATE_HASH_POLITICAL] = state_hash_mix(seed, ((uint64_t)c->political_capacity << 32) | c->political_usage);
+  f[STATE_HASH_DIPLOMATIC] = state_hash_mix(seed, ((uint64_t)c->diplomatic_capacity << 32) | c->diplomatic_usage);
+  f[STATE_HASH_MILITARY] = state_hash_mix(seed, ((uint64_t)c->military_capacity << 32) | c->military_usage);
+  f[STATE_HASH_POPULATION] = state_hash_mix(seed, c->population);
+  f[STATE_HASH_POPULATION_DELTA] = state_hash_mix(seed, (uint32_t)c->population_delta);
+
+  uint64_t v = state_hash_mix(seed, c->num_effects);
+  for (size_t i = 0; i < c->num_effects; i++) {
+    v = state_hash_effect(v, c, &c->effects[i]);
+  }
+  f[STATE_HASH_EFFECTS] = v;
 
-  if (cp->unique_effects) {
-    const size_t i = (activated_effect - cp->effect) / sizeof(struct Effect);
-    cp->effect[i] = cp->effect[cp->num_effects - 1];
-    cp->num_effects--;
+  v = state_hash_mix(seed, c->num_construction_projects);
+  for (size_t i = 0; i < c->num_construction_projects; i++) {
+    v = state_hash_construction(v, c, &c->construction_projects[i]);
   }
+  f[STATE_HASH_CONSTRUCTION_PROJECTS] = v;
 
-  eventlog_add_msgf(c->log, "Building of %s started ..", con->name_str);
+  v = state_hash_mix(seed, c->num_constructions);
+  for (size_t i = 0; i < c->num_constructions; i++) {
+    v = state_hash_construction(v, c, &c->constructions[i]);
+  }
+  f[STATE_HASH_CONSTRUCTIONS] = v;
 
-  int lng = snprintf(NULL, 0, "9999 days left, - %.2f / day", con->construction_cost) + 1;
-  char *description_str = (char *)calloc(lng, sizeof(char)); // Filled by the building_tick_effect
+  v = state_hash_mix(seed, c->num_popups);
+  for (size_t i = 0; i < c->num_popups; i++) {
+    const struct Popup *p = &c->popups[i];
+    v = state_hash_mix(v, ((uint64_t)p->callback << 32) | (uint32_t)p->choice_choosen);
+    v = state_hash_str(v, p->title);
+    v = state_hash_mix(v, p->num_choices);
+    for (uint32_t j = 0; j < p->num_choices; j++) {
+      v = state_hash_str(v, p->choices[j]);
+    }
+  }
+  f[STATE_HASH_POPUPS] = v;
+
+  v = state_hash_mix(seed, c->num_available_laws);
+  for (size_t i = 0; i < c->num_available_laws; i++) {
+    const struct Law *l = &c->available_laws[i];
+    v = state_hash_mix(v, ((uint64_t)l->gui_handler << 24) | (l->cost_lng << 16) | (l->cost << 8) |
+                              ((uint32_t)l->type << 1) | l->passed);
+    v = state_hash_date(v, l->date_passed);
+    v = state_hash_str(v, l->name_str);
+    v = l->effect ? state_hash_effect(v, c, l->effect) : state_hash_mix(v, SAVE_NONE);
+  }
+  f[STATE_HASH_LAWS] = v;
+
+  v = seed;
+  if (c->cursus_honorum) {
+    const struct CursusHonorum *ch = c->cursus_honorum;
+    v = state_hash_mix(v, ((uint64_t)ch->magistrates_enabled << 2) | (ch->aedile_enabled << 1) |
+                              ch->censor_enabled);
+    v = state_hash_mix(v, save_construction_handle(c, ch->aedile_assigned_construction));
+  }
+  f[STATE_HASH_CURSUS_HONORUM] = v;
 
-  lng = snprintf(NULL, 0, "Building %s", con->name_str) + 1;
-  char *name_str = (char *)calloc(lng, sizeof(char));
-  snprintf(name_str, lng, "Building %s", con->name_str);
+  h->hash = seed;
+  for (size_t i = 0; i < NUM_STATE_HASH_FIELDS; i++) {
+    h->hash = state_hash_mix(h->hash, f[i]);
+  }
+  h->hash ^= h->hash >> 31; // Final avalanche of the last mixed in field
+}
 
-  struct Effect building_effect = {.name_str = name_str,
-                                   .description_str = description_str,
-                                   .duration = cp->construction_time,
-                                   .arg = con,
-                                   .tick_effect = building_tick_effect};
-  city_add_effect(c, building_effect);
+static uint64_t city_state_hash(const struct City *c) {
+  struct StateHash h;
+  state_hash_city(c, &h);
+  return h.hash;
 }
 
-bool quit_menu(struct City *c) {
-  // TODO: Export City state to JSON
-  // TODO: Export City state to binary
-  // TODO: Load City state from JSON
-  // TODO: Load City state from binary
-  // TODO: Quit & Save, Save, Restart, Quit
+// Starts writing a trace of state hashes to filepath
+bool state_trace_create(struct StateTrace *t, const char *filepath) {
+  assert(t); assert(filepath);
+  memset(t, 0, sizeof(struct StateTrace));
+  t->file = fopen(filepath, "wb");
+  if (t->file == NULL) {
+    fprintf(stderr, "[ColoniaC]: Failed to create %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
+  const struct StateTraceHeader header = {
+      .magic = STATE_TRACE_MAGIC, .version = STATE_TRACE_VERSION, .num_fields = NUM_STATE_HASH_FIELDS};
+  fwrite(&header, sizeof(header), 1, t->file);
   return true;
 }
 
-void help_menu(struct City *c) {
-  // TODO: Implement help menu
-  // TODO: There should be a explain word/concept discovery functionality like
-  // Emacs's explain-function
+// Appends the state hash of the current timestep to the trace
+void state_trace_write(struct StateTrace *t, const struct StateHash *h) {
+  assert(t); assert(h);
+  if (t->file == NULL) {
+    return;
+  }
+  uint32_t changed = 0;
+  for (uint32_t i = 0; i < NUM_STATE_HASH_FIELDS; i++) {
+    if (t->num_records == 0 || h->fields[i] != t->last.fields[i]) {
+      changed |= 1u << i;
+    }
+  }
+  fwrite(&timestep, sizeof(timestep), 1, t->file);
+  fwrite(&changed, sizeof(changed), 1, t->file);
+  for (uint32_t i = 0; i < NUM_STATE_HASH_FIELDS; i++) {
+    if (changed & (1u << i)) {
+      fwrite(&h->fields[i], sizeof(uint64_t), 1, t->file);
+    }
+  }
+  t->last = *h;
+  t->num_records++;
 }
 
-/// GUI specific resources initialized once at startup
-static struct {
-  struct nk_vec2 icon_size;
-  struct nk_image policy_icon;
-  struct nk_image construction_icon;
-  struct nk_image diplomatic_icon;
-  struct nk_image military_icon;
-  struct nk_image political_icon;
-  struct nk_image construction_detail_icon;
-#define WINDOW_NAME_CONSTRUCTION "construction_window"
-#define WINDOW_NAME_EVENTLOG "eventlog_window"
-#define WINDOW_NAME_HELP "help_window"
-#define WINDOW_NAME_MILITARY "military_window"
-#define WINDOW_NAME_DIPLOMATIC "diplomatic_window"
-#define WINDOW_NAME_POLITICAL "political_window"
-} GUI;
+// Reads the trace at filepath, returns false if it is not a trace of this version
+bool state_trace_open(struct StateTrace *t, const char *filepath) {
+  assert(t); assert(filepath);
+  memset(t, 0, sizeof(struct StateTrace));
+  const int fd = open(filepath, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct StateTraceHeader)) {
+    fprintf(stderr, "[ColoniaC]: Failed to open the state trace %s \n", filepath);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
 
-void glfw_error_callback(int e, const char *d) {
-  fprintf(stderr, "[glfw3]: Error %d: %s", e, d);
+  t->size = st.st_size;
+  t->data = (uint8_t *)malloc(t->size);
+  const bool read_all = read(fd, t->data, t->size) == (ssize_t)t->size;
+  close(fd);
+  struct StateTraceHeader header;
+  memcpy(&header, t->data, sizeof(header));
+  if (!read_all || memcmp(header.magic, STATE_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != STATE_TRACE_VERSION || header.num_fields != NUM_STATE_HASH_FIELDS) {
+    fprintf(stderr, "[ColoniaC]: %s is not a state trace of this version of the game \n", filepath);
+    free(t->data);
+    t->data = NULL;
+    return false;
+  }
+  t->offset = sizeof(header);
+  return true;
 }
 
-struct nk_image nk_image_load(const char *filename) {
-  int x = 0, y = 0, n = 0;
-  GLuint tex = 0;
-  unsigned char *data = stbi_load(filename, &x, &y, &n, 0);
-  if (!data) {
-    fprintf(stderr, "[stbi]: failed to load image: %s", filename);
-  } else {
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
+// Reads the next record of the trace, returns false at its end
+bool state_trace_next(struct StateTrace *t, uint64_t *ts, struct StateHash *h) {
+  assert(t); assert(ts); assert(h);
+  uint32_t changed;
+  if (t->data == NULL || t->size - t->offset < sizeof(*ts) + sizeof(changed)) {
+    return false;
+  }
+  memcpy(ts, &t->data[t->offset], sizeof(*ts));
+  memcpy(&changed, &t->data[t->offset + sizeof(*ts)], sizeof(changed));
+  size_t offset = t->offset + sizeof(*ts) + sizeof(changed);
+  for (uint32_t i = 0; i < NUM_STATE_HASH_FIELDS; i++) {
+    if (changed & (1u << i)) {
+      if (t->size - offset < sizeof(uint64_t)) {
+        return false;
+      }
+      memcpy(&t->last.fields[i], &t->data[offset], sizeof(uint64_t));
+      offset += sizeof(uint64_t);
+    }
   }
-  assert(tex);
-  return nk_image_id((int)tex);
+  t->offset = offset;
+  t->num_records++;
+  *h = t->last;
+  h->hash = 0; // Only the fields are traced
+  return true;
 }
 
-void gui_farm_construction_management(struct nk_context *ctx,
-                                      struct Construction *con,
-                                      struct City *c) {
-  assert(con); assert(ctx); assert(c);
+// Compares the state hash of the current timestep with the next record of the
+// golden trace, reports the first divergent fields and returns false if any
+bool state_trace_check(struct StateTrace *golden, const struct StateHash *h) {
+  assert(golden); assert(h);
+  uint64_t ts;
+  struct StateHash expected;
+  if (!state_trace_next(golden, &ts, &expected)) {
+    fprintf(stderr, "[ColoniaC]: The golden trace ends before timestep %" PRIu64 " \n", timestep);
+    return false;
+  }
+  if (ts != timestep) {
+    fprintf(stderr, "[ColoniaC]: Expected timestep %" PRIu64 " in the golden trace, found %" PRIu64 " \n",
+            timestep, ts);
+    return false;
+  }
 
-  struct FarmArgument *arg = (struct FarmArgument *)con->effect->arg;
-  assert(arg && "Farm construction's effect lacks argument");
+  bool equal = true;
+  for (uint32_t i = 0; i < NUM_STATE_HASH_FIELDS; i++) {
+    if (h->fields[i] != expected.fields[i]) {
+      fprintf(stderr, "[ColoniaC]: State diverged from the golden trace at timestep %" PRIu64
+                      " (%u %s %d) in %s \n",
+              timestep, date.day + 1, get_month_str(date), date.year, lut_state_hash_field_str(i));
+      equal = false;
+    }
+  }
+  return equal;
+}
 
-  nk_layout_row_dynamic(ctx, 0.0f, 1);
-  nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Food production: %lu +- %.2f", arg->area, arg->p1);
+void state_trace_close(struct StateTrace *t) {
+  assert(t);
+  if (t->file) {
+    fclose(t->file);
+  }
+  free(t->data);
+  memset(t, 0, sizeof(struct StateTrace));
+}
 
-  const float ratio[2] = {0.90f, 0.10f};
-  nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 2, ratio);
+/***** replay *****/
+// Recording of the seed and every player command (see command_issue) of a
+// game, with state hashes every in-game month. Playing it back headless
+// re-runs the game as fast as possible and verifies the hashes. It can also
+// trace the state hash of every timestep or check it against a golden trace.
+
+// Starts recording the game to filepath, call before the first timestep after
+// seeding the RNG with seed
+bool replay_recorder_open(struct ReplayRecorder *r, const char *filepath, const uint64_t seed) {
+  assert(r); assert(filepath);
+  memset(r, 0, sizeof(struct ReplayRecorder));
+  r->file = fopen(filepath, "wb");
+  if (r->file == NULL) {
+    fprintf(stderr, "[ColoniaC]: Failed to create %s: %s \n", filepath, strerror(errno));
+    return false;
+  }
 
-  const char *tooltip_str = "Land area increase costs X gold where X is the current land area.";
-  nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Land area: %lu jugerum", arg->area);
-  NK_TOOLTIP(
-      ctx,
-      if (nk_button_symbol(ctx, NK_SYMBOL_PLUS)) {
-        if (c->gold >= arg->area) {
-          if (1 + c->land_area_used <= c->land_area) {
-            c->gold -= (float) arg->area;
-            arg->area++;
-          }
-        }
-      },
-      tooltip_str);
+  const struct ReplayHeader header = {.magic = REPLAY_MAGIC,
+                                      .version = REPLAY_VERSION,
+                                      .seed = seed,
+                                      .start_date = date,
+                                      .eventlog_capacity = CONFIG.EVENTLOG_CAPACITY,
+                                      .difficulty = CONFIG.DIFFICULTY,
+                                      .save_version = SAVE_VERSION,
+                                      .catalogue_hash = catalogue.header->hash};
+  fwrite(&header, sizeof(header), 1, r->file);
+  r->last_timestep = timestep;
+  if (CONFIG.STATE_HASH_TRACE) {
+    char *trace_filepath = str_concat_new(CONFIG.FILEPATH_SAVE, STATE_TRACE_FILENAME);
+    state_trace_create(&r->trace, trace_filepath);
+    free(trace_filepath);
+  }
+  return true;
 }
 
-void gui_forum_construction_management(struct nk_context *ctx,
-                                       struct Construction *con,
-                                       struct City *c) {
-  assert(con); assert(ctx); assert(c);
+// Traces the state hash of c if enabled, call after each timestep
+void replay_recorder_tick(struct ReplayRecorder *r, const struct City *c) {
+  assert(r); assert(c);
+  if (r->file && r->trace.file) {
+    struct StateHash h;
+    state_hash_city(c, &h);
+    state_trace_write(&r->trace, &h);
+  }
+}
 
-  struct ForumArgument *arg = (struct ForumArgument *)con->effect->arg;
-  assert(arg);
+static void replay_record_hash(struct ReplayRecorder *r, const uint8_t kind, const struct City *c) {
+  const uint64_t hash = city_state_hash(c);
+  replay_write_record(r, kind);
+  fwrite(&hash, sizeof(hash), 1, r->file);
+  fflush(r->file);
+  r->num_checkpoints++;
+}
 
-  nk_layout_row_dynamic(ctx, 0.0f, 1);
-  nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Taberna spots: %zu / %zu",
-            arg->num_taberna, arg->taberna_capacity);
+// Records the state hash of c, call between timesteps
+void replay_recorder_checkpoint(struct ReplayRecorder *r, const struct City *c) {
+  assert(r); assert(c);
+  if (r->file) {
+    replay_record_hash(r, REPLAY_RECORD_CHECKPOINT, c);
+  }
 }
 
-void gui_construction_detail_menu(struct Construction *con,
-                                  struct nk_context *ctx, struct City *c) {
-  assert(con);
-  assert(ctx);
+// Ends the recording with the final state hash of c
+void replay_recorder_close(struct ReplayRecorder *r, const struct City *c) {
+  assert(r); assert(c);
+  if (r->file == NULL) {
+    return;
+  }
+  replay_record_hash(r, REPLAY_RECORD_END, c);
+  fclose(r->file);
+  r->file = NULL;
+  state_trace_close(&r->trace);
+}
 
-  const nk_flags flags = NK_WINDOW_BORDER | NK_WINDOW_MINIMIZABLE |
-                         NK_WINDOW_MOVABLE | NK_WINDOW_CLOSABLE;
-  const uint32_t win_width = 400;
-  const uint32_t win_height = 200;
-  const struct nk_rect win_rect =
-      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
-              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
-              win_width, win_height);
-  if (nk_begin(ctx, con->name_str, win_rect, flags)) {
-    nk_layout_row_dynamic(ctx, 0.0f, 1);
-    nk_label_wrap(ctx, con->effect->description_str);
-    nk_label_wrap(ctx, con->help_str);
+// Recorded game being played back
+struct ReplayPlayer {
+  uint8_t *data;
+  size_t size;
+  size_t offset; // Of the next record
+  struct ReplayHeader header;
+  uint64_t next_timestep;
+};
 
-    if (con->gui_construction_management) {
-      con->gui_construction_management(ctx, con, c);
+// Reads the replay at filepath, returns false if it is not a valid replay
+bool replay_player_open(struct ReplayPlayer *p, const char *filepath) {
+  assert(p); assert(filepath);
+  memset(p, 0, sizeof(struct ReplayPlayer));
+  const int fd = open(filepath, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct ReplayHeader)) {
+    fprintf(stderr, "[ColoniaC]: Failed to open the replay %s \n", filepath);
+    if (fd >= 0) {
+      close(fd);
     }
+    return false;
+  }
 
-    char *maintained_str = NULL;
-    if (con->maintained) {
-      maintained_str = "Disable maintenance";
-    } else {
-      maintained_str = "Enable maintenance";
-    }
-    const char *tooltip_str =
-        "Maintained: costs gold, gives effects. Unmaintained: costs no gold, "
-        "gives no effect, might cause other side effects to occur.";
-    NK_TOOLTIP(
-        ctx,
-        if (nk_button_label(ctx, maintained_str)) {
-          con->maintained = !con->maintained;
-        },
-        tooltip_str);
+  p->size = st.st_size;
+  p->data = (uint8_t *)malloc(p->size);
+  const bool read_all = read(fd, p->data, p->size) == (ssize_t)p->size;
+  close(fd);
+  memcpy(&p->header, p->data, sizeof(struct ReplayHeader));
+  if (!read_all || memcmp(p->header.magic, REPLAY_MAGIC, sizeof(p->header.magic)) != 0 ||
+      p->header.version != REPLAY_VERSION || p->header.save_version != SAVE_VERSION) {
+    fprintf(stderr, "[ColoniaC]: %s is not a replay of this version of the game \n", filepath);
+    free(p->data);
+    return false;
+  }
+  p->offset = sizeof(struct ReplayHeader);
+  return true;
+}
 
-    if (nk_button_label(ctx, "Destroy building")) {
-      // TODO: Implement ?
+static bool replay_read_varint(struct ReplayPlayer *p, uint64_t *v) {
+  *v = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (p->offset == p->size) {
+      return false;
+    }
+    const uint8_t b = p->data[p->offset++];
+    *v |= (uint64_t)(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return true;
     }
   }
-  nk_end(ctx);
+  return false;
 }
 
-void gui_construction_help_menu(const struct Construction *con,
-                                struct nk_context *ctx) {
-  const nk_flags flags = NK_WINDOW_BORDER | NK_WINDOW_MINIMIZABLE |
-                         NK_WINDOW_MOVABLE | NK_WINDOW_CLOSABLE;
-  const uint32_t win_width = 400;
-  const uint32_t win_height = 200;
-  const struct nk_rect win_rect =
-      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
-              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
-              win_width, win_height);
-  if (nk_begin(ctx, con->name_str, win_rect, flags)) {
-    nk_layout_row_dynamic(ctx, 0.0f, 1);
-    nk_labelf_wrap(ctx, "Effect: %s", con->effect->description_str);
-    nk_label_wrap(ctx, con->help_str);
+// Reads the next record, returns false at the end of the replay or if the
+// record is truncated
+static bool replay_player_next(struct ReplayPlayer *p, uint8_t *kind, struct Command *cmd,
+                               uint64_t *hash) {
+  uint64_t delta;
+  if (p->offset == p->size) {
+    return false;
   }
-  nk_end(ctx);
-}
+  *kind = p->data[p->offset++];
+  if (!replay_read_varint(p, &delta)) {
+    return false;
+  }
+  p->next_timestep += delta;
 
-void gui_construction_menu(struct City *c, struct nk_context *ctx) {
-  static bool open_construction_help_menu = false;
-  static const struct Construction *help_menu_proj = NULL;
+  if (*kind == REPLAY_RECORD_CHECKPOINT || *kind == REPLAY_RECORD_END) {
+    if (p->size - p->offset < sizeof(*hash)) {
+      return false;
+    }
+    memcpy(hash, &p->data[p->offset], sizeof(*hash));
+    p->offset += sizeof(*hash);
+    return true;
+  }
 
-  static bool open_construction_detail_menu = false;
-  static struct Construction *detail_menu_proj = NULL;
+  uint64_t args[2];
+  if (*kind >= NUM_COMMANDS || !replay_read_varint(p, &args[0]) || !replay_read_varint(p, &args[1])) {
+    return false;
+  }
+  *cmd = (struct Command){.type = *kind, .args = {(uint32_t)args[0], (uint32_t)args[1]}};
+  return true;
+}
 
-  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_MINIMIZABLE |
-                             NK_WINDOW_CLOSABLE | NK_WINDOW_SCALABLE;
+// Re-runs the recorded game on the initialized cities as fast as possible,
+// returns false if it diverged from the recording or the golden trace.
+// The state hash of every timestep is written to trace and checked against
+// golden when they are given.
+bool replay_player_run(struct ReplayPlayer *p, struct City *cities, struct StateTrace *trace,
+                       struct StateTrace *golden) {
+  assert(p); assert(cities);
+  uint8_t cidx = 0;
+  uint32_t num_commands = 0;
+  uint32_t num_refused = 0;
+  uint32_t num_checkpoints = 0;
+  bool diverged = false;
+  bool ended = false;
+  const double t0 = time_now_ms();
+  const uint64_t first_timestep = timestep;
+
+  uint8_t kind;
+  struct Command cmd;
+  uint64_t hash = 0;
+  while (!diverged && !ended && replay_player_next(p, &kind, &cmd, &hash)) {
+    while (!diverged && timestep < p->next_timestep) {
+      simulate_next_timestep(&cities[cidx], &cities[(cidx + 1) % 2]);
+      cidx = (cidx + 1) % 2;
+      if (trace || golden) {
+        struct StateHash h;
+        state_hash_city(&cities[cidx], &h);
+        if (trace) {
+          state_trace_write(trace, &h);
+        }
+        diverged = golden && !state_trace_check(golden, &h);
+      }
+    }
+    if (diverged) {
+      break;
+    }
 
-  const uint32_t win_width = 900;
-  const uint32_t win_height = 500;
-  const struct nk_rect win_rect =
-      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
-              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
-              win_width, win_height);
-  if (nk_begin(ctx, "Construction", win_rect, win_flags)) {
-    if (nk_tree_push(ctx, NK_TREE_TAB, "Construction projects", NK_MAXIMIZED)) {
-      for (size_t i = 0; i < c->num_construction_projects; i++) {
-        const struct Construction *proj = &c->construction_projects[i];
+    if (kind == REPLAY_RECORD_CHECKPOINT || kind == REPLAY_RECORD_END) {
+      num_checkpoints++;
+      ended = kind == REPLAY_RECORD_END;
+      diverged = city_state_hash(&cities[cidx]) != hash;
+      if (diverged) {
+        fprintf(stderr, "[ColoniaC]: Replay diverged at timestep %" PRIu64 " (%u %s %d) \n",
+                timestep, date.day + 1, get_month_str(date), date.year);
+      }
+    } else {
+      num_commands++;
+      if (!command_execute(&cities[cidx], &cmd)) {
+        num_refused++;
+      }
+    }
+  }
 
-        if (proj->num_effects == 0) {
-          continue;
-        }
+  const double t1 = time_now_ms();
+  const uint64_t num_timesteps = timestep - first_timestep;
+  printf("[ColoniaC]: Replayed %" PRIu64 " timesteps, %u commands (%u refused), %u checkpoints "
+         "in %.1f ms (%.0f timesteps/s) \n",
+         num_timesteps, num_commands, num_refused, num_checkpoints, t1 - t0,
+         num_timesteps / ((t1 - t0) / 1000.0));
+  if (golden && !diverged) {
+    printf("[ColoniaC]: Matched the golden trace for %u timesteps \n", golden->num_records);
+  }
+  if (!ended && !diverged) {
+    fprintf(stderr, "[ColoniaC]: The replay ends without its final checkpoint \n");
+  }
+  free(p->data);
+  p->data = NULL;
+  return !diverged;
+}
 
-        // TODO: Add visual indication or smt to show that building failed or started
-        static const float ratio[] = {0.05f, 0.35f, 0.25f, 0.15f, 0.05f, 0.125f};
-        if (proj->num_effects_capacity == 1) {
-          nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 6, ratio);
+/***** history *****/
+// Statistics of the city over time for the Statistics tab. Every timestep is
+// sampled into a ring with the days of the last year, and rolled up into a
+// ring of monthly min/avg/max spanning centuries, so the memory is fixed no
+// matter how long the game runs. Charts are downsampled to their width in
+// pixels with Largest-Triangle-Three-Buckets (LTTB), which keeps the peaks.
+#define HISTORY_DAYS 365          // Daily samples kept, a year
+#define HISTORY_MONTHS (12 * 600) // Monthly rollups kept, six centuries
+#define HISTORY_PLOT_MAX 1024     // Most points drawn by a chart
+
+enum HistorySeries {
+  HISTORY_GOLD,
+  HISTORY_GOLD_USAGE,
+  HISTORY_POPULATION,
+  HISTORY_POPULATION_DELTA,
+  HISTORY_FOOD_PRODUCTION,
+  HISTORY_FOOD_USAGE,
+  HISTORY_POLITICAL_CAPACITY,
+  HISTORY_DIPLOMATIC_CAPACITY,
+  HISTORY_MILITARY_CAPACITY,
+  NUM_HISTORY_SERIES
+};
 
-          if (nk_button_label(ctx, "?")) {
-            open_construction_help_menu = !open_construction_help_menu;
-            help_menu_proj = proj;
-          }
+static const char *history_series_str[NUM_HISTORY_SERIES] = {
+    "Gold",       "Gold usage",         "Population",          "Population change", "Food production",
+    "Food usage", "Political capacity", "Diplomatic capacity", "Military capacity"};
 
-          // TODO: Last variant of buildings name will not be shown ...
-          nk_label(ctx, proj->name_str, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+enum HistoryRange { HISTORY_RANGE_YEAR, HISTORY_RANGE_ALL, NUM_HISTORY_RANGES };
 
-          nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%.2f gold", proj->cost);
-          nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%ld days", proj->construction_time);
+static const char *history_range_str[NUM_HISTORY_RANGES] = {"Last year", "All time"};
 
-          nk_spacing(ctx, 1);
+struct HistoryMonth {
+  float min;
+  float avg;
+  float max;
+};
 
-          // TODO: Positive colored buttons that are actionable
-          if (nk_button_label(ctx, "Build")) {
-            build_construction(c, &c->construction_projects[i], &proj->effect[0]);
-          }
-        } else {
-          if (nk_tree_push_id(ctx, NK_TREE_NODE, proj->name_str, NK_MINIMIZED, i)) {
-            for (size_t j = 0; j < proj->num_effects; j++) {
+// NOTE: Rings are per series so that the chart of a series reads one array
+struct History {
+  float days[NUM_HISTORY_SERIES][HISTORY_DAYS];
+  uint32_t num_days;
+  uint32_t day; // Index of the next daily sample
+  struct HistoryMonth months[NUM_HISTORY_SERIES][HISTORY_MONTHS];
+  uint32_t num_months;
+  uint32_t month;                       // Index of the month being sampled
+  int32_t month_key;                    // year * 12 + month of the month being sampled
+  uint32_t month_samples;               // Samples in the month being sampled
+  double month_sum[NUM_HISTORY_SERIES]; // Sum of the samples of the month being sampled
+  uint64_t timestep;                    // Of the last sample
+  uint32_t version;                     // Changes with every sample
+};
 
-              nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 6, ratio);
+static struct History history; // Statistics of the game being played
 
-              if (nk_button_label(ctx, "?")) {
-                open_construction_help_menu = !open_construction_help_menu;
-                help_menu_proj = proj;
-              }
+static void history_clear(struct History *h) {
+  const uint32_t version = h->version;
+  memset(h, 0, sizeof(struct History));
+  h->version = version + 1;
+}
 
-              nk_label(ctx, proj->effect[j].name_str, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+// Samples c, call once per timestep after simulating it. The history starts
+// over when the game jumps in time (loaded or rewound).
+void history_record(struct History *h, const struct City *c) {
+  assert(h); assert(c);
+  if (h->num_days > 0 && timestep != h->timestep + 1) {
+    history_clear(h);
+  }
 
-              nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%.2f gold", proj->cost);
-              nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE, "%ld days", proj->construction_time);
+  const float values[NUM_HISTORY_SERIES] = {
+      [HISTORY_GOLD] = c->gold,
+      [HISTORY_GOLD_USAGE] = c->gold_usage,
+      [HISTORY_POPULATION] = (float)c->population,
+      [HISTORY_POPULATION_DELTA] = (float)c->population_delta,
+      [HISTORY_FOOD_PRODUCTION] = c->food_production,
+      [HISTORY_FOOD_USAGE] = c->food_usage,
+      [HISTORY_POLITICAL_CAPACITY] = (float)c->political_capacity,
+      [HISTORY_DIPLOMATIC_CAPACITY] = (float)c->diplomatic_capacity,
+      [HISTORY_MILITARY_CAPACITY] = (float)c->military_capacity};
+  h->timestep = timestep;
+  h->version++;
+
+  for (size_t s = 0; s < NUM_HISTORY_SERIES; s++) {
+    h->days[s][h->day] = values[s];
+  }
+  h->day = (h->day + 1) % HISTORY_DAYS;
+  if (h->num_days < HISTORY_DAYS) {
+    h->num_days++;
+  }
 
-              nk_spacing(ctx, 1);
+  const int32_t month_key = date.year * 12 + (int32_t)date.month;
+  if (h->num_months == 0 || month_key != h->month_key) {
+    if (h->num_months > 0) {
+      h->month = (h->month + 1) % HISTORY_MONTHS; // Overwrites the oldest month when full
+    }
+    if (h->num_months < HISTORY_MONTHS) {
+      h->num_months++;
+    }
+    h->month_key = month_key;
+    h->month_samples = 0;
+    for (size_t s = 0; s < NUM_HISTORY_SERIES; s++) {
+      h->month_sum[s] = 0.0;
+      h->months[s][h->month] = (struct HistoryMonth){.min = values[s], .max = values[s]};
+    }
+  }
+  h->month_samples++;
+  for (size_t s = 0; s < NUM_HISTORY_SERIES; s++) {
+    struct HistoryMonth *m = &h->months[s][h->month];
+    h->month_sum[s] += values[s];
+    m->avg = (float)(h->month_sum[s] / h->month_samples);
+    if (values[s] < m->min) {
+      m->min = values[s];
+    }
+    if (values[s] > m->max) {
+      m->max = values[s];
+    }
+  }
+}
 
-              if (nk_button_label(ctx, "Build")) {
-                build_construction(c, &c->construction_projects[i], &proj->effect[j]);
-              }
-            }
-            nk_tree_pop(ctx);
-          }
-        }
-      }
-      nk_tree_pop(ctx);
+// Copies a series of the history to out, oldest first, field is the offset of
+// the HistoryMonth member to copy for the monthly range. Returns the count.
+static uint32_t history_unroll(const struct History *h, const enum HistorySeries s,
+                               const enum HistoryRange range, const size_t field, float *out) {
+  if (range == HISTORY_RANGE_YEAR) {
+    const uint32_t oldest = (h->day + HISTORY_DAYS - h->num_days) % HISTORY_DAYS;
+    for (uint32_t i = 0; i < h->num_days; i++) {
+      out[i] = h->days[s][(oldest + i) % HISTORY_DAYS];
     }
+    return h->num_days;
+  }
+  const uint32_t oldest = (h->month + 1 + HISTORY_MONTHS - h->num_months) % HISTORY_MONTHS;
+  for (uint32_t i = 0; i < h->num_months; i++) {
+    const struct HistoryMonth *m = &h->months[s][(oldest + i) % HISTORY_MONTHS];
+    out[i] = *(const float *)((const char *)m + field);
+  }
+  return h->num_months;
+}
 
-    // Constructions built
-    if (nk_tree_push(ctx, NK_TREE_TAB, "Manage constructions", NK_MAXIMIZED)) {
-      for (size_t i = 0; i < c->num_constructions; i++) {
-        struct Construction *con = &c->constructions[i];
-        if (!con->construction_finished) {
-          continue;
-        }
+// Downsamples the n values of data to threshold values in out with LTTB: the
+// first and last values are kept and in between every bucket of values gives
+// the one forming the largest triangle with the value picked before it and the
+// average of the next bucket. Returns the number of values in out.
+static uint32_t lttb(const float *data, const uint32_t n, const uint32_t threshold, float *out) {
+  assert(threshold >= 3);
+  if (n <= threshold) {
+    memcpy(out, data, sizeof(float) * n);
+    return n;
+  }
 
-        const float ratio[2] = {0.85f, 0.15f};
-        nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 2, ratio);
+  const double every = (double)(n - 2) / (double)(threshold - 2);
+  uint32_t a = 0; // Index of the value picked last
+  uint32_t num_out = 0;
+  out[num_out++] = data[0];
+  for (uint32_t i = 0; i < threshold - 2; i++) {
+    uint32_t avg_start = (uint32_t)((i + 1) * every) + 1;
+    uint32_t avg_end = (uint32_t)((i + 2) * every) + 1;
+    if (avg_end > n) {
+      avg_end = n;
+    }
+    double avg_x = 0.0;
+    double avg_y = 0.0;
+    for (uint32_t j = avg_start; j < avg_end; j++) {
+      avg_x += j;
+      avg_y += data[j];
+    }
+    avg_x /= avg_end - avg_start;
+    avg_y /= avg_end - avg_start;
+
+    const uint32_t start = (uint32_t)(i * every) + 1;
+    const uint32_t end = (uint32_t)((i + 1) * every) + 1;
+    double max_area = -1.0;
+    uint32_t pick = start;
+    for (uint32_t j = start; j < end; j++) {
+      // NOTE: Twice the area, only compared
+      double area = ((double)a - avg_x) * ((double)data[j] - data[a]) -
+                    ((double)a - j) * (avg_y - data[a]);
+      if (area < 0.0) {
+        area = -area;
+      }
+      if (area > max_area) {
+        max_area = area;
+        pick = j;
+      }
+    }
+    out[num_out++] = data[pick];
+    a = pick;
+  }
+  out[num_out++] = data[n - 1];
+  return num_out;
+}
 
-        nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "%s - %s", con->name_str, con->description_str);
+// Chart of a series of the history as wide as the window, downsampled again
+// only when the history, series, range or width changed
+void gui_history_chart(struct nk_context *ctx, const struct History *h, const enum HistorySeries s,
+                       const enum HistoryRange range, const float height) {
+  static struct {
+    bool valid;
+    uint32_t version;
+    enum HistorySeries series;
+    enum HistoryRange range;
+    uint32_t width;
+    float lines[3][HISTORY_PLOT_MAX]; // Average, min and max (only the first for days)
+    uint32_t num_lines;
+    uint32_t num_points;
+    float min;
+    float max;
+  } plot;
+  static float unrolled[HISTORY_MONTHS];
+
+  nk_layout_row_dynamic(ctx, height, 1);
+  const float bounds_width = nk_layout_widget_bounds(ctx).w;
+  uint32_t width = bounds_width < 3.0f ? 3 : (uint32_t)bounds_width;
+  if (width > HISTORY_PLOT_MAX) {
+    width = HISTORY_PLOT_MAX;
+  }
 
-        if (con->gui_construction_management) {
-          // Construction detail menu
-          if (nk_button_label(ctx, "Manage")) {
-            open_construction_detail_menu = !open_construction_detail_menu;
-            detail_menu_proj = con;
-          }
+  if (!plot.valid || plot.version != h->version || plot.series != s || plot.range != range ||
+      plot.width != width) {
+    static const size_t fields[] = {offsetof(struct HistoryMonth, avg), offsetof(struct HistoryMonth, min),
+                                    offsetof(struct HistoryMonth, max)};
+    plot.num_lines = range == HISTORY_RANGE_YEAR ? 1 : 3;
+    for (uint32_t k = 0; k < plot.num_lines; k++) {
+      const uint32_t n = history_unroll(h, s, range, fields[k], unrolled);
+      plot.num_points = lttb(unrolled, n, width, plot.lines[k]);
+    }
+    plot.min = plot.num_points > 0 ? plot.lines[0][0] : 0.0f;
+    plot.max = plot.min;
+    for (uint32_t k = 0; k < plot.num_lines; k++) {
+      for (uint32_t i = 0; i < plot.num_points; i++) {
+        if (plot.lines[k][i] < plot.min) {
+          plot.min = plot.lines[k][i];
+        }
+        if (plot.lines[k][i] > plot.max) {
+          plot.max = plot.lines[k][i];
         }
       }
-      nk_tree_pop(ctx);
     }
+    if (plot.max - plot.min < 1.0f) { // NOTE: Flat series are drawn in the middle
+      plot.min -= 0.5f;
+      plot.max += 0.5f;
+    }
+    plot.valid = true;
+    plot.version = h->version;
+    plot.series = s;
+    plot.range = range;
+    plot.width = width;
   }
 
-  nk_end(ctx);
+  if (plot.num_points < 2) {
+    nk_label(ctx, "Not enough history yet", NK_TEXT_ALIGN_CENTERED);
+    return;
+  }
+  // NOTE: Charts space the points evenly, LTTB picks one per bucket so a point
+  // is off by at most a bucket (a pixel)
+  const struct nk_color dim = nk_rgba(150, 150, 150, 255);
+  if (nk_chart_begin(ctx, NK_CHART_LINES, plot.num_points, plot.min, plot.max)) {
+    for (uint32_t k = 1; k < plot.num_lines; k++) {
+      nk_chart_add_slot_colored(ctx, NK_CHART_LINES, dim, dim, plot.num_points, plot.min, plot.max);
+    }
+    for (uint32_t i = 0; i < plot.num_points; i++) {
+      if (nk_chart_push_slot(ctx, plot.lines[0][i], 0) & NK_CHART_HOVERING) {
+        nk_tooltipf(ctx, "%.2f", plot.lines[0][i]);
+      }
+      for (uint32_t k = 1; k < plot.num_lines; k++) {
+        nk_chart_push_slot(ctx, plot.lines[k][i], k);
+      }
+    }
+    nk_chart_end(ctx);
+  }
+}
+
+/***** rewind *****/
+// In-memory history of the game for debugging: every interval timesteps a
+// snapshot of the SaveImage is kept, LZ compressed. Most snapshots are deltas
+// against the previous one, every REWIND_KEYFRAME_INTERVAL-th is complete so
+// that restoring one applies at most that many deltas. The oldest snapshots
+// are dropped to stay within the memory budget.
+#define REWIND_DEFAULT_BUDGET_MB 16 // Default memory budget (see config.json)
+#define REWIND_DEFAULT_INTERVAL 10  // Default timesteps between snapshots (see config.json)
+#define REWIND_KEYFRAME_INTERVAL 32 // Snapshots per complete snapshot
+#define REWIND_FORK_FILENAME "rewind_fork.bin"
+
+struct RewindSnapshot {
+  uint64_t timestep;
+  struct Date date;
+  uint8_t *data;     // Packed SaveImage (keyframe) or delta record
+  uint32_t size;     // Bytes in data, equals raw_size if data is not compressed
+  uint32_t raw_size;
+  bool keyframe;
+};
+
+struct Rewind {
+  struct RewindSnapshot *snapshots; // Oldest first
+  uint32_t num_snapshots;
+  uint32_t capacity;
+  size_t budget; // In bytes, 0 disables the rewind history
+  size_t used;
+  uint32_t interval;
+  uint32_t num_since_keyframe;
+  struct SaveImage last; // Image of the newest snapshot
+  double snapshot_ms;    // Time spent taking the last snapshot
+};
+
+void rewind_open(struct Rewind *r, const size_t budget, const uint32_t interval) {
+  assert(r); assert(interval > 0);
+  memset(r, 0, sizeof(struct Rewind));
+  r->budget = budget;
+  r->interval = interval;
+}
 
-  if (open_construction_help_menu) {
-    assert(help_menu_proj);
-    gui_construction_help_menu(help_menu_proj, ctx);
+// Writes the section table followed by the section data of img to out
+static void save_image_pack(const struct SaveImage *img, struct SaveBuffer *out) {
+  uint64_t offset = sizeof(img->sections);
+  struct SaveSection *sections = (struct SaveSection *)save_buffer_push(out, sizeof(img->sections));
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    sections[i] = img->sections[i];
+    sections[i].offset = offset;
+    offset += img->sections[i].size;
   }
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    if (img->sections[i].size > 0) {
+      memcpy(save_buffer_push(out, img->sections[i].size), img->data[i], img->sections[i].size);
+    }
+  }
+}
 
-  if (open_construction_detail_menu) {
-    assert(detail_menu_proj);
-    gui_construction_detail_menu(detail_menu_proj, ctx, c);
+// Copies a packed image into an owned image
+static void save_image_unpack(const uint8_t *packed, struct SaveImage *img) {
+  *img = (struct SaveImage){.owned = true};
+  memcpy(img->sections, packed, sizeof(img->sections));
+  for (size_t i = 0; i < NUM_SAVE_SECTIONS; i++) {
+    uint8_t *data = (uint8_t *)malloc(img->sections[i].size + 1);
+    memcpy(data, &packed[img->sections[i].offset], img->sections[i].size);
+    img->data[i] = data;
   }
 }
 
-void gui_event_log(const struct City *c, struct nk_context *ctx) {
-  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_BORDER |
-                             NK_WINDOW_CLOSABLE | NK_WINDOW_MINIMIZABLE |
-                             NK_WINDOW_SCALABLE;
-  if (nk_begin(ctx, "Event log", nk_rect(50, 600, 600, 400), win_flags)) {
-    char *msg = NULL;
-    nk_layout_row_dynamic(ctx, 0.0f, 1);
-    while (eventlog_next_msg(c->log, &msg)) {
-      nk_label_wrap(ctx, msg);
-    }
+// Stores raw in s, compressed if that makes it smaller
+static void rewind_snapshot_store(struct RewindSnapshot *s, const struct SaveBuffer *raw) {
+  s->raw_size = raw->size;
+  s->data = (uint8_t *)malloc(raw->size + 1);
+  s->size = raw->size > 0 ? lz_compress(raw->data, raw->size, s->data, raw->size - 1) : 0;
+  if (s->size == 0) {
+    memcpy(s->data, raw->data, raw->size);
+    s->size = raw->size;
   }
-  nk_end(ctx);
+  s->data = (uint8_t *)realloc(s->data, s->size + 1);
 }
 
-void gui_political_menu(struct City *c, struct nk_context *ctx) {
-  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_BORDER |
-                             NK_WINDOW_CLOSABLE | NK_WINDOW_MINIMIZABLE;
-  const uint32_t win_width = 500;
-  const uint32_t win_height = 500;
-  const struct nk_rect win_rect =
-      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
-              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
-              win_width, win_height);
-  if (nk_begin(ctx, "Political", win_rect, win_flags)) {
+// Callee owned raw bytes of a snapshot
+static uint8_t *rewind_snapshot_load_new(const struct RewindSnapshot *s) {
+  uint8_t *raw = (uint8_t *)malloc(s->raw_size + 1);
+  if (s->size == s->raw_size) {
+    memcpy(raw, s->data, s->size);
+  } else {
+    const bool valid = lz_decompress(s->data, s->size, raw, s->raw_size);
+    assert(valid && "Corrupt rewind snapshot");
+    (void)valid;
+  }
+  return raw;
+}
 
-    if (nk_tree_push(ctx, NK_TREE_TAB, "Laws", NK_MAXIMIZED)) {
+// Rebuilds the image of snapshot i into the owned image img
+static void rewind_image(const struct Rewind *r, const uint32_t i, struct SaveImage *img) {
+  assert(i < r->num_snapshots);
+  uint32_t k = i;
+  while (!r->snapshots[k].keyframe) {
+    assert(k > 0 && "Rewind history without a keyframe");
+    k--;
+  }
 
-      nk_layout_row_dynamic(ctx, 0.0f, 2);
+  uint8_t *raw = rewind_snapshot_load_new(&r->snapshots[k]);
+  save_image_unpack(raw, img);
+  free(raw);
+  for (k++; k <= i; k++) {
+    if (r->snapshots[k].raw_size == 0) {
+      continue; // Nothing changed
+    }
+    raw = rewind_snapshot_load_new(&r->snapshots[k]);
+    const struct SaveDeltaHeader *header = (const struct SaveDeltaHeader *)raw;
+    const bool valid = save_delta_apply(img, header, raw + sizeof(struct SaveDeltaHeader));
+    assert(valid && "Corrupt rewind delta");
+    (void)valid;
+    free(raw);
+  }
+}
 
-      static int active_pane = 0;
-      if (nk_button_symbol_label(ctx,
-                                 active_pane == 0 ? NK_SYMBOL_CIRCLE_SOLID
-                                                  : NK_SYMBOL_CIRCLE_OUTLINE,
-                                 "Passed", NK_TEXT_ALIGN_CENTERED)) {
-        active_pane = 0;
-      }
+static void rewind_snapshot_free(struct Rewind *r, struct RewindSnapshot *s) {
+  r->used -= s->size + sizeof(struct RewindSnapshot);
+  free(s->data);
+  memset(s, 0, sizeof(struct RewindSnapshot));
+}
 
-      if (nk_button_symbol_label(ctx,
-                                 active_pane == 1 ? NK_SYMBOL_CIRCLE_SOLID
-                                                  : NK_SYMBOL_CIRCLE_OUTLINE,
-                                 "Available", NK_TEXT_ALIGN_CENTERED)) {
-        active_pane = 1;
-      }
+// Drops the oldest snapshot, the next one is turned into a keyframe if needed
+static void rewind_drop_oldest(struct Rewind *r) {
+  assert(r->num_snapshots > 1);
+  struct RewindSnapshot *next = &r->snapshots[1];
+  if (!next->keyframe) {
+    struct SaveImage img;
+    rewind_image(r, 1, &img);
+    struct SaveBuffer raw = {0};
+    save_image_pack(&img, &raw);
+    save_image_free(&img);
+    r->used -= next->size;
+    free(next->data);
+    rewind_snapshot_store(next, &raw);
+    next->keyframe = true;
+    r->used += next->size;
+    free(raw.data);
+  }
 
-      switch (active_pane) {
-      case 0:
-        for (size_t i = 0; i < c->num_available_laws; i++) {
-          struct Law *law = &c->available_laws[i];
-          if (!law->passed) {
-            continue;
-          }
-          if (nk_tree_push(ctx, NK_TREE_TAB, law->name_str, NK_MINIMIZED)) {
-            nk_layout_row_dynamic(ctx, 100.0f, 1);
-            nk_label_wrap(ctx, law->description_str);
-            nk_layout_row_dynamic(ctx, 0.0f, 1);
-            nk_labelf_wrap(ctx, "Passed: %u BC", law->date_passed.year);
-            if (law->gui_handler) {
-              law->gui_handler(ctx, law);
-            }
+  rewind_snapshot_free(r, &r->snapshots[0]);
+  r->num_snapshots--;
+  memmove(&r->snapshots[0], &r->snapshots[1], r->num_snapshots * sizeof(struct RewindSnapshot));
+}
 
-            nk_tree_pop(ctx);
-          }
-        }
-        break;
-      case 1:
-        for (size_t i = 0; i < c->num_available_laws; i++) {
-          struct Law *law = &c->available_laws[i];
-          if (law->passed) {
-            continue;
-          }
-          if (nk_tree_push(ctx, NK_TREE_TAB, law->name_str, NK_MINIMIZED)) {
-            nk_layout_row_dynamic(ctx, 100.0f, 1);
-            nk_label_wrap(ctx, law->description_str);
-            nk_layout_row_dynamic(ctx, 0.0f, 1);
-            if (nk_button_label(ctx, "Enact")) {
-              // TODO: Implement positive/negative feedback based success or not
-              city_enact_law(c, law);
-            }
-            nk_tree_pop(ctx);
-          }
-        }
-        break;
-      }
+// Takes a snapshot of c every interval timesteps, call after each timestep
+void rewind_record(struct Rewind *r, const struct City *c) {
+  assert(r); assert(c);
+  if (r->budget == 0 || timestep % r->interval != 0) {
+    return;
+  }
 
-      nk_tree_pop(ctx);
-    }
+  const double t0 = time_now_ms();
+  struct SaveImage img;
+  save_image_build(c, &img);
 
-    if (nk_tree_push(ctx, NK_TREE_TAB, "Cursus Honorum", NK_MAXIMIZED)) {
-      if (c->cursus_honorum->aedile_enabled) {
-        if (c->cursus_honorum->aedile_assigned_construction) {
-          nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Aedile assigned to %s", c->cursus_honorum->aedile_assigned_construction->name_str);
-        } else {
-          if (nk_group_begin(ctx, "assign_aedile", NK_WINDOW_BORDER | NK_WINDOW_NO_SCROLLBAR)) {
-            nk_layout_row_dynamic(ctx, 0.0f, 1);
+  if (r->num_snapshots == r->capacity) {
+    r->capacity = r->capacity ? 2 * r->capacity : 64;
+    r->snapshots = (struct RewindSnapshot *)realloc(r->snapshots, r->capacity * sizeof(struct RewindSnapshot));
+  }
+  struct RewindSnapshot *s = &r->snapshots[r->num_snapshots++];
+  *s = (struct RewindSnapshot){.timestep = timestep, .date = date};
+  s->keyframe = r->num_snapshots == 1 || r->num_since_keyframe + 1 >= REWIND_KEYFRAME_INTERVAL;
+
+  struct SaveBuffer raw = {0};
+  if (s->keyframe) {
+    save_image_pack(&img, &raw);
+    r->num_since_keyframe = 0;
+  } else {
+    save_delta_build(&r->last, &img, &raw);
+    r->num_since_keyframe++;
+  }
+  rewind_snapshot_store(s, &raw);
+  r->used += s->size + sizeof(struct RewindSnapshot);
+  free(raw.data);
 
-            const struct nk_vec2 menu_size = nk_vec2(200, 100 * c->num_constructions);
+  save_image_free(&r->last);
+  r->last = img;
 
-            const char *ui_str = "Assign Aedile to ...";
-            if (nk_menu_begin_label(ctx, ui_str, NK_TEXT_ALIGN_CENTERED, menu_size)) {
-              nk_layout_row_dynamic(ctx, 0.0f, 1);
-              for (size_t i = 0; i < c->num_constructions; i++) {
-                if (nk_menu_item_label(ctx, c->constructions[i].name_str, NK_TEXT_ALIGN_CENTERED | NK_TEXT_ALIGN_MIDDLE)) {
-                  c->cursus_honorum->aedile_assigned_construction = &c->constructions[i];
-                }
-              }
-              nk_menu_end(ctx);
-            }
+  while (r->used > r->budget && r->num_snapshots > 1) {
+    rewind_drop_oldest(r);
+  }
+  r->snapshot_ms = time_now_ms() - t0;
+}
 
-            nk_group_end(ctx);
-          }
-        }
-      }
-      nk_tree_pop(ctx);
-    }
+// Restores c to snapshot i, the newer snapshots are dropped as the game
+// continues from there. Returns false if the snapshot could not be restored.
+bool rewind_restore(struct Rewind *r, const uint32_t i, struct City *c) {
+  assert(r); assert(c);
+  if (i >= r->num_snapshots) {
+    return false;
   }
 
-  nk_end(ctx);
+  struct SaveImage img;
+  rewind_image(r, i, &img);
+  if (!save_image_restore(&img, c)) {
+    save_image_free(&img);
+    return false;
+  }
+
+  while (r->num_snapshots > i + 1) {
+    rewind_snapshot_free(r, &r->snapshots[--r->num_snapshots]);
+  }
+  r->num_since_keyframe = 0;
+  for (uint32_t k = i; !r->snapshots[k].keyframe; k--) {
+    r->num_since_keyframe++;
+  }
+  save_image_free(&r->last);
+  r->last = img;
+  return true;
 }
 
-void gui_diplomatic_menu(struct City *c, struct nk_context *ctx) {
-  // TODO: Implement diplomatic menu
+// Writes snapshot i as a savegame to filepath without changing the game
+bool rewind_fork(const struct Rewind *r, const uint32_t i, const char *filepath) {
+  assert(r); assert(filepath);
+  if (i >= r->num_snapshots) {
+    return false;
+  }
+  struct SaveImage img;
+  rewind_image(r, i, &img);
+  const bool success = save_image_write(&img, filepath, CONFIG.COMPRESSION);
+  save_image_free(&img);
+  return success;
 }
 
-void gui_military_menu(struct City *c, struct nk_context *ctx) {
-  // TODO: Implement military menu
-  const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_BORDER |
-                             NK_WINDOW_CLOSABLE | NK_WINDOW_MINIMIZABLE;
-  const uint32_t win_width = 500;
-  const uint32_t win_height = 500;
-  const struct nk_rect win_rect =
-      nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
-              (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
-              win_width, win_height);
-  if (nk_begin(ctx, "Military", win_rect, win_flags)) {
+void rewind_close(struct Rewind *r) {
+  assert(r);
+  while (r->num_snapshots > 0) {
+    rewind_snapshot_free(r, &r->snapshots[--r->num_snapshots]);
+  }
+  free(r->snapshots);
+  save_image_free(&r->last);
+  memset(r, 0, sizeof(struct Rewind));
+}
+
+// Development window to travel back to a snapshot of the game
+void gui_rewind(struct nk_context *ctx, struct Rewind *r, struct City *c) {
+  const nk_flags win_flags = NK_WINDOW_BORDER | NK_WINDOW_MOVABLE | NK_WINDOW_MINIMIZABLE |
+                             NK_WINDOW_TITLE | NK_WINDOW_NO_SCROLLBAR;
+  const float win_width = 260.0f;
+  const float win_height = 220.0f;
+  const struct nk_rect win_rect = nk_rect(CONFIG.RESOLUTION.width - win_width - 10.0f,
+                                          CONFIG.RESOLUTION.height - 2.0f * win_height - 20.0f,
+                                          win_width, win_height);
+  static int selected = -1; // Snapshot to rewind to, the newest if out of range
+  static const char *status = NULL;
+  if (nk_begin(ctx, "Rewind", win_rect, win_flags)) {
     nk_layout_row_dynamic(ctx, 0.0f, 1);
-    if (nk_button_label(ctx, "Raise legion")) {
-      // TODO: Raise a legion
+    if (r->budget == 0 || r->num_snapshots == 0) {
+      nk_label(ctx, r->budget == 0 ? "Rewind disabled" : "No snapshots yet", NK_TEXT_ALIGN_LEFT);
+      nk_end(ctx);
+      return;
     }
 
-    if (nk_button_label(ctx, "Strengthen the Rhine border")) {
-      // TODO:
+    nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Snapshots: %u, %zu / %zu KiB", r->num_snapshots,
+              r->used / 1024, r->budget / 1024);
+    nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Snapshot: %.2f ms", r->snapshot_ms);
+    if (selected < 0 || (uint32_t)selected >= r->num_snapshots) {
+      selected = r->num_snapshots - 1;
     }
-
-    if (nk_button_label(ctx, "Strengthen the Danube border")) {
-      // TODO:
+    nk_slider_int(ctx, 0, &selected, r->num_snapshots - 1, 1);
+    const struct RewindSnapshot *s = &r->snapshots[selected];
+    nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "%u %s %d %s (timestep %" PRIu64 ")", s->date.day + 1,
+              get_month_str(s->date), abs(s->date.year), s->date.year < 0 ? "BC" : "AD", s->timestep);
+
+    nk_layout_row_dynamic(ctx, 0.0f, 2);
+    if (nk_button_label(ctx, "Rewind")) {
+      replay_recorder_close(&replay_recorder, c); // A replay cannot reproduce the rewind
+      status = rewind_restore(r, selected, c) ? "Rewound" : "Failed to rewind";
     }
-
-    if (nk_button_label(ctx, "Launch military campaign ..")) {
-      // TODO:
+    if (nk_button_label(ctx, "Fork to save")) {
+      char *filepath = str_concat_new(CONFIG.FILEPATH_SAVE, REWIND_FORK_FILENAME);
+      status = rewind_fork(r, selected, filepath) ? "Forked to " REWIND_FORK_FILENAME : "Failed to fork";
+      free(filepath);
+    }
+    if (status) {
+      nk_layout_row_dynamic(ctx, 0.0f, 1);
+      nk_label(ctx, status, NK_TEXT_ALIGN_LEFT);
     }
-
-    // TODO: List legions?
   }
   nk_end(ctx);
 }
 
-void gui_help_menu(struct City *c, struct nk_context *ctx) {
-  // TODO: Help menu is used to look things up and search for in-game things
-}
-
-// Saves the City state to the save folder from the CONFIG
-bool save_game_to_json(const struct City *c) {
-  // TODO: Wrap the save_game_to_json up
-
-  cJSON *root = cJSON_CreateObject();
-  cJSON_AddNumberToObject(root, "gold", c->gold);
+// Development statistics in the corner of the screen
+void gui_debug_overlay(struct nk_context *ctx, struct Autosave *autosave) {
+  const nk_flags win_flags = NK_WINDOW_BORDER | NK_WINDOW_MOVABLE | NK_WINDOW_MINIMIZABLE |
+                             NK_WINDOW_TITLE | NK_WINDOW_NO_SCROLLBAR;
+  const float win_width = 260.0f;
+  const float win_height = 210.0f;
+  const struct nk_rect win_rect = nk_rect(CONFIG.RESOLUTION.width - win_width - 10.0f,
+                                          CONFIG.RESOLUTION.height - win_height - 10.0f,
+                                          win_width, win_height);
+  if (nk_begin(ctx, "Debug", win_rect, win_flags)) {
+    nk_layout_row_dynamic(ctx, 0.0f, 1);
+    if (autosave->num_slots == 0) {
+      nk_label(ctx, "Autosave disabled", NK_TEXT_ALIGN_LEFT);
+    } else {
+      const struct AutosaveStats stats = autosave_stats(autosave);
+      nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Autosaves: %u (slot %u / %u)", stats.num_saves,
+                stats.last_slot, autosave->num_slots);
+      nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Checkpoints: %u, last save: %" PRIu64 " bytes",
+                stats.num_checkpoints, stats.last_size);
+      nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Snapshot: %.2f ms", stats.snapshot_ms);
+      nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Write: %.2f ms (max %.2f ms)", stats.write_ms,
+                stats.max_write_ms);
+      if (stats.num_skipped || stats.num_failed) {
+        nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Skipped: %u, failed: %u", stats.num_skipped,
+                  stats.num_failed);
+      }
+    }
 
-  const char *str = cJSON_Print(root);
-  if (str) {
-    fprintf(stderr, "%s \n", str);
+    // NOTE: Counts of the previous frame as this one is not rendered yet, frame
+    // counters are left out as they would make every frame differ
+    const struct nk_sdl_stats frame = nk_sdl_frame_stats();
+    nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Vertices: %zu, indices: %zu", frame.vertices, frame.elements);
+    nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "Draw calls: %zu, buffers: %zu / %zu KiB", frame.draw_calls,
+              frame.vertex_capacity / 1024, frame.element_capacity / 1024);
   }
-
-  return true;
+  nk_end(ctx);
 }
 
 // TODO: Display gametime, something fun in the ingame menu
-void gui_ingame_menu(struct City *c, struct nk_context *ctx) {
+/// Returns true if the player wants to quit the game
+bool gui_ingame_menu(struct City *c, struct nk_context *ctx) {
   const nk_flags win_flags = NK_WINDOW_MOVABLE | NK_WINDOW_BORDER |
                              NK_WINDOW_CLOSABLE | NK_WINDOW_MINIMIZABLE;
   const uint32_t win_width = 500;
@@ -1650,47 +8790,78 @@ void gui_ingame_menu(struct City *c, struct nk_context *ctx) {
       nk_rect((CONFIG.RESOLUTION.width / 2.0f) - (win_width / 2.0f),
               (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
               win_width, win_height);
+  static const char *status = NULL; // Outcome of the last save/load
+  bool quit = false;
   if (nk_begin(ctx, "Menu", win_rect, win_flags)) {
     nk_layout_row_dynamic(ctx, 0.0f, 1);
     if (nk_button_label(ctx, "Save game")) {
-      // TODO: Save game handling
-      // const bool success = save_game_to_json(c);
+      status = save_game_to_binary(c) ? "Game saved" : "Failed to save the game";
     }
 
     if (nk_button_label(ctx, "Load game")) {
-      // TODO: Load game
+      replay_recorder_close(&replay_recorder, c); // A replay cannot reproduce the loaded state
+      status = load_game_from_binary(c) ? "Game loaded" : "Failed to load the game";
+    }
+
+    if (nk_button_label(ctx, "Load last autosave")) {
+      replay_recorder_close(&replay_recorder, c);
+      status = load_game_from_autosave(c) ? "Autosave loaded" : "Failed to load the autosave";
+    }
+
+    // Human readable saves for debugging
+    if (nk_button_label(ctx, "Export game to JSON")) {
+      status = save_game_to_json(c) ? "Game exported" : "Failed to export the game";
+    }
+
+    if (nk_button_label(ctx, "Import game from JSON")) {
+      replay_recorder_close(&replay_recorder, c);
+      status = load_game_from_json(c) ? "Game imported" : "Failed to import the game";
+    }
+
+    if (nk_button_label(ctx, "Save & quit")) {
+      quit = quit_menu(c);
+      if (!quit) {
+        status = "Failed to save the game";
+      }
     }
 
     if (nk_button_label(ctx, "Quit")) {
-      // TODO: Quit game
+      quit = true;
+    }
+
+    if (status) {
+      nk_label(ctx, status, NK_TEXT_ALIGN_LEFT);
     }
   }
   nk_end(ctx);
+  return quit;
 }
 
 // ----------- Custom GUI widgets  -----------
 
 void gui_building_row(struct City *c, struct nk_context *ctx, struct Effect *e) {
-  assert(c); assert(e); assert(e->arg);
+  assert(c); assert(e);
 
-  struct Construction *arg = (struct Construction *)e->arg;
+  struct Construction *arg = construction_get(c, e->component);
+  assert(arg);
 
   static const float ratio[5] = {0.05f, 0.38f, 0.05f, 0.45f, 0.07f};
-  nk_layout_row(ctx, NK_DYNAMIC, 0.0f, 5, ratio);
+  nk_layout_row(ctx, NK_DYNAMIC, gui_list_row_height(ctx), 5, ratio);
 
+  const uint32_t idx = e - c->effects;
   if (nk_button_label(ctx, "X")) {
-    e->scheduled_for_removal = true;
+    command_issue(c, COMMAND_CANCEL_CONSTRUCTION, idx, 0);
   }
 
   nk_labelf(ctx, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Building %s", arg->name_str);
 
   if (arg->construction_in_progress) {
     if (nk_button_label(ctx, "||")) {
-      arg->construction_in_progress = !arg->construction_in_progress;
+      command_issue(c, COMMAND_TOGGLE_CONSTRUCTION, idx, 0);
     }
   } else {
     if (nk_button_symbol(ctx, NK_SYMBOL_TRIANGLE_RIGHT)) {
-      arg->construction_in_progress = !arg->construction_in_progress;
+      command_issue(c, COMMAND_TOGGLE_CONSTRUCTION, idx, 0);
     }
   }
 
@@ -1748,7 +8919,7 @@ void gui_popup(struct nk_context *ctx, struct City *c, struct Popup *p) {
     nk_layout_row_dynamic(ctx, 0.0f, 1);
     for (size_t i = 0; i < p->num_choices; i++) {
       if (nk_button_label(ctx, p->choices[i])) {
-        p->choice_choosen = i;
+        command_issue(c, COMMAND_CHOOSE_POPUP, p - c->popups, i);
       }
     }
   }
@@ -1778,17 +8949,13 @@ void update_gui(struct City *c, struct nk_context *ctx) {
                                         (CONFIG.RESOLUTION.height / 2.0f) - (win_height / 2.0f),
                                         win_width, win_height);
 
-  char *date_str = get_new_date_str(date, DATE_FORMAT_SHORT);
-  const char *win_title = str_concat_new(c->name, date_str);
-  free(date_str);
+  const char *win_title = frame_printf("%s%s", c->name, get_date_str(date, DATE_FORMAT_SHORT));
 
   if (nk_begin(ctx, win_title, win_rect, main_win_flags)) {
     nk_layout_row_dynamic(ctx, 0.0f, 1);
-    char *numeral_str = roman_numeral_new_str(date.day + 1);
     nk_labelf(ctx, NK_TEXT_ALIGN_CENTERED, "The %s, day %s of %s, %s",
-              get_year_str(&date), numeral_str, get_month_str(date),
+              get_year_str(&date), roman_numeral_str(date.day + 1), get_month_str(date),
               get_season_str(&date));
-    free(numeral_str);
 
     // Capacities
     nk_layout_row_dynamic(ctx, 55.0f, 3);
@@ -1869,21 +9036,41 @@ void update_gui(struct City *c, struct nk_context *ctx) {
     if (nk_tree_push(ctx, NK_TREE_TAB, "Statistics", NK_MINIMIZED)) {
       nk_layout_row_dynamic(ctx, 0.0f, 1);
       nk_labelf(ctx, NK_TEXT_ALIGN_MIDDLE | NK_TEXT_ALIGN_CENTERED, "Land area: %zu / %zu", c->land_area_used, c->land_area);
+      static int series = HISTORY_GOLD;
+      static int range = HISTORY_RANGE_YEAR;
+      nk_layout_row_dynamic(ctx, 0.0f, 2);
+      series = nk_combo(ctx, history_series_str, NUM_HISTORY_SERIES, series, 20, nk_vec2(200.0f, 200.0f));
+      range = nk_combo(ctx, history_range_str, NUM_HISTORY_RANGES, range, 20, nk_vec2(200.0f, 80.0f));
+      gui_history_chart(ctx, &history, series, range, 120.0f);
       nk_tree_pop(ctx);
     }
 
     // Effects
     if (nk_tree_push(ctx, NK_TREE_TAB, "Effects", NK_MAXIMIZED)) {
-      for (size_t i = 0; i < c->num_effects; i++) {
-        struct Effect *e = &c->effects[i];
-        // Construction effects
-        if (e->tick_effect == building_tick_effect) {
-          gui_building_row(c, ctx, e);
-        } else if (e->name_str) {
-          nk_layout_row_dynamic(ctx, 0.0f, 2);
-          nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "%s", e->name_str);
-          nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT, "%s", e->description_str);
+      static struct GuiListRows rows; // Indices of the effects shown in the UI
+      if (gui_list_rows_stale(&rows, c->effects_version, 0, c->num_effects)) {
+        for (size_t i = 0; i < c->num_effects; i++) {
+          const struct Effect *e = &c->effects[i];
+          if (e->tick_effect == TICK_EFFECT_BUILDING || e->name_str) {
+            rows.rows[rows.num_rows++] = i;
+          }
+        }
+      }
+
+      struct nk_list_view view;
+      if (gui_list_view_begin(ctx, &view, "effects", 300.0f, rows.num_rows)) {
+        for (int r = view.begin; r < view.end; r++) {
+          struct Effect *e = &c->effects[rows.rows[r]];
+          // Construction effects
+          if (e->tick_effect == TICK_EFFECT_BUILDING) {
+            gui_building_row(c, ctx, e);
+          } else {
+            nk_layout_row_dynamic(ctx, gui_list_row_height(ctx), 2);
+            nk_labelf(ctx, NK_TEXT_ALIGN_LEFT, "%s", e->name_str);
+            nk_labelf(ctx, NK_TEXT_ALIGN_RIGHT, "%s", e->description_str);
+          }
         }
+        nk_list_view_end(&view);
       }
       nk_tree_pop(ctx);
     }
@@ -1894,7 +9081,10 @@ void update_gui(struct City *c, struct nk_context *ctx) {
       char curr_speed[2]; snprintf(curr_speed, sizeof(curr_speed), "%u", simulation_speed);
       nk_label(ctx, curr_speed, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE);
       nk_label(ctx, "0", NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE);
-      nk_slider_int(ctx, 0, (int *)&simulation_speed, 9, 1);
+      int speed = simulation_speed;
+      if (nk_slider_int(ctx, 0, &speed, 9, 1)) {
+        command_issue(c, COMMAND_SET_SPEED, speed, 0);
+      }
       nk_label(ctx, "1", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
       nk_tree_pop(ctx);
     }
@@ -1930,93 +9120,265 @@ void update_gui(struct City *c, struct nk_context *ctx) {
   }
 }
 
-// Parses the config.json at the project root and inits the Config struct at
-// startup
-void parse_config_file() {
-  const char *raw_json = open_file("config.json");
+/***** frame scheduler *****/
+// Frames are only drawn when input arrived, the simulation stepped or the UI
+// is being interacted with. In between the main loop blocks on the SDL event
+// queue until the next timestep is due instead of spinning.
+#define FRAME_DEFAULT_FPS_CAP 60 // Default frame rate cap (see config.json)
+#define FRAME_REDRAW_FRAMES 2    // Frames drawn per redraw, Nuklear lags input by a frame
+
+struct FrameScheduler {
+  double min_frame_ms;      // Frame time of the FPS cap, 0 if uncapped
+  double last_frame_ms;     // When the last frame was drawn
+  double last_timestep_ms;  // When the simulation last stepped
+  uint32_t redraw_frames;   // Frames left to draw
+};
 
-  if (raw_json) {
-    cJSON *json = cJSON_Parse(raw_json);
+void frame_scheduler_init(struct FrameScheduler *f, const uint32_t fps_cap) {
+  assert(f);
+  memset(f, 0, sizeof(struct FrameScheduler));
+  f->min_frame_ms = fps_cap > 0 ? 1000.0 / fps_cap : 0.0;
+  f->last_timestep_ms = time_now_ms();
+  f->redraw_frames = FRAME_REDRAW_FRAMES;
+}
 
-    if (json) {
-      struct cJSON *root_folder =
-          cJSON_GetObjectItemCaseSensitive(json, "root_folder");
-      if (cJSON_IsString(root_folder) && root_folder->valuestring) {
-        CONFIG.FILEPATH_ROOT = root_folder->valuestring;
-      }
+void frame_request_redraw(struct FrameScheduler *f) {
+  f->redraw_frames = FRAME_REDRAW_FRAMES;
+}
 
-      struct cJSON *save_folder =
-          cJSON_GetObjectItemCaseSensitive(json, "save_folder");
-      if (cJSON_IsString(save_folder) && save_folder->valuestring) {
-        CONFIG.FILEPATH_SAVE = save_folder->valuestring;
-      } else {
-        CONFIG.FILEPATH_SAVE = CONFIG.FILEPATH_ROOT;
-      }
+/// Returns true if the simulation should step at now given ms per timestep, 0 = paused
+bool frame_timestep_due(struct FrameScheduler *f, const uint32_t ms_per_timestep, const double now) {
+  if (ms_per_timestep == 0 || now - f->last_timestep_ms < ms_per_timestep) {
+    return false;
+  }
+  f->last_timestep_ms = now;
+  frame_request_redraw(f);
+  return true;
+}
 
-      struct cJSON *gui = cJSON_GetObjectItem(json, "gui");
-      if (cJSON_IsBool(gui)) {
-        CONFIG.GUI = gui->valueint;
-      }
+// Sleeps until the next frame may be drawn when a redraw is pending, otherwise
+// blocks until an event arrives or the next timestep is due
+void frame_wait(struct FrameScheduler *f, const uint32_t ms_per_timestep) {
+  const double now = time_now_ms();
+  double timeout = ms_per_timestep == 0 ? -1.0 : f->last_timestep_ms + ms_per_timestep - now;
+  if (f->redraw_frames > 0) {
+    double delay = f->last_frame_ms + f->min_frame_ms - now;
+    if (timeout >= 0.0 && timeout < delay) {
+      delay = timeout;
+    }
+    if (delay >= 1.0) {
+      SDL_Delay((uint32_t)delay);
+    }
+    return;
+  }
 
-      struct cJSON *hard_mode = cJSON_GetObjectItem(json, "hard_mode");
-      if (cJSON_IsBool(hard_mode)) {
-        CONFIG.HARD_MODE = hard_mode->valueint;
-      }
+  const int has_event = timeout < 0.0 ? SDL_WaitEvent(NULL) : SDL_WaitEventTimeout(NULL, (int)ceil(timeout));
+  if (has_event) {
+    frame_request_redraw(f);
+  }
+}
 
-      struct cJSON *language = cJSON_GetObjectItem(json, "language");
-      if (cJSON_IsNumber(language)) {
-        CONFIG.LANGUAGE = language->valueint;
-      }
+/// Returns true if a frame should be drawn now
+bool frame_begin(struct FrameScheduler *f) {
+  const double now = time_now_ms();
+  if (f->redraw_frames == 0 || now - f->last_frame_ms < f->min_frame_ms) {
+    return false;
+  }
+  f->last_frame_ms = now;
+  f->redraw_frames--;
+  return true;
+}
 
-      struct cJSON *resolution = cJSON_GetObjectItem(json, "resolution");
-      if (cJSON_IsObject(resolution)) {
-        struct Resolution res;
+// Keeps drawing while a mouse button is held, i.e. dragging windows and sliders
+void frame_end(struct FrameScheduler *f, const struct nk_context *ctx) {
+  for (size_t i = 0; i < NK_BUTTON_MAX; i++) {
+    if (ctx->input.mouse.buttons[i].down) {
+      frame_request_redraw(f);
+      return;
+    }
+  }
+}
 
-        struct cJSON *width = cJSON_GetObjectItem(resolution, "width");
-        if (cJSON_IsNumber(width)) {
-          res.width = width->valueint;
-        }
+// Sets the keys present in json, on_disk if it is the config.json on disk
+// rather than the default config embedded in the executable
+static void parse_config_json(cJSON *json, const bool on_disk) {
+  // Folders are specific to the machine, only taken from the config.json on disk
+  struct cJSON *root_folder =
+      cJSON_GetObjectItemCaseSensitive(json, "root_folder");
+  if (on_disk && cJSON_IsString(root_folder) && root_folder->valuestring) {
+    free(CONFIG.FILEPATH_ROOT);
+    CONFIG.FILEPATH_ROOT = str_concat_new(root_folder->valuestring, "");
+  }
 
-        struct cJSON *height = cJSON_GetObjectItem(resolution, "height");
-        if (cJSON_IsNumber(height)) {
-          res.height = height->valueint;
-        }
+  struct cJSON *save_folder =
+      cJSON_GetObjectItemCaseSensitive(json, "save_folder");
+  if (on_disk && cJSON_IsString(save_folder) && save_folder->valuestring) {
+    free(CONFIG.FILEPATH_SAVE);
+    CONFIG.FILEPATH_SAVE = str_concat_new(save_folder->valuestring, "");
+  }
 
-        CONFIG.RESOLUTION = res;
-      }
+  struct cJSON *asset_overrides = cJSON_GetObjectItem(json, "asset_overrides");
+  if (on_disk && cJSON_IsBool(asset_overrides)) {
+    CONFIG.ASSET_OVERRIDES = cJSON_IsTrue(asset_overrides);
+  }
 
-      struct cJSON *start_date = cJSON_GetObjectItem(json, "start_date");
-      if (cJSON_IsObject(start_date)) {
-        struct cJSON *year = cJSON_GetObjectItem(start_date, "year");
-        if (cJSON_IsNumber(year)) {
-          date.year = year->valueint;
-        }
+  struct cJSON *gui = cJSON_GetObjectItem(json, "gui");
+  if (cJSON_IsBool(gui)) {
+    CONFIG.GUI = gui->valueint;
+  }
 
-        struct cJSON *month = cJSON_GetObjectItem(start_date, "month");
-        if (cJSON_IsNumber(month)) {
-          date.month = month->valueint;
-        }
+  struct cJSON *hard_mode = cJSON_GetObjectItem(json, "hard_mode");
+  if (cJSON_IsBool(hard_mode)) {
+    CONFIG.HARD_MODE = hard_mode->valueint;
+  }
 
-        struct cJSON *day = cJSON_GetObjectItem(start_date, "day");
-        if (cJSON_IsNumber(day)) {
-          date.day = day->valueint;
-        }
-      }
+  struct cJSON *language = cJSON_GetObjectItem(json, "language");
+  if (cJSON_IsNumber(language)) {
+    CONFIG.LANGUAGE = language->valueint;
+  }
 
-      struct cJSON *fullscreen = cJSON_GetObjectItem(json, "fullscreen");
-      if (cJSON_IsBool(fullscreen)) {
-        CONFIG.FULLSCREEN = fullscreen->valueint;
-      }
+  struct cJSON *resolution = cJSON_GetObjectItem(json, "resolution");
+  if (cJSON_IsObject(resolution)) {
+    struct Resolution res;
+
+    struct cJSON *width = cJSON_GetObjectItem(resolution, "width");
+    if (cJSON_IsNumber(width)) {
+      res.width = width->valueint;
+    }
+
+    struct cJSON *height = cJSON_GetObjectItem(resolution, "height");
+    if (cJSON_IsNumber(height)) {
+      res.height = height->valueint;
+    }
+
+    CONFIG.RESOLUTION = res;
+  }
+
+  struct cJSON *start_date = cJSON_GetObjectItem(json, "start_date");
+  if (cJSON_IsObject(start_date)) {
+    struct cJSON *year = cJSON_GetObjectItem(start_date, "year");
+    if (cJSON_IsNumber(year)) {
+      date.year = year->valueint;
+    }
+
+    struct cJSON *month = cJSON_GetObjectItem(start_date, "month");
+    if (cJSON_IsNumber(month)) {
+      date.month = month->valueint;
+    }
+
+    struct cJSON *day = cJSON_GetObjectItem(start_date, "day");
+    if (cJSON_IsNumber(day)) {
+      date.day = day->valueint;
+    }
+  }
+
+  struct cJSON *fullscreen = cJSON_GetObjectItem(json, "fullscreen");
+  if (cJSON_IsBool(fullscreen)) {
+    CONFIG.FULLSCREEN = fullscreen->valueint;
+  }
+
+  struct cJSON *eventlog_capacity = cJSON_GetObjectItem(json, "eventlog_capacity");
+  if (cJSON_IsNumber(eventlog_capacity) && eventlog_capacity->valueint > 0) {
+    CONFIG.EVENTLOG_CAPACITY = eventlog_capacity->valueint;
+  }
+
+  struct cJSON *autosave_slots = cJSON_GetObjectItem(json, "autosave_slots");
+  if (cJSON_IsNumber(autosave_slots) && autosave_slots->valueint >= 0) {
+    CONFIG.AUTOSAVE_SLOTS = autosave_slots->valueint;
+  }
+
+  struct cJSON *record_replay = cJSON_GetObjectItem(json, "record_replay");
+  if (cJSON_IsBool(record_replay)) {
+    CONFIG.RECORD_REPLAY = cJSON_IsTrue(record_replay);
+  }
+
+  struct cJSON *compression = cJSON_GetObjectItem(json, "compression");
+  if (cJSON_IsBool(compression)) {
+    CONFIG.COMPRESSION = cJSON_IsTrue(compression);
+  }
+
+  struct cJSON *catalogue_name = cJSON_GetObjectItemCaseSensitive(json, "catalogue");
+  if (cJSON_IsString(catalogue_name) && catalogue_name->valuestring) {
+    free((void *)CONFIG.CATALOGUE);
+    CONFIG.CATALOGUE = str_concat_new(catalogue_name->valuestring, "");
+  }
+
+  struct cJSON *state_hash_trace = cJSON_GetObjectItem(json, "state_hash_trace");
+  if (cJSON_IsBool(state_hash_trace)) {
+    CONFIG.STATE_HASH_TRACE = cJSON_IsTrue(state_hash_trace);
+  }
+
+  struct cJSON *rewind_budget = cJSON_GetObjectItem(json, "rewind_budget_mb");
+  if (cJSON_IsNumber(rewind_budget) && rewind_budget->valueint >= 0) {
+    CONFIG.REWIND_BUDGET_MB = rewind_budget->valueint;
+  }
+
+  struct cJSON *rewind_interval = cJSON_GetObjectItem(json, "rewind_interval");
+  if (cJSON_IsNumber(rewind_interval) && rewind_interval->valueint > 0) {
+    CONFIG.REWIND_INTERVAL = rewind_interval->valueint;
+  }
 
+  struct cJSON *checkpoint_interval = cJSON_GetObjectItem(json, "autosave_checkpoint_interval");
+  if (cJSON_IsNumber(checkpoint_interval) && checkpoint_interval->valueint > 0) {
+    CONFIG.AUTOSAVE_CHECKPOINT_INTERVAL = checkpoint_interval->valueint;
+  }
+
+  struct cJSON *vsync = cJSON_GetObjectItem(json, "vsync");
+  if (cJSON_IsBool(vsync)) {
+    CONFIG.VSYNC = cJSON_IsTrue(vsync);
+  }
+
+  struct cJSON *fps_cap = cJSON_GetObjectItem(json, "fps_cap");
+  if (cJSON_IsNumber(fps_cap) && fps_cap->valueint >= 0) {
+    CONFIG.FPS_CAP = fps_cap->valueint;
+  }
+}
+
+// Parses the config.json at the project root and inits the Config struct at
+// startup, its keys override those of the default config embedded in the
+// executable
+void parse_config_file() {
+  CONFIG.EVENTLOG_CAPACITY = EVENTLOG_DEFAULT_CAPACITY;
+  CONFIG.AUTOSAVE_SLOTS = AUTOSAVE_DEFAULT_SLOTS;
+  CONFIG.AUTOSAVE_CHECKPOINT_INTERVAL = AUTOSAVE_DEFAULT_CHECKPOINT_INTERVAL;
+  CONFIG.REWIND_BUDGET_MB = REWIND_DEFAULT_BUDGET_MB;
+  CONFIG.REWIND_INTERVAL = REWIND_DEFAULT_INTERVAL;
+  CONFIG.CATALOGUE = str_concat_new(CATALOGUE_DEFAULT_NAME, "");
+  CONFIG.VSYNC = true;
+  CONFIG.FPS_CAP = FRAME_DEFAULT_FPS_CAP;
+
+  CONFIG.FILEPATH_ROOT = str_concat_new("", ""); // Working directory
+
+  const struct EmbeddedAsset *default_config = asset_embedded("config.json");
+  if (default_config) {
+    cJSON *json = cJSON_Parse((const char *)default_config->data);
+    if (json) {
+      parse_config_json(json, false);
+      cJSON_Delete(json);
+    }
+  }
+
+  const char *raw_json = open_file("config.json");
+
+  if (raw_json) {
+    cJSON *json = cJSON_Parse(raw_json);
+
+    if (json) {
+      parse_config_json(json, true);
+      cJSON_Delete(json);
     } else {
       const char *error_ptr = cJSON_GetErrorPtr();
       if (error_ptr) {
         fprintf(stderr, "[ColoniaC]: cJSON error before: %s \n", error_ptr);
       }
     }
-  } else {
+    free((void *)raw_json);
+  } else if (default_config == NULL) {
     fprintf(stderr, "[ColoniaC]: Failed to load config.json");
   }
+  if (CONFIG.FILEPATH_SAVE == NULL) {
+    CONFIG.FILEPATH_SAVE = str_concat_new(CONFIG.FILEPATH_ROOT, "");
+  }
   CONFIG.FILEPATH_RSRC = str_concat_new(CONFIG.FILEPATH_ROOT, "resources/");
 }
 
@@ -2061,9 +9423,71 @@ enum GameState check_gamestate(const struct City *c) {
   return REPUBLIC;
 }
 
-int main(void) {
-  srand(time(NULL));
-  parse_config_file();
+// Creates the window and initializes OpenGL and the GUI, returns NULL on failure
+// Sub-image of the icon name in image, the atlas image as uploaded to the GPU
+static struct nk_image gui_icon(const struct Atlas *atlas, const struct nk_image image, const char *name) {
+  const struct AtlasIcon *icon = atlas_icon(atlas, name);
+  if (icon == NULL) {
+    fprintf(stderr, "[ColoniaC]: No icon %s in the icon atlas \n", name);
+    return nk_image_id(0);
+  }
+  return nk_subimage_id(image.handle.id, image.w, image.h,
+                        nk_rect(image.region[0] + icon->x, image.region[1] + icon->y, icon->w, icon->h));
+}
+
+// Asset job mapping, or cooking, the icon atlas into data
+static bool gui_load_icons(void *data) {
+  return atlas_load((struct Atlas *)data, CONFIG.FILEPATH_RSRC, ATLAS_DEFAULT_NAME);
+}
+
+// Asset job reading the font and restoring its bake from the font cache or
+// baking it, the atlas is kept by the backend until nk_sdl_font_stash_end_shared
+static bool gui_load_font(void *data) {
+  struct nk_font_atlas *font_atlas;
+  nk_sdl_font_stash_begin(&font_atlas);
+  const bool USE_CUSTOM_FONT = true;
+  if (USE_CUSTOM_FONT) {
+    const float FONT_HEIGHT = 25.0f;
+    const char *font_name = "fonts/CONSTANTINE/Constantine.ttf";
+    const struct EmbeddedAsset *ttf = asset_embedded(font_name);
+    struct nk_font *font = NULL;
+    if (ttf) {
+      font = nk_font_atlas_add_from_memory(font_atlas, (void *)ttf->data, ttf->size, FONT_HEIGHT, NULL);
+    } else {
+      char *font_filepath = str_concat_new(CONFIG.FILEPATH_RSRC, font_name);
+      font = nk_font_atlas_add_from_file(font_atlas, font_filepath, FONT_HEIGHT, NULL);
+      free(font_filepath);
+    }
+    if (font == NULL) {
+      fprintf(stderr, "Could not load custom font. \n");
+      return false;
+    }
+    font_atlas->default_font = font;
+  }
+  const uint64_t font_key = font_cache_key(font_atlas);
+  char *font_cache_filepath = str_concat_new(CONFIG.FILEPATH_SAVE, FONT_CACHE_NAME);
+  bool success = font_cache_restore(font_cache_filepath, font_key);
+  if (!success) {
+    const double t0 = time_now_ms();
+    struct nk_sdl_font_bake bake;
+    success = nk_sdl_font_stash_bake(&bake);
+    if (success) {
+      font_cache_write(font_cache_filepath, font_key, &bake);
+    }
+    printf("[ColoniaC]: Baked the font in %.2f ms \n", time_now_ms() - t0);
+  }
+  free(font_cache_filepath);
+  return success;
+}
+
+struct nk_context *gui_init(SDL_Window **sdl_window) {
+  // Icons and font load on workers meanwhile the window and context are created
+  struct Atlas atlas;
+  struct AssetJob icons_job;
+  struct AssetJob font_job;
+  asset_job_start(&icons_job, "icons", gui_load_icons, &atlas);
+  asset_job_start(&font_job, "font", gui_load_font, NULL);
+  double t0 = time_now_ms();
 
   /* SDL setup */
   SDL_SetHint(SDL_HINT_VIDEO_HIGHDPI_DISABLED, "0");
@@ -2077,67 +9501,114 @@ int main(void) {
   if (CONFIG.FULLSCREEN) {
     win_flags |= SDL_WINDOW_FULLSCREEN;
   }
-  SDL_Window *sdl_window = SDL_CreateWindow(
+  SDL_Window *window = SDL_CreateWindow(
       "Rome: Total Simulation", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
       CONFIG.RESOLUTION.width, CONFIG.RESOLUTION.height, win_flags);
-  SDL_GL_CreateContext(sdl_window);
+  SDL_GL_CreateContext(window);
+  SDL_GL_SetSwapInterval(CONFIG.VSYNC ? 1 : 0);
+  *sdl_window = window;
 
   // OpenGL
   glViewport(0, 0, CONFIG.RESOLUTION.width, CONFIG.RESOLUTION.height);
   glewExperimental = true;
-  if (glewInit() != GLEW_OK) {
+  const bool glew = glewInit() == GLEW_OK;
+  if (!glew) {
     fprintf(stderr, "Error could not initalize GLEW \n");
-    return -1;
   }
 
   // Init Nuklear - GUI
-  struct nk_context *ctx = nk_sdl_init(sdl_window);
-  set_style(ctx);
-
-  const bool USE_CUSTOM_FONT = true;
-  if (USE_CUSTOM_FONT) {
-    struct nk_font_atlas *atlas;
-    nk_sdl_font_stash_begin(&atlas);
-    const float FONT_HEIGHT = 25.0f;
-    const char *font_name = "fonts/CONSTANTINE/Constantine.ttf";
-    const char *font_filepath = str_concat_new(CONFIG.FILEPATH_RSRC, font_name);
-    struct nk_font *font = nk_font_atlas_add_from_file(atlas, font_filepath, FONT_HEIGHT, NULL);
-    if (font_filepath) {
-      free((void *)font_filepath);
-    }
-    if (font == NULL) {
-      fprintf(stderr, "Could not load custom font. \n");
-      return -1;
+  struct nk_context *ctx = glew ? nk_sdl_init(window) : NULL;
+  if (ctx) {
+    set_style(ctx);
+  }
+  startup_log("window", time_now_ms() - t0, false);
+
+  t0 = time_now_ms();
+  const bool icons_loaded = asset_job_wait(&icons_job);
+  const bool font_loaded = asset_job_wait(&font_job);
+  startup_log("waiting", time_now_ms() - t0, false);
+  if (ctx == NULL || !icons_loaded || !font_loaded) {
+    if (icons_loaded) {
+      atlas_close(&atlas);
     }
-    nk_sdl_font_stash_end();
-    nk_style_set_font(ctx, &font->handle);
-  } else {
-    struct nk_font_atlas *atlas;
-    nk_sdl_font_stash_begin(&atlas);
-    nk_sdl_font_stash_end();
+    return NULL;
   }
 
-  GUI.icon_size = nk_vec2(64, 64);
-
-  char *filepath = str_concat_new(CONFIG.FILEPATH_RSRC, "icons/ionic-column.png");
-  GUI.construction_icon = nk_image_load(filepath);
-  free(filepath);
+  // Font and icons share one texture so they are drawn in a single batch
+  t0 = time_now_ms();
+  const struct nk_image icons = nk_sdl_font_stash_end_shared(atlas.pixels, atlas.header->width, atlas.header->height);
+  startup_log("upload", time_now_ms() - t0, false);
 
-  filepath = str_concat_new(CONFIG.FILEPATH_RSRC, "icons/gladius.png");
-  GUI.military_icon = nk_image_load(filepath);
-  free(filepath);
+  GUI.icon_size = nk_vec2(64, 64);
+  GUI.construction_icon = gui_icon(&atlas, icons, "ionic-column");
+  GUI.military_icon = gui_icon(&atlas, icons, "gladius");
+  GUI.diplomatic_icon = gui_icon(&atlas, icons, "wax-tablet");
+  GUI.political_icon = gui_icon(&atlas, icons, "caesar");
+  GUI.construction_detail_icon = gui_icon(&atlas, icons, "organigram");
+  atlas_close(&atlas);
+
+  return ctx;
+}
 
-  filepath = str_concat_new(CONFIG.FILEPATH_RSRC, "icons/wax-tablet.png");
-  GUI.diplomatic_icon = nk_image_load(filepath);
-  free(filepath);
+int main(int argc, char **argv) {
+  // --replay <file> plays back a recorded game without a window and exits,
+  // --trace <file> writes the state hash of every timestep of the replay and
+  // --golden <file> checks them against a previously written trace,
+  // --cook <json> <blob> cooks a content catalogue and exits,
+  // --cook-atlas <folder> <blob> packs the icons of folder into an atlas and exits,
+  // --embed <c file> <name>=<path>... writes the assets to compile in and exits
+  const char *replay_filepath = NULL;
+  const char *trace_filepath = NULL;
+  const char *golden_filepath = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_filepath = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_filepath = argv[++i];
+    } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+      golden_filepath = argv[++i];
+    } else if (strcmp(argv[i], "--cook") == 0 && i + 2 < argc) {
+      return catalogue_cook(argv[i + 1], argv[i + 2]) ? 0 : 1;
+    } else if (strcmp(argv[i], "--cook-atlas") == 0 && i + 2 < argc) {
+      return atlas_cook(argv[i + 1], argv[i + 2]) ? 0 : 1;
+    } else if (strcmp(argv[i], "--embed") == 0 && i + 1 < argc) {
+      return embed_assets(argv[i + 1], &argv[i + 2], argc - i - 2) ? 0 : 1;
+    }
+  }
 
-  filepath = str_concat_new(CONFIG.FILEPATH_RSRC, "icons/caesar.png");
-  GUI.political_icon = nk_image_load(filepath);
-  free(filepath);
+  startup.start = time_now_ms();
+  parse_config_file();
+  startup_log("config", time_now_ms() - startup.start, false);
+  double t0 = time_now_ms();
+  if (!catalogue_load(&catalogue, CONFIG.FILEPATH_RSRC, CONFIG.CATALOGUE)) {
+    return 1;
+  }
+  startup_log("catalogue", time_now_ms() - t0, false);
+  uint64_t seed = time(NULL);
+  static struct ReplayPlayer replay;
+  if (replay_filepath) {
+    if (!replay_player_open(&replay, replay_filepath)) {
+      return 1;
+    }
+    seed = replay.header.seed;
+    date = replay.header.start_date;
+    CONFIG.EVENTLOG_CAPACITY = replay.header.eventlog_capacity;
+    CONFIG.DIFFICULTY = replay.header.difficulty;
+    if (replay.header.catalogue_hash != catalogue.header->hash) {
+      fprintf(stderr, "[ColoniaC]: The replay was recorded with another content catalogue \n");
+      return 1;
+    }
+  }
+  random_seed(seed);
 
-  filepath = str_concat_new(CONFIG.FILEPATH_RSRC, "icons/organigram.png");
-  GUI.construction_detail_icon = nk_image_load(filepath);
-  free(filepath);
+  SDL_Window *sdl_window = NULL;
+  struct nk_context *ctx = NULL;
+  if (replay_filepath == NULL) {
+    ctx = gui_init(&sdl_window);
+    if (ctx == NULL) {
+      return -1;
+    }
+  }
 
   struct City *cities = (struct City *)calloc(2, sizeof(struct City));
 
@@ -2153,443 +9624,194 @@ int main(void) {
   city->produce_values[Grapes] = 0.125f;
   city->produce_values[Wheat] = 0.55f;
   city->produce_values[Olives] = 0.25f;
-  struct EventLog log = eventlog_new();
+  struct EventLog log = eventlog_new(CONFIG.EVENTLOG_CAPACITY);
+  static struct Journal journal;
+  if (replay_filepath == NULL && journal_open(&journal, CONFIG.FILEPATH_SAVE, CONFIG.COMPRESSION, 0, 0)) {
+    log.journal = &journal;
+  }
+  static struct Autosave autosave;
+  autosave_open(&autosave, CONFIG.FILEPATH_SAVE, replay_filepath ? 0 : CONFIG.AUTOSAVE_SLOTS,
+                CONFIG.AUTOSAVE_CHECKPOINT_INTERVAL);
   city->log = &log;
   city->cursus_honorum = (struct CursusHonorum *)calloc(sizeof(struct CursusHonorum), 1);
+  city->cursus_honorum->aedile_assigned_construction = COMPONENT_NONE;
+  city->components = components_new();
 
-  struct Effect port_ostia_construction_effect = {.name_str = "Port Ostia",
-                                                  .description_str = "",
-                                                  .tick_effect = &port_ostia_tick_effect,
-                                                  .duration = FOREVER};
-
-  struct Construction port_ostia = {
-      .name_str = "Port Ostia",
-      .description_str = "Enables import and export of foodstuffs to Rome.",
-      .help_str = port_ostia_help_str[CONFIG.LANGUAGE],
-      .cost = 100.0f,
-      .maintenance = 1.0f,
-      .construction_time = 12 * 30,
-      .effect = &port_ostia_construction_effect,
-      .num_effects = 1};
-
-  struct Effect aqueduct_valens_construction_effect = {
-      .name_str = "Aqueduct of Valens",
-      .duration = FOREVER,
-      .tick_effect = aqueduct_tick_effect};
-
-  struct Effect aqueduct_appia_construction_effect = {
-      .name_str = "Aqueduct Appia",
-      .duration = FOREVER,
-      .tick_effect = aqueduct_tick_effect};
-
-  struct Effect aqueduct_construction_effects[2] = {
-      aqueduct_valens_construction_effect, aqueduct_appia_construction_effect};
-
-  struct Construction aqueduct = {
-      .name_str = "Aqueduct",
-      .help_str = aqueduct_help_str[CONFIG.LANGUAGE],
-      .description_str = aqueduct_description_strs[CONFIG.LANGUAGE],
-      .cost = 25.0f,
-      .maintenance = 0.2f,
-      .construction_time = 6 * 30,
-      .unique_effects = true,
-      .effect = aqueduct_construction_effects,
-      .num_effects = 2};
-
-  // TODO: Plot food production of the year (year report?)
-  struct FarmArgument grape_farm_arg = {
-      .produce = Grapes,
-      .area = 1,
-      .p0 = uniform_random(),
-      .p1 = 0.25f + (uniform_random() / 20.0f)};
-
-  struct Effect grape_farm_construction_effect = {
-      .name_str = "Grape farm",
-      .description_str = "piece of land that produces grapes",
-      .duration = FOREVER,
-      .arg = &grape_farm_arg,
-      .tick_effect = farm_tick_effect};
-
-  struct FarmArgument wheat_farm_arg = {
-      .produce = Wheat,
-      .area = 1,
-      .p0 = uniform_random(),
-      .p1 = 0.25f + (uniform_random() / 20.0f)};
-
-  struct Effect wheat_farm_construction_effect = {
-      .name_str = "Wheat farm",
-      .description_str = "piece of land that produces wheat",
-      .duration = FOREVER,
-      .arg = &wheat_farm_arg,
-      .tick_effect = farm_tick_effect};
-
-  struct FarmArgument olive_farm_arg = {
-      .produce = Olives,
-      .area = 1,
-      .p0 = uniform_random(),
-      .p1 = 0.25f + (uniform_random() / 20.0f)};
-
-  struct Effect olive_farm_construction_effect = {
-      .name_str = "Olive farm",
-      .description_str = "piece of land producing olives",
-      .duration = FOREVER,
-      .arg = &olive_farm_arg,
-      .tick_effect = farm_tick_effect};
-
-  struct Effect farm_construction_effects[3] = {grape_farm_construction_effect,
-                                                wheat_farm_construction_effect,
-                                                olive_farm_construction_effect};
-
-  struct Construction farm = {
-      .cost = 2.0f,
-      .construction_time = 10,
-      .maintenance = 0.0f,
-      .name_str = "Farm",
-      .help_str = farm_help_str[CONFIG.LANGUAGE],
-      .description_str = farm_description_strs[CONFIG.LANGUAGE],
-      .unique_effects = true,
-      .effect = farm_construction_effects,
-      .num_effects = 3,
-      .gui_construction_management = gui_farm_construction_management};
-
-  city_add_construction(city, farm);
-
-  struct Effect basilica_construction_effect = {.name_str = "Basilica",
-                                                .duration = FOREVER,
-                                                .tick_effect = basilica_tick_effect};
-
-  struct Construction basilica = {
-      .cost = 15.0f,
-      .maintenance = 0.2f,
-      .construction_time = 3 * 30,
-      .name_str = "Basilica",
-      .help_str = basilica_help_str[CONFIG.LANGUAGE],
-      .description_str = basilica_description_strs[CONFIG.LANGUAGE],
-      .effect = &basilica_construction_effect,
-      .num_effects = 1};
-
-  struct ForumArgument forum_trajan_arg = {.taberna_capacity = 3};
-
-  struct Effect forum_trajan_construction_effect = {
-      .name_str = "Forum of Trajan",
-      .duration = FOREVER,
-      .arg = &forum_trajan_arg,
-      .tick_effect = forum_tick_effect};
-
-  struct Effect forum_effects[] = {forum_trajan_construction_effect};
-
-  struct Construction forum = {
-      .cost = 50.0f,
-      .maintenance = 0.5f,
-      .construction_time = 12 * 30,
-      .name_str = "Forum",
-      .help_str = forum_help_str[CONFIG.LANGUAGE],
-      .description_str = forum_description_strs[CONFIG.LANGUAGE],
-      .gui_construction_management = gui_forum_construction_management,
-      .unique_effects = true,
-      .effect = forum_effects,
-      .num_effects = 1};
-
-  struct Effect coin_mint_construction_effect = {
-      .name_str = "Coin mint",
-      .description_str = coin_mint_description_strs[CONFIG.LANGUAGE],
-      .duration = FOREVER,
-      .tick_effect = coin_mint_tick_effect};
-
-  struct Construction coin_mint = {.cost = 30.0f,
-                                   .maintenance = 0.1f,
-                                   .construction_time = 2 * 30,
-                                   .name_str = "Coin mint",
-                                   .help_str =
-                                       coin_mint_help_str[CONFIG.LANGUAGE],
-                                   .description_str = "Produces coinage.",
-                                   .effect = &coin_mint_construction_effect,
-                                   .num_effects = 1};
-
-  struct Effect temple_of_mars_construction_effect = {
-      .name_str = "Temple of Mars",
-      .description_str = "House of the God of warfare.",
-      .duration = FOREVER,
-      .tick_effect = temple_of_mars_tick_effect};
-
-  struct Effect temple_of_jupiter_construction_effect = {
-      .name_str = "Temple of Jupiter",
-      .description_str = "House of the God ruler",
-      .duration = FOREVER,
-      .tick_effect = temple_of_jupiter_tick_effect};
-
-  struct Effect temple_of_vulcan_construction_effect = {
-      .name_str = "Temple of Vulcan",
-      .description_str = "House of the God of fire and metalworking.",
-      .duration = FOREVER,
-      .tick_effect = temple_of_vulcan_tick_effect};
-
-  struct Effect temple_effects[3] = {temple_of_jupiter_construction_effect,
-                                     temple_of_mars_construction_effect,
-                                     temple_of_vulcan_construction_effect};
-
-  struct Construction temple = {.name_str = "Temple",
-                                .description_str =
-                                    temple_description_strs[CONFIG.LANGUAGE],
-                                .help_str = temple_help_strs[CONFIG.LANGUAGE],
-                                .cost = 25.0f,
-                                .maintenance = 0.12f,
-                                .construction_time = 5 * 30,
-                                .unique_effects = true,
-                                .effect = temple_effects,
-                                .num_effects = 3};
-
-  struct Effect senate_house_construction_effect = {
-      .name_str = "Senate house",
-      .description_str = senate_house_description_strs[CONFIG.LANGUAGE],
-      .duration = FOREVER,
-      .tick_effect = senate_house_tick_effect};
-
-  struct Construction senate_house = {
-      .name_str = "Senate house",
-      .help_str = senate_house_help_str[CONFIG.LANGUAGE],
-      .description_str = senate_house_description_strs[CONFIG.LANGUAGE],
-      .cost = 50.0f,
-      .maintenance = 0.05f,
-      .construction_time = 3 * 30,
-      .unique_effects = true,
-      .effect = &senate_house_construction_effect,
-      .num_effects = 1};
-
-  struct Effect insula_construction_effect = {
-      .name_str = "Insula",
-      .description_str = "+300 population",
-      .duration = 300,
-      .tick_effect = insula_tick_effect};
-
-  struct Construction insula = {.name_str = "Insula",
-                                .help_str = insula_help_str[CONFIG.LANGUAGE],
-                                .description_str =
-                                    insula_description_strs[CONFIG.LANGUAGE],
-                                .cost = 10.0f,
-                                .maintenance = 0.05f,
-                                .construction_time = 60,
-                                .effect = &insula_construction_effect,
-                                .num_effects = 1};
-
-  struct Effect villa_publica_construction_effect = {
-      .name_str = "Villa Publica",
-      .duration = FOREVER,
-      .tick_effect = &villa_publica_tick_effect};
-
-  struct Construction villa_publica = {
-      .name_str = "Villa Publica",
-      .help_str = villa_publica_help_str[CONFIG.LANGUAGE],
-      .description_str = villa_publica_description_strs[CONFIG.LANGUAGE],
-      .cost = 50.0f,
-      .maintenance = 0.25f,
-      .construction_time = 60,
-      .effect = &villa_publica_construction_effect,
-      .num_effects = 1};
-
-  struct Effect circus_maximus_construction_effect = {
-      .name_str = "Circus Maximus",
-      .duration = FOREVER,
-      .tick_effect = &circus_maximus_tick_effect};
-
-  struct Construction circus_maximus = {
-      .name_str = "Circus Maximus",
-      .help_str = circus_maximus_help_str[CONFIG.LANGUAGE],
-      .description_str = circus_maximus_description_strs[CONFIG.LANGUAGE],
-      .cost = 100.0f,
-      .maintenance = 1.10f,
-      .construction_time = 12 * 30,
-      .effect = &circus_maximus_construction_effect,
-      .num_effects = 1};
-
-  struct Effect bath_construction_effect = {.duration = FOREVER,
-                                            .tick_effect = &bath_tick_effect};
-
-  struct Construction bath = {.name_str = "Bath house",
-                              .help_str = bath_help_str[CONFIG.LANGUAGE],
-                              .description_str =
-                                  bath_description_strs[CONFIG.LANGUAGE],
-                              .cost = 100.0f,
-                              .maintenance = 0.8f,
-                              .construction_time = 12 * 10,
-                              .effect = &bath_construction_effect,
-                              .num_effects = 1};
-
-  struct Effect taberna_bakery_construction_effect = {
-      .name_str = "Bakery",
-      .description_str = taberna_bakery_help_strs[CONFIG.LANGUAGE],
-      .duration = 0,
-      .tick_effect = taberna_bakery_tick_effect};
-
-  struct Effect taberna_effects[] = {taberna_bakery_construction_effect};
-
-  struct Construction taberna = {.name_str = "Taberna",
-                                 .help_str = taberna_help_strs[CONFIG.LANGUAGE],
-                                 .description_str =
-                                     taberna_description_strs[CONFIG.LANGUAGE],
-                                 .cost = 5.0f,
-                                 .maintenance = 0.0f,
-                                 .construction_time = 30,
-                                 .effect = taberna_effects,
-                                 .num_effects = 1};
-
-  city_add_construction_project(city, insula);
-  city_add_construction_project(city, senate_house);
-  city_add_construction_project(city, aqueduct);
-  city_add_construction_project(city, farm);
-  city_add_construction_project(city, basilica);
-  city_add_construction_project(city, forum);
-  city_add_construction_project(city, coin_mint);
-  city_add_construction_project(city, temple);
-  city_add_construction_project(city, port_ostia);
-  city_add_construction_project(city, circus_maximus);
-  city_add_construction_project(city, villa_publica);
-  city_add_construction_project(city, taberna);
-  city_add_construction_project(city, bath);
+  catalogue_instantiate(&catalogue, city);
 
   struct Effect pops_food_eating = {.duration = FOREVER};
-  pops_food_eating.tick_effect = pops_eating_tick_effect;
+  pops_food_eating.tick_effect = TICK_EFFECT_POPS_EATING;
 
   struct Effect emperor_gold_demands = {.duration = FOREVER};
-  emperor_gold_demands.tick_effect = imperator_demands_money;
+  emperor_gold_demands.tick_effect = TICK_EFFECT_IMPERATOR_DEMANDS_MONEY;
 
   struct Effect building_maintenance = {.duration = FOREVER};
-  building_maintenance.tick_effect = building_maintenance_tick_effect;
+  building_maintenance.tick_effect = TICK_EFFECT_BUILDING_MAINTENANCE;
 
   struct Effect event_log_tester = {.duration = FOREVER};
   event_log_tester.name_str = "Debug Event";
   event_log_tester.description_str = "Testing the event log";
-  event_log_tester.tick_effect = event_log_test_effect;
+  event_log_tester.tick_effect = TICK_EFFECT_EVENT_LOG_TEST;
 
   city_add_effect(city, event_log_tester);
   city_add_effect(city, pops_food_eating);
   city_add_effect(city, emperor_gold_demands);
   city_add_effect(city, building_maintenance);
 
-  /// Laws
-  struct LandTaxArgument land_tax_arg = {.tax_percentage = 0.2f};
-
-  struct Effect land_tax_effect = {.duration = FOREVER,
-                                   .arg = &land_tax_arg,
-                                   .tick_effect = &land_tax_tick_effect};
-
-  struct Law land_tax = {.name_str = "Lex Tributum Soli",
-                         .description_str =
-                             "Roman land tax based on size of the land. Costs"
-                             "1 Poltical power of the course of 3 months.",
-                         .cost = 1,
-                         .cost_lng = 3 * 30,
-                         .type = Political,
-                         .effect = &land_tax_effect};
-
-  city->num_available_laws_capacity = 1;
-  city->available_laws = (struct Law *)calloc(
-      sizeof(struct Law), city->num_available_laws_capacity);
-
-  city_add_law(city, land_tax);
+  if (replay_filepath) {
+    static struct StateTrace trace;
+    static struct StateTrace golden;
+    if ((trace_filepath && !state_trace_create(&trace, trace_filepath)) ||
+        (golden_filepath && !state_trace_open(&golden, golden_filepath))) {
+      return 1;
+    }
+    const bool success = replay_player_run(&replay, cities, trace_filepath ? &trace : NULL,
+                                           golden_filepath ? &golden : NULL);
+    state_trace_close(&trace);
+    state_trace_close(&golden);
+    return success ? 0 : 1;
+  }
+  static struct Rewind rewind;
+  rewind_open(&rewind, (size_t)CONFIG.REWIND_BUDGET_MB * 1024 * 1024, CONFIG.REWIND_INTERVAL);
+  if (CONFIG.RECORD_REPLAY) {
+    char *replay_path = str_concat_new(CONFIG.FILEPATH_SAVE, REPLAY_FILENAME);
+    replay_recorder_open(&replay_recorder, replay_path, seed);
+    free(replay_path);
+  }
 
   bool quit = false;
   bool pause = false; // Pauses simulation when window goes inactive
+  bool show_ingame_menu = false;
 
-  struct timeval t0;
-  struct timeval t1;
-  gettimeofday(&t0, NULL);
+  static struct FrameScheduler frames;
+  frame_scheduler_init(&frames, CONFIG.FPS_CAP);
   uint8_t cidx = 0;
 
   while (!quit) {
-    gettimeofday(&t1, NULL);
-    uint64_t dt = ((t1.tv_sec * 1000) + (t1.tv_usec / 1000)) -
-                  ((t0.tv_sec * 1000) + (t0.tv_usec / 1000));
-
-    if (!pause) {
-      const uint32_t ms_per_timestep = ms_per_timestep_for(simulation_speed);
-      if (dt >= ms_per_timestep && ms_per_timestep != 0) {
-        struct City *c = &cities[cidx];
-        struct City *c1 = &cities[(cidx + 1) % 2];
-        simulate_next_timestep(c, c1);
-        cidx = (cidx + 1) % 2;
-        t0 = t1;
+    const uint32_t ms_per_timestep = pause ? 0 : ms_per_timestep_for(simulation_speed);
+    if (frame_timestep_due(&frames, ms_per_timestep, time_now_ms())) {
+      struct City *c = &cities[cidx];
+      struct City *c1 = &cities[(cidx + 1) % 2];
+      const uint32_t month = date.month;
+      simulate_next_timestep(c, c1);
+      cidx = (cidx + 1) % 2;
+      rewind_record(&rewind, c1);
+      history_record(&history, c1);
+      replay_recorder_tick(&replay_recorder, c1);
+      if (date.month != month) {
+        autosave_request(&autosave, c1);
+        replay_recorder_checkpoint(&replay_recorder, c1);
       }
-    } else {
-      SDL_Delay(1000);
     }
 
+    frame_wait(&frames, ms_per_timestep);
+    if (!frame_begin(&frames)) {
+      continue;
+    }
+    frame_arena_reset();
+
     /* Input */
     SDL_Event evt;
     nk_input_begin(ctx);
     while (SDL_PollEvent(&evt)) {
       if (evt.type == SDL_QUIT) {
-        return 0;
+        quit = true;
+        break;
       }
       if (evt.type == SDL_WINDOWEVENT) {
         switch (evt.window.event) {
         case SDL_WINDOWEVENT_FOCUS_LOST:
           pause = true;
+          command_issue(&cities[cidx], COMMAND_PAUSE, 1, 0);
           break;
         case SDL_WINDOWEVENT_FOCUS_GAINED:
           pause = false;
+          command_issue(&cities[cidx], COMMAND_PAUSE, 0, 0);
+          break;
+        case SDL_WINDOWEVENT_EXPOSED:
+          nk_sdl_invalidate(); // Contents of the window were lost
           break;
         }
       }
       if (evt.type == SDL_KEYDOWN) {
+        int32_t speed = -1;
         switch (evt.key.keysym.sym) {
         case SDLK_ESCAPE:
-          gui_ingame_menu(&cities[cidx], ctx);
-          return 0;
+          show_ingame_menu = !show_ingame_menu;
+          if (show_ingame_menu) {
+            nk_window_show(ctx, "Menu", NK_SHOWN); // Reopen if closed from its title bar
+          }
           break;
         case SDLK_SPACE:
-          if (simulation_speed == 0) {
-            simulation_speed = 5; // TODO: last_simulation_speed;
-          } else {
-            simulation_speed = 0;
-          }
+          speed = simulation_speed == 0 ? 5 : 0; // TODO: last_simulation_speed;
           break;
         case SDLK_0:
-          simulation_speed = 0;
+          speed = 0;
           break;
         case SDLK_1:
-          simulation_speed = 1;
+          speed = 1;
           break;
         case SDLK_2:
-          simulation_speed = 2;
+          speed = 2;
           break;
         case SDLK_3:
-          simulation_speed = 3;
+          speed = 3;
           break;
         case SDLK_4:
-          simulation_speed = 4;
+          speed = 4;
           break;
         case SDLK_5:
-          simulation_speed = 5;
+          speed = 5;
           break;
         case SDLK_6:
-          simulation_speed = 6;
+          speed = 6;
           break;
         case SDLK_7:
-          simulation_speed = 7;
+          speed = 7;
           break;
         case SDLK_8:
-          simulation_speed = 8;
+          speed = 8;
           break;
         case SDLK_9:
-          simulation_speed = 9;
+          speed = 9;
           break;
         }
+        if (speed >= 0) {
+          command_issue(&cities[cidx], COMMAND_SET_SPEED, speed, 0);
+        }
       }
       nk_sdl_handle_event(&evt);
     }
     nk_input_end(ctx);
+    if (quit) {
+      break; // Window closed, shut down below
+    }
     update_gui(&cities[cidx], ctx);
+    if (show_ingame_menu) {
+      quit = gui_ingame_menu(&cities[cidx], ctx);
+    }
+#ifdef DEBUG
+    gui_debug_overlay(ctx, &autosave);
+    gui_rewind(ctx, &rewind, &cities[cidx]);
+#endif
     SDL_GetWindowSize(sdl_window, &CONFIG.RESOLUTION.width, &CONFIG.RESOLUTION.height);
     glViewport(0, 0, CONFIG.RESOLUTION.width, CONFIG.RESOLUTION.height);
     glClear(GL_COLOR_BUFFER_BIT);
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    nk_sdl_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_MEMORY, MAX_ELEMENT_MEMORY);
-    SDL_GL_SwapWindow(sdl_window);
+    if (nk_sdl_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_MEMORY, MAX_ELEMENT_MEMORY)) {
+      SDL_GL_SwapWindow(sdl_window);
+      startup_print();
+    }
+    frame_end(&frames, ctx);
 
     // TODO: Handle end of game states
     enum GameState game_state = check_gamestate(&cities[cidx]);
   }
+  replay_recorder_close(&replay_recorder, &cities[cidx]);
+  rewind_close(&rewind);
+  autosave_close(&autosave);
+  catalogue_close(&catalogue);
+  journal_close(&journal);
   if (CONFIG.FILEPATH_ROOT) {
     free((void *)CONFIG.FILEPATH_ROOT);
   }
@@ -2599,6 +9821,7 @@ int main(void) {
   if (CONFIG.FILEPATH_SAVE) {
     free((void *)CONFIG.FILEPATH_SAVE);
   }
+  free((void *)CONFIG.CATALOGUE);
   SDL_Quit();
   // TODO: Make sure to clean up some library calls in order to make valgrinding this a bit easier later on
   return 0;
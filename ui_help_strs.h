@@ -87,6 +87,21 @@ const char *coin_mint_description_strs[NUM_LANGUAGES] = {""};
 
 const char *senate_house_description_strs[NUM_LANGUAGES] = {""};
 
+// ----- EVENT LOG STRINGS -----
+// Event log strings are printf formats used to display the structured events
+// of the event log, their arguments are documented per string.
+
+// %s: construction name
+const char *event_construction_started_strs[NUM_LANGUAGES] = {
+    "Building of %s started .."};
+
+// %s: construction name
+const char *event_construction_finished_strs[NUM_LANGUAGES] = {
+    "Finished construction of a %s"};
+
+// %d: message number
+const char *event_debug_strs[NUM_LANGUAGES] = {"Message #%d"};
+
 // ----- HISTORICAL TIDBITS STRINGS -----
 // Historical strings give a short-ish historically relevant description
 // regarding their subject
@@ -101,3 +116,46 @@ const char *coin_mint_tidbit_strs[NUM_LANGUAGES] = {
 const char *insula_tidbit_strs[NUM_LANGUAGES] = {
     "In Rome these multistory apartment complexes was a common housing "
     "situation for the city's inhabitants."};
+
+// ----- STRING KEYS -----
+// Strings referenced by their key from the content catalogue
+// (resources/catalogue.json), where text starting with '@' is a key
+
+struct UiStringKey {
+  const char *key;
+  const char **strs;
+};
+
+const struct UiStringKey ui_string_keys[] = {
+    {"aqueduct_help_str", aqueduct_help_str},
+    {"basilica_help_str", basilica_help_str},
+    {"farm_help_str", farm_help_str},
+    {"senate_house_help_str", senate_house_help_str},
+    {"temple_help_strs", temple_help_strs},
+    {"coin_mint_help_str", coin_mint_help_str},
+    {"insula_help_str", insula_help_str},
+    {"forum_help_str", forum_help_str},
+    {"port_ostia_help_str", port_ostia_help_str},
+    {"bakery_help_str", bakery_help_str},
+    {"circus_maximus_help_str", circus_maximus_help_str},
+    {"villa_publica_help_str", villa_publica_help_str},
+    {"bath_help_str", bath_help_str},
+    {"taberna_help_strs", taberna_help_strs},
+    {"taberna_bakery_help_strs", taberna_bakery_help_strs},
+    {"aqueduct_description_strs", aqueduct_description_strs},
+    {"basilica_description_strs", basilica_description_strs},
+    {"bath_description_strs", bath_description_strs},
+    {"circus_maximus_description_strs", circus_maximus_description_strs},
+    {"villa_publica_description_strs", villa_publica_description_strs},
+    {"farm_description_strs", farm_description_strs},
+    {"forum_description_strs", forum_description_strs},
+    {"insula_description_strs", insula_description_strs},
+    {"taberna_description_strs", taberna_description_strs},
+    {"temple_description_strs", temple_description_strs},
+    {"coin_mint_description_strs", coin_mint_description_strs},
+    {"senate_house_description_strs", senate_house_description_strs},
+    {"aqueduct_tidbit_strs", aqueduct_tidbit_strs},
+    {"coin_mint_tidbit_strs", coin_mint_tidbit_strs},
+    {"insula_tidbit_strs", insula_tidbit_strs}};
+
+#define NUM_UI_STRING_KEYS (sizeof(ui_string_keys) / sizeof(ui_string_keys[0]))